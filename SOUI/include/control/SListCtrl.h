@@ -3,6 +3,7 @@
 
 #include "core/SPanel.h"
 #include "SHeaderCtrl.h"
+#include "helper/SIndexView.h"
 
 SNSBEGIN
 
@@ -75,6 +76,13 @@ typedef struct DXLVITEM
     BOOL checked;           /**< Check state */
 } DXLVITEM;
 
+/**
+ * @typedef PFNLVFILTER
+ * @brief Filter function type
+ * @details Function pointer type for the function deciding whether an item is shown. It receives the context and a pointer to the DXLVITEM.
+ */
+typedef BOOL(__cdecl *PFNLVFILTER)(void *, const DXLVITEM *);
+
 /**
  * @class SListCtrl
  * @brief List Control
@@ -225,9 +233,55 @@ class SOUI_EXP SListCtrl : public SPanel {
      * @param pfnCompare Comparison function
      * @param pContext Context for the comparison function
      * @return TRUE if successful, FALSE otherwise
+     * @details The items are reordered, so their indexes change. The sort is stable and the selected item stays selected.
+     *          pfnCompare is always called on the calling thread.
      */
     BOOL SortItems(PFNLVCOMPAREEX pfnCompare, void *pContext);
 
+    /**
+     * @brief Keep the displayed rows sorted by a comparison function
+     * @param pfnCompare Comparison function receiving two DXLVITEM pointers, NULL to show items in index order
+     * @param pContext Context for the comparison function
+     * @details Unlike SortItems, items keep their indexes and only the display order changes. Inserted and modified
+     *          items are moved to their place without sorting the whole list again. Items comparing equal are shown in index order.
+     *          Large lists are sorted on several threads, so pfnCompare must be thread safe and only read the items.
+     */
+    void SetSortView(PFNLVCOMPAREEX pfnCompare, void *pContext);
+
+    /**
+     * @brief Show only the items accepted by a filter function
+     * @param pfnFilter Filter function, NULL to show all items
+     * @param pContext Context for the filter function
+     * @details Hidden items keep their indexes, data and check state.
+     */
+    void SetFilter(PFNLVFILTER pfnFilter, void *pContext);
+
+    /**
+     * @brief Sort and filter all items again
+     * @details Call it after the criteria used by the sort view or the filter change.
+     */
+    void UpdateView();
+
+    /**
+     * @brief Get the number of displayed rows
+     * @return Number of items that pass the filter
+     */
+    int GetShowCount() const;
+
+    /**
+     * @brief Get the item displayed at a row
+     * @param iShow Row index
+     * @return Index of the item, or -1 if iShow is out of range
+     */
+    int GetItemByShowIndex(int iShow) const;
+
+    /**
+     * @brief Get the row at which an item is displayed
+     * @param nItem Index of the item
+     * @return Row index, or -1 if the item is hidden by the filter
+     */
+    int GetItemShowIndex(int nItem) const;
+
     /**
      * @brief Get the check state of an item
      * @param nItem Index of the item
@@ -310,8 +364,8 @@ class SOUI_EXP SListCtrl : public SPanel {
     int HitTest(const CPoint &pt);
 
     /**
-     * @brief Get the index of the top visible item
-     * @return Index of the top visible item
+     * @brief Get the row index of the top visible item
+     * @return Row index of the top visible item
      */
     int GetTopIndex() const;
 
@@ -454,6 +508,23 @@ class SOUI_EXP SListCtrl : public SPanel {
      */
     BOOL HitCheckBox(const CPoint &pt);
 
+    /**
+     * @brief Move an item to its row after its content changed
+     * @param nItem Index of the item
+     * @param iOldShow Show index of the item before its content changed
+     */
+    void UpdateItemView(int nItem, int iOldShow);
+
+    /**
+     * @brief Comparison callback of the sort view
+     */
+    static int __cdecl ViewCompareProc(void *pCtx, int iItem1, int iItem2);
+
+    /**
+     * @brief Filter callback of the view
+     */
+    static BOOL __cdecl ViewFilterProc(void *pCtx, int iItem);
+
   protected:
     SLayoutSize m_nHeaderHeight; /**< Height of the header */
     SLayoutSize m_nItemHeight;   /**< Height of the items */
@@ -485,6 +556,12 @@ class SOUI_EXP SListCtrl : public SPanel {
     ArrLvItem m_arrItems;   /**< Array of items */
     CPoint m_ptOrigin;      /**< Origin point */
 
+    SIndexView m_view;               /**< Rows displayed, mapped to item indexes */
+    PFNLVCOMPAREEX m_pfnViewCompare; /**< Comparison function of the sort view */
+    void *m_pViewCompareCtx;         /**< Context for m_pfnViewCompare */
+    PFNLVFILTER m_pfnFilter;         /**< Filter function */
+    void *m_pFilterCtx;              /**< Context for m_pfnFilter */
+
   protected:
     SOUI_ATTRS_BEGIN()
         ATTR_LAYOUTSIZE(L"headerHeight", m_nHeaderHeight, FALSE)
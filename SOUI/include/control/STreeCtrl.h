@@ -70,6 +70,9 @@ typedef struct tagTVITEM
     int nContentWidth;     /**< Content width of the item. */
     DWORD dwToggleState;   /**< Toggle state of the item. */
     DWORD dwCheckBoxState; /**< Checkbox state of the item. */
+    int nSubRows;          /**< Rows shown by the item and its expanded descendants when the item is visible. */
+    int nSubWidth;         /**< Maximum width, indent included, of those rows. */
+    int iSibling;          /**< Position among the siblings, valid while the parent has a SiblingRows index. */
 
     /**
      * @brief Constructor for TVITEM.
@@ -89,6 +92,9 @@ typedef struct tagTVITEM
         nContentWidth = 0;
         dwToggleState = WndState_Normal;
         dwCheckBoxState = WndState_Normal;
+        nSubRows = 1;
+        nSubWidth = 0;
+        iSibling = -1;
     }
 
 } TVITEM, *LPTVITEM;
@@ -394,6 +400,20 @@ class SOUI_EXP STreeCtrl
      */
     HSTREEITEM HitTest(CPoint &pt);
 
+    /**
+     * @brief Starts a batch of insertions.
+     * @details Until the matching EndBatchInsert, inserted items are not measured and the scroll bars
+     *          are not updated. Calls can be nested.
+     */
+    void BeginBatchInsert();
+
+    /**
+     * @brief Ends a batch of insertions.
+     * @details The outermost call measures the items inserted during the batch, recomputes the content
+     *          width once and updates the scroll bars.
+     */
+    void EndBatchInsert();
+
     /**
      * @brief Gets the text of an item.
      * @param hItem Handle to the item.
@@ -407,7 +427,12 @@ class SOUI_EXP STreeCtrl
 
   protected:
     void CalcItemWidth(IRenderTarget *pRT, HSTREEITEM hItem, DWORD dwFlags);
-    void RecalcItemsWidth();
+
+    /**
+     * @brief Measures the content width of items with one render target.
+     * @param bPendingOnly TRUE to measure only the items inserted during a batch.
+     */
+    void RecalcItemsWidth(BOOL bPendingOnly = FALSE);
     /**
      * @brief Handles the page up action.
      */
@@ -518,6 +543,12 @@ class SOUI_EXP STreeCtrl
      */
     virtual void CalcItemContentWidth(LPTVITEM pItem);
 
+    /**
+     * @brief Calculates the content width of an item, or marks it to be measured when the batch ends.
+     * @param pItem Pointer to the item data.
+     */
+    void UpdateItemContentWidth(LPTVITEM pItem);
+
     /**
      * @brief Calculates the width of an item.
      * @param pItem Pointer to the item data.
@@ -529,9 +560,31 @@ class SOUI_EXP STreeCtrl
      * @brief Calculates the maximum width of an item and its children.
      * @param hItem Handle to the item.
      * @return Maximum width of the item and its children.
+     * @details Reads the nSubWidth of the item, or of the root items for STVI_ROOT.
      */
     virtual int CalcMaxItemWidth(HSTREEITEM hItem);
 
+    /**
+     * @brief Recomputes nSubRows and nSubWidth of an item from its children.
+     * @param hItem Handle to the item.
+     * @param bPropagate TRUE to pass the change to the ancestors.
+     */
+    void UpdateItemStat(HSTREEITEM hItem, BOOL bPropagate = TRUE);
+
+    /**
+     * @brief Passes a change of a child's nSubRows and nSubWidth up to its ancestors.
+     * @param hParent Handle to the parent of the changed child, STVI_ROOT or NULL for root items.
+     * @param nDeltaRows Change of the child's nSubRows.
+     * @param nOldWidth nSubWidth of the child before the change, 0 for a new child.
+     * @param nNewWidth nSubWidth of the child after the change, 0 for a removed child.
+     */
+    void PropagateItemStat(HSTREEITEM hParent, int nDeltaRows, int nOldWidth, int nNewWidth);
+
+    /**
+     * @brief Recomputes nSubRows and nSubWidth of all items, the visible item count and the content width.
+     */
+    void UpdateAllItemsStat();
+
     /**
      * @brief Updates the content width of the tree.
      */
@@ -540,10 +593,68 @@ class SOUI_EXP STreeCtrl
     /**
      * @brief Gets the index of an item in the visible list.
      * @param hItemObj Handle to the item.
-     * @return Index of the item in the visible list.
+     * @return Index of the item in the visible list, -1 if the item is hidden.
      */
     int GetItemShowIndex(HSTREEITEM hItemObj);
 
+    /**
+     * @brief Gets the item at an index of the visible list.
+     * @param iIndex Index in the visible list.
+     * @return Handle to the item, or NULL if the index is out of range.
+     */
+    HSTREEITEM GetItemByShowIndex(int iIndex);
+
+    /**
+     * @struct SiblingRows
+     * @brief Order statistics of the children of one item, used to convert between items and show indexes.
+     * @details arrSums is a Fenwick tree over the nSubRows of arrItems, so the rows before a child and the
+     *          child holding a row are found in O(log n). A change of nSubRows updates it in O(log n),
+     *          appending a child extends it; other structural changes drop it and it is rebuilt on the next query.
+     */
+    struct SiblingRows
+    {
+        SArray<HSTREEITEM> arrItems; /**< Children in order. */
+        SArray<int> arrSums;         /**< Fenwick tree of nSubRows, arrSums[i] covers arrItems(i-lowbit(i), i], 1-based. */
+    };
+
+    /**
+     * @brief Gets the order statistics of the children of an item, building them if needed.
+     * @param hParent Handle to the parent item, STVI_ROOT for the root items.
+     * @return Pointer to the order statistics.
+     */
+    SiblingRows *GetSiblingRows(HSTREEITEM hParent);
+
+    /**
+     * @brief Drops the order statistics of the children of an item.
+     * @param hParent Handle to the parent item, STVI_ROOT for the root items.
+     */
+    void InvalidSiblingRows(HSTREEITEM hParent);
+
+    /**
+     * @brief Drops the order statistics of all items.
+     */
+    void ClearSiblingRows();
+
+    /**
+     * @brief Passes a change of an item's nSubRows to the order statistics of its siblings.
+     * @param hItem Handle to the item.
+     * @param nDeltaRows Change of nSubRows.
+     */
+    void UpdateSiblingRows(HSTREEITEM hItem, int nDeltaRows);
+
+    /**
+     * @brief Records a new child in the order statistics of its parent.
+     * @param hItem Handle to the inserted item.
+     */
+    void OnSiblingInserted(HSTREEITEM hItem);
+
+    /**
+     * @brief Gets the next item in the visible list.
+     * @param hItem Handle to a visible item.
+     * @return Handle to the next visible item, or NULL.
+     */
+    HSTREEITEM GetNextShowItem(HSTREEITEM hItem);
+
     /**
      * @brief Gets the rectangle of an item.
      * @param pItem Pointer to the item data.
@@ -675,6 +786,16 @@ class SOUI_EXP STreeCtrl
      */
     int m_nContentWidth;
 
+    /**
+     * @brief Nesting count of BeginBatchInsert.
+     */
+    int m_nBatchInsert;
+
+    /**
+     * @brief Order statistics of children by parent item, see SiblingRows.
+     */
+    SMap<HSTREEITEM, SiblingRows *> m_mapSiblingRows;
+
     /**
      * @brief Mask for item attributes.
      */
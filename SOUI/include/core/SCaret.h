@@ -4,6 +4,7 @@
 #include <interface/scaret-i.h>
 #include <interface/sinterpolator-i.h>
 #include <interface/STimelineHandler-i.h>
+#include <interface/STimer-i.h>
 #include <sobject/Sobject.hpp>
 
 SNSBEGIN
@@ -121,6 +122,29 @@ class SOUI_EXP SCaret
      */
     void Invalidate();
 
+    /**
+     * @brief    Chooses what drives the next frames
+     *
+     * @details  The steady phases (fully shown, and hidden for a non-animated caret) are timed by a
+     *           one-shot timer, so the container's pulse timer only runs while the caret fades.
+     */
+    void UpdateTicker();
+
+    /**
+     * @brief    Gets the end frame of the steady phase the caret is in
+     *
+     * @return   End frame of the steady phase, -1 if the caret is fading.
+     */
+    int GetSteadyPhaseEnd() const;
+
+    /**
+     * @brief    Called when the steady phase timer elapses
+     *
+     * @param    e Timer event.
+     * @return   TRUE
+     */
+    BOOL OnSteadyTimer(IEvtArgs *e);
+
   protected:
     BOOL m_bVisible;                  /**< TRUE if the caret is currently visible. */
     CPoint m_ptCaret;                 /**< Position of the caret. */
@@ -136,6 +160,7 @@ class SOUI_EXP SCaret
     SAutoRefPtr<IInterpolator> m_AniInterpolator; /**< Interpolator for caret animation. */
     ISwndContainer *m_pContainer;                 /**< Pointer to the container window. */
     SWND m_hOwner;                                /**< Handle to the owner window. */
+    SAutoRefPtr<ITimer> m_steadyTimer;            /**< Timer for the steady phases. */
 };
 
 SNSEND
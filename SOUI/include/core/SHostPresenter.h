@@ -92,6 +92,26 @@ class SOUI_EXP SHostPresenter : public TObjRefImpl<IHostPresenter> {
      * @param prcDirty Optional rectangle specifying the area to update.
      */
     void UpdateLayerFromRenderTarget(IRenderTarget *pRT, BYTE byAlpha, LPCRECT prcDirty = NULL);
+
+#ifndef _WIN32
+    /**
+     * @brief Keeps the autoShape window region in step with the presented bitmap.
+     * Only the tiles touched by prcDirty are rescanned, and the window region is left alone
+     * when their alpha mask did not change.
+     * @param hBmp Bitmap selected into the memory DC.
+     * @param prcDirty Presented rectangle, NULL for the whole bitmap.
+     */
+    void UpdateAutoShape(HBITMAP hBmp, LPCRECT prcDirty);
+
+    /**
+     * @brief Drops the cached shape so the next present rebuilds it from scratch.
+     */
+    void ResetAutoShape();
+
+    HRGN m_hRgnShape;               // Current window shape, owned by the presenter
+    SIZE m_szShape;                 // Bitmap size the shape was built for
+    SArray<uint64_t> m_arrTileHash; // Alpha mask hash of each tile, row major
+#endif //_WIN32
 };
 
 SNSEND
@@ -14,11 +14,13 @@
 #include <interface/shostwnd-i.h>
 #include <interface/SHostPresenter-i.h>
 #include <core/SCaret.h>
+#include <core/STimelineDef.h>
 #include <core/SNcPainter.h>
 #include <layout/SLayoutSize.h>
 #include <helper/SplitString.h>
 #include <helper/swndspy.h>
 #include <helper/STimerGenerator.h>
+#include <helper/STimerWheel.h>
 #include <proxy/SNativeWndProxy.h>
 SNSBEGIN
 
@@ -149,6 +151,7 @@ public:
         ATTR_ICON(L"bigIcon", m_hAppIconBig, FALSE)
         ATTR_BOOL(L"allowSpy", m_bAllowSpy, FALSE)
         ATTR_BOOL(L"hasMsgLoop", m_bHasMsgLoop, FALSE)
+        ATTR_BOOL(L"parallelPaint", m_bParallelPaint, FALSE)
         ATTR_ENUM_BEGIN(L"wndType", WndType, FALSE)
             ATTR_ENUM_VALUE(L"undefine", WT_UNDEFINE)
             ATTR_ENUM_VALUE(L"appMain", WT_APPMAIN)
@@ -170,6 +173,7 @@ protected:
     BOOL m_bAllowSpy;        /**< Flag indicating if spy is allowed */
     BOOL m_bSendWheel2Hover; /**< Flag indicating if wheel messages should be sent to the hover window */
     BOOL m_bHasMsgLoop;      /**< Flag indicating if the window has a message loop, affecting tooltip RelayEvent timing */
+    BOOL m_bParallelPaint;   /**< Flag indicating if repaints are recorded and rasterized in parallel, see IRenderTarget::EnableRecording */
     DWORD m_dwStyle;
     DWORD m_dwExStyle;
 
@@ -343,6 +347,8 @@ class SOUI_EXP SHostWnd
     CSize m_szPrev; /**< Previous window size. */
     int m_nAutoSizing; /**< Auto-sizing trigger count for WM_SIZE messages. */
     bool m_bResizing; /**< Indicates if resizing is in progress. */
+    BOOL m_bPulseArmed; /**< Indicates if kPulseTimer is running. */
+    BOOL m_bHostShown; /**< Visibility last seen by _UpdatePulseTimer, used to notify child hosts. */
 
     SAutoRefPtr<IAnimation> m_hostAnimation; /**< Host animation object. */
     DWORD m_AniState; /**< Animation state. */
@@ -394,11 +400,12 @@ class SOUI_EXP SHostWnd
   public:
     enum {
         kPulseTimer = 4321, /**< SOUI timer ID (do not use in applications). */
-        kPulseInterval = 10, /**< Pulse interval in milliseconds. */
+        kPulseInterval = kTimelineInterval, /**< Pulse interval in milliseconds. */
         kNcCheckTimer = 4322, /**< Timer ID for non-client area checks. */
         kNcCheckInterval = 50, /**< Interval for non-client area checks in milliseconds. */
         kTaskTimer = 4323, /**< Timer ID for task execution. */
-        kTaskInterval = 100 /**< Interval for task execution in milliseconds. */
+        kTaskInterval = 100, /**< Interval for task execution in milliseconds. */
+        kSwndTimer = 4324 /**< Timer ID driving the timer wheel of SWindow timers. */
     };
 
     /**
@@ -586,6 +593,13 @@ STDMETHOD_(void, EnablePrivateUiDef)(THIS_ BOOL bEnable) OVERRIDE;
  */
 STDMETHOD_(void, SetScale)(THIS_ int nScale, LPCRECT pDestRect) OVERRIDE;
 
+/**
+ * @brief Queues scaling of the skins used by the host window to a scale it is about to switch to.
+ * 
+ * @param nScale Upcoming scale factor.
+ */
+void PrefetchScale(int nScale);
+
 /**
  * @brief Finds a child window by its name (Unicode version).
  * 
@@ -778,6 +792,39 @@ protected:
         STDMETHOD_(void, OnNextFrame)(THIS_) OVERRIDE;
     } m_hostAnimationHandler;
 
+    /**
+     * @class SHostTimerHandler
+     * @brief Drives the timer wheel of SWindow timers with the host's system timer.
+     */
+    class SHostTimerHandler : public ITimerWheelListener {
+      public:
+        /**
+         * @brief Pointer to the host window.
+         */
+        SHostWnd *m_pHostWnd;
+
+      protected:
+        virtual void OnArmTimer(UINT uElapse);
+        virtual void OnTimerExpired(UINT_PTR uKey);
+    } m_timerHandler;
+
+    STimerWheel m_swndTimers; /**< Timer wheel multiplexing all SWindow timers onto kSwndTimer. */
+
+    SAutoRefPtr<ICaret> m_caretOverlay;       /**< Caret composited over the cached frame. */
+    SWND m_swndCaretOwner;                    /**< Owner of the composited caret. */
+    CRect m_rcCaretOverlay;                   /**< Caret area composited by the last present. */
+    CRect m_rcCaretDirty;                     /**< Caret area waiting to be presented. */
+    SAutoRefPtr<IRenderTarget> m_rtCaretBack; /**< Frame pixels saved from under the caret while presenting. */
+
+    /**
+     * @brief Gets the area of the composited caret, clipped by its owner and by the windows above it.
+     *
+     * @param ppClip Receives the caret area minus partially overlapping windows above the owner,
+     *               NULL when nothing overlaps the caret.
+     * @return Caret area in host coordinates, empty if the caret is not shown.
+     */
+    CRect _GetCaretOverlayRect(IRegionS **ppClip = NULL) const;
+
     /**
      * @brief Called when the host window animation starts.
      * 
@@ -831,6 +878,21 @@ protected: // 辅助函数
      */
     void _Init();
 
+    /**
+     * @brief Starts or stops the pulse timer.
+     *
+     * The pulse only runs while there are timeline handlers and the host is visible and not minimized,
+     * so that a hidden or minimized host does not wake the message loop every kPulseInterval.
+     * A child host follows its ancestors, so when the visibility of this host changes every host
+     * gets UM_UPDATEPULSE and re-evaluates its own pulse.
+     */
+    void _UpdatePulseTimer();
+
+    /**
+     * @brief Tests if the host is visible and neither it nor any parent window is minimized.
+     */
+    BOOL _IsHostShown() const;
+
     /**
      * @brief Excludes the video canvas from painting.
      * 
@@ -1035,6 +1097,24 @@ protected:
      */
     void OnWindowPosChanged(LPWINDOWPOS lpWndPos);
 
+    /**
+     * @brief Handles the WM_SHOWWINDOW message.
+     *
+     * @param bShow Indicates if the window is being shown.
+     * @param nStatus Reason of the change, SW_PARENTOPENING/SW_PARENTCLOSING for owned popups.
+     */
+    void OnShowWindow(BOOL bShow, UINT nStatus);
+
+    /**
+     * @brief Handles the UM_UPDATEPULSE message.
+     *
+     * @param uMsg Message identifier.
+     * @param wp WPARAM.
+     * @param lp LPARAM.
+     * @return LRESULT.
+     */
+    LRESULT OnUpdatePulse(UINT uMsg, WPARAM wp, LPARAM lp);
+
     /**
      * @brief Handles the WM_GETOBJECT message.
      * 
@@ -1265,6 +1345,50 @@ public: // IContainer
      */
     STDMETHOD_(int, RemoveTasksForObject)(THIS_ void *pObj) OVERRIDE;
 
+    /**
+     * @brief Sets a timer for a window.
+     *
+     * @param swnd Handle to the window.
+     * @param id Timer ID.
+     * @param uElapse Timer interval in milliseconds.
+     * @return TRUE if successful.
+     */
+    STDMETHOD_(BOOL, SetSwndTimer)(THIS_ SWND swnd, char id, UINT uElapse) OVERRIDE;
+
+    /**
+     * @brief Kills a timer of a window.
+     *
+     * @param swnd Handle to the window.
+     * @param id Timer ID.
+     * @return TRUE if the timer existed.
+     */
+    STDMETHOD_(BOOL, KillSwndTimer)(THIS_ SWND swnd, char id) OVERRIDE;
+
+    /**
+     * @brief Kills all timers of a window.
+     *
+     * @param swnd Handle to the window.
+     * @return Number of timers killed.
+     */
+    STDMETHOD_(int, KillSwndTimers)(THIS_ SWND swnd) OVERRIDE;
+
+    /**
+     * @brief Composites a caret over the cached frame instead of painting it into the frame.
+     *
+     * @param pCaret Caret to composite, NULL to remove the caret of swndOwner.
+     * @param swndOwner Handle to the window owning the caret.
+     * @return TRUE if the caret is composited by the host.
+     */
+    STDMETHOD_(BOOL, SetCaretOverlay)(THIS_ ICaret *pCaret, SWND swndOwner) OVERRIDE;
+
+    /**
+     * @brief Re-presents the area of the composited caret.
+     *
+     * @param pCaret The caret.
+     * @return TRUE if pCaret is the composited caret.
+     */
+    STDMETHOD_(BOOL, UpdateCaretOverlay)(THIS_ ICaret *pCaret) OVERRIDE;
+
 protected:
     /**
      * @brief Creates a tooltip for the container.
@@ -1387,12 +1511,14 @@ protected:
         MESSAGE_HANDLER_EX(UM_MENUEVENT, OnMenuExEvent)
         MSG_WM_WINDOWPOSCHANGING(OnWindowPosChanging)
         MSG_WM_WINDOWPOSCHANGED(OnWindowPosChanged)
+        MSG_WM_SHOWWINDOW(OnShowWindow)
         MESSAGE_HANDLER_EX(WM_GETOBJECT, OnGetObject)
         MSG_WM_COMMAND(OnCommand)
         MSG_WM_SYSCOMMAND(OnSysCommand)
         MESSAGE_HANDLER_EX(UM_UPDATEFONT, OnUpdateFont)
         MESSAGE_HANDLER_EX(UM_SETLANGUAGE, OnSetLanguage)
         MESSAGE_HANDLER_EX(UM_RUN_TASKS, OnRunTasks)
+        MESSAGE_HANDLER_EX(UM_UPDATEPULSE, OnUpdatePulse)
         CHAIN_MSG_MAP_MEMBER(*m_pNcPainter)
 #if (!DISABLE_SWNDSPY)
         MESSAGE_HANDLER_EX(SPYMSG_SETSPY, OnSpyMsgSetSpy)
@@ -32,6 +32,7 @@ struct IHostProxy
     virtual BOOL IsHostVisible() const = 0;
     virtual CRect GetHostRect() const = 0;
     virtual void InvalidateHostRect(LPCRECT pRc, BOOL bClip) = 0;
+    virtual void MarkHostLayersDirty() = 0; //表项直接绘制到宿主容器时让宿主及其祖先的图层失效
     virtual ISwndContainer *GetHostContainer() = 0;
     virtual void OnLayoutDirty() = 0;
 };
@@ -68,6 +69,10 @@ class SHostProxy : public IHostProxy {
     {
         m_pHost->InvalidateRect(pRc, TRUE, bClip);
     }
+    virtual void MarkHostLayersDirty()
+    {
+        m_pHost->MarkLayersDirty();
+    }
     virtual ISwndContainer *GetHostContainer()
     {
         return m_pHost->GetContainer();
@@ -142,6 +147,15 @@ class SOUI_EXP SOsrPanel
     STDMETHOD_(BOOL, PostTask)(THIS_ IRunnable *runable, BOOL bAsync DEF_VAL(TRUE)) OVERRIDE;
     STDMETHOD_(int, RemoveTasksForObject)(THIS_ void *pObj) OVERRIDE;
 
+    STDMETHOD_(BOOL, SetSwndTimer)(THIS_ SWND swnd, char id, UINT uElapse) OVERRIDE;
+    STDMETHOD_(BOOL, KillSwndTimer)(THIS_ SWND swnd, char id) OVERRIDE;
+    STDMETHOD_(int, KillSwndTimers)(THIS_ SWND swnd) OVERRIDE;
+    STDMETHOD_(BOOL, SetCaretOverlay)(THIS_ ICaret *pCaret, SWND swndOwner) OVERRIDE;
+    STDMETHOD_(BOOL, UpdateCaretOverlay)(THIS_ ICaret *pCaret) OVERRIDE;
+    STDMETHOD_(BOOL, AcquireOffscreenRT)(THIS_ SIZE sz, IRenderTarget **ppRT) OVERRIDE;
+    STDMETHOD_(void, RecycleOffscreenRT)(THIS_ IRenderTarget *pRT) OVERRIDE;
+    STDMETHOD_(void, GetOffscreenRTStats)(THIS_ RtPoolStats *pStats) SCONST OVERRIDE;
+
   public: // SWindow
     virtual LRESULT DoFrameEvent(UINT uMsg, WPARAM wParam, LPARAM lParam);
     virtual void ModifyItemState(DWORD dwStateAdd, DWORD dwStateRemove);
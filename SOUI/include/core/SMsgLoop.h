@@ -135,6 +135,17 @@ class SOUI_EXP SMessageLoop : public TObjRefImpl<IMessageLoop> {
      */
     STDMETHOD_(int, HandleMsg)(THIS) OVERRIDE;
 
+    /**
+     * @brief Gets the wake-up statistics of the message loop.
+     * @param pStats Receives the statistics.
+     */
+    STDMETHOD_(void, GetWakeStats)(THIS_ MsgLoopWakeStats *pStats) const OVERRIDE;
+
+    /**
+     * @brief Resets the wake-up statistics of the message loop.
+     */
+    STDMETHOD_(void, ResetWakeStats)(THIS) OVERRIDE;
+
   public:
     /**
      * @brief Checks if a message is an idle message.
@@ -149,6 +160,12 @@ class SOUI_EXP SMessageLoop : public TObjRefImpl<IMessageLoop> {
      */
     void RunIdle();
 
+    /**
+     * @brief Records why the loop woke up, judged from the first message after a wait.
+     * @param pMsg The first message retrieved after WaitMessage returned.
+     */
+    void AccountWake(const MSG *pMsg);
+
   protected:
     // Flag indicating whether the message loop is running
     BOOL m_bRunning;
@@ -158,6 +175,14 @@ class SOUI_EXP SMessageLoop : public TObjRefImpl<IMessageLoop> {
     BOOL m_bDoIdle;
     // Idle count
     int m_nIdleCount;
+    // Flag indicating the loop has just returned from WaitMessage
+    BOOL m_bWaked;
+    // Flag indicating the pending task timer is armed
+    BOOL m_bTaskTimerArmed;
+    // Flag indicating a WM_NULL has been posted to flush pending tasks
+    BOOL m_bTaskWakePosted;
+    // Wake-up statistics
+    MsgLoopWakeStats m_wakeStats;
 
     // Critical section for thread safety
     SCriticalSection m_cs;
@@ -135,6 +135,12 @@ class SOUI_EXP SNcPainter
      */
     virtual void InvalidateHostRect(LPCRECT pRc, BOOL bClip);
 
+    /**
+     * @brief Marks the retained layers of the host as outdated.
+     * @remark The non-client root has no parent and never retains a layer.
+     */
+    virtual void MarkHostLayersDirty();
+
     /**
      * @brief Gets the host container.
      * @return Pointer to the host container.
@@ -15,7 +15,9 @@
 #define __SOBJECTFACTORY__H__
 
 #include <core/SCmnMap.h>
+#include <xml/SXml.h>
 #include <helper/obj-ref-impl.hpp>
+#include <helper/SCriticalSection.h>
 #include <interface/SObjFactory-i.h>
 
 /**
@@ -52,7 +54,10 @@ class CElementTraits<SObjectInfo> : public CElementTraitsBase<SObjectInfo> {
      */
     static ULONG Hash(INARGTYPE objInfo)
     {
-        ULONG uRet = CElementTraits<SStringW>::Hash(objInfo.szName);
+        // szName is already folded to lower case by ObjInfo_New, hash it in place instead of copying it into a SStringW.
+        ULONG uRet = 0;
+        for (const wchar_t *pch = objInfo.szName; *pch; pch++)
+            uRet = (uRet << 5) + uRet + *pch;
         uRet = (uRet << 5) + objInfo.nType;
         return uRet;
     }
@@ -164,8 +169,17 @@ class SOUI_EXP SObjectFactoryMgr : public SCmnMap<SObjectFactoryPtr, SObjectInfo
     /**
      * @brief Sets default attributes for a given object.
      * @param pObject Pointer to the object.
+     * @param xmlInit XML node the object is going to be initialized from; defaults it sets again are skipped.
      */
-    void SetSwndDefAttr(IObject *pObject) const;
+    void SetSwndDefAttr(IObject *pObject, SXmlNode xmlInit = SXmlNode()) const;
+
+    /**
+     * @brief Registers the XML node the next created window is going to be initialized from.
+     * @param xmlInit XML node, or an empty node to clear it.
+     * @details Kept per thread. Only the next window created by CreateObject on the
+     *          calling thread uses it, windows created by its constructor do not.
+     */
+    void SetPendingInitXml(SXmlNode xmlInit);
 
     /**
      * @brief Gets the base object information from a given object information.
@@ -219,6 +233,15 @@ class SOUI_EXP SObjectFactoryMgr : public SCmnMap<SObjectFactoryPtr, SObjectInfo
      * @param obj Pointer to the object factory.
      */
     static void OnFactoryRemoved(const SObjectFactoryPtr &obj);
+
+    /**
+     * @brief Takes the XML node registered by SetPendingInitXml on the calling thread.
+     * @return The node, or an empty node if none is pending.
+     */
+    SXmlNode TakePendingInitXml() const;
+
+    mutable SMap<tid_t, SXmlNode> m_mapPendingInit; // thread id -> node, see SetPendingInitXml
+    mutable SCriticalSection m_csPendingInit;       // guards m_mapPendingInit
 };
 
 SNSEND
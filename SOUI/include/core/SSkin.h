@@ -60,6 +60,20 @@ class SOUI_EXP SSkinImgList : public SSkinObjBase {
      */
     STDMETHOD_(void, OnColorize)(THIS_ COLORREF cr) OVERRIDE;
 
+    /**
+     * @brief Sets the byte budget of the colorized image cache shared by all image list skins.
+     * @param cbBudget Budget in bytes, 0 disables the cache.
+     * @details Each skin keeps at most four colorized copies of its image, the least recently used
+     *          copies of all skins are dropped when the budget is exceeded. The default budget is 16M.
+     */
+    static void SetColorizedCacheBudget(size_t cbBudget);
+
+    /**
+     * @brief Gets the bytes used by the colorized image cache shared by all image list skins.
+     * @return Bytes used.
+     */
+    static size_t GetColorizedCacheSize();
+
     /**
      * @brief Sets the number of states in the skin.
      * @param nStates Number of states.
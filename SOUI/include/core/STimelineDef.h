@@ -0,0 +1,18 @@
+﻿#ifndef __STIMELINEDEF__H__
+#define __STIMELINEDEF__H__
+
+SNSBEGIN
+
+/**
+ * @brief 时间轴常量
+ * @details 宿主窗口的脉冲定时器按kTimelineInterval驱动ITimelineHandler::OnNextFrame,
+ *          需要在帧数和时间之间换算的对象使用同一个值。
+ */
+enum
+{
+    kTimelineInterval = 10, /**< 时间轴的帧间隔(毫秒) */
+};
+
+SNSEND
+
+#endif // __STIMELINEDEF__H__
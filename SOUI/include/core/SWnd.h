@@ -1714,6 +1714,26 @@ class SOUI_EXP SWindow
      */
     void RedrawRegion(IRenderTarget *pRT, IRegionS *pRgn);
 
+    /**
+     * ReleaseLayerCache
+     * @brief    Drops the retained layer of the window.
+     * @return   void
+     *
+     * Describe  Subtrees that stay unchanged for a few frames are painted once into a retained layer
+     *           and blitted from it afterwards. The container calls this to evict the layer.
+     */
+    void ReleaseLayerCache();
+
+    /**
+     * MarkLayersDirty
+     * @brief    Marks the retained layers of the window and of all its ancestors as outdated.
+     * @return   void
+     *
+     * Describe  InvalidateRect does this on its way up. Content that reaches the screen without
+     *           going through InvalidateRect, such as directly painted item panels, calls it explicitly.
+     */
+    void MarkLayersDirty();
+
     /**
      * GetRenderTarget
      * @brief    Retrieves a memory DC compatible with the SWND window.
@@ -1992,6 +2012,27 @@ class SOUI_EXP SWindow
      */
     void UpdateCacheMode();
 
+    /**
+     * @brief Paints the window and its children from the retained layer, promoting the subtree if it has been stable.
+     * @param pRT Pointer to the RenderTarget, with the window's matrix applied.
+     * @param iZorderBegin Beginning Z-order for rendering.
+     * @param iZorderEnd Ending Z-order for rendering.
+     * @return true if the subtree was painted from the layer.
+     */
+    bool _PaintLayer(IRenderTarget *pRT, UINT iZorderBegin, UINT iZorderEnd);
+
+    /**
+     * @brief Checks if the visible subtree can be retained in a layer of the given rectangle.
+     * @param rcLayer Rectangle of the layer.
+     * @return true if no descendant paints outside rcLayer, is transformed, animating or a video canvas.
+     */
+    bool _CanRetainLayer(const CRect &rcLayer) const;
+
+    /**
+     * @brief Marks the retained layer as outdated.
+     */
+    void _MarkLayerDirty();
+
     /**
      * @brief Tests if the current thread is the main UI thread.
      */
@@ -2490,6 +2531,7 @@ class SOUI_EXP SWindow
         ATTR_CUSTOM(L"cache", OnAttrCache)
         ATTR_CUSTOM(L"alpha", OnAttrAlpha)
         ATTR_BOOL(L"layeredWindow", m_bLayeredWindow, TRUE)
+        ATTR_BOOL(L"retainLayer", m_bRetainLayer, FALSE)
         ATTR_CUSTOM(L"trackMouseEvent", OnAttrTrackMouseEvent)
         ATTR_CUSTOM(L"videoCanvas", OnAttrVideoCanvas)
         ATTR_CUSTOM(L"tip", OnAttrTip)
@@ -2645,6 +2687,15 @@ class SOUI_EXP SWindow
 
     SAutoRefPtr<IAttrStorage> m_attrStorage; /**< Attribute storage object. */
     SAutoRefPtr<ICaret> m_caret;             /**< Caret object. */
+    BOOL m_bCaretOverlay;                    /**< TRUE if the caret is composited by the container instead of painted here. */
+
+    SAutoRefPtr<IRenderTarget> m_layerRT; /**< Retained layer holding the painted subtree. */
+    CRect m_rcLayer;                      /**< Window rectangle when the layer was captured. */
+    BOOL m_bRetainLayer;                  /**< Opts the subtree in to a retained layer (retainLayer="1"). */
+    BOOL m_bLayerValid;                   /**< TRUE if m_layerRT matches the subtree. */
+    BOOL m_bLayerCapturing;               /**< TRUE while the subtree is painted into m_layerRT. */
+    int m_nLayerFrames;                   /**< Paints since the subtree was last invalidated. */
+    int m_nLayerMisses;                   /**< Paints since the layer was last used. */
 
     FunSwndProc m_funSwndProc; /**< Custom window procedure. */
 
@@ -18,6 +18,7 @@
 #include <core/SDropTargetDispatcher.h>
 #include <core/SFocusManager.h>
 #include <core/STimerlineHandlerMgr.h>
+#include <helper/SRenderTargetPool.h>
 
 SNSBEGIN
 
@@ -194,6 +195,59 @@ class SOUI_EXP SwndContainerImpl
      */
     STDMETHOD_(BOOL, UnregisterVideoCanvas)(THIS_ SWND swnd) OVERRIDE;
 
+    /**
+     * @brief Reserves room for the retained layer of a window.
+     * @param swnd Window handle.
+     * @param cbLayer Size of the layer in bytes.
+     * @return TRUE if the layer fits into the budget, least recently used layers are evicted to make room.
+     */
+    STDMETHOD_(BOOL, RetainLayer)(THIS_ SWND swnd, UINT cbLayer) OVERRIDE;
+
+    /**
+     * @brief Gives back the room reserved for the retained layer of a window.
+     * @param swnd Window handle.
+     */
+    STDMETHOD_(void, ReleaseLayer)(THIS_ SWND swnd) OVERRIDE;
+
+    /**
+     * @brief Counts a paint involving a retained layer and marks the layer as recently used.
+     * @param swnd Window handle.
+     * @param type How the layer was used.
+     */
+    STDMETHOD_(void, OnLayerPaint)(THIS_ SWND swnd, LayerPaint type) OVERRIDE;
+
+    /**
+     * @brief Sets the byte budget of retained layers.
+     * @param cbBudget Budget in bytes, 0 disables retained layers.
+     */
+    STDMETHOD_(void, SetLayerCacheBudget)(THIS_ UINT cbBudget) OVERRIDE;
+
+    /**
+     * @brief Gets the statistics of the retained layer cache.
+     * @param pStats Receives the statistics.
+     */
+    STDMETHOD_(void, GetLayerCacheStats)(THIS_ LayerCacheStats *pStats) SCONST OVERRIDE;
+
+    /**
+     * @brief Gets an offscreen render target from the pool.
+     * @param sz Minimal size of the render target.
+     * @param[out] ppRT Receives the render target.
+     * @return TRUE if successful.
+     */
+    STDMETHOD_(BOOL, AcquireOffscreenRT)(THIS_ SIZE sz, IRenderTarget **ppRT) OVERRIDE;
+
+    /**
+     * @brief Gives back a render target to the pool.
+     * @param pRT The render target.
+     */
+    STDMETHOD_(void, RecycleOffscreenRT)(THIS_ IRenderTarget *pRT) OVERRIDE;
+
+    /**
+     * @brief Gets the statistics of the render target pool.
+     * @param pStats Receives the statistics.
+     */
+    STDMETHOD_(void, GetOffscreenRTStats)(THIS_ RtPoolStats *pStats) SCONST OVERRIDE;
+
   public: // ITimelineHandler
     /**
      * @brief Called when the next frame is ready.
@@ -274,6 +328,24 @@ class SOUI_EXP SwndContainerImpl
      */
     void _BuildWndTreeZorder(IWindow *pWnd, UINT &iOrder);
 
+    /**
+     * @brief Evicts least recently used layers until cbNeed more bytes fit into the budget.
+     * @param cbNeed Bytes needed.
+     */
+    void _EvictLayers(UINT cbNeed);
+
+  protected:
+    enum
+    {
+        kDefLayerCacheBudget = 32 * 1024 * 1024, /**< Default byte budget of retained layers */
+    };
+
+    struct LayerInfo
+    {
+        SWND swnd;    /**< Window owning the layer */
+        UINT cbLayer; /**< Size of the layer in bytes */
+    };
+
   protected:
     SWindow *m_pRoot;                          /**< Root window of the container */
     SWND m_hCapture;                           /**< Window handle with capture */
@@ -286,6 +358,10 @@ class SOUI_EXP SwndContainerImpl
     SList<SWND> m_lstVideoCanvas;              /**< List of video canvas windows */
     SAutoRefPtr<ICaret> m_caret;               /**< Caret */
     STimerlineHandlerMgr m_timelineHandlerMgr; /**< Timeline handler manager */
+    SList<LayerInfo> m_lstLayers;              /**< Retained layers, most recently used first */
+    SMap<SWND, SPOSITION> m_mapLayers;         /**< Window to its entry in m_lstLayers */
+    LayerCacheStats m_layerStats;              /**< Statistics of retained layers */
+    SRenderTargetPool m_rtPool;                /**< Pool of offscreen render targets */
 };
 
 SNSEND
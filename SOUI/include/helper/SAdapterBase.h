@@ -4,6 +4,8 @@
 #include "interface/SAdapter-i.h"
 #include <souicoll.h>
 #include "control/STree.h"
+#include "control/SHeaderCtrl.h"
+#include "helper/SIndexView.h"
 
 SNSBEGIN
 
@@ -425,6 +427,236 @@ class SMcAdapterBase : public TObjRefImpl<LvAdatperImpl<IMcAdapter>> {
         (pColWid);
         (nCols);
     }
+
+    /**
+     * @brief 显示位置转换为数据项标识
+     * @param position 显示位置
+     * @return 没有排序索引时就是显示位置
+     */
+    STDMETHOD_(int, ViewToItem)(THIS_ int position) SCONST OVERRIDE
+    {
+        return position;
+    }
+
+    /**
+     * @brief 数据项标识转换为显示位置
+     * @param iItem 数据项标识
+     * @return 没有排序索引时就是数据项标识
+     */
+    STDMETHOD_(int, ItemToView)(THIS_ int iItem) SCONST OVERRIDE
+    {
+        return iItem;
+    }
+};
+
+/**
+ * @class SMcIndexAdapterBase
+ * @brief 带排序和过滤索引的多列适配器基类
+ * @details 数据保存在派生类中, 列表显示的行通过SIndexView映射到数据项, 排序和过滤都不复制数据.
+ *          派生类实现getItemCount, getItemView和CompareItem, 加载数据后调用notifyItemsReset,
+ *          之后数据改变时调用notifyItemInserted等函数增量更新索引.
+ *          getCount和getView中的position是显示行, 用ViewToItem/ItemToView在显示行和数据项之间转换,
+ *          SMCListView排序时通过它们按数据项保持选中项.
+ */
+class SMcIndexAdapterBase : public SMcAdapterBase {
+  public:
+    /**
+     * @brief 构造函数
+     */
+    SMcIndexAdapterBase()
+        : m_iSortCol(-1)
+        , m_bSortDown(FALSE)
+    {
+    }
+
+    /**
+     * @brief 获取数据项数量
+     * @return 数据项数量
+     */
+    virtual int getItemCount() = 0;
+
+    /**
+     * @brief 获取数据项的视图
+     * @param iItem 数据项索引
+     * @param pItem 项面板对象
+     * @param xmlTemplate XML模板对象
+     */
+    virtual void getItemView(int iItem, SItemPanel *pItem, SXmlNode xmlTemplate) = 0;
+
+    /**
+     * @brief 按列比较两个数据项
+     * @param iCol 列索引
+     * @param iItem1 数据项1的索引
+     * @param iItem2 数据项2的索引
+     * @return 小于0表示iItem1在前, 大于0表示iItem2在前, 0表示相等
+     * @note 大数据量排序时会在多个线程中同时调用, 只能读数据
+     */
+    virtual int CompareItem(int iCol, int iItem1, int iItem2)
+    {
+        (iCol);
+        (iItem1);
+        (iItem2);
+        return 0;
+    }
+
+    /**
+     * @brief 判断列是否支持排序
+     * @param iCol 列索引
+     * @return 支持返回TRUE
+     */
+    virtual BOOL IsColumnSortable(int iCol)
+    {
+        (iCol);
+        return TRUE;
+    }
+
+    /**
+     * @brief 判断数据项是否显示, 过滤打开后生效
+     * @param iItem 数据项索引
+     * @return 显示返回TRUE
+     */
+    virtual BOOL FilterItem(int iItem)
+    {
+        (iItem);
+        return TRUE;
+    }
+
+    /**
+     * @brief 获取显示行数量
+     * @return 显示行数量
+     */
+    STDMETHOD_(int, getCount)(THIS) OVERRIDE
+    {
+        return m_index.GetCount();
+    }
+
+    /**
+     * @brief 获取显示行的视图
+     * @param position 显示行
+     * @param pItem 项面板对象
+     * @param xmlTemplate XML模板对象
+     */
+    STDMETHOD_(void, getView)(int position, SItemPanel *pItem, SXmlNode xmlTemplate) OVERRIDE
+    {
+        getItemView(m_index.ViewToItem(position), pItem, xmlTemplate);
+    }
+
+    /**
+     * @brief 按列排序, 再次点击同一列时切换升降序
+     * @param iCol 列索引
+     * @param pFmts 格式数组
+     * @param nCols 列数量
+     * @return 排序结果
+     */
+    STDMETHOD_(BOOL, OnSort)(int iCol, UINT *pFmts, int nCols) OVERRIDE
+    {
+        if (!IsColumnSortable(iCol))
+            return FALSE;
+
+        UINT fmt = (pFmts[iCol] & SORT_MASK) == HDF_SORTUP ? HDF_SORTDOWN : HDF_SORTUP;
+        for (int i = 0; i < nCols; i++)
+        {
+            pFmts[i] &= ~SORT_MASK;
+        }
+        pFmts[iCol] |= fmt;
+
+        m_iSortCol = iCol;
+        m_bSortDown = fmt == HDF_SORTDOWN;
+        m_index.SetCompare(IndexCompare, this);
+        m_index.Reset(getItemCount());
+        return TRUE;
+    }
+
+    /**
+     * @brief 打开或者关闭过滤
+     * @param bEnable 打开时只显示FilterItem返回TRUE的数据项
+     */
+    void EnableFilter(BOOL bEnable)
+    {
+        m_index.SetFilter(bEnable ? IndexFilter : NULL, this);
+        notifyItemsReset();
+    }
+
+    /**
+     * @brief 显示行转换为数据项索引
+     * @param position 显示行
+     * @return 数据项索引
+     */
+    STDMETHOD_(int, ViewToItem)(THIS_ int position) SCONST OVERRIDE
+    {
+        return m_index.ViewToItem(position);
+    }
+
+    /**
+     * @brief 数据项索引转换为显示行
+     * @param iItem 数据项索引
+     * @return 显示行, 被过滤时返回-1
+     */
+    STDMETHOD_(int, ItemToView)(THIS_ int iItem) SCONST OVERRIDE
+    {
+        return m_index.ItemToView(iItem);
+    }
+
+    /**
+     * @brief 数据项已经插入, 按当前排序放到对应的显示行
+     * @param iItem 数据项索引
+     */
+    void notifyItemInserted(int iItem)
+    {
+        m_index.InsertItem(iItem);
+        notifyDataSetChanged();
+    }
+
+    /**
+     * @brief 数据项已经删除
+     * @param iItem 数据项索引
+     */
+    void notifyItemRemoved(int iItem)
+    {
+        m_index.RemoveItem(iItem);
+        notifyDataSetChanged();
+    }
+
+    /**
+     * @brief 数据项内容已经改变, 重新过滤并调整它的显示行
+     * @param iItem 数据项索引
+     */
+    void notifyItemUpdated(int iItem)
+    {
+        int iOldRow = -1;
+        int iNewRow = m_index.UpdateItem(iItem, &iOldRow);
+        if (iOldRow == iNewRow && iNewRow != -1)
+            notifyItemDataChanged(iNewRow);
+        else if (iOldRow != iNewRow)
+            notifyDataSetChanged();
+    }
+
+    /**
+     * @brief 数据整体改变, 或者排序/过滤条件改变后重建索引
+     */
+    void notifyItemsReset()
+    {
+        m_index.Reset(getItemCount());
+        notifyDataSetChanged();
+    }
+
+  protected:
+    static int __cdecl IndexCompare(void *pCtx, int iItem1, int iItem2)
+    {
+        SMcIndexAdapterBase *_this = (SMcIndexAdapterBase *)pCtx;
+        int nRet = _this->CompareItem(_this->m_iSortCol, iItem1, iItem2);
+        return _this->m_bSortDown ? -nRet : nRet;
+    }
+
+    static BOOL __cdecl IndexFilter(void *pCtx, int iItem)
+    {
+        SMcIndexAdapterBase *_this = (SMcIndexAdapterBase *)pCtx;
+        return _this->FilterItem(iItem);
+    }
+
+    SIndexView m_index; ///< 显示行到数据项的索引
+    int m_iSortCol;     ///< 排序列, -1表示未排序
+    BOOL m_bSortDown;   ///< 是否降序
 };
 
 /**
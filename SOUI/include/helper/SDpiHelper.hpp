@@ -7,6 +7,10 @@
 #include <wtl.mini/souimisc.h>
 #include <sdef.h>
 
+#ifndef WM_GETDPISCALEDSIZE
+#define WM_GETDPISCALEDSIZE 0x02E4
+#endif
+
 SNSBEGIN
 
 /**
@@ -40,6 +44,22 @@ class SDpiHandler {
         HandleScaleChange(nScale, desRect);
     }
 
+    /**
+     * @brief DPI即将变化，提前在后台缩放窗口使用的皮肤
+     * @param dpi 新的DPI值
+     */
+    virtual void OnDpiChanging(WORD dpi)
+    {
+        if (!IsDpiAware())
+            return;
+        int nScale = SDpiScale::NormalizeScale(dpi * 100 / 96);
+        T *pT = static_cast<T *>(this);
+        if (nScale != pT->GetRoot()->GetScale())
+        {
+            pT->PrefetchScale(nScale);
+        }
+    }
+
     /**
      * @brief 处理缩放变化
      * @param nScale 新的缩放比例
@@ -96,6 +116,11 @@ class SDpiHandler {
                 ScaleHost(hWnd);
                 lResult = 0;
             }
+            if (uMsg == WM_GETDPISCALEDSIZE)
+            {
+                // 不处理，使用系统默认的窗口大小
+                OnDpiChanging((WORD)wParam);
+            }
             if (uMsg == WM_DPICHANGED)
             {
                 OnDpiChanged((WORD)HIWORD(wParam), (RECT *const)lParam);
@@ -0,0 +1,179 @@
+﻿#ifndef __SINDEXVIEW__H__
+#define __SINDEXVIEW__H__
+
+#include <souicoll.h>
+
+SNSBEGIN
+
+/**
+ * @brief 比较两个数据项
+ * @param pCtx 比较上下文
+ * @param iItem1 数据项1的索引
+ * @param iItem2 数据项2的索引
+ * @return 小于0表示iItem1在前, 大于0表示iItem2在前, 0表示相等
+ * @note SIndexView对大数据量排序时会在多个线程中同时调用, 比较函数只能读数据
+ */
+typedef int(__cdecl *FunIndexCompare)(void *pCtx, int iItem1, int iItem2);
+
+/**
+ * @brief 判断数据项是否显示
+ * @param pCtx 过滤上下文
+ * @param iItem 数据项索引
+ * @return 显示返回TRUE
+ */
+typedef BOOL(__cdecl *FunIndexFilter)(void *pCtx, int iItem);
+
+/**
+ * @class SIndexView
+ * @brief 数据项的排序/过滤索引
+ * @details 数据保存在调用者的数组中, SIndexView只保存显示行到数据项索引的映射, 排序和过滤都不复制数据.
+ *          比较结果相等的数据项按数据项索引排列, 所以排序是稳定的, 增量插入的结果和重新排序一致.
+ *          没有比较函数和过滤函数时, 显示行就是数据项索引, 不占用额外内存.
+ */
+class SOUI_EXP SIndexView {
+  public:
+    SIndexView();
+
+    /**
+     * @brief 设置比较函数
+     * @param fun 比较函数, NULL表示按数据项索引排列
+     * @param pCtx 比较上下文
+     * @note 调用Rebuild或者Reset后生效
+     */
+    void SetCompare(FunIndexCompare fun, void *pCtx);
+
+    /**
+     * @brief 设置过滤函数
+     * @param fun 过滤函数, NULL表示显示所有数据项
+     * @param pCtx 过滤上下文
+     * @note 调用Rebuild或者Reset后生效
+     */
+    void SetFilter(FunIndexFilter fun, void *pCtx);
+
+    /**
+     * @brief 按当前的比较和过滤函数重建nItems个数据项的索引
+     * @param nItems 数据项数量
+     */
+    void Reset(int nItems);
+
+    /**
+     * @brief 按当前的比较和过滤函数重建索引, 用于比较或者过滤条件改变后
+     */
+    void Rebuild();
+
+    /**
+     * @brief 获取数据项数量
+     * @return 数据项数量
+     */
+    int GetItemCount() const
+    {
+        return m_nItems;
+    }
+
+    /**
+     * @brief 获取显示行数量
+     * @return 通过过滤的数据项数量
+     */
+    int GetCount() const;
+
+    /**
+     * @brief 显示行转换为数据项索引
+     * @param iRow 显示行
+     * @return 数据项索引, iRow越界时返回-1
+     */
+    int ViewToItem(int iRow) const;
+
+    /**
+     * @brief 数据项索引转换为显示行
+     * @param iItem 数据项索引
+     * @return 显示行, 数据项被过滤时返回-1
+     * @note 重建索引后为O(1); 插入/删除/更新数据项后在有序的显示行中二分查找, 为O(log n).
+     *       数据项内容改变后, UpdateItem之前结果不可靠, 需要原显示行时在改变内容之前调用.
+     */
+    int ItemToView(int iItem) const;
+
+    /**
+     * @brief 显示行是否就是数据项索引
+     * @return 没有比较函数和过滤函数时返回TRUE
+     */
+    BOOL IsIdentity() const
+    {
+        return m_bIdentity;
+    }
+
+    /**
+     * @brief 数据项已经插入到iItem位置, 原来索引不小于iItem的数据项后移
+     * @param iItem 新数据项的索引
+     * @return 新数据项的显示行, 被过滤时返回-1
+     * @note 只对新数据项做一次二分查找, 不重新排序
+     */
+    int InsertItem(int iItem);
+
+    /**
+     * @brief 数据项iItem已经删除, 原来索引大于iItem的数据项前移
+     * @param iItem 被删除的数据项索引
+     */
+    void RemoveItem(int iItem);
+
+    /**
+     * @brief 数据项iItem的内容已经改变, 重新过滤并调整它的显示行
+     * @param iItem 数据项索引
+     * @param[out] pOldRow 原来的显示行, 原来被过滤时为-1, 可以为NULL
+     * @return 新的显示行, 被过滤时返回-1
+     * @note 增量修改后查找原显示行为O(n), 已知原显示行时用UpdateItemAt
+     */
+    int UpdateItem(int iItem, int *pOldRow = NULL);
+
+    /**
+     * @brief 同UpdateItem, 由调用者提供原来的显示行
+     * @param iItem 数据项索引
+     * @param iOldRow 内容改变之前ItemToView(iItem)的结果
+     * @return 新的显示行, 被过滤时返回-1
+     */
+    int UpdateItemAt(int iItem, int iOldRow);
+
+    /**
+     * @brief 稳定排序一组数据项索引
+     * @param pItems 数据项索引数组
+     * @param nCount 数组长度
+     * @param fun 比较函数, NULL表示按数据项索引排列
+     * @param pCtx 比较上下文
+     * @param bParallel 是否允许多线程排序, 为TRUE时比较函数会在多个线程中同时调用
+     * @details 归并排序, 比较结果相等时按数据项索引排列. bParallel为TRUE并且数据量大时分块在多个线程中排序后归并.
+     */
+    static void StableSort(int *pItems, int nCount, FunIndexCompare fun, void *pCtx, BOOL bParallel = FALSE);
+
+  protected:
+    /**
+     * @brief 查找数据项在有序显示行中的插入位置
+     * @param iItem 数据项索引
+     * @return 插入位置
+     */
+    int FindInsertRow(int iItem) const;
+
+    /**
+     * @brief 数据项是否排在另一个数据项之前
+     */
+    BOOL IsItemBefore(int iItem1, int iItem2) const;
+
+    /**
+     * @brief 重建数据项索引到显示行的映射
+     */
+    void UpdateItemRows() const;
+
+    FunIndexCompare m_funCompare; // 比较函数
+    void *m_pCompareCtx;          // 比较上下文
+    FunIndexFilter m_funFilter;   // 过滤函数
+    void *m_pFilterCtx;           // 过滤上下文
+
+    int m_nItems;            // 数据项数量
+    BOOL m_bIdentity;        // 显示行就是数据项索引, 此时m_arrRows为空
+    SArray<int> m_arrRows;   // 显示行 -> 数据项索引
+
+    mutable SArray<int> m_arrItemRows; // 数据项索引 -> 显示行, 重建索引时生成
+    mutable BOOL m_bItemRowsDirty;     // m_arrItemRows需要重建
+};
+
+SNSEND
+
+#endif // __SINDEXVIEW__H__
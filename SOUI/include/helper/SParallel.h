@@ -0,0 +1,43 @@
+﻿#ifndef __SPARALLEL__H__
+#define __SPARALLEL__H__
+
+SNSBEGIN
+
+/**
+ * @brief 并行任务
+ * @param pCtx 任务上下文
+ * @param iTask 任务序号
+ */
+typedef void(__cdecl *FunParallelTask)(void *pCtx, int iTask);
+
+/**
+ * @class SParallel
+ * @brief 进程共享的常驻工作线程池, 用于把大块计算拆成互不依赖的任务并行执行
+ * @details 工作线程在第一次使用时创建, 随进程存在. 同一时间只有一批任务使用线程池,
+ *          线程池忙时, 包括在任务中再调用Run, 任务在调用线程中依次执行.
+ */
+class SOUI_EXP SParallel {
+  public:
+    enum
+    {
+        kMaxThreads = 8, // 参与执行的最大线程数, 包括调用线程
+    };
+
+    /**
+     * @brief 获取并行执行的线程数
+     * @return 包括调用线程的线程数, 不超过kMaxThreads, 单核机器返回1
+     */
+    static int GetThreadCount();
+
+    /**
+     * @brief 执行任务[0,nTasks), 调用线程也参与执行, 全部完成后返回
+     * @param nTasks 任务数
+     * @param fun 任务函数, 会在多个线程中同时调用
+     * @param pCtx 任务上下文
+     */
+    static void Run(int nTasks, FunParallelTask fun, void *pCtx);
+};
+
+SNSEND
+
+#endif // __SPARALLEL__H__
@@ -0,0 +1,87 @@
+﻿#ifndef __SRENDERTARGETPOOL__H__
+#define __SRENDERTARGETPOOL__H__
+
+#include <souicoll.h>
+#include <interface/SRender-i.h>
+#include <interface/SWndContainer-i.h>
+
+SNSBEGIN
+
+/**
+ * @class SRenderTargetPool
+ * @brief 离屏RenderTarget池
+ * @details 按尺寸分桶(宽高向上取整到BUCKET_STEP)回收离屏RT, 避免分层窗口每帧都重新分配位图。
+ *          申请到的RT可能比请求的尺寸大, 使用者只应使用请求的区域。
+ *          空闲RT占用的内存不超过设定上限, 超出时丢弃最久未用的RT。
+ */
+class SOUI_EXP SRenderTargetPool {
+  public:
+    enum
+    {
+        BUCKET_STEP = 32,                 // 尺寸分桶步长
+        DEF_MAX_IDLE = 16 * 1024 * 1024, // 默认空闲RT内存上限
+    };
+
+    /**
+     * @brief 构造函数
+     * @param cbMaxIdle 空闲RT内存上限
+     */
+    SRenderTargetPool(UINT cbMaxIdle = DEF_MAX_IDLE);
+
+    /**
+     * @brief 析构函数
+     */
+    ~SRenderTargetPool();
+
+    /**
+     * @brief 申请一个不小于sz的离屏RT
+     * @param sz 需要的尺寸
+     * @param[out] ppRT 返回的RT, 视口原点为(0,0), 变换矩阵为单位矩阵
+     * @return TRUE-成功
+     */
+    BOOL Acquire(SIZE sz, IRenderTarget **ppRT);
+
+    /**
+     * @brief 归还由Acquire申请的RT
+     * @param pRT 归还的RT, 调用后池接管调用者持有的引用
+     */
+    void Recycle(IRenderTarget *pRT);
+
+    /**
+     * @brief 设置空闲RT的内存上限
+     * @param cbMaxIdle 内存上限, 0表示不保留空闲RT
+     */
+    void SetMaxIdleBytes(UINT cbMaxIdle);
+
+    /**
+     * @brief 释放所有空闲RT
+     */
+    void Clear();
+
+    /**
+     * @brief 获取统计数据
+     * @param pStats 返回统计数据
+     */
+    void GetStats(RtPoolStats *pStats) const;
+
+  protected:
+    struct RtEntry
+    {
+        IRenderTarget *pRT; // 持有一个引用
+        CSize sz;           // 分桶后的尺寸
+    };
+
+    static CSize BucketSize(SIZE sz);
+    static UINT EntryBytes(const CSize &sz);
+
+    void Trim(UINT cbMaxIdle);
+
+    SList<RtEntry> m_lstIdle;              // 空闲RT, 最近归还的在前
+    SMap<IRenderTarget *, CSize> m_mapBusy; // 已借出RT的分桶尺寸
+    UINT m_cbMaxIdle;
+    RtPoolStats m_stats;
+};
+
+SNSEND
+
+#endif // __SRENDERTARGETPOOL__H__
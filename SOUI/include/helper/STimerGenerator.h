@@ -2,6 +2,8 @@
 #define __STIMERGENERATOR__H__
 
 #include "core/SSingletonMap.h"
+#include "helper/STimerWheel.h"
+#include <helper/SCriticalSection.h>
 
 SNSBEGIN
 
@@ -14,16 +16,24 @@ struct TIMERINFO
     SAutoRefPtr<IEvtSlot> pEvtSlot; // 事件槽对象指针
     BOOL bRepeat;                   // 是否重复定时器
     LPARAM uData;                   // 用户数据
+    tid_t tid;                      // 设置定时器的线程
 };
 
 /**
  * @class STimerGenerator
  * @brief 定时器生成器类，继承自单例映射类
+ * @details 每个线程有自己的定时器轮和驱动它的线程定时器, 定时器在设置它的线程上触发。
+ *          定时器ID在进程内唯一, 可以在任意线程清除。
  */
 class STimerGenerator : public SSingletonMap<STimerGenerator, TIMERINFO, UINT_PTR> {
     SINGLETON2_TYPE(SINGLETON_TIMERGENERATOR)
 
   public:
+    /**
+     * @brief 构造函数
+     */
+    STimerGenerator();
+
     /**
      * @brief 析构函数
      */
@@ -45,6 +55,12 @@ class STimerGenerator : public SSingletonMap<STimerGenerator, TIMERINFO, UINT_PT
      */
     void ClearTimer(UINT_PTR uID);
 
+    /**
+     * @brief 释放当前线程的定时器轮
+     * @details 线程的消息循环退出时调用, 当前线程上还没有触发的定时器不再触发。
+     */
+    void ReleaseThreadTimers();
+
     /**
      * @brief 定时器回调函数
      * @param hwnd 窗口句柄
@@ -53,6 +69,32 @@ class STimerGenerator : public SSingletonMap<STimerGenerator, TIMERINFO, UINT_PT
      * @param dwTime 时间戳
      */
     static VOID CALLBACK _TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+
+  protected:
+    /**
+     * @class SThreadTimers
+     * @brief 一个线程的定时器轮, 只在所属线程上访问
+     */
+    class SThreadTimers : public ITimerWheelListener {
+      public:
+        SThreadTimers(STimerGenerator *pOwner);
+        ~SThreadTimers();
+
+        STimerWheel m_timerWheel; // 线程的所有定时器共用一个系统定时器
+        UINT_PTR m_uSysTimer;     // 驱动定时器轮的系统定时器
+
+      protected:
+        virtual void OnArmTimer(UINT uElapse);
+        virtual void OnTimerExpired(UINT_PTR uKey);
+
+        STimerGenerator *m_pOwner;
+    };
+
+    SThreadTimers *_GetThreadTimers(BOOL bCreate);
+
+    SMap<tid_t, SThreadTimers *> m_mapThreadTimers; // 线程ID到线程定时器轮的映射
+    SCriticalSection m_cs;                          // 保护定时器信息和线程映射
+    UINT m_uNextID;                                 // 下一个分配的定时器ID
 };
 
 SNSEND
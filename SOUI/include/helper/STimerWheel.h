@@ -0,0 +1,164 @@
+﻿#ifndef __STIMERWHEEL__H__
+#define __STIMERWHEEL__H__
+
+#include <souicoll.h>
+
+SNSBEGIN
+
+/**
+ * @struct ITimerWheelListener
+ * @brief 定时器轮的驱动接口
+ * @details 定时器轮本身不持有系统定时器, 由宿主提供唯一的系统定时器,
+ *          并在系统定时器到期时调用STimerWheel::OnTick。
+ */
+struct ITimerWheelListener
+{
+    /**
+     * @brief 重新设置驱动定时器轮的系统定时器
+     * @param uElapse 到最近一个定时器到期的时间（毫秒）, INFINITE表示不再需要系统定时器
+     */
+    virtual void OnArmTimer(UINT uElapse) = 0;
+
+    /**
+     * @brief 定时器到期
+     * @param uKey 定时器键值
+     */
+    virtual void OnTimerExpired(UINT_PTR uKey) = 0;
+};
+
+/**
+ * @class STimerWheel
+ * @brief 分层定时器轮
+ * @details 以1毫秒为刻度, 共5层(256+4*64个槽), 把任意多个逻辑定时器复用到一个系统定时器上。
+ *          插入、删除为O(1), 系统定时器总是被设置到最近的到期时间。
+ *          定时器可以归属到一个分组, 用于一次性删除一个窗口的全部定时器。
+ */
+class SOUI_EXP STimerWheel {
+  public:
+    enum
+    {
+        TVR_BITS = 8,
+        TVN_BITS = 6,
+        TVR_SIZE = 1 << TVR_BITS,
+        TVN_SIZE = 1 << TVN_BITS,
+        TVR_MASK = TVR_SIZE - 1,
+        TVN_MASK = TVN_SIZE - 1,
+        TV_LEVELS = 5, // tv1 + 4个高层
+        MAX_ELAPSE = 0x7FFFFFFF,
+    };
+
+    /**
+     * @brief 构造函数
+     * @param pListener 驱动接口
+     */
+    STimerWheel(ITimerWheelListener *pListener = NULL);
+
+    /**
+     * @brief 析构函数
+     */
+    ~STimerWheel();
+
+    /**
+     * @brief 设置驱动接口
+     * @param pListener 驱动接口
+     */
+    void SetListener(ITimerWheelListener *pListener);
+
+    /**
+     * @brief 设置定时器, 同一个键值的定时器会被重置
+     * @param uKey 定时器键值
+     * @param uElapse 定时器间隔时间（毫秒）
+     * @param bRepeat 是否重复定时器
+     * @param dwGroup 定时器分组
+     * @return TRUE-成功
+     */
+    BOOL SetTimer(UINT_PTR uKey, UINT uElapse, BOOL bRepeat = TRUE, DWORD dwGroup = 0);
+
+    /**
+     * @brief 删除定时器
+     * @param uKey 定时器键值
+     * @return TRUE-定时器存在并被删除
+     */
+    BOOL KillTimer(UINT_PTR uKey);
+
+    /**
+     * @brief 删除一个分组的全部定时器
+     * @param dwGroup 定时器分组
+     * @return 删除的定时器数量
+     */
+    int KillGroup(DWORD dwGroup);
+
+    /**
+     * @brief 删除全部定时器
+     */
+    void KillAll();
+
+    /**
+     * @brief 查询定时器是否存在
+     * @param uKey 定时器键值
+     * @return TRUE-存在
+     */
+    BOOL HasTimer(UINT_PTR uKey) const;
+
+    /**
+     * @brief 获取定时器数量
+     * @return 定时器数量
+     */
+    int GetCount() const;
+
+    /**
+     * @brief 驱动定时器轮, 在系统定时器到期时调用
+     * @details 执行所有已经到期的定时器, 然后把系统定时器设置到下一个到期时间。
+     *          定时器回调中可以安全地设置或者删除定时器, 也可以销毁定时器轮本身。
+     */
+    void OnTick();
+
+  protected:
+    struct TimerLink
+    {
+        TimerLink *pPrev;
+        TimerLink *pNext;
+    };
+
+    struct TimerNode : TimerLink
+    {
+        UINT_PTR uKey;
+        DWORD dwGroup;
+        UINT uElapse;
+        DWORD dwExpire;
+        BOOL bRepeat;
+        int iLevel;              // 所在的层, -1表示在到期队列中
+        TimerNode *pGroupPrev;   // 分组链表
+        TimerNode *pGroupNext;
+    };
+
+    static void ListInit(TimerLink *pHead);
+    static BOOL ListEmpty(const TimerLink *pHead);
+    static void ListAppend(TimerLink *pHead, TimerLink *pNode);
+    static void ListUnlink(TimerLink *pNode);
+
+    TimerLink *GetSlot(int iLevel, UINT iSlot) const;
+    void AddNode(TimerNode *pNode);
+    void DetachNode(TimerNode *pNode);
+    void FreeNode(TimerNode *pNode);
+    UINT Cascade(int iLevel);
+    void Advance(DWORD dwNow, TimerLink *pExpired);
+    BOOL GetNextExpire(DWORD &dwExpire) const;
+    void Rearm(BOOL bForce);
+
+    ITimerWheelListener *m_pListener;
+    TimerLink m_slots[TVR_SIZE + (TV_LEVELS - 1) * TVN_SIZE];
+    int m_nLevelCount[TV_LEVELS];
+    DWORD m_dwCur; // 下一个要处理的刻度
+
+    SMap<UINT_PTR, TimerNode *> m_mapTimer;
+    SMap<DWORD, TimerNode *> m_mapGroup; // 分组链表头
+
+    BOOL m_bArmed;
+    DWORD m_dwArmedExpire;
+    BOOL *m_pbDestroyed; // OnTick执行期间指向它栈上的标志, 回调中销毁定时器轮时置位
+};
+
+SNSEND
+
+#endif // __STIMERWHEEL__H__
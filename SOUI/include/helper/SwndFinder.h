@@ -18,7 +18,7 @@ struct SFindInfo
      * @param strName 窗口名称
      * @param nDeep 查找深度
      */
-    SFindInfo(SWindow *pParent, const SStringW &strName, int nDeep);
+    SFindInfo(SWindow *pParent, const SAtom &name, int nDeep);
 
     /**
      * @brief 构造函数，通过ID查找
@@ -30,7 +30,7 @@ struct SFindInfo
 
     SWND hParent;     // 父窗口句柄
     bool findByName;  // 是否通过名称查找
-    SStringW strName; // 窗口名称
+    SAtom name;       // 窗口名称(原子)
     int nID;          // 窗口ID
     int nDeep;        // 查找深度
 };
@@ -51,7 +51,7 @@ class CElementTraits<SFindInfo> : public CElementTraitsBase<SFindInfo> {
     {
         ULONG lRet = 0;
         if (fi.findByName)
-            lRet = SStringElementTraits<SStringW>::Hash(fi.strName);
+            lRet = fi.name.GetHash();
         else
             lRet = fi.nID << 16;
 
@@ -86,7 +86,7 @@ class CElementTraits<SFindInfo> : public CElementTraitsBase<SFindInfo> {
         if (bRet)
         {
             if (element1.findByName)
-                bRet = element1.strName == element2.strName;
+                bRet = element1.name == element2.name;
             else
                 bRet = element1.nID == element2.nID;
         }
@@ -107,7 +107,7 @@ class CElementTraits<SFindInfo> : public CElementTraitsBase<SFindInfo> {
         if (nRet == 0)
         {
             if (element1.findByName)
-                nRet = element1.strName.Compare(element2.strName);
+                nRet = wcscmp(element1.name.GetName(), element2.name.GetName());
             else
                 nRet = element1.nID - element2.nID;
         }
@@ -128,11 +128,11 @@ class SWindowFinder : public SSingleton2<SWindowFinder> {
     /**
      * @brief 通过名称查找子窗口
      * @param pParent 父窗口指针
-     * @param strName 窗口名称
+     * @param name 窗口名称的原子
      * @param nDeep 查找深度
      * @return 找到的窗口指针，未找到返回NULL
      */
-    SWindow *FindChildByName(SWindow *pParent, const SStringW &strName, int nDeep);
+    SWindow *FindChildByName(SWindow *pParent, const SAtom &name, int nDeep);
 
     /**
      * @brief 通过ID查找子窗口
@@ -146,11 +146,11 @@ class SWindowFinder : public SSingleton2<SWindowFinder> {
     /**
      * @brief 缓存通过名称查找的结果
      * @param pParent 父窗口指针
-     * @param strName 窗口名称
+     * @param name 窗口名称的原子
      * @param nDeep 查找深度
      * @param pResult 找到的窗口指针
      */
-    void CacheResultForName(SWindow *pParent, const SStringW &strName, int nDeep, SWindow *pResult);
+    void CacheResultForName(SWindow *pParent, const SAtom &name, int nDeep, SWindow *pResult);
 
     /**
      * @brief 缓存通过ID查找的结果
@@ -292,6 +292,22 @@ DECLARE_INTERFACE_(IMcAdapter, ILvAdapter)
      * @return void
      */
     STDMETHOD_(void, SetColumnsWidth)(THIS_ int *pColWid, int nCols) PURE;
+
+    /**
+     * @brief 显示位置转换为数据项标识
+     * @param position int -- 显示位置
+     * @return int -- 数据项标识, 排序前后不变
+     * @remark 列表用来在排序后按数据项保持选中项, 默认返回position
+     */
+    STDMETHOD_(int, ViewToItem)(CTHIS_ int position) SCONST PURE;
+
+    /**
+     * @brief 数据项标识转换为显示位置
+     * @param iItem int -- ViewToItem返回的数据项标识
+     * @return int -- 显示位置, 数据项不显示时返回-1
+     * @remark 默认返回iItem
+     */
+    STDMETHOD_(int, ItemToView)(CTHIS_ int iItem) SCONST PURE;
 };
 
 #undef INTERFACE
@@ -5,6 +5,19 @@
 #include <interface/obj-ref-i.h>
 #include <interface/SRunnable-i.h>
 
+/**
+ * @brief Wake-up accounting of a message loop.
+ * @details Every time the loop returns from blocking it is counted once, by the first message it retrieved.
+ */
+typedef struct _MsgLoopWakeStats
+{
+    UINT nWaits;      /**< Number of times the loop blocked waiting for input. */
+    UINT nTimerWakes; /**< Wake-ups by WM_TIMER/WM_SYSTIMER. */
+    UINT nMsgWakes;   /**< Wake-ups by any other message, including sent messages. */
+    UINT nTaskWakes;  /**< Wake-ups to run posted tasks. */
+    UINT nIdleRuns;   /**< Number of idle handler passes. */
+} MsgLoopWakeStats;
+
 SNSBEGIN
 
 #undef INTERFACE
@@ -171,6 +184,17 @@ DECLARE_INTERFACE_(IMessageLoop, IObjRef)
      * @return Return value of message handling.
      */
     STDMETHOD_(int, HandleMsg)(THIS) PURE;
+
+    /**
+     * @brief Gets the wake-up accounting of the loop.
+     * @param pStats Receives the counters.
+     */
+    STDMETHOD_(void, GetWakeStats)(CTHIS_ MsgLoopWakeStats * pStats) SCONST PURE;
+
+    /**
+     * @brief Resets the wake-up accounting of the loop.
+     */
+    STDMETHOD_(void, ResetWakeStats)(THIS) PURE;
 };
 
 #undef INTERFACE
@@ -2004,6 +2004,16 @@ DECLARE_INTERFACE_(IRenderTarget, IObjRef)
      * @return BOOL indicating whether anti-aliasing is enabled.
      */
     STDMETHOD_(BOOL, GetAntiAlias)(CTHIS) SCONST PURE;
+
+    /**
+     * @brief Enables or disables recording of drawing commands.
+     * @param bEnable TRUE to record the commands issued between BeginDraw and the matching EndDraw and
+     *        rasterize them in parallel when EndDraw is called, FALSE to draw directly.
+     * @return TRUE if the render target supports recording, FALSE otherwise.
+     * @details Reading the bitmap of the render target, e.g. by GetDC, GetPixel or GetCurrentObject,
+     *          rasterizes the recorded commands first, so the result is the same as drawing directly.
+     */
+    STDMETHOD_(BOOL, EnableRecording)(THIS_ BOOL bEnable) PURE;
 };
 
 /**
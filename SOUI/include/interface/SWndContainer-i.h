@@ -37,6 +37,41 @@ typedef enum GrtFlag
     GRT_OFFSCREEN,  /**< Offscreen drawing */
 } GrtFlag;
 
+typedef enum LayerPaint
+{
+    LP_HIT = 0, /**< The subtree was drawn from its retained layer */
+    LP_MISS,    /**< The retained layer was invalidated, the subtree was painted */
+    LP_CAPTURE, /**< The subtree was painted into its retained layer */
+} LayerPaint;
+
+/**
+ * @brief Statistics of the retained layer cache of a container.
+ */
+typedef struct LayerCacheStats
+{
+    UINT nHits;      /**< Paints served from a retained layer */
+    UINT nMisses;    /**< Paints of a retained subtree whose layer had been invalidated */
+    UINT nCaptures;  /**< Subtrees painted into a retained layer */
+    UINT nEvictions; /**< Layers dropped to stay within the budget */
+    UINT nLayers;    /**< Number of retained layers */
+    UINT cbUsed;     /**< Bytes held by retained layers */
+    UINT cbBudget;   /**< Byte budget of retained layers */
+} LayerCacheStats;
+
+/**
+ * @brief Statistics of the offscreen render target pool of a container.
+ */
+typedef struct RtPoolStats
+{
+    UINT nAcquires; /**< Render targets handed out */
+    UINT nCreates;  /**< Render targets created because no idle one of the size bucket existed */
+    UINT nReuses;   /**< Render targets handed out from the idle list */
+    UINT nRecycles; /**< Render targets given back */
+    UINT nDrops;    /**< Idle render targets released to stay within the idle budget */
+    UINT nIdle;     /**< Number of idle render targets */
+    UINT cbIdle;    /**< Bytes held by idle render targets */
+} RtPoolStats;
+
 /**
  * @struct     ISwndContainer
  * @brief      SOUI Window Container Interface
@@ -299,6 +334,101 @@ DECLARE_INTERFACE_(ISwndContainer, ITimelineHandlersMgr)
      * @return The number of tasks removed.
      */
     STDMETHOD_(int, RemoveTasksForObject)(THIS_ void *pObj) PURE;
+
+    /**
+     * @brief Sets a timer for a window.
+     * @param swnd Handle to the window.
+     * @param id Timer ID, unique within the window.
+     * @param uElapse Timer interval in milliseconds.
+     * @return TRUE if successful.
+     * @remark All window timers of a container share one system timer.
+     */
+    STDMETHOD_(BOOL, SetSwndTimer)(THIS_ SWND swnd, char id, UINT uElapse) PURE;
+
+    /**
+     * @brief Kills a timer of a window.
+     * @param swnd Handle to the window.
+     * @param id Timer ID.
+     * @return TRUE if the timer existed.
+     */
+    STDMETHOD_(BOOL, KillSwndTimer)(THIS_ SWND swnd, char id) PURE;
+
+    /**
+     * @brief Kills all timers of a window.
+     * @param swnd Handle to the window.
+     * @return The number of timers killed.
+     */
+    STDMETHOD_(int, KillSwndTimers)(THIS_ SWND swnd) PURE;
+
+    /**
+     * @brief Lets the container composite a caret over its cached frame.
+     * @param pCaret Caret to composite, NULL to remove the caret of swndOwner.
+     * @param swndOwner Handle to the window owning the caret.
+     * @return TRUE if the container composites the caret, in which case the owner must not paint it.
+     * @remark Returns FALSE when the owner or an ancestor is transformed, translucent or layered.
+     */
+    STDMETHOD_(BOOL, SetCaretOverlay)(THIS_ ICaret * pCaret, SWND swndOwner) PURE;
+
+    /**
+     * @brief Re-presents the area of a composited caret after its position or alpha changed.
+     * @param pCaret The caret.
+     * @return TRUE if pCaret is composited by the container, FALSE if its owner has to be invalidated.
+     */
+    STDMETHOD_(BOOL, UpdateCaretOverlay)(THIS_ ICaret * pCaret) PURE;
+
+    /**
+     * @brief Reserves room for the retained layer of a window, evicting least recently used layers if needed.
+     * @param swnd Handle to the window.
+     * @param cbLayer Size of the layer in bytes.
+     * @return TRUE if the window may keep a layer of cbLayer bytes.
+     */
+    STDMETHOD_(BOOL, RetainLayer)(THIS_ SWND swnd, UINT cbLayer) PURE;
+
+    /**
+     * @brief Gives back the room reserved by RetainLayer.
+     * @param swnd Handle to the window.
+     */
+    STDMETHOD_(void, ReleaseLayer)(THIS_ SWND swnd) PURE;
+
+    /**
+     * @brief Notifies the container that a retained layer took part in a paint.
+     * @param swnd Handle to the window.
+     * @param type How the layer was used.
+     */
+    STDMETHOD_(void, OnLayerPaint)(THIS_ SWND swnd, LayerPaint type) PURE;
+
+    /**
+     * @brief Sets the byte budget of retained layers, 0 disables them.
+     * @param cbBudget Budget in bytes.
+     */
+    STDMETHOD_(void, SetLayerCacheBudget)(THIS_ UINT cbBudget) PURE;
+
+    /**
+     * @brief Gets the statistics of the retained layer cache.
+     * @param pStats Receives the statistics.
+     */
+    STDMETHOD_(void, GetLayerCacheStats)(CTHIS_ LayerCacheStats * pStats) SCONST PURE;
+
+    /**
+     * @brief Gets an offscreen render target from the pool of the container.
+     * @param sz Minimal size of the render target.
+     * @param[out] ppRT Receives the render target, which may be larger than sz.
+     * @return TRUE if successful.
+     * @remark Give the render target back with RecycleOffscreenRT instead of releasing it.
+     */
+    STDMETHOD_(BOOL, AcquireOffscreenRT)(THIS_ SIZE sz, IRenderTarget * *ppRT) PURE;
+
+    /**
+     * @brief Gives back a render target got from AcquireOffscreenRT.
+     * @param pRT The render target, the reference of the caller is taken over.
+     */
+    STDMETHOD_(void, RecycleOffscreenRT)(THIS_ IRenderTarget * pRT) PURE;
+
+    /**
+     * @brief Gets the statistics of the offscreen render target pool.
+     * @param pStats Receives the statistics.
+     */
+    STDMETHOD_(void, GetOffscreenRTStats)(CTHIS_ RtPoolStats * pStats) SCONST PURE;
 };
 
 SNSEND
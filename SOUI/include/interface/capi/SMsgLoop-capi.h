@@ -81,6 +81,12 @@ extern "C" {
 #define IMessageLoop_HandleMsg(This) \
     ((This)->lpVtbl->HandleMsg(This))
 
+#define IMessageLoop_GetWakeStats(This, pStats) \
+    ((This)->lpVtbl->GetWakeStats(This, pStats))
+
+#define IMessageLoop_ResetWakeStats(This) \
+    ((This)->lpVtbl->ResetWakeStats(This))
+
 /* IMsgLoopFactory C API Macros */
 #define IMsgLoopFactory_CreateMsgLoop(This, ppMsgLoop, pParentLoop) \
     ((This)->lpVtbl->CreateMsgLoop(This, ppMsgLoop, pParentLoop))
@@ -180,6 +186,16 @@ static inline int IMessageLoop_HandleMsg_C(IMessageLoop* pThis)
     return IMessageLoop_HandleMsg(pThis);
 }
 
+static inline void IMessageLoop_GetWakeStats_C(IMessageLoop* pThis, MsgLoopWakeStats* pStats)
+{
+    IMessageLoop_GetWakeStats(pThis, pStats);
+}
+
+static inline void IMessageLoop_ResetWakeStats_C(IMessageLoop* pThis)
+{
+    IMessageLoop_ResetWakeStats(pThis);
+}
+
 /* IMsgLoopFactory Helper Functions */
 static inline HRESULT IMsgLoopFactory_CreateMsgLoop_C(IMsgLoopFactory* pThis, IMessageLoop** ppMsgLoop, IMessageLoop* pParentLoop)
 {
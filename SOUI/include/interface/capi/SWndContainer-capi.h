@@ -130,6 +130,45 @@ extern "C" {
 #define ISwndContainer_RemoveTasksForObject(This, pObj) \
     ((This)->lpVtbl->RemoveTasksForObject(This, pObj))
 
+#define ISwndContainer_SetSwndTimer(This, swnd, id, uElapse) \
+    ((This)->lpVtbl->SetSwndTimer(This, swnd, id, uElapse))
+
+#define ISwndContainer_KillSwndTimer(This, swnd, id) \
+    ((This)->lpVtbl->KillSwndTimer(This, swnd, id))
+
+#define ISwndContainer_KillSwndTimers(This, swnd) \
+    ((This)->lpVtbl->KillSwndTimers(This, swnd))
+
+#define ISwndContainer_SetCaretOverlay(This, pCaret, swndOwner) \
+    ((This)->lpVtbl->SetCaretOverlay(This, pCaret, swndOwner))
+
+#define ISwndContainer_UpdateCaretOverlay(This, pCaret) \
+    ((This)->lpVtbl->UpdateCaretOverlay(This, pCaret))
+
+#define ISwndContainer_RetainLayer(This, swnd, cbLayer) \
+    ((This)->lpVtbl->RetainLayer(This, swnd, cbLayer))
+
+#define ISwndContainer_ReleaseLayer(This, swnd) \
+    ((This)->lpVtbl->ReleaseLayer(This, swnd))
+
+#define ISwndContainer_OnLayerPaint(This, swnd, type) \
+    ((This)->lpVtbl->OnLayerPaint(This, swnd, type))
+
+#define ISwndContainer_SetLayerCacheBudget(This, cbBudget) \
+    ((This)->lpVtbl->SetLayerCacheBudget(This, cbBudget))
+
+#define ISwndContainer_GetLayerCacheStats(This, pStats) \
+    ((This)->lpVtbl->GetLayerCacheStats(This, pStats))
+
+#define ISwndContainer_AcquireOffscreenRT(This, sz, ppRT) \
+    ((This)->lpVtbl->AcquireOffscreenRT(This, sz, ppRT))
+
+#define ISwndContainer_RecycleOffscreenRT(This, pRT) \
+    ((This)->lpVtbl->RecycleOffscreenRT(This, pRT))
+
+#define ISwndContainer_GetOffscreenRTStats(This, pStats) \
+    ((This)->lpVtbl->GetOffscreenRTStats(This, pStats))
+
 /*
  * C API Helper Functions (Optional - for more C-like usage)
  */
@@ -251,6 +290,60 @@ static inline int ISwndContainer_RemoveTasksForObject_C(ISwndContainer* pThis, v
     return ISwndContainer_RemoveTasksForObject(pThis, pObj);
 }
 
+/* Timer Management */
+static inline BOOL ISwndContainer_SetSwndTimer_C(ISwndContainer* pThis, SWND swnd, char id, UINT uElapse)
+{
+    return ISwndContainer_SetSwndTimer(pThis, swnd, id, uElapse);
+}
+
+static inline BOOL ISwndContainer_KillSwndTimer_C(ISwndContainer* pThis, SWND swnd, char id)
+{
+    return ISwndContainer_KillSwndTimer(pThis, swnd, id);
+}
+
+static inline int ISwndContainer_KillSwndTimers_C(ISwndContainer* pThis, SWND swnd)
+{
+    return ISwndContainer_KillSwndTimers(pThis, swnd);
+}
+
+/* Caret Overlay */
+static inline BOOL ISwndContainer_SetCaretOverlay_C(ISwndContainer* pThis, ICaret* pCaret, SWND swndOwner)
+{
+    return ISwndContainer_SetCaretOverlay(pThis, pCaret, swndOwner);
+}
+
+static inline BOOL ISwndContainer_UpdateCaretOverlay_C(ISwndContainer* pThis, ICaret* pCaret)
+{
+    return ISwndContainer_UpdateCaretOverlay(pThis, pCaret);
+}
+
+/* Retained Layer Cache */
+static inline void ISwndContainer_SetLayerCacheBudget_C(ISwndContainer* pThis, UINT cbBudget)
+{
+    ISwndContainer_SetLayerCacheBudget(pThis, cbBudget);
+}
+
+static inline void ISwndContainer_GetLayerCacheStats_C(ISwndContainer* pThis, LayerCacheStats* pStats)
+{
+    ISwndContainer_GetLayerCacheStats(pThis, pStats);
+}
+
+/* Offscreen Render Target Pool */
+static inline BOOL ISwndContainer_AcquireOffscreenRT_C(ISwndContainer* pThis, SIZE sz, IRenderTarget** ppRT)
+{
+    return ISwndContainer_AcquireOffscreenRT(pThis, sz, ppRT);
+}
+
+static inline void ISwndContainer_RecycleOffscreenRT_C(ISwndContainer* pThis, IRenderTarget* pRT)
+{
+    ISwndContainer_RecycleOffscreenRT(pThis, pRT);
+}
+
+static inline void ISwndContainer_GetOffscreenRTStats_C(ISwndContainer* pThis, RtPoolStats* pStats)
+{
+    ISwndContainer_GetOffscreenRTStats(pThis, pStats);
+}
+
 /*
  * Convenience macros for common container operations
  */
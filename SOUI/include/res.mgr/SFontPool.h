@@ -81,6 +81,44 @@ class CElementTraits<FontInfo> : public CElementTraitsBase<FontInfo> {
     }
 };
 
+/**
+ * @struct FontCacheKey
+ * @brief Key of the font front cache
+ *
+ * @details The font description exactly as passed to GetFont, before named fonts are resolved, and the scale.
+ */
+struct FontCacheKey
+{
+    SStringW strFont; /**< Font description or font name */
+    int scale;        /**< Font scale */
+};
+
+/**
+ * @class CElementTraits<FontCacheKey>
+ * @brief Hash and comparison template for FontCacheKey
+ */
+template <>
+class CElementTraits<FontCacheKey> : public CElementTraitsBase<FontCacheKey> {
+  public:
+    static ULONG Hash(INARGTYPE key)
+    {
+        return (SNS::CElementTraits<SStringW>::Hash(key.strFont) << 5) + key.scale;
+    }
+
+    static bool CompareElements(INARGTYPE element1, INARGTYPE element2)
+    {
+        return element1.scale == element2.scale && element1.strFont == element2.strFont;
+    }
+
+    static int CompareElementsOrdered(INARGTYPE element1, INARGTYPE element2)
+    {
+        int nRet = element1.strFont.Compare(element2.strFont);
+        if (nRet == 0)
+            nRet = element1.scale - element2.scale;
+        return nRet;
+    }
+};
+
 typedef IFontS *IFontPtr;
 typedef BOOL (*FunFontCheck)(const SStringW &strFontName);
 
@@ -196,8 +234,16 @@ class SOUI_EXP SFontPool : public SCmnMap<IFontPtr, FontInfo> {
      */
     void _SetDefFontInfo(const FontInfo &fontInfo);
 
+    /**
+     * @brief Clear the parsed description and front caches
+     * @details Must be called whenever the default font or the named fonts change.
+     */
+    void _ClearFontCache();
+
     SAutoRefPtr<IRenderFactory> m_RenderFactory; /**< Render factory object pointer */
     FontInfo m_defFontInfo;                      /**< Default font information */
+    SMap<SStringW, FontInfo> m_descCache;        /**< Font description -> parsed FontInfo */
+    SMap<FontCacheKey, IFontPtr> m_fontCache;    /**< (font description, scale) -> font, references are held by the pool */
 
     static FunFontCheck s_funFontCheck; /**< Font check callback function */
 };
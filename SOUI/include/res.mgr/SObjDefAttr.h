@@ -2,6 +2,7 @@
 #define __SOBJDEFATTR__H__
 
 #include "core/SSingletonMap.h"
+#include <helper/SRwLock.h>
 
 SNSBEGIN
 
@@ -16,6 +17,28 @@ class SOUI_EXP SObjDefAttr
     : public SCmnMap<SXmlNode, SStringW>
     , public TObjRefImpl<IObjRef> {
   public:
+    /**
+     * @struct AttrItem
+     * @brief A default attribute with its name and value kept as ready-made strings.
+     */
+    struct AttrItem
+    {
+        SStringW strName;
+        SStringW strValue;
+    };
+
+    /**
+     * @struct ClassAttrTable
+     * @brief Flattened default attributes of a class, inherited ones included.
+     * @details "class" comes first, the others keep their document order.
+     *          arrSorted indexes arrAttr by case-insensitive name for merging with xml attributes.
+     */
+    struct ClassAttrTable
+    {
+        SArray<AttrItem> arrAttr;
+        SArray<int> arrSorted;
+    };
+
     /**
      * @brief Constructor.
      */
@@ -53,6 +76,21 @@ class SOUI_EXP SObjDefAttr
      */
     SXmlNode GetDefAttribute(LPCWSTR pszClassName);
 
+    /**
+     * @brief Retrieves the flattened default attribute table for a class.
+     * @param pszClassName Name of the class.
+     * @return The table, built on first use; it is empty if the class has no default attributes.
+     * @details Thread safe. A table is never moved once built, so the reference stays valid until the next Init.
+     */
+    const ClassAttrTable &GetClassAttrTable(LPCWSTR pszClassName);
+
+    /**
+     * @brief Applies the default attributes of the object's class to the object.
+     * @param pObject Object to apply the default attributes to.
+     * @param xmlInit XML node the object is going to be initialized from. Defaults it sets again are skipped.
+     */
+    void ApplyDefAttribute(IObject *pObject, SXmlNode xmlInit = SXmlNode());
+
   protected:
     /**
      * @brief Builds the class attributes from an XML node.
@@ -62,6 +100,8 @@ class SOUI_EXP SObjDefAttr
     void BuildClassAttribute(SXmlNode &xmlNode, LPCWSTR pszClassName);
 
     SXmlDoc m_xmlRoot; // XML document containing the default attributes
+    SMap<SAtom, ClassAttrTable> m_mapAttrTable; // class name -> flattened default attributes
+    SRwLock m_lockAttrTable;                    // guards m_mapAttrTable, tables are built under the write lock
 };
 
 SNSEND
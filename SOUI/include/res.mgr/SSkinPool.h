@@ -4,6 +4,7 @@
 #include <core/SSingletonMap.h>
 #include <interface/SSkinPool-i.h>
 #include <helper/obj-ref-impl.hpp>
+#include <string/satom.h>
 
 SNSBEGIN
 
@@ -70,11 +71,23 @@ typedef ISkinObj *SSkinPtr;
 /**
  * @struct SkinKey
  * @brief Key for identifying a skin object in the pool.
+ * @details The name is an interned atom, so hashing and comparing keys never touches the text.
  */
 class SkinKey {
   public:
-    SStringW strName; // Name of the skin
-    int scale;        // Scale factor for the skin
+    SkinKey()
+        : scale(100)
+    {
+    }
+
+    SkinKey(const SAtom &name_, int scale_)
+        : name(name_)
+        , scale(scale_)
+    {
+    }
+
+    SAtom name; // Name of the skin
+    int scale;  // Scale factor for the skin
 };
 
 /**
@@ -91,7 +104,7 @@ class CElementTraits<SkinKey> : public CElementTraitsBase<SkinKey> {
      */
     static ULONG Hash(INARGTYPE skinKey)
     {
-        ULONG nHash = CElementTraits<SStringW>::Hash(skinKey.strName);
+        ULONG nHash = skinKey.name.GetHash();
         nHash <<= 5;
         nHash += skinKey.scale;
         return nHash;
@@ -105,7 +118,7 @@ class CElementTraits<SkinKey> : public CElementTraitsBase<SkinKey> {
      */
     static bool CompareElements(INARGTYPE element1, INARGTYPE element2)
     {
-        return element1.strName == element2.strName && element1.scale == element2.scale;
+        return element1.name == element2.name && element1.scale == element2.scale;
     }
 
     /**
@@ -116,7 +129,7 @@ class CElementTraits<SkinKey> : public CElementTraitsBase<SkinKey> {
      */
     static int CompareElementsOrdered(INARGTYPE element1, INARGTYPE element2)
     {
-        int nRet = element1.strName.CompareNoCase(element2.strName);
+        int nRet = _wcsicmp(element1.name.GetName(), element2.name.GetName());
         if (nRet == 0)
             nRet = element1.scale - element2.scale;
         return nRet;
@@ -128,7 +141,8 @@ class CElementTraits<SkinKey> : public CElementTraitsBase<SkinKey> {
  * @brief Manages the mapping of skin names to ISkinObj objects.
  *
  * @details This class provides functionality to load, retrieve, and manage skin objects. It supports automatic scaling
- *          and maintains a pool of skin objects for efficient reuse.
+ *          and maintains a pool of skin objects for efficient reuse. Skins produced by automatic scaling are kept in a
+ *          cache shared by all pools and bounded by a byte budget, see SetScaledSkinBudget.
  */
 class SOUI_EXP SSkinPool
     : public TObjRefImpl<ISkinPool>
@@ -180,6 +194,32 @@ class SOUI_EXP SSkinPool
      */
     STDMETHOD_(void, RemoveAll)(THIS) OVERRIDE;
 
+  public:
+    /**
+     * @brief Queues scaling of the skins used at one scale to another scale.
+     * @param nFromScale Scale the skins are currently used at.
+     * @param nToScale Scale that is about to be used.
+     * @return Number of skins queued for scaling, 0 if the calling thread has no message loop or nothing to do.
+     * @details The skins are scaled one per task on the calling thread's message loop, because scaling
+     *          reads images that OnColorize changes in place. Results go to the shared scaled skin cache.
+     *          A skin requested by GetSkin before its turn is scaled on the calling thread as usual.
+     */
+    int PrefetchScale(int nFromScale, int nToScale);
+
+    /**
+     * @brief Sets the byte budget of the scaled skin cache shared by all skin pools.
+     * @param cbBudget Budget in bytes, estimated from the bitmap sizes of the scaled skins.
+     * @details The budget bounds prefetched skins nobody has asked for yet. A skin returned by GetSkin
+     *          is held by its users as a raw pointer, so it stays until its pool removes it.
+     */
+    static void SetScaledSkinBudget(size_t cbBudget);
+
+    /**
+     * @brief Gets the bytes the scaled skin cache holds against its budget.
+     * @return Estimated bytes of prefetched skins not returned by GetSkin yet.
+     */
+    static size_t GetScaledSkinCacheSize();
+
   protected:
     /**
      * @brief Loads skins from an XML node.
@@ -196,6 +236,28 @@ class SOUI_EXP SSkinPool
      */
     ISkinObj *_LoadSkin(SXmlNode xmlNode, int nScale);
 
+    /**
+     * @brief Adds a loaded skin and records its scale in the scale index.
+     * @param key Key of the skin.
+     * @param pSkin Skin object, owned by the pool afterwards.
+     */
+    void _AddSkin(const SkinKey &key, ISkinObj *pSkin);
+
+    /**
+     * @brief Finds the loaded skin that is the best source for scaling to nScale.
+     * @param name Name of the skin.
+     * @param nScale Normalized target scale.
+     * @return Source skin, or NULL if no builtin scale of the skin is loaded.
+     */
+    ISkinObj *_FindScaleSource(const SAtom &name, int nScale) const;
+
+    /**
+     * @brief Returns the skin scaled to key.scale, from the shared cache or by scaling its source.
+     * @param key Key of the skin, with a normalized scale.
+     * @return Scaled skin, or NULL if the skin can not be scaled.
+     */
+    ISkinObj *_GetScaledSkin(const SkinKey &key);
+
     /**
      * @brief Callback function called when a skin object is removed from the pool.
      * @param obj Pointer to the removed skin object.
@@ -206,7 +268,9 @@ class SOUI_EXP SSkinPool
     SMap<SkinKey, int> m_mapSkinUseCount; // Skin usage count map (debug only)
 #endif
 
-    BOOL m_bAutoScale; // Flag indicating if automatic scaling is enabled
+    SMap<SAtom, UINT> m_mapScaleMask;  // Builtin scales loaded for each skin name, bit i for SDpiScale::GetBuiltinScales()[i]
+    SMap<SAtom, UINT> m_mapUsedScales; // Builtin scales each skin name was requested at, used by PrefetchScale
+    BOOL m_bAutoScale;                 // Flag indicating if automatic scaling is enabled
 };
 
 SNSEND
@@ -11,6 +11,7 @@
 #include <res.mgr/SGradientPool.h>
 #include <res.mgr/SObjDefAttr.h>
 #include <res.mgr/SNamedValue.h>
+#include <helper/SRwLock.h>
 
 SNSBEGIN
 
@@ -215,6 +216,22 @@ class SOUI_EXP SUiDef
      */
     BOOL PopSkinPool(ISkinPool *pSkinPool);
 
+    /**
+     * @brief Invalidates the cached skin and style resolution results.
+     * @details Called whenever skin pools or UI definitions change, including skins added to or removed from a pool.
+     */
+    void InvalidateResolveCache();
+
+    /**
+     * @brief Queues scaling of the skins used at one scale to another scale on the calling thread's message loop.
+     * @param nFromScale Scale the skins are currently used at.
+     * @param nToScale Scale that is about to be used.
+     * @return Number of skins queued for scaling.
+     * @details Covers the builtin skin pool and the skin pools of the UI definitions on the stack,
+     *          see SSkinPool::PrefetchScale.
+     */
+    int PrefetchSkins(int nFromScale, int nToScale);
+
   public:
     /**
      * @brief Retrieves a skin object by name and scale.
@@ -339,11 +356,30 @@ class SOUI_EXP SUiDef
     FontInfo GetDefFontInfo() const;
 
   protected:
+
+    /**
+     * @brief Resolves a skin through the skin pools and UI definitions, m_cs must be held.
+     */
+    ISkinObj *_GetSkin(const SStringW &strSkinName, int nScale);
+
+    /**
+     * @brief Resolves a style through the UI definitions, m_cs must be held.
+     */
+    SXmlNode _GetStyle(const SStringW &strName);
+
     SAutoRefPtr<IUiDefInfo> m_defUiDefInfo;   // Default UI definition information
     SList<IUiDefInfo *> m_lstUiDefInfo;       // List of UI definition information objects
     SList<ISkinPool *> m_lstSkinPools;        // List of skin pools
     SAutoRefPtr<ISkinPool> m_bulitinSkinPool; // Built-in skin pool
     mutable SCriticalSection m_cs;            // Critical section for thread safety
+
+    // Resolved skins and styles, looked up under a shared m_lockResolve. Misses are resolved under m_cs
+    // and added in place, unless m_nGeneration changed meanwhile. The maps hold references to the skins.
+    SMap<SkinKey, SAutoRefPtr<ISkinObj> > m_mapResolvedSkin;
+    SMap<SkinKey, SAutoRefPtr<ISkinObj> > m_mapResolvedBuiltinSkin;
+    SMap<SAtom, SXmlNode> m_mapResolvedStyle;
+    mutable SRwLock m_lockResolve; // Guards the resolved maps
+    volatile LONG m_nGeneration;   // Bumped whenever resolution results may change
 };
 
 SNSEND
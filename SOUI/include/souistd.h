@@ -54,6 +54,7 @@
 #include <atl.mini/atldef.h>
 #include <string/tstring.h>
 #include <string/strcpcvt.h>
+#include <string/satom.h>
 #include <xml/SXml.h>
 
 #include <interface/SRender-i.h>
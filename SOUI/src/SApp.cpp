@@ -599,10 +599,10 @@ HWND SApplication::GetMainWnd()
 BOOL SApplication::SetMsgLoopFactory(IMsgLoopFactory *pMsgLoopFac)
 {
     m_msgLoopFactory = pMsgLoopFac;
-    RemoveMsgLoop();
+    //直接替换当前线程的msgLoop, 不释放这个线程的定时器
     SAutoRefPtr<IMessageLoop> pMsgLoop;
     m_msgLoopFactory->CreateMsgLoop(&pMsgLoop);
-    AddMsgLoop(pMsgLoop);
+    AddMsgLoop(pMsgLoop, TRUE);
     return TRUE;
 }
 
@@ -723,6 +723,10 @@ BOOL SApplication::RemoveMsgLoop()
         return FALSE;
     }
     m_msgLoopMap.RemoveKey(p->m_key);
+    //线程的消息循环结束，释放这个线程的定时器轮
+    STimerGenerator *pTimerGenerator = (STimerGenerator *)m_pSingletons[STimerGenerator::GetType()];
+    if (pTimerGenerator)
+        pTimerGenerator->ReleaseThreadTimers();
     return TRUE;
 }
 
@@ -13,6 +13,7 @@ SListCtrl::SListCtrl()
     , m_nItemHeight(20)
     , m_pHeader(NULL)
     , m_nSelectItem(-1)
+    , m_nHoverItem(-1)
     , m_crItemBg(RGBA(255, 255, 255, 255))
     , m_crItemBg2(RGBA(226, 226, 226, 255))
     , m_crItemSelBg(RGBA(57, 145, 209, 255))
@@ -27,6 +28,10 @@ SListCtrl::SListCtrl()
     , m_bHotTrack(FALSE)
     , m_bCheckBox(FALSE)
     , m_bMultiSelection(FALSE)
+    , m_pfnViewCompare(NULL)
+    , m_pViewCompareCtx(NULL)
+    , m_pfnFilter(NULL)
+    , m_pFilterCtx(NULL)
 {
     m_bClipClient = TRUE;
     m_bFocusable = TRUE;
@@ -90,6 +95,11 @@ int SListCtrl::InsertItem(int nItem, LPCTSTR pszText, int nImage)
     subItem.nImage = nImage;
 
     m_arrItems.InsertAt(nItem, lvi);
+    m_view.InsertItem(nItem);
+    if (m_nSelectItem >= nItem)
+        m_nSelectItem++;
+    if (m_nHoverItem >= nItem)
+        m_nHoverItem++;
 
     UpdateScrollBar();
 
@@ -101,7 +111,9 @@ BOOL SListCtrl::SetItemData(int nItem, LPARAM dwData)
     if (nItem >= GetItemCount() || nItem < 0)
         return FALSE;
 
+    int iOldShow = GetItemShowIndex(nItem);
     m_arrItems[nItem].dwData = dwData;
+    UpdateItemView(nItem, iOldShow);
 
     return TRUE;
 }
@@ -120,6 +132,7 @@ BOOL SListCtrl::SetSubItem(int nItem, int nSubItem, const DXLVSUBITEM *plv)
 {
     if (nItem >= GetItemCount() || nSubItem >= GetColumnCount() || nItem < 0)
         return FALSE;
+    int iOldShow = GetItemShowIndex(nItem);
     DXLVSUBITEM &lvsi_dst = m_arrItems[nItem].arSubItems->GetAt(nSubItem);
     if (plv->mask & S_LVIF_TEXT)
     {
@@ -133,6 +146,7 @@ BOOL SListCtrl::SetSubItem(int nItem, int nSubItem, const DXLVSUBITEM *plv)
     if (plv->mask & S_LVIF_INDENT)
         lvsi_dst.nIndent = plv->nIndent;
     RedrawItem(nItem);
+    UpdateItemView(nItem, iOldShow);
     return TRUE;
 }
 
@@ -161,6 +175,7 @@ BOOL SListCtrl::SetSubItemText(int nItem, int nSubItem, LPCTSTR pszText)
     if (nSubItem < 0 || nSubItem >= GetColumnCount())
         return FALSE;
 
+    int iOldShow = GetItemShowIndex(nItem);
     DXLVSUBITEM &lvi = m_arrItems[nItem].arSubItems->GetAt(nSubItem);
     if (lvi.strText)
     {
@@ -171,6 +186,7 @@ BOOL SListCtrl::SetSubItemText(int nItem, int nSubItem, LPCTSTR pszText)
 
     CRect rcItem = GetItemRect(nItem, nSubItem);
     InvalidateRect(rcItem);
+    UpdateItemView(nItem, iOldShow);
     return TRUE;
 }
 
@@ -219,6 +235,7 @@ BOOL SListCtrl::SetItemCount(int nItems, int nGrowBy)
             lvi.arSubItems = new ArrSubItem;
             lvi.arSubItems->SetCount(GetColumnCount());
         }
+        m_view.Reset((int)m_arrItems.GetCount());
     }
     UpdateScrollBar();
 
@@ -242,7 +259,7 @@ void SListCtrl::UpdateScrollBar()
     CSize szView;
     szView.cx = m_pHeader->GetTotalWidth(false);
     int nMinWid = m_pHeader->GetTotalWidth(true);
-    szView.cy = GetItemCount() * m_nItemHeight.toPixelSize(GetScale());
+    szView.cy = GetShowCount() * m_nItemHeight.toPixelSize(GetScale());
 
     CRect rcClient;
     SWindow::GetClientRect(&rcClient); //不计算滚动条大小
@@ -372,6 +389,15 @@ void SListCtrl::DeleteItem(int nItem)
         }
         delete lvi.arSubItems;
         m_arrItems.RemoveAt(nItem);
+        m_view.RemoveItem(nItem);
+        if (m_nSelectItem == nItem)
+            m_nSelectItem = -1;
+        else if (m_nSelectItem > nItem)
+            m_nSelectItem--;
+        if (m_nHoverItem == nItem)
+            m_nHoverItem = -1;
+        else if (m_nHoverItem > nItem)
+            m_nHoverItem--;
 
         UpdateScrollBar();
     }
@@ -400,6 +426,8 @@ void SListCtrl::DeleteColumn(int iCol)
                 free(lvsi.strText);
             m_arrItems[i].arSubItems->RemoveAt(iCol);
         }
+        if (!m_view.IsIdentity())
+            m_view.Rebuild();
         UpdateScrollBar();
     }
 }
@@ -425,6 +453,8 @@ void SListCtrl::DeleteAllItems()
         delete lvi.arSubItems;
     }
     m_arrItems.RemoveAll();
+    m_view.Reset(0);
+    m_nHoverItem = -1;
 
     UpdateScrollBar();
 }
@@ -433,10 +463,13 @@ CRect SListCtrl::GetItemRect(int nItem, int nSubItem)
 {
     if (!(nItem >= 0 && nItem < GetItemCount() && nSubItem >= 0 && nSubItem < GetColumnCount()))
         return CRect();
+    int iShow = GetItemShowIndex(nItem);
+    if (iShow == -1)
+        return CRect();
 
     CRect rcItem;
     int itemHeight = m_nItemHeight.toPixelSize(GetScale());
-    rcItem.top = itemHeight * nItem;
+    rcItem.top = itemHeight * iShow;
     rcItem.bottom = rcItem.top + itemHeight;
     rcItem.left = 0;
     rcItem.right = 0;
@@ -471,12 +504,12 @@ int SListCtrl::HitTest(const CPoint &pt)
     pt2.y -= rcList.top - m_ptOrigin.y;
 
     int nRet = pt2.y / m_nItemHeight.toPixelSize(GetScale());
-    if (nRet >= GetItemCount())
+    if (nRet >= GetShowCount())
     {
         nRet = -1;
     }
 
-    return nRet;
+    return GetItemByShowIndex(nRet);
 }
 
 void SListCtrl::RedrawItem(int nItem)
@@ -489,11 +522,12 @@ void SListCtrl::RedrawItem(int nItem)
     int nTopItem = GetTopIndex();
     int nItemHeight = m_nItemHeight.toPixelSize(GetScale());
     int nPageItems = (rcList.Height() + nItemHeight - 1) / nItemHeight;
+    int iShow = GetItemShowIndex(nItem);
 
-    if (nItem >= nTopItem && nItem < GetItemCount() && nItem <= nTopItem + nPageItems)
+    if (iShow >= nTopItem && iShow <= nTopItem + nPageItems)
     {
         CRect rcItem(0, 0, rcList.Width(), nItemHeight);
-        rcItem.OffsetRect(0, nItemHeight * nItem - m_ptOrigin.y);
+        rcItem.OffsetRect(0, nItemHeight * iShow - m_ptOrigin.y);
         rcItem.OffsetRect(rcList.TopLeft());
         CRect rcDC;
         rcDC.IntersectRect(rcItem, rcList);
@@ -516,15 +550,116 @@ int SListCtrl::GetCountPerPage(BOOL bPartial)
     // round up to nearest item count
     return smax((int)(bPartial && divHeight.rem > 0 ? divHeight.quot + 1 : divHeight.quot), 1);
 }
+
+struct LVCOMPARECTX
+{
+    const DXLVITEM *pItems;
+    PFNLVCOMPAREEX pfnCompare;
+    void *pContext;
+};
+
+static int __cdecl LvCompareProc(void *pCtx, int iItem1, int iItem2)
+{
+    const LVCOMPARECTX *pCmp = (const LVCOMPARECTX *)pCtx;
+    return pCmp->pfnCompare(pCmp->pContext, pCmp->pItems + iItem1, pCmp->pItems + iItem2);
+}
+
 BOOL SListCtrl::SortItems(PFNLVCOMPAREEX pfnCompare, void *pContext)
 {
-    qsort_s(m_arrItems.GetData(), m_arrItems.GetCount(), sizeof(DXLVITEM), pfnCompare, pContext);
-    m_nSelectItem = -1;
+    //先排序索引再按索引重排数据项, 保证排序稳定, 并且可以找回选中项
+    int nItems = (int)m_arrItems.GetCount();
+    SArray<int> arrOrder;
+    arrOrder.SetCount(nItems);
+    for (int i = 0; i < nItems; i++)
+        arrOrder[i] = i;
+    LVCOMPARECTX ctx = { m_arrItems.GetData(), pfnCompare, pContext };
+    SIndexView::StableSort(arrOrder.GetData(), nItems, LvCompareProc, &ctx);
+
+    ArrLvItem arrSorted;
+    arrSorted.SetCount(nItems);
+    int nSelectItem = -1;
+    for (int i = 0; i < nItems; i++)
+    {
+        arrSorted[i] = m_arrItems[arrOrder[i]];
+        if (arrOrder[i] == m_nSelectItem)
+            nSelectItem = i;
+    }
+    m_arrItems.Copy(arrSorted);
+    m_nSelectItem = nSelectItem;
     m_nHoverItem = -1;
+    if (!m_view.IsIdentity())
+        m_view.Rebuild();
     InvalidateRect(GetListRect());
     return TRUE;
 }
 
+int __cdecl SListCtrl::ViewCompareProc(void *pCtx, int iItem1, int iItem2)
+{
+    SListCtrl *_this = (SListCtrl *)pCtx;
+    const DXLVITEM *pItems = _this->m_arrItems.GetData();
+    return _this->m_pfnViewCompare(_this->m_pViewCompareCtx, pItems + iItem1, pItems + iItem2);
+}
+
+BOOL __cdecl SListCtrl::ViewFilterProc(void *pCtx, int iItem)
+{
+    SListCtrl *_this = (SListCtrl *)pCtx;
+    return _this->m_pfnFilter(_this->m_pFilterCtx, _this->m_arrItems.GetData() + iItem);
+}
+
+void SListCtrl::SetSortView(PFNLVCOMPAREEX pfnCompare, void *pContext)
+{
+    m_pfnViewCompare = pfnCompare;
+    m_pViewCompareCtx = pContext;
+    m_view.SetCompare(pfnCompare ? ViewCompareProc : NULL, this);
+    UpdateView();
+}
+
+void SListCtrl::SetFilter(PFNLVFILTER pfnFilter, void *pContext)
+{
+    m_pfnFilter = pfnFilter;
+    m_pFilterCtx = pContext;
+    m_view.SetFilter(pfnFilter ? ViewFilterProc : NULL, this);
+    UpdateView();
+}
+
+void SListCtrl::UpdateView()
+{
+    m_view.Reset((int)m_arrItems.GetCount());
+    m_nHoverItem = -1;
+    UpdateScrollBar();
+}
+
+void SListCtrl::UpdateItemView(int nItem, int iOldShow)
+{
+    if (m_view.IsIdentity())
+        return;
+    int iNewShow = m_view.UpdateItemAt(nItem, iOldShow);
+    if (iOldShow == iNewShow)
+        return;
+    if (iOldShow == -1 || iNewShow == -1)
+        UpdateScrollBar(); //显示行数变化
+    else
+        InvalidateRect(GetListRect());
+}
+
+int SListCtrl::GetShowCount() const
+{
+    if (GetColumnCount() <= 0)
+        return 0;
+
+    return m_view.GetCount();
+}
+
+int SListCtrl::GetItemByShowIndex(int iShow) const
+{
+    return m_view.ViewToItem(iShow);
+}
+
+int SListCtrl::GetItemShowIndex(int nItem) const
+{
+    return m_view.ItemToView(nItem);
+}
+
 void SListCtrl::OnPaint(IRenderTarget *pRT)
 {
     SPainter painter;
@@ -537,11 +672,11 @@ void SListCtrl::OnPaint(IRenderTarget *pRT)
     rcItem.bottom = rcItem.top;
     int nItemHeight = m_nItemHeight.toPixelSize(GetScale());
     rcItem.OffsetRect(0, -(m_ptOrigin.y % nItemHeight));
-    for (int nItem = nTopItem; nItem <= (nTopItem + GetCountPerPage(TRUE)) && nItem < GetItemCount(); rcItem.top = rcItem.bottom, nItem++)
+    for (int iShow = nTopItem; iShow <= (nTopItem + GetCountPerPage(TRUE)) && iShow < GetShowCount(); rcItem.top = rcItem.bottom, iShow++)
     {
         rcItem.bottom = rcItem.top + nItemHeight;
 
-        DrawItem(pRT, rcItem, nItem);
+        DrawItem(pRT, rcItem, GetItemByShowIndex(iShow));
     }
     pRT->PopClip();
     AfterPaint(pRT, painter);
@@ -577,7 +712,7 @@ void SListCtrl::DrawItem(IRenderTarget *pRT, CRect rcItem, int nItem)
     DXLVITEM lvItem = m_arrItems[nItem];
     CRect rcIcon, rcText;
 
-    if (nItem % 2)
+    if (GetItemShowIndex(nItem) % 2)
     {
         //         if (m_pItemSkin != NULL)
         //             nBgImg = 1;
@@ -759,15 +894,19 @@ void SListCtrl::NotifySelChange(int nOldSel, int nNewSel, BOOL checkBox)
             if (nNewSel != -1)
             {
                 if (nOldSel == -1)
-                    nOldSel = 0;
+                    nOldSel = GetItemByShowIndex(0);
 
-                int imax = (nOldSel > nNewSel) ? nOldSel : nNewSel;
-                int imin = (imax == nOldSel) ? nNewSel : nOldSel;
+                //按显示顺序选中两项之间的数据项
+                int iOldShow = smax(GetItemShowIndex(nOldSel), 0);
+                int iNewShow = GetItemShowIndex(nNewSel);
+                int imax = (iOldShow > iNewShow) ? iOldShow : iNewShow;
+                int imin = (imax == iOldShow) ? iNewShow : iOldShow;
                 for (int i = 0; i < GetItemCount(); i++)
                 {
                     DXLVITEM &lvItem = m_arrItems[i];
                     BOOL last = lvItem.checked;
-                    if (i >= imin && i <= imax)
+                    int iShow = GetItemShowIndex(i);
+                    if (iShow != -1 && iShow >= imin && iShow <= imax)
                     {
                         lvItem.checked = TRUE;
                     }
@@ -357,6 +357,8 @@ BOOL SMCListView::OnHeaderClick(IEvtArgs *pEvt)
         if (i == pEvt2->iItem)
             iCol = hi.iOrder;
     }
+    //排序后按数据项保持选中项
+    int iSelData = (m_adapter && m_iSelItem != -1) ? m_adapter->ViewToItem(m_iSelItem) : -1;
     if (m_adapter && m_adapter->OnSort(iCol, pFmts, m_pHeader->GetItemCount()))
     {
         //更新表头的排序状态
@@ -364,6 +366,8 @@ BOOL SMCListView::OnHeaderClick(IEvtArgs *pEvt)
         {
             m_pHeader->SetItemSort(pOrders[i], pFmts[i]);
         }
+        if (iSelData != -1)
+            m_iSelItem = m_adapter->ItemToView(iSelData);
         onDataSetChanged();
     }
     delete[] pOrders;
@@ -28,6 +28,7 @@ STreeCtrl::STreeCtrl()
     , m_crItemSelText(RGBA(255, 255, 255, 255))
     , m_nVisibleItems(0)
     , m_nContentWidth(0)
+    , m_nBatchInsert(0)
     , m_bCheckBox(FALSE)
     , m_bRightClickSel(FALSE)
     , m_uItemMask(0)
@@ -48,6 +49,7 @@ STreeCtrl::STreeCtrl()
 
 STreeCtrl::~STreeCtrl()
 {
+    ClearSiblingRows();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -83,15 +85,9 @@ BOOL STreeCtrl::RemoveItem(HSTREEITEM hItem)
     LPTVITEM pItem = CSTree<LPTVITEM>::GetItem(hItem);
 
     BOOL bVisible = pItem->bVisible;
-    int nItemWidth = CalcMaxItemWidth(hItem);
+    int nSubRows = pItem->nSubRows;
+    int nSubWidth = pItem->nSubWidth;
     int nCheckBoxValue = pItem->nCheckBoxValue;
-    if (bVisible)
-    {
-        if (GetChildItem(hItem) && pItem->bCollapsed == FALSE)
-        {
-            SetChildrenVisible(hItem, FALSE);
-        }
-    }
 
     if (IsAncestor(hItem, m_hHoverItem))
         m_hHoverItem = 0;
@@ -101,6 +97,8 @@ BOOL STreeCtrl::RemoveItem(HSTREEITEM hItem)
         m_hCaptureItem = 0;
 
     DeleteItem(hItem);
+    InvalidSiblingRows(hParent);
+    PropagateItemStat(hParent, -nSubRows, nSubWidth, 0);
 
     //去掉父节点的展开标志
     if (hParent && !GetChildItem(hParent))
@@ -108,7 +106,8 @@ BOOL STreeCtrl::RemoveItem(HSTREEITEM hItem)
         LPTVITEM pParent = GetItem(hParent);
         pParent->bHasChildren = FALSE;
         pParent->bCollapsed = FALSE;
-        CalcItemContentWidth(pParent);
+        UpdateItemContentWidth(pParent);
+        UpdateItemStat(hParent);
     }
 
     if (m_bCheckBox && hParent)
@@ -119,21 +118,14 @@ BOOL STreeCtrl::RemoveItem(HSTREEITEM hItem)
     }
 
     if (bVisible)
-    {
-        m_nVisibleItems--;
-
-        //重新计算x最大尺寸
-        if (nItemWidth == m_nContentWidth)
-            UpdateContentWidth();
-
         UpdateScrollBar();
-    }
     return TRUE;
 }
 
 void STreeCtrl::RemoveAllItems()
 {
     DeleteAllItems();
+    ClearSiblingRows();
     m_nVisibleItems = 0;
     m_hSelItem = 0;
     m_hHoverItem = 0;
@@ -194,7 +186,11 @@ BOOL STreeCtrl::SetItemText(HSTREEITEM hItem, LPCTSTR lpszItem)
         if (pItem)
         {
             pItem->strText = lpszItem;
-            CalcItemContentWidth(pItem); //如果新的串比原来的长，没有重新计算就会出现...
+            UpdateItemContentWidth(pItem); //如果新的串比原来的长，没有重新计算就会出现...
+            int nContentWidth = m_nContentWidth;
+            UpdateItemStat(hItem);
+            if (m_nContentWidth != nContentWidth)
+                UpdateScrollBar();
             return TRUE;
         }
     }
@@ -315,18 +311,18 @@ BOOL STreeCtrl::Expand(HSTREEITEM hItem, UINT nCode)
         if (nCode == TVE_EXPAND && pItem->bCollapsed)
         {
             pItem->bCollapsed = FALSE;
-            SetChildrenVisible(hItem, TRUE);
+            SetChildrenVisible(hItem, pItem->bVisible); //父项被折叠时子项仍然不可见
             bRet = TRUE;
         }
         if (nCode == TVE_TOGGLE)
         {
             pItem->bCollapsed = !pItem->bCollapsed;
-            SetChildrenVisible(hItem, !pItem->bCollapsed);
+            SetChildrenVisible(hItem, pItem->bVisible && !pItem->bCollapsed);
             bRet = TRUE;
         }
         if (bRet)
         {
-            UpdateContentWidth();
+            UpdateItemStat(hItem);
             UpdateScrollBar();
         }
     }
@@ -387,7 +383,11 @@ BOOL STreeCtrl::CreateChildren(SXmlNode xmlNode)
     SXmlNode xmlItem = xmlNode.child(L"item");
 
     if (xmlItem)
+    {
+        BeginBatchInsert();
         LoadBranch(STVI_ROOT, xmlItem);
+        EndBatchInsert();
+    }
 
     return TRUE;
 }
@@ -433,6 +433,7 @@ HSTREEITEM STreeCtrl::InsertItem(LPTVITEM pItemObj, HSTREEITEM hParent, HSTREEIT
     pItemObj->nLevel = GetItemLevel(hParent) + 1;
 
     BOOL bCheckState = FALSE;
+    BOOL bParentChanged = FALSE;
 
     if (hParent != STVI_ROOT)
     {
@@ -446,25 +447,27 @@ HSTREEITEM STreeCtrl::InsertItem(LPTVITEM pItemObj, HSTREEITEM hParent, HSTREEIT
         if (!GetChildItem(hParent) && !pParentItem->bHasChildren)
         {
             pParentItem->bHasChildren = TRUE;
-            CalcItemContentWidth(pParentItem);
+            UpdateItemContentWidth(pParentItem);
+            bParentChanged = TRUE;
         }
     }
 
-    CalcItemContentWidth(pItemObj);
+    UpdateItemContentWidth(pItemObj);
+    pItemObj->nSubRows = 1;
+    pItemObj->nSubWidth = CalcItemWidth(pItemObj);
 
     HSTREEITEM hRet = CSTree<LPTVITEM>::InsertItem(pItemObj, hParent, hInsertAfter);
     pItemObj->hItem = hRet;
+    OnSiblingInserted(hRet);
     OnInsertItem(pItemObj);
+    if (bParentChanged)
+        UpdateItemStat(hParent); //父项自身的宽度也变了
+    else
+        PropagateItemStat(hParent, 1, 0, pItemObj->nSubWidth);
     if (bCheckState)
         CheckState(hParent);
     if (pItemObj->bVisible)
-    {
-        m_nVisibleItems++;
-
-        int nViewWidth = CalcItemWidth(pItemObj);
-        m_nContentWidth = smax(nViewWidth, m_nContentWidth);
         UpdateScrollBar();
-    }
 
     return hRet;
 }
@@ -495,7 +498,6 @@ void STreeCtrl::SetChildrenVisible(HSTREEITEM hItem, BOOL bVisible)
     {
         LPTVITEM pItem = GetItem(hChild);
         pItem->bVisible = bVisible;
-        m_nVisibleItems += bVisible ? 1 : -1;
         if (!pItem->bCollapsed)
             SetChildrenVisible(hChild, bVisible);
         hChild = GetNextSiblingItem(hChild);
@@ -635,28 +637,28 @@ void STreeCtrl::CalcItemContentWidth(LPTVITEM pItem)
     pItem->nContentWidth = rcTest.Width() + m_nItemOffset + 2 * m_nItemMargin.toPixelSize(GetScale());
 }
 
-int STreeCtrl::CalcMaxItemWidth(HSTREEITEM hItem)
+void STreeCtrl::UpdateItemContentWidth(LPTVITEM pItem)
 {
-    int nItemWidth = 0, nChildrenWidth = 0;
+    if (m_nBatchInsert > 0)
+        pItem->nContentWidth = -1; //在EndBatchInsert中用同一个RenderTarget测量
+    else
+        CalcItemContentWidth(pItem);
+}
 
+int STreeCtrl::CalcMaxItemWidth(HSTREEITEM hItem)
+{
     if (hItem != STVI_ROOT)
     {
         LPTVITEM pItem = GetItem(hItem);
-        if (pItem->bVisible)
-            nItemWidth = CalcItemWidth(pItem);
-        else
-            return 0;
+        return pItem->bVisible ? pItem->nSubWidth : 0;
     }
-    HSTREEITEM hChild = GetChildItem(hItem);
+    int nItemWidth = 0;
+    HSTREEITEM hChild = GetChildItem(STVI_ROOT);
     while (hChild)
     {
-        nChildrenWidth = CalcMaxItemWidth(hChild);
-        if (nChildrenWidth > nItemWidth)
-            nItemWidth = nChildrenWidth;
-
+        nItemWidth = smax(nItemWidth, GetItem(hChild)->nSubWidth);
         hChild = GetNextSiblingItem(hChild);
     }
-
     return nItemWidth;
 }
 
@@ -665,31 +667,257 @@ void STreeCtrl::UpdateContentWidth()
     m_nContentWidth = CalcMaxItemWidth(STVI_ROOT);
 }
 
+//nSubRows和nSubWidth统计项自身和展开的子孙项, 与项是否可见无关, 所以根项的统计之和就是可见项的统计.
+//折叠项的统计只包含自身, 子孙项的变化不需要向上传递.
+void STreeCtrl::UpdateItemStat(HSTREEITEM hItem, BOOL bPropagate)
+{
+    LPTVITEM pItem = GetItem(hItem);
+    int nOldRows = pItem->nSubRows;
+    int nOldWidth = pItem->nSubWidth;
+    pItem->nSubRows = 1;
+    pItem->nSubWidth = CalcItemWidth(pItem);
+    if (!pItem->bCollapsed)
+    {
+        HSTREEITEM hChild = GetChildItem(hItem);
+        while (hChild)
+        {
+            LPTVITEM pChild = GetItem(hChild);
+            pItem->nSubRows += pChild->nSubRows;
+            pItem->nSubWidth = smax(pItem->nSubWidth, pChild->nSubWidth);
+            hChild = GetNextSiblingItem(hChild);
+        }
+    }
+    if (pItem->nSubRows != nOldRows)
+        UpdateSiblingRows(hItem, pItem->nSubRows - nOldRows);
+    if (bPropagate && (pItem->nSubRows != nOldRows || pItem->nSubWidth != nOldWidth))
+        PropagateItemStat(GetParentItem(hItem), pItem->nSubRows - nOldRows, nOldWidth, pItem->nSubWidth);
+}
+
+void STreeCtrl::PropagateItemStat(HSTREEITEM hParent, int nDeltaRows, int nOldWidth, int nNewWidth)
+{
+    while (hParent && hParent != STVI_ROOT)
+    {
+        LPTVITEM pParent = GetItem(hParent);
+        if (pParent->bCollapsed)
+            return;
+        if (nNewWidth < nOldWidth && nOldWidth == pParent->nSubWidth)
+        { //最宽的行被删除或变窄了, 重新比较所有子项
+            UpdateItemStat(hParent);
+            return;
+        }
+        int nParentWidth = pParent->nSubWidth;
+        pParent->nSubRows += nDeltaRows;
+        if (nDeltaRows != 0)
+            UpdateSiblingRows(hParent, nDeltaRows);
+        pParent->nSubWidth = smax(nParentWidth, nNewWidth);
+        if (nDeltaRows == 0 && pParent->nSubWidth == nParentWidth)
+            return;
+        nOldWidth = nParentWidth;
+        nNewWidth = pParent->nSubWidth;
+        hParent = GetParentItem(hParent);
+    }
+
+    m_nVisibleItems += nDeltaRows;
+    if (nNewWidth > m_nContentWidth)
+        m_nContentWidth = nNewWidth;
+    else if (nNewWidth < nOldWidth && nOldWidth == m_nContentWidth)
+        UpdateContentWidth();
+}
+
+void STreeCtrl::UpdateAllItemsStat()
+{
+    ClearSiblingRows();
+    //后序遍历, 子项先于父项统计
+    HSTREEITEM hItem = GetRootItem();
+    while (hItem && GetChildItem(hItem))
+        hItem = GetChildItem(hItem);
+    while (hItem)
+    {
+        UpdateItemStat(hItem, FALSE);
+        HSTREEITEM hNext = GetNextSiblingItem(hItem);
+        if (hNext)
+        {
+            while (GetChildItem(hNext))
+                hNext = GetChildItem(hNext);
+            hItem = hNext;
+        }
+        else
+        {
+            hItem = GetParentItem(hItem);
+        }
+    }
+
+    m_nVisibleItems = 0;
+    hItem = GetRootItem();
+    while (hItem)
+    {
+        m_nVisibleItems += GetItem(hItem)->nSubRows;
+        hItem = GetNextSiblingItem(hItem);
+    }
+    UpdateContentWidth();
+}
+
+void STreeCtrl::BeginBatchInsert()
+{
+    m_nBatchInsert++;
+}
+
+void STreeCtrl::EndBatchInsert()
+{
+    SASSERT(m_nBatchInsert > 0);
+    if (--m_nBatchInsert > 0)
+        return;
+    RecalcItemsWidth(TRUE);
+    UpdateAllItemsStat();
+    UpdateScrollBar();
+}
+
 int STreeCtrl::GetItemShowIndex(HSTREEITEM hItemObj)
 {
-    int iVisible = -1;
-    HSTREEITEM hItem = GetNextItem(STVI_ROOT);
+    if (!GetItem(hItemObj)->bVisible)
+        return -1;
+    //前面的兄弟项及其展开的子孙项, 加上各级父项自身
+    int iVisible = 0;
+    HSTREEITEM hItem = hItemObj;
     while (hItem)
     {
-        LPTVITEM pItem = GetItem(hItem);
-        if (pItem->bVisible)
+        HSTREEITEM hParent = GetParentItem(hItem);
+        SiblingRows *pRows = GetSiblingRows(hParent ? hParent : STVI_ROOT);
+        for (int i = GetItem(hItem)->iSibling; i > 0; i -= i & -i)
+            iVisible += pRows->arrSums[i - 1];
+        hItem = hParent;
+        if (hItem)
             iVisible++;
-        if (hItem == hItemObj)
+    }
+    return iVisible;
+}
+
+HSTREEITEM STreeCtrl::GetItemByShowIndex(int iIndex)
+{
+    if (iIndex < 0 || iIndex >= m_nVisibleItems)
+        return 0;
+    HSTREEITEM hParent = STVI_ROOT;
+    for (;;)
+    {
+        //在树状数组中找到包含第iIndex行的子项
+        SiblingRows *pRows = GetSiblingRows(hParent);
+        int nCount = (int)pRows->arrItems.GetCount();
+        int iChild = 0;
+        int nStep = 1;
+        while (nStep * 2 <= nCount)
+            nStep *= 2;
+        for (; nStep > 0; nStep /= 2)
         {
-            return iVisible;
-        }
-        if (pItem->bCollapsed)
-        { //跳过被折叠的项
-            HSTREEITEM hChild = GetChildItem(hItem, FALSE);
-            while (hChild)
+            if (iChild + nStep <= nCount && pRows->arrSums[iChild + nStep - 1] <= iIndex)
             {
-                hItem = hChild;
-                hChild = GetChildItem(hItem, FALSE);
+                iChild += nStep;
+                iIndex -= pRows->arrSums[iChild - 1];
             }
         }
-        hItem = GetNextItem(hItem);
+        if (iChild >= nCount)
+            return 0;
+        HSTREEITEM hItem = pRows->arrItems[iChild];
+        if (iIndex == 0)
+            return hItem;
+        iIndex--; //跳过项自身, 在展开的子项中继续查找
+        hParent = hItem;
     }
-    return -1;
+}
+
+STreeCtrl::SiblingRows *STreeCtrl::GetSiblingRows(HSTREEITEM hParent)
+{
+    SiblingRows *pRows = NULL;
+    if (m_mapSiblingRows.Lookup(hParent, pRows))
+        return pRows;
+    pRows = new SiblingRows;
+    HSTREEITEM hChild = GetChildItem(hParent);
+    while (hChild)
+    {
+        LPTVITEM pChild = GetItem(hChild);
+        pChild->iSibling = (int)pRows->arrItems.GetCount();
+        pRows->arrItems.Add(hChild);
+        pRows->arrSums.Add(pChild->nSubRows);
+        hChild = GetNextSiblingItem(hChild);
+    }
+    //线性建树: 每个节点把自己的和加到父节点
+    int nCount = (int)pRows->arrSums.GetCount();
+    for (int i = 1; i <= nCount; i++)
+    {
+        int iUp = i + (i & -i);
+        if (iUp <= nCount)
+            pRows->arrSums[iUp - 1] += pRows->arrSums[i - 1];
+    }
+    m_mapSiblingRows[hParent] = pRows;
+    return pRows;
+}
+
+void STreeCtrl::InvalidSiblingRows(HSTREEITEM hParent)
+{
+    SiblingRows *pRows = NULL;
+    if (m_mapSiblingRows.Lookup(hParent ? hParent : STVI_ROOT, pRows))
+    {
+        delete pRows;
+        m_mapSiblingRows.RemoveKey(hParent ? hParent : STVI_ROOT);
+    }
+}
+
+void STreeCtrl::ClearSiblingRows()
+{
+    SPOSITION pos = m_mapSiblingRows.GetStartPosition();
+    while (pos)
+    {
+        delete m_mapSiblingRows.GetNextValue(pos);
+    }
+    m_mapSiblingRows.RemoveAll();
+}
+
+void STreeCtrl::UpdateSiblingRows(HSTREEITEM hItem, int nDeltaRows)
+{
+    HSTREEITEM hParent = GetParentItem(hItem);
+    SiblingRows *pRows = NULL;
+    if (!m_mapSiblingRows.Lookup(hParent ? hParent : STVI_ROOT, pRows))
+        return;
+    int nCount = (int)pRows->arrSums.GetCount();
+    for (int i = GetItem(hItem)->iSibling + 1; i <= nCount; i += i & -i)
+        pRows->arrSums[i - 1] += nDeltaRows;
+}
+
+void STreeCtrl::OnSiblingInserted(HSTREEITEM hItem)
+{
+    HSTREEITEM hParent = GetParentItem(hItem);
+    if (!hParent)
+        hParent = STVI_ROOT;
+    SiblingRows *pRows = NULL;
+    if (!m_mapSiblingRows.Lookup(hParent, pRows))
+        return;
+    if (GetNextSiblingItem(hItem))
+    { //插入到中间, 后面的子项位置都变了, 下次查询时重建
+        InvalidSiblingRows(hParent);
+        return;
+    }
+    //追加到末尾: 新节点覆盖(i-lowbit(i), i], 等于自身的行数加上(i-lowbit(i), i-1]的和
+    LPTVITEM pItem = GetItem(hItem);
+    int i = (int)pRows->arrItems.GetCount() + 1;
+    int nSum = pItem->nSubRows;
+    for (int j = i - 1; j > i - (i & -i); j -= j & -j)
+        nSum += pRows->arrSums[j - 1];
+    pItem->iSibling = i - 1;
+    pRows->arrItems.Add(hItem);
+    pRows->arrSums.Add(nSum);
+}
+
+HSTREEITEM STreeCtrl::GetNextShowItem(HSTREEITEM hItem)
+{
+    if (GetItem(hItem)->bCollapsed)
+    { //跳过被折叠的项
+        HSTREEITEM hChild = GetChildItem(hItem, FALSE);
+        while (hChild)
+        {
+            hItem = hChild;
+            hChild = GetChildItem(hItem, FALSE);
+        }
+    }
+    return GetNextItem(hItem);
 }
 
 BOOL STreeCtrl::GetItemRect(LPTVITEM pItemObj, CRect &rcItem)
@@ -703,34 +931,14 @@ BOOL STreeCtrl::GetItemRect(LPTVITEM pItemObj, CRect &rcItem)
     int iFirstVisible = m_siVer.nPos / nItemHei;
     int nPageItems = (rcClient.Height() + nItemHei - 1) / nItemHei + 1;
 
-    int iVisible = -1;
-    HSTREEITEM hItem = CSTree<LPTVITEM>::GetNextItem(STVI_ROOT);
-    while (hItem)
-    {
-        LPTVITEM pItem = CSTree<LPTVITEM>::GetItem(hItem);
-        if (pItem->bVisible)
-            iVisible++;
-        if (iVisible > iFirstVisible + nPageItems)
-            break;
-        if (iVisible >= iFirstVisible && pItem == pItemObj)
-        {
-            CRect rcRet(m_nIndent.toPixelSize(GetScale()) * pItemObj->nLevel, 0, rcClient.Width(), nItemHei);
-            rcRet.OffsetRect(rcClient.left - m_siHoz.nPos, rcClient.top - m_siVer.nPos + iVisible * nItemHei);
-            rcItem = rcRet;
-            return TRUE;
-        }
-        if (pItem->bCollapsed)
-        { //跳过被折叠的项
-            HSTREEITEM hChild = GetChildItem(hItem, FALSE);
-            while (hChild)
-            {
-                hItem = hChild;
-                hChild = GetChildItem(hItem, FALSE);
-            }
-        }
-        hItem = CSTree<LPTVITEM>::GetNextItem(hItem);
-    }
-    return FALSE;
+    int iVisible = GetItemShowIndex(pItemObj->hItem);
+    if (iVisible < iFirstVisible || iVisible > iFirstVisible + nPageItems)
+        return FALSE;
+
+    CRect rcRet(m_nIndent.toPixelSize(GetScale()) * pItemObj->nLevel, 0, rcClient.Width(), nItemHei);
+    rcRet.OffsetRect(rcClient.left - m_siHoz.nPos, rcClient.top - m_siVer.nPos + iVisible * nItemHei);
+    rcItem = rcRet;
+    return TRUE;
 }
 
 //自动修改pt的位置为相对当前项的偏移量
@@ -746,33 +954,13 @@ HSTREEITEM STreeCtrl::HitTest(CPoint &pt)
     if (iItem >= m_nVisibleItems)
         return 0;
 
-    HSTREEITEM hRet = 0;
-
-    int iVisible = -1;
-    HSTREEITEM hItem = CSTree<LPTVITEM>::GetNextItem(STVI_ROOT);
-    while (hItem)
+    HSTREEITEM hRet = GetItemByShowIndex(iItem);
+    if (hRet)
     {
-        LPTVITEM pItem = CSTree<LPTVITEM>::GetItem(hItem);
-        if (pItem->bVisible)
-            iVisible++;
-        if (iVisible == iItem)
-        {
-            CRect rcItem(nIndent * pItem->nLevel, 0, rcClient.Width(), nItemHei);
-            rcItem.OffsetRect(rcClient.left - m_siHoz.nPos, rcClient.top - m_siVer.nPos + iVisible * nItemHei);
-            pt -= rcItem.TopLeft();
-            hRet = hItem;
-            break;
-        }
-        if (pItem->bCollapsed)
-        { //跳过被折叠的项
-            HSTREEITEM hChild = GetChildItem(hItem, FALSE);
-            while (hChild)
-            {
-                hItem = hChild;
-                hChild = GetChildItem(hItem, FALSE);
-            }
-        }
-        hItem = CSTree<LPTVITEM>::GetNextItem(hItem);
+        LPTVITEM pItem = CSTree<LPTVITEM>::GetItem(hRet);
+        CRect rcItem(nIndent * pItem->nLevel, 0, rcClient.Width(), nItemHei);
+        rcItem.OffsetRect(rcClient.left - m_siHoz.nPos, rcClient.top - m_siVer.nPos + iItem * nItemHei);
+        pt -= rcItem.TopLeft();
     }
     return hRet;
 }
@@ -1142,6 +1330,7 @@ void STreeCtrl::ItemMouseLeave(HSTREEITEM hItem)
 void STreeCtrl::OnDestroy()
 {
     DeleteAllItems();
+    ClearSiblingRows();
     __baseCls::OnDestroy();
 }
 
@@ -1159,32 +1348,17 @@ void STreeCtrl::OnPaint(IRenderTarget *pRT)
     int iFirstVisible = m_siVer.nPos / nItemHei;
     int nPageItems = (m_rcClient.Height() + nItemHei - 1) / nItemHei + 1;
 
-    int iVisible = -1;
-    HSTREEITEM hItem = CSTree<LPTVITEM>::GetNextItem(STVI_ROOT);
-    while (hItem)
+    int iVisible = iFirstVisible;
+    HSTREEITEM hItem = GetItemByShowIndex(iFirstVisible);
+    while (hItem && iVisible <= iFirstVisible + nPageItems)
     {
         LPTVITEM pItem = CSTree<LPTVITEM>::GetItem(hItem);
-        if (pItem->bVisible)
-            iVisible++;
-        if (iVisible > iFirstVisible + nPageItems)
-            break;
-        if (iVisible >= iFirstVisible)
-        {
-            CRect rcItem(0, 0, CalcItemWidth(pItem), nItemHei);
-            rcItem.OffsetRect(rcClient.left - m_siHoz.nPos, rcClient.top - m_siVer.nPos + iVisible * nItemHei);
-            DrawLines(pRT, rcItem, hItem);
-            DrawItem(pRT, rcItem, hItem);
-        }
-        if (pItem->bCollapsed)
-        { //跳过被折叠的项
-            HSTREEITEM hChild = GetChildItem(hItem, FALSE);
-            while (hChild)
-            {
-                hItem = hChild;
-                hChild = GetChildItem(hItem, FALSE);
-            }
-        }
-        hItem = CSTree<LPTVITEM>::GetNextItem(hItem);
+        CRect rcItem(0, 0, CalcItemWidth(pItem), nItemHei);
+        rcItem.OffsetRect(rcClient.left - m_siHoz.nPos, rcClient.top - m_siVer.nPos + iVisible * nItemHei);
+        DrawLines(pRT, rcItem, hItem);
+        DrawItem(pRT, rcItem, hItem);
+        hItem = GetNextShowItem(hItem);
+        iVisible++;
     }
     AfterPaint(pRT, painter);
 }
@@ -1316,6 +1490,7 @@ void STreeCtrl::SortChildren(HSTREEITEM hItem, FunTreeSortCallback sortFunc, voi
     m_hHoverItem = 0;
     m_hCaptureItem = 0;
     CSTree<LPTVITEM>::SortChildren(hItem, sortFunc, pCtx);
+    ClearSiblingRows(); //子孙项也被排序了
 }
 
 BOOL STreeCtrl::VerifyItem(HSTREEITEM hItem) const
@@ -1339,6 +1514,7 @@ void STreeCtrl::OnNodeFree(LPTVITEM &pItemData)
     {
         m_pListener->OnDeleteItem(this, pItemData->hItem, pItemData->lParam);
     }
+    InvalidSiblingRows(pItemData->hItem);
     delete pItemData;
 }
 
@@ -1357,6 +1533,9 @@ void STreeCtrl::SetListener(IListener *pListener)
 
 void STreeCtrl::UpdateScrollBar()
 {
+    if (m_nBatchInsert > 0)
+        return; //在EndBatchInsert中更新
+
     CRect rcClient;
     SWindow::GetClientRect(&rcClient);
 
@@ -1452,22 +1631,17 @@ void STreeCtrl::CalcItemWidth(IRenderTarget *pRT, HSTREEITEM hItem, DWORD dwFlag
     CRect rcTest;
     DrawText(pRT, pItem->strText, pItem->strText.GetLength(), rcTest, dwFlags);
     pItem->nContentWidth = rcTest.Width() + m_nItemOffset + 2 * m_nItemMargin.toPixelSize(GetScale());
-    HSTREEITEM hChild = GetChildItem(hItem);
-    while (hChild)
-    {
-        CalcItemWidth(pRT, hChild, dwFlags);
-        hChild = GetNextSiblingItem(hChild);
-    }
 }
 
-void STreeCtrl::RecalcItemsWidth()
+void STreeCtrl::RecalcItemsWidth(BOOL bPendingOnly)
 {
     SAutoRefPtr<IRenderTarget> pRT;
     GETRENDERFACTORY->CreateRenderTarget(&pRT, 0, 0);
     BeforePaintEx(pRT);
     int dwFlags = DT_CALCRECT | (GetTextAlign() & ~(DT_CENTER | DT_RIGHT | DT_VCENTER | DT_BOTTOM));
     for (HSTREEITEM hItem = GetRootItem(); hItem; hItem = GetNextItem(hItem)){
-        CalcItemWidth(pRT, hItem, dwFlags);
+        if (!bPendingOnly || GetItem(hItem)->nContentWidth < 0)
+            CalcItemWidth(pRT, hItem, dwFlags);
     }
 }
 
@@ -1482,7 +1656,7 @@ void STreeCtrl::OnScaleChanged(int nScale)
     GetScaleSkin(m_pCheckSkin, nScale);
     ItemLayout();
     RecalcItemsWidth();
-    UpdateContentWidth();
+    UpdateAllItemsStat();
     UpdateScrollBar();
 }
 
@@ -3,6 +3,8 @@
 #include "animation/SInterpolatorImpl.h"
 #include <core/SWindowMgr.h>
 #include <core/SWnd.h>
+#include <core/STimelineDef.h>
+#include <helper/STimer.h>
 
 SNSBEGIN
 
@@ -19,10 +21,13 @@ SCaret::SCaret(ISwndContainer *pContainer)
     , m_hOwner(0)
 {
     m_AniInterpolator.Attach(CREATEINTERPOLATOR(SAccelerateInterpolator::GetClassName()));
+    MemberFunctionSlot<SCaret, IEvtArgs> slot = Subscriber(&SCaret::OnSteadyTimer, this);
+    m_steadyTimer.Attach(new STimer(&slot));
 }
 
 SCaret::~SCaret()
 {
+    m_steadyTimer->KillTimer();
     m_pContainer->UnregisterTimelineHandler(this);
 }
 
@@ -115,6 +120,43 @@ void SCaret::OnNextFrame()
             Invalidate();
         }
     }
+    if (m_iFrame == 0 || m_iFrame == m_nShowFrames)
+        UpdateTicker();
+}
+
+int SCaret::GetSteadyPhaseEnd() const
+{
+    if (m_iFrame < m_nShowFrames)
+        return m_nShowFrames;
+    if (!m_bAniCaret)
+        return m_nShowFrames + m_nAniFrames * 2;
+    return -1;
+}
+
+void SCaret::UpdateTicker()
+{
+    int nEnd = GetSteadyPhaseEnd();
+    if (nEnd > m_iFrame)
+    { //稳定阶段不需要逐帧刷新，让出宿主的脉冲定时器
+        m_pContainer->UnregisterTimelineHandler(this);
+        m_steadyTimer->StartTimer((nEnd - m_iFrame) * kTimelineInterval, FALSE);
+    }
+    else
+    {
+        m_steadyTimer->KillTimer();
+        m_pContainer->RegisterTimelineHandler(this);
+    }
+}
+
+BOOL SCaret::OnSteadyTimer(IEvtArgs *e)
+{
+    if (!m_bVisible)
+        return TRUE;
+    int nEnd = GetSteadyPhaseEnd();
+    if (nEnd > 0)
+        m_iFrame = nEnd - 1;
+    OnNextFrame();
+    return TRUE;
 }
 
 void SCaret::SetPosition(int x, int y)
@@ -125,6 +167,8 @@ void SCaret::SetPosition(int x, int y)
     if (m_bVisible)
     {
         m_bDrawCaret = TRUE;
+        m_byAlpha = 255;
+        UpdateTicker();
     }
     RECT rc = { 0 };
     m_pContainer->FrameToHost(&rc);
@@ -142,11 +186,14 @@ BOOL SCaret::SetVisible(BOOL bVisible, SWND owner)
     if (m_bVisible)
     {
         m_bDrawCaret = TRUE;
+        m_byAlpha = 255;
+        UpdateTicker();
     }
-    if (bVisible)
-        m_pContainer->RegisterTimelineHandler(this);
     else
+    {
+        m_steadyTimer->KillTimer();
         m_pContainer->UnregisterTimelineHandler(this);
+    }
     return TRUE;
 }
 
@@ -165,6 +212,8 @@ RECT SCaret::GetRect() const
 
 void SCaret::Invalidate()
 {
+    if (m_pContainer->UpdateCaretOverlay(this))
+        return;
     if (m_hOwner)
     {
         SWindow *pOwner = SWindowMgr::GetWindow(m_hOwner);
@@ -129,13 +129,50 @@ void SHostPresenter::UpdateLayerFromRenderTarget(IRenderTarget *pRT, BYTE byAlph
 }
 
 #else
+// tile边长，一行像素的掩码正好装进一个64位整数
+static const int KShapeTile = 64;
+static const COLORREF KShapeAlphaMask = 0xFF000000;
+
+//计算一个tile的alpha掩码(透明/不透明)的哈希，颜色和半透明程度的变化不影响结果
+static uint64_t HashTileMask(const COLORREF *bits, int nWid, const RECT &rcTile)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const COLORREF *row = bits + rcTile.top * nWid;
+    for (int y = rcTile.top; y < rcTile.bottom; y++, row += nWid)
+    {
+        uint64_t mask = 0;
+        for (int x = rcTile.left; x < rcTile.right; x++)
+            mask = (mask << 1) | ((row[x] & KShapeAlphaMask) != 0);
+        hash = (hash ^ mask) * 1099511628211ULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+//用位图中rcPatch范围的形状替换hRgnShape中对应的部分
+static void PatchShapeRgn(HRGN hRgnShape, HBITMAP hBmp, const RECT &rcPatch)
+{
+    HRGN hRgn = CreateRectRgnIndirect(&rcPatch);
+    CombineRgn(hRgnShape, hRgnShape, hRgn, RGN_DIFF);
+    DeleteObject(hRgn);
+    hRgn = CreateRegionFromBitmapRect(hBmp, &rcPatch, 0, KShapeAlphaMask);
+    if (hRgn)
+    {
+        CombineRgn(hRgnShape, hRgnShape, hRgn, RGN_OR);
+        DeleteObject(hRgn);
+    }
+}
+
 SHostPresenter::SHostPresenter(SHostWnd *pHostWnd)
     : m_pHostWnd(pHostWnd)
+    , m_hRgnShape(NULL)
 {
+    m_szShape.cx = m_szShape.cy = 0;
 }
 
 SHostPresenter::~SHostPresenter(void)
 {
+    ResetAutoShape();
 }
 
 void SHostPresenter::OnHostCreate(THIS)
@@ -144,10 +181,12 @@ void SHostPresenter::OnHostCreate(THIS)
 
 void SHostPresenter::OnHostDestroy(THIS)
 {
+    ResetAutoShape();
 }
 
 void SHostPresenter::OnHostResize(THIS_ SIZE szHost)
 {
+    ResetAutoShape();
 }
 
 void SHostPresenter::OnHostPresent(THIS_ HDC hdc, IRenderTarget *pMemRT, LPCRECT rcInvalid, BYTE byAlpha)
@@ -159,16 +198,98 @@ void SHostPresenter::OnHostPresent(THIS_ HDC hdc, IRenderTarget *pMemRT, LPCRECT
     ::BitBlt(hdc, rcInvalid->left, rcInvalid->top, rcInvalid->right - rcInvalid->left, rcInvalid->bottom - rcInvalid->top, memdc, rcInvalid->left, rcInvalid->top, SRCCOPY);
     if (m_pHostWnd->GetHostAttr().m_bTranslucent && m_pHostWnd->GetHostAttr().m_bAutoShape)
     {
-        HBITMAP hBmp = GetCurrentObject(memdc, OBJ_BITMAP);
-        HRGN hRgn = CreateRegionFromBitmap(hBmp, 0, 0xFF000000);
-        SetWindowRgn(m_pHostWnd->m_hWnd, hRgn, FALSE);
-        if (hRgn)
-            DeleteObject(hRgn);
+        UpdateAutoShape((HBITMAP)GetCurrentObject(memdc, OBJ_BITMAP), rcInvalid);
+    }
+    else
+    {
+        ResetAutoShape();
     }
     pMemRT->ReleaseDC(memdc, NULL);
     if (bGetDC)
         m_pHostWnd->ReleaseDC(hdc);
 }
 
+void SHostPresenter::UpdateAutoShape(HBITMAP hBmp, LPCRECT prcDirty)
+{
+    BITMAP bm = { 0 };
+    if (!GetObject(hBmp, sizeof(bm), &bm) || bm.bmBitsPixel != 32 || !bm.bmBits)
+        return;
+    const COLORREF *bits = (const COLORREF *)bm.bmBits;
+    CRect rcBmp(0, 0, bm.bmWidth, bm.bmHeight);
+    int nCols = (bm.bmWidth + KShapeTile - 1) / KShapeTile;
+    int nRows = (bm.bmHeight + KShapeTile - 1) / KShapeTile;
+
+    if (!m_hRgnShape || m_szShape.cx != bm.bmWidth || m_szShape.cy != bm.bmHeight)
+    {
+        //没有可用的形状，全图扫描一次并记下每个tile的掩码哈希
+        ResetAutoShape();
+        m_szShape = rcBmp.Size();
+        m_arrTileHash.SetCount(nCols * nRows);
+        for (int r = 0; r < nRows; r++)
+        {
+            for (int c = 0; c < nCols; c++)
+            {
+                CRect rcTile = CRect(c * KShapeTile, r * KShapeTile, (c + 1) * KShapeTile, (r + 1) * KShapeTile) & rcBmp;
+                m_arrTileHash[r * nCols + c] = HashTileMask(bits, bm.bmWidth, rcTile);
+            }
+        }
+        m_hRgnShape = CreateRegionFromBitmap(hBmp, 0, KShapeAlphaMask);
+        if (!m_hRgnShape)
+            m_hRgnShape = CreateRectRgn(0, 0, 0, 0);
+        SetWindowRgn(m_pHostWnd->m_hWnd, m_hRgnShape, FALSE);
+        return;
+    }
+
+    CRect rcDirty = prcDirty ? (CRect(prcDirty) & rcBmp) : rcBmp;
+    if (rcDirty.IsRectEmpty())
+        return;
+    int c0 = rcDirty.left / KShapeTile, c1 = (rcDirty.right - 1) / KShapeTile;
+    int r0 = rcDirty.top / KShapeTile, r1 = (rcDirty.bottom - 1) / KShapeTile;
+    BOOL bChanged = FALSE;
+    for (int r = r0; r <= r1; r++)
+    {
+        //只重扫掩码变化了的tile，同一行相邻的tile合并成一段再修补区域
+        int cRun = -1;
+        for (int c = c0; c <= c1 + 1; c++)
+        {
+            BOOL bTileChanged = FALSE;
+            if (c <= c1)
+            {
+                CRect rcTile = CRect(c * KShapeTile, r * KShapeTile, (c + 1) * KShapeTile, (r + 1) * KShapeTile) & rcBmp;
+                uint64_t hash = HashTileMask(bits, bm.bmWidth, rcTile);
+                uint64_t &hashOld = m_arrTileHash[r * nCols + c];
+                bTileChanged = hash != hashOld;
+                hashOld = hash;
+            }
+            if (bTileChanged)
+            {
+                if (cRun < 0)
+                    cRun = c;
+            }
+            else if (cRun >= 0)
+            {
+                CRect rcRun = CRect(cRun * KShapeTile, r * KShapeTile, c * KShapeTile, (r + 1) * KShapeTile) & rcBmp;
+                PatchShapeRgn(m_hRgnShape, hBmp, rcRun);
+                cRun = -1;
+                bChanged = TRUE;
+            }
+        }
+    }
+    //掩码没变时窗口形状不动
+    if (bChanged)
+        SetWindowRgn(m_pHostWnd->m_hWnd, m_hRgnShape, FALSE);
+}
+
+void SHostPresenter::ResetAutoShape()
+{
+    if (m_hRgnShape)
+    {
+        DeleteObject(m_hRgnShape);
+        m_hRgnShape = NULL;
+    }
+    m_szShape.cx = m_szShape.cy = 0;
+    m_arrTileHash.RemoveAll();
+}
+
 #endif //_WIN32
 SNSEND
\ No newline at end of file
@@ -18,6 +18,8 @@ SOsrPanel::SOsrPanel(IHostProxy *pFrameHost, IItemContainer *pItemContainer)
 {
     SetContainer(this);
     SwndContainerImpl::SetRoot(this);
+    //面板在不同的表项间复用，不保留图层
+    SwndContainerImpl::SetLayerCacheBudget(0);
     SASSERT(m_pHostProxy);
     SASSERT(m_pItemContainer);
     m_evtSet.addEvent(EVENTID(EventItemPanelClick));
@@ -148,13 +150,18 @@ void SOsrPanel::UpdateRegion(IRegionS *rgn)
 {
     CRect rc = GetItemRect();
     rgn->Offset(rc.TopLeft());
+    //表项直接刷新到宿主容器，没有经过宿主的InvalidateRect
+    m_pHostProxy->MarkHostLayersDirty();
     m_pHostProxy->GetHostContainer()->UpdateRegion(rgn);
 }
 
 void SOsrPanel::OnRedraw(LPCRECT rc, BOOL bClip)
 {
     if (m_pHostProxy->IsHostUpdateLocked())
+    {
+        m_pHostProxy->MarkHostLayersDirty();
         return;
+    }
 
     CRect rcItem = GetItemRect();
     if (!rcItem.IsRectNull() && m_pHostProxy->IsHostVisible())
@@ -438,6 +445,48 @@ int SOsrPanel::RemoveTasksForObject(THIS_ void *pObj)
     return m_pHostProxy->GetHostContainer()->RemoveTasksForObject(pObj);
 }
 
+BOOL SOsrPanel::SetSwndTimer(THIS_ SWND swnd, char id, UINT uElapse)
+{
+    return m_pHostProxy->GetHostContainer()->SetSwndTimer(swnd, id, uElapse);
+}
+
+BOOL SOsrPanel::KillSwndTimer(THIS_ SWND swnd, char id)
+{
+    return m_pHostProxy->GetHostContainer()->KillSwndTimer(swnd, id);
+}
+
+int SOsrPanel::KillSwndTimers(THIS_ SWND swnd)
+{
+    return m_pHostProxy->GetHostContainer()->KillSwndTimers(swnd);
+}
+
+BOOL SOsrPanel::SetCaretOverlay(THIS_ ICaret *pCaret, SWND swndOwner)
+{
+    //表项没有独立的缓存，插入符仍然由宿主窗口绘制
+    return FALSE;
+}
+
+BOOL SOsrPanel::UpdateCaretOverlay(THIS_ ICaret *pCaret)
+{
+    return FALSE;
+}
+
+//表项共用宿主的RT池，避免每个表项各自缓存空闲RT
+BOOL SOsrPanel::AcquireOffscreenRT(THIS_ SIZE sz, IRenderTarget **ppRT)
+{
+    return m_pHostProxy->GetHostContainer()->AcquireOffscreenRT(sz, ppRT);
+}
+
+void SOsrPanel::RecycleOffscreenRT(THIS_ IRenderTarget *pRT)
+{
+    m_pHostProxy->GetHostContainer()->RecycleOffscreenRT(pRT);
+}
+
+void SOsrPanel::GetOffscreenRTStats(THIS_ RtPoolStats *pStats) const
+{
+    m_pHostProxy->GetHostContainer()->GetOffscreenRTStats(pStats);
+}
+
 //////////////////////////////////////////////////////////////////////////
 SItemPanel *SItemPanel::Create(IHostProxy *pFrameHost, SXmlNode xmlNode, IItemContainer *pItemContainer)
 {
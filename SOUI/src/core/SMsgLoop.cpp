@@ -42,7 +42,11 @@ SMessageLoop::SMessageLoop(IMessageLoop *pParentLoop)
     , m_bQuit(FALSE)
     , m_bDoIdle(FALSE)
     , m_nIdleCount(0)
+    , m_bWaked(FALSE)
+    , m_bTaskTimerArmed(FALSE)
+    , m_bTaskWakePosted(FALSE)
 {
+    memset(&m_wakeStats, 0, sizeof(m_wakeStats));
     m_priv = new SMessageLoopPriv(pParentLoop);
 }
 
@@ -186,12 +190,6 @@ BOOL SMessageLoop::AddMessageFilter(IMsgFilter *pMessageFilter)
     return TRUE;
 }
 
-static void CALLBACK OnTimer(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime){
-    KillTimer(hwnd, idEvent);
-    tid_t tid = GetCurrentThreadId();
-    PostThreadMessage(tid, WM_NULL, 0, 0);
-}
-
 BOOL SMessageLoop::PostTask(IRunnable *runable)
 {
     SAutoLock lock(m_cs);
@@ -200,11 +198,23 @@ BOOL SMessageLoop::PostTask(IRunnable *runable)
         SSLOGW() << "msg loop not running now! pending task size:" << m_priv->m_runnables.GetCount();
     }
     m_priv->m_runnables.AddTail(runable->clone());
+    // 一批任务只唤醒一次消息循环：队列较长时立即投递WM_NULL，否则只在队列由空变为非空时设置一个100ms的最长等待定时器。
+    // 任务在处理下一条消息前执行，定时器消息本身就能唤醒循环，不需要再额外投递WM_NULL。
     if (m_priv->m_runnables.GetCount() > 5)
     {
-        PostThreadMessage(m_tid, WM_NULL, 0, 0);
-    }else{
-        m_priv->m_msgWnd.SetTimer(TM_POSTTASK, 100, OnTimer);//set max waitting time to 100ms.
+        if (!m_bTaskWakePosted)
+        {
+            m_bTaskWakePosted = PostThreadMessage(m_tid, WM_NULL, 0, 0);
+        }
+    }
+    else if (!m_bTaskTimerArmed && !m_bTaskWakePosted)
+    {
+        m_bTaskTimerArmed = m_priv->m_msgWnd.SetTimer(TM_POSTTASK, 100, NULL) != 0; // set max waitting time to 100ms.
+        if (!m_bTaskTimerArmed)
+        {
+            // 非消息循环线程无法为m_msgWnd设置定时器，直接投递WM_NULL唤醒。
+            m_bTaskWakePosted = PostThreadMessage(m_tid, WM_NULL, 0, 0);
+        }
     }
     return TRUE;
 }
@@ -250,6 +260,12 @@ void SMessageLoop::ExecutePendingTask()
 {
     m_cs.Enter();
     m_priv->m_runningQueue.Swap(m_priv->m_runnables);
+    if (m_bTaskTimerArmed)
+    {
+        m_priv->m_msgWnd.KillTimer(TM_POSTTASK);
+        m_bTaskTimerArmed = FALSE;
+    }
+    m_bTaskWakePosted = FALSE;
     m_cs.Leave();
     for (;;)
     {
@@ -265,7 +281,6 @@ void SMessageLoop::ExecutePendingTask()
     {
         m_priv->m_parentLoop->ExecutePendingTask();
     }
-    m_priv->m_msgWnd.KillTimer(TM_POSTTASK);
 }
 
 BOOL SMessageLoop::PeekMsg(THIS_ LPMSG pMsg, UINT wMsgFilterMin, UINT wMsgFilterMax, BOOL bRemove)
@@ -279,6 +294,7 @@ void SMessageLoop::RunIdle()
     while (!m_bQuit && m_bDoIdle && !PeekMsg(&msg, 0, 0, FALSE))
     {
         m_bDoIdle = OnIdle(m_nIdleCount++);
+        m_wakeStats.nIdleRuns++;
     }
 }
 
@@ -287,7 +303,47 @@ BOOL SMessageLoop::WaitMsg(THIS)
     RunIdle();
     if (m_bQuit)
         return FALSE;
-    return ::WaitMessage();
+    m_wakeStats.nWaits++;
+    BOOL bRet = ::WaitMessage();
+    m_bWaked = bRet;
+    return bRet;
+}
+
+void SMessageLoop::AccountWake(const MSG *pMsg)
+{
+    switch (pMsg->message)
+    {
+    case WM_TIMER:
+        if (pMsg->hwnd == m_priv->m_msgWnd.m_hWnd && pMsg->wParam == (WPARAM)TM_POSTTASK)
+            m_wakeStats.nTaskWakes++;
+        else
+            m_wakeStats.nTimerWakes++;
+        break;
+    case WM_SYSTIMER:
+        m_wakeStats.nTimerWakes++;
+        break;
+    case WM_NULL:
+        if (pMsg->hwnd == 0)
+        {
+            m_wakeStats.nTaskWakes++;
+            break;
+        }
+        // fall through
+    default:
+        m_wakeStats.nMsgWakes++;
+        break;
+    }
+}
+
+void SMessageLoop::GetWakeStats(THIS_ MsgLoopWakeStats *pStats) const
+{
+    if (pStats)
+        *pStats = m_wakeStats;
+}
+
+void SMessageLoop::ResetWakeStats(THIS)
+{
+    memset(&m_wakeStats, 0, sizeof(m_wakeStats));
 }
 
 int SMessageLoop::HandleMsg(THIS)
@@ -295,6 +351,11 @@ int SMessageLoop::HandleMsg(THIS)
     MSG msg = { 0 };
     while (PeekMsg(&msg, 0, 0, TRUE) && !m_bQuit)
     {
+        if (m_bWaked)
+        {
+            m_bWaked = FALSE;
+            AccountWake(&msg);
+        }
         if (msg.message == WM_QUIT)
         {
             m_bQuit = TRUE;
@@ -308,6 +369,12 @@ int SMessageLoop::HandleMsg(THIS)
             m_nIdleCount = 0;
         }
     }
+    if (m_bWaked)
+    {
+        // 只有SendMessage类消息时PeekMessage在内部分发后返回FALSE
+        m_bWaked = FALSE;
+        m_wakeStats.nMsgWakes++;
+    }
     return (int)msg.wParam;
 }
 
@@ -552,6 +552,10 @@ void SNcPainter::InvalidateHostRect(LPCRECT pRc, BOOL bClip)
     DeleteObject(hRgn);
 }
 
+void SNcPainter::MarkHostLayersDirty()
+{
+}
+
 void SNcPainter::OnLayoutDirty()
 {
     if (!m_memLeft)
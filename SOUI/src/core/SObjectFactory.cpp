@@ -6,10 +6,10 @@
 
 void ObjInfo_New(SObjectInfo *ret, LPCWSTR name, int type, LPCWSTR alise)
 {
-    SNS::SStringW strName(name);
-    strName.MakeLower();
-    SASSERT(strName.GetLength() < MAX_OBJNAME);
-    wcscpy(ret->szName, strName.c_str());
+    //类名不区分大小写，直接取原子的小写形式，创建对象时不再分配和转换字符串
+    SNS::SAtom atom = SNS::SAtom(name).GetFolded();
+    SASSERT(atom.GetLength() < MAX_OBJNAME);
+    wcscpy(ret->szName, atom.GetName());
     ret->nType = type;
     ret->szAlise = alise;
 }
@@ -79,16 +79,43 @@ BOOL SObjectFactoryMgr::UnregisterFactory(const SObjectInfo &objInfo)
 
 IObject *SObjectFactoryMgr::CreateObject(const SObjectInfo &objInfo) const
 {
-    if (!HasKey(objInfo))
+    const SMap<SObjectInfo, SObjectFactoryPtr>::CPair *p = m_mapNamedObj->Lookup(objInfo);
+    if (!p)
     {
         return OnCreateUnknownObject(objInfo);
     }
-    IObject *pRet = GetKeyObject(objInfo)->NewObject();
+    //在构造之前取走，构造函数里创建的窗口不会用到它
+    SXmlNode xmlInit;
+    if (objInfo.nType == Window)
+        xmlInit = TakePendingInitXml();
+    IObject *pRet = p->m_value->NewObject();
     SASSERT(pRet);
-    SetSwndDefAttr(pRet);
+    SetSwndDefAttr(pRet, xmlInit);
     return pRet;
 }
 
+void SObjectFactoryMgr::SetPendingInitXml(SXmlNode xmlInit)
+{
+    //按线程保存，多个UI线程同时创建窗口时互不干扰
+    SAutoLock lock(m_csPendingInit);
+    if (xmlInit)
+        m_mapPendingInit[GetCurrentThreadId()] = xmlInit;
+    else
+        m_mapPendingInit.RemoveKey(GetCurrentThreadId());
+}
+
+SXmlNode SObjectFactoryMgr::TakePendingInitXml() const
+{
+    SAutoLock lock(m_csPendingInit);
+    if (m_mapPendingInit.IsEmpty())
+        return SXmlNode();
+    SXmlNode ret;
+    tid_t tid = GetCurrentThreadId();
+    if (m_mapPendingInit.Lookup(tid, ret))
+        m_mapPendingInit.RemoveKey(tid);
+    return ret;
+}
+
 SObjectInfo SObjectFactoryMgr::BaseObjectInfoFromObjectInfo(const SObjectInfo &objInfo)
 {
     SObjectInfo ret = { L"", NULL, Undef };
@@ -104,39 +131,15 @@ SObjectInfo SObjectFactoryMgr::BaseObjectInfoFromObjectInfo(const SObjectInfo &o
     return ret;
 }
 
-void SObjectFactoryMgr::SetSwndDefAttr(IObject *pObject) const
+void SObjectFactoryMgr::SetSwndDefAttr(IObject *pObject, SXmlNode xmlInit) const
 {
-    LPCWSTR pszClassName = pObject->GetObjectClass();
-
     if (pObject->GetObjectType() != Window)
         return;
 
-    //检索并设置类的默认属性
-    SXmlNode defAttr;
+    //按类展开好的默认属性表，"class"属性在最前面
     SObjDefAttr *pDefObjAttr = GETUIDEF->GetUiDef()->GetObjDefAttr();
     if (pDefObjAttr)
-        defAttr = pDefObjAttr->GetDefAttribute(pszClassName);
-
-    if (defAttr)
-    {
-        //优先处理"class"属性
-        SXmlAttr attrClass = defAttr.attribute(L"class");
-        if (attrClass)
-        {
-            attrClass.set_userdata(1);
-            pObject->SetAttribute(attrClass.name(), attrClass.value(), TRUE);
-        }
-        for (SXmlAttr attr = defAttr.first_attribute(); attr; attr = attr.next_attribute())
-        {
-            if (attr.get_userdata())
-                continue;
-            pObject->SetAttribute(attr.name(), attr.value(), TRUE);
-        }
-        if (attrClass)
-        {
-            attrClass.set_userdata(0);
-        }
-    }
+        pDefObjAttr->ApplyDefAttribute(pObject, xmlInit);
 }
 
 IObject *SObjectFactoryMgr::OnCreateUnknownObject(const SObjectInfo &objInfo) const
@@ -5,8 +5,142 @@
 #include "core/SSkin.h"
 #include "helper/SDIBHelper.h"
 #include <core/SGradient.h>
+#include <helper/SCriticalSection.h>
 SNSBEGIN
 
+//////////////////////////////////////////////////////////////////////////
+// SColorizedCache
+// 所有SSkinImgList共享的着色副本缓存, 切换回缓存中的颜色只需要复制像素.
+// 每个皮肤最多保留kMaxPerSkin份副本, 全部副本按位图字节数计入预算, 超出时淘汰最久未用的副本.
+class SColorizedCache {
+    enum
+    {
+        kMaxPerSkin = 4,
+        KDefBudget = 16 * 1024 * 1024, // 默认预算16M
+    };
+
+    struct CacheItem
+    {
+        const SSkinImgList *pOwner;
+        COLORREF cr;
+        SAutoRefPtr<IBitmapS> img;
+        size_t cbSize;
+    };
+
+  public:
+    SColorizedCache()
+        : m_cbBudget(KDefBudget)
+        , m_cbUsed(0)
+    {
+    }
+
+    void SetBudget(size_t cbBudget)
+    {
+        SAutoLock lock(m_cs);
+        m_cbBudget = cbBudget;
+        _Evict(0);
+    }
+
+    size_t GetUsed()
+    {
+        SAutoLock lock(m_cs);
+        return m_cbUsed;
+    }
+
+    //命中时把副本复制到pDst, 副本移到LRU链表头部
+    BOOL CopyTo(const SSkinImgList *pOwner, COLORREF cr, IBitmapS *pDst)
+    {
+        SAutoLock lock(m_cs);
+        SPOSITION pos = m_lstItem.GetHeadPosition();
+        while (pos)
+        {
+            SPOSITION posCur = pos;
+            const CacheItem &item = m_lstItem.GetNext(pos);
+            if (item.pOwner == pOwner && item.cr == cr)
+            {
+                CopyPixels(pDst, item.img);
+                m_lstItem.MoveToHead(posCur);
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+
+    void Insert(const SSkinImgList *pOwner, COLORREF cr, IBitmapS *pImg)
+    {
+        size_t cbSize = (size_t)pImg->Width() * pImg->Height() * 4;
+        SAutoLock lock(m_cs);
+        if (cbSize > m_cbBudget)
+            return;
+        //同一个皮肤的副本超过kMaxPerSkin时先淘汰它自己最久未用的副本
+        int nOwned = 0;
+        SPOSITION posOldest = NULL;
+        SPOSITION pos = m_lstItem.GetHeadPosition();
+        while (pos)
+        {
+            SPOSITION posCur = pos;
+            if (m_lstItem.GetNext(pos).pOwner == pOwner)
+            {
+                nOwned++;
+                posOldest = posCur;
+            }
+        }
+        if (nOwned >= kMaxPerSkin)
+            _RemoveAt(posOldest);
+        _Evict(cbSize);
+
+        CacheItem item;
+        item.pOwner = pOwner;
+        item.cr = cr;
+        item.img = pImg;
+        item.cbSize = cbSize;
+        m_lstItem.AddHead(item);
+        m_cbUsed += cbSize;
+    }
+
+    void Remove(const SSkinImgList *pOwner)
+    {
+        SAutoLock lock(m_cs);
+        SPOSITION pos = m_lstItem.GetHeadPosition();
+        while (pos)
+        {
+            SPOSITION posCur = pos;
+            if (m_lstItem.GetNext(pos).pOwner == pOwner)
+                _RemoveAt(posCur);
+        }
+    }
+
+    static void CopyPixels(IBitmapS *pDst, const IBitmapS *pSrc)
+    {
+        LPCVOID pSrcBits = pSrc->GetPixelBits();
+        LPVOID pDstBits = pDst->LockPixelBits();
+        memcpy(pDstBits, pSrcBits, pDst->Width() * pDst->Height() * 4);
+        pDst->UnlockPixelBits(pDstBits);
+    }
+
+  protected:
+    void _RemoveAt(SPOSITION pos)
+    {
+        m_cbUsed -= m_lstItem.GetAt(pos).cbSize;
+        m_lstItem.RemoveAt(pos);
+    }
+
+    void _Evict(size_t cbNeed)
+    {
+        while (m_cbUsed + cbNeed > m_cbBudget && !m_lstItem.IsEmpty())
+        {
+            _RemoveAt(m_lstItem.GetTailPosition());
+        }
+    }
+
+    SCriticalSection m_cs;
+    SList<CacheItem> m_lstItem; // 最近使用的在头部
+    size_t m_cbBudget;
+    size_t m_cbUsed;
+};
+
+static SColorizedCache s_colorizedCache;
+
 //////////////////////////////////////////////////////////////////////////
 // SSkinImgList
 SSkinImgList::SSkinImgList()
@@ -21,6 +155,7 @@ SSkinImgList::SSkinImgList()
 
 SSkinImgList::~SSkinImgList()
 {
+    s_colorizedCache.Remove(this);
 }
 
 SIZE SSkinImgList::GetSkinSize() const
@@ -88,6 +223,10 @@ bool SSkinImgList::SetImage(IBitmapS *pImg)
     m_pImg = pImg;
     m_strSrc.Empty();
     m_bLazyLoad = FALSE;
+    // colorized data belongs to the old image.
+    m_imgBackup = NULL;
+    s_colorizedCache.Remove(this);
+    m_crColorize = 0;
     return true;
 }
 
@@ -103,6 +242,16 @@ IBitmapS *SSkinImgList::GetImage() const
     return m_pImg;
 }
 
+void SSkinImgList::SetColorizedCacheBudget(size_t cbBudget)
+{
+    s_colorizedCache.SetBudget(cbBudget);
+}
+
+size_t SSkinImgList::GetColorizedCacheSize()
+{
+    return s_colorizedCache.GetUsed();
+}
+
 void SSkinImgList::OnColorize(COLORREF cr)
 {
     if (!m_bEnableColorize)
@@ -112,25 +261,31 @@ void SSkinImgList::OnColorize(COLORREF cr)
     m_crColorize = cr;
 
     IBitmapS *pImg = GetImage();
-    if (m_imgBackup)
-    { // restore
-        LPCVOID pSrc = m_imgBackup->GetPixelBits();
-        LPVOID pDst = pImg->LockPixelBits();
-        memcpy(pDst, pSrc, pImg->Width() * pImg->Height() * 4);
-        pImg->UnlockPixelBits(pDst);
-    }
-    else
+    if (!pImg)
+        return;
+    if (!m_imgBackup)
     {
-        if (!pImg)
+        if (cr == 0)
             return;
         if (S_OK != pImg->Clone(&m_imgBackup))
             return;
     }
 
-    if (cr != 0)
-        SDIBHelper::Colorize(pImg, cr);
-    else
-        m_imgBackup = NULL; // free backup
+    if (cr == 0)
+    { // restore, keep backup and cache for switching back.
+        SColorizedCache::CopyPixels(pImg, m_imgBackup);
+        return;
+    }
+
+    if (s_colorizedCache.CopyTo(this, cr, pImg))
+        return;
+
+    SColorizedCache::CopyPixels(pImg, m_imgBackup);
+    SDIBHelper::Colorize(pImg, cr);
+
+    SAutoRefPtr<IBitmapS> imgColorized;
+    if (S_OK == pImg->Clone(&imgColorized))
+        s_colorizedCache.Insert(this, cr, imgColorized);
 }
 
 void SSkinImgList::_Scale(ISkinObj *skinObj, int nScale)
@@ -140,6 +140,12 @@ SWindow::SWindow()
     , m_isAnimating(false)
     , m_isDestroying(false)
     , m_isLoading(false)
+    , m_bCaretOverlay(FALSE)
+    , m_bRetainLayer(FALSE)
+    , m_bLayerValid(FALSE)
+    , m_bLayerCapturing(FALSE)
+    , m_nLayerFrames(0)
+    , m_nLayerMisses(0)
     , m_funSwndProc(NULL)
 #ifdef _DEBUG
     , m_nMainThreadId(::GetCurrentThreadId()) // 初始化对象的线程不一定是主线程
@@ -476,14 +482,12 @@ ULONG_PTR SWindow::SetUserData(ULONG_PTR uData)
 
 BOOL SWindow::SetTimer(char id, UINT uElapse)
 {
-    STimerID timerID(m_swnd, id);
-    return (BOOL)::SetTimer(GetContainer()->GetHostHwnd(), DWORD(timerID), uElapse, NULL);
+    return GetContainer()->SetSwndTimer(m_swnd, id, uElapse);
 }
 
 BOOL SWindow::KillTimer(char id)
 {
-    STimerID timerID(m_swnd, id);
-    return ::KillTimer(GetContainer()->GetHostHwnd(), DWORD(timerID));
+    return GetContainer()->KillSwndTimer(m_swnd, id);
 }
 
 SWND SWindow::GetSwnd() const
@@ -800,13 +804,17 @@ SWindow *SWindow::FindChildByName(LPCWSTR pszName, int nDeep)
     if (strName.IsEmpty())
         return NULL;
 
-    SWindow *pRet = SWindowFinder::getSingletonPtr()->FindChildByName(this, strName, nDeep);
+    //窗口名在OnAttrName里已入原子表，查不到原子的名字不走缓存
+    SAtom name = SAtom::Find(strName, strName.GetLength());
+    if (name.IsNull())
+        return _FindChildByName(strName, nDeep);
+    SWindow *pRet = SWindowFinder::getSingletonPtr()->FindChildByName(this, name, nDeep);
     if (pRet)
         return pRet;
 
     pRet = _FindChildByName(strName, nDeep);
     if (pRet)
-        SWindowFinder::getSingletonPtr()->CacheResultForName(this, strName, nDeep, pRet);
+        SWindowFinder::getSingletonPtr()->CacheResultForName(this, name, nDeep, pRet);
     return pRet;
 }
 
@@ -914,7 +922,10 @@ BOOL SWindow::CreateChildren(SXmlNode xmlNode)
 
 BOOL SWindow::CreateChild(SXmlNode xmlChild)
 {
+    //子窗口随后用xmlChild初始化，创建时跳过被它覆盖的默认属性
+    SApplication::getSingleton().SetPendingInitXml(xmlChild);
     SWindow *pChild = CreateChildByName(xmlChild.name());
+    SApplication::getSingleton().SetPendingInitXml(SXmlNode());
     if (!pChild)
     {
         return FALSE;
@@ -1182,57 +1193,24 @@ void SWindow::_RedrawNonClient()
     #endif//__APPLE__
 }
 
-static SAutoRefPtr<IRegionS> ConvertRect2RenderRegion(const CRect &rc, const SMatrix &mtx)
+//只在绘制遍历中判断窗口是否需要绘制，不必为每个窗口创建区域对象：
+//把窗口矩形变换到宿主坐标后直接和绘制区域求交。旋转等不保持矩形的变换使用外接矩形，
+//多绘制的部分会被RT的剪裁区过滤掉。
+bool SWindow::_WndRectInRgn(const CRect &rc, const IRegionS *rgn) const
 {
-    SAutoRefPtr<IRegionS> pRet;
-    GETRENDERFACTORY->CreateRegion(&pRet);
+    CRect rcTest = rc;
+    SMatrix mtx = _GetMatrixEx();
     if (!mtx.isIdentity())
     {
         SRect sRc = SRect::IMake(rc);
-        if (mtx.rectStaysRect())
-        {
-            mtx.mapRect(&sRc);
-            CRect rc2 = sRc.toRect();
-            pRet->CombineRect(&rc2, RGN_COPY);
-        }
-        else
-        {
-            SPoint quad[4];
-            mtx.mapRectToQuad(quad, sRc);
-            POINT pts[4];
-            for (int i = 0; i < 4; i++)
-            {
-                pts[i] = quad[i].toPoint();
-            }
-            pRet->CombinePolygon(pts, 4, WINDING, RGN_COPY);
-        }
-    }
-    else
-    {
-        pRet->CombineRect(&rc, RGN_COPY);
+        mtx.mapRect(&sRc);
+        rcTest = sRc.toRect();
     }
-    return pRet;
-}
-
-static bool RgnInRgn(const IRegionS *r1, IRegionS *r2)
-{
-    SAutoRefPtr<IRegionS> pRet;
-    GETRENDERFACTORY->CreateRegion(&pRet);
-    pRet->CombineRgn(r1, RGN_COPY);
-    pRet->CombineRgn(r2, RGN_AND);
-    return !pRet->IsEmpty();
-}
-
-bool SWindow::_WndRectInRgn(const CRect &rc, const IRegionS *rgn) const
-{
-    CRect rc2;
-    rgn->GetRgnBox(&rc2);
-
-    SMatrix mtx = _GetMatrixEx();
-    if (mtx.isIdentity() && !rc2.IntersectRect(rc2, rc))
+    CRect rcBox;
+    rgn->GetRgnBox(&rcBox);
+    if (!rcBox.IntersectRect(rcBox, rcTest))
         return false;
-    SAutoRefPtr<IRegionS> rgn2 = ConvertRect2RenderRegion(rc, mtx);
-    return RgnInRgn(rgn, rgn2);
+    return !!rgn->RectInRegion(&rcTest);
 }
 
 void SWindow::_PaintChildren(IRenderTarget *pRT, IRegionS *pRgn, UINT iBeginZorder, UINT iEndZorder)
@@ -1278,8 +1256,16 @@ void SWindow::DispatchPaint(IRenderTarget *pRT, IRegionS *pRgn, UINT iZorderBegi
     if (!IsVisible(FALSE) || !GetContainer())
         return;
 
+    //绘制到保留图层时，窗口自身的矩阵和透明度在使用图层时才应用
     SMatrix oriMtx;
-    bool bMtx = _ApplyMatrix(pRT, oriMtx);
+    bool bMtx = !m_bLayerCapturing && _ApplyMatrix(pRT, oriMtx);
+    if (!m_bLayerCapturing && _PaintLayer(pRT, iZorderBegin, iZorderEnd))
+    {
+        if (bMtx)
+            pRT->SetTransform(oriMtx.fMat, NULL);
+        return;
+    }
+    BOOL bLayered = !m_bLayerCapturing && IsLayeredWindow();
 
     CRect rcWnd = GetWindowRect();
     CRect rcClient = GetClientRect();
@@ -1301,13 +1287,15 @@ void SWindow::DispatchPaint(IRenderTarget *pRT, IRegionS *pRgn, UINT iZorderBegi
 
     IRenderTarget *pRTBackup = NULL; // backup current RT
 
-    if (IsLayeredWindow())
+    if (bLayered)
     { //获得当前LayeredWindow RT来绘制内容
         pRTBackup = pRT;
+        //从容器的RT池中申请，提交后马上归还。空闲的RT计入池的内存上限，尺寸不变的下一帧会拿回同一个位图
         pRT = NULL;
-        GETRENDERFACTORY->CreateRenderTarget(&pRT, rcWnd.Width(), rcWnd.Height());
+        if (!GetContainer()->AcquireOffscreenRT(rcWnd.Size(), &pRT))
+            GETRENDERFACTORY->CreateRenderTarget(&pRT, rcWnd.Width(), rcWnd.Height());
         pRT->BeginDraw();
-        pRT->OffsetViewportOrg(-rcWnd.left, -rcWnd.top, NULL);
+        pRT->SetViewportOrg(-rcWnd.TopLeft());
         //绘制到窗口的缓存上,需要继承原RT的绘图属性
         pRT->SelectObject(pRTBackup->GetCurrentObject(OT_FONT), NULL);
         pRT->SelectObject(pRTBackup->GetCurrentObject(OT_PEN), NULL);
@@ -1340,7 +1328,7 @@ void SWindow::DispatchPaint(IRenderTarget *pRT, IRegionS *pRgn, UINT iZorderBegi
     if (m_uZorder >= iZorderBegin && m_uZorder < iZorderEnd && (!pRgn || pRgn->IsEmpty() || _WndRectInRgn(rcClient, pRgn)))
     { // paint client
         _PaintClient(pRT);
-        if (IsFocused() && m_caret)
+        if (IsFocused() && m_caret && !m_bCaretOverlay)
         { // draw caret
             m_caret->Draw(pRT);
         }
@@ -1367,18 +1355,180 @@ void SWindow::DispatchPaint(IRenderTarget *pRT, IRegionS *pRgn, UINT iZorderBegi
     // restore clip state.
     pRT->RestoreClip(nSave1);
 
-    if (IsLayeredWindow())
+    if (bLayered)
     { //将绘制到窗口的缓存上的图像返回到上一级RT
         SASSERT(pRTBackup);
         pRT->EndDraw();
         OnCommitSurface(pRTBackup, &rcWnd, pRT, &rcWnd, GetAlpha());
-        pRT->Release();
+        GetContainer()->RecycleOffscreenRT(pRT);
         pRT = pRTBackup;
     }
     if (bMtx)
         pRT->SetTransform(oriMtx.fMat, NULL);
 }
 
+// 子树连续这么多次绘制都没有失效才提升为保留图层
+static const int KLayer_PromoteFrames = 3;
+// 图层失效后连续这么多次绘制都没能重新使用则释放
+static const int KLayer_DemoteMisses = 30;
+// 太小的窗口直接绘制比混合图层更划算
+static const int KLayer_MinArea = 64 * 64;
+
+bool SWindow::_PaintLayer(IRenderTarget *pRT, UINT iZorderBegin, UINT iZorderEnd)
+{
+    if (!m_bRetainLayer || !GetParent() || m_pGetRTData)
+    {
+        ReleaseLayerCache();
+        return false;
+    }
+    //祖先已经保留了图层时本窗口的像素已经在祖先的图层中，不再重复保留
+    for (SWindow *pAncestor = GetParent(); pAncestor; pAncestor = pAncestor->GetParent())
+    {
+        if (pAncestor->m_layerRT)
+        {
+            ReleaseLayerCache();
+            return false;
+        }
+    }
+    //图层只能整体使用，子树的zorder必须都在绘制范围内
+    const SWindow *pLast = this;
+    while (pLast->m_pLastChild)
+        pLast = pLast->m_pLastChild;
+    if (m_uZorder < iZorderBegin || pLast->m_uZorder >= iZorderEnd)
+        return false;
+
+    ISwndContainer *pContainer = GetContainer();
+    CRect rcWnd = GetWindowRect();
+    if (m_layerRT && m_bLayerValid && m_rcLayer == rcWnd)
+    {
+        m_nLayerMisses = 0;
+        pContainer->OnLayerPaint(m_swnd, LP_HIT);
+        m_layerRT->SetViewportOrg(-rcWnd.TopLeft());
+        if (IsLayeredWindow())
+            OnCommitSurface(pRT, &rcWnd, m_layerRT, &rcWnd, GetAlpha());
+        else
+            pRT->AlphaBlend(&rcWnd, m_layerRT, &rcWnd, 255);
+        return true;
+    }
+    if (m_layerRT && m_rcLayer.Size() != rcWnd.Size())
+        ReleaseLayerCache();
+
+    if (++m_nLayerFrames < KLayer_PromoteFrames)
+    {
+        if (m_layerRT)
+        {
+            pContainer->OnLayerPaint(m_swnd, LP_MISS);
+            if (++m_nLayerMisses >= KLayer_DemoteMisses)
+                ReleaseLayerCache();
+        }
+        return false;
+    }
+
+    if (!m_layerRT)
+    {
+        UINT cbLayer = rcWnd.Width() * rcWnd.Height() * 4;
+        LayerCacheStats stats;
+        pContainer->GetLayerCacheStats(&stats);
+        if (rcWnd.Width() * rcWnd.Height() < KLayer_MinArea || cbLayer > stats.cbBudget || m_isAnimating || GetStyle().m_bVideoCanvas || !_CanRetainLayer(rcWnd) || !pContainer->RetainLayer(m_swnd, cbLayer))
+        {
+            m_nLayerFrames = 0;
+            return false;
+        }
+        if (!pContainer->AcquireOffscreenRT(rcWnd.Size(), &m_layerRT))
+        {
+            pContainer->ReleaseLayer(m_swnd);
+            m_nLayerFrames = 0;
+            return false;
+        }
+    }
+    else if (!_CanRetainLayer(rcWnd))
+    {
+        ReleaseLayerCache();
+        return false;
+    }
+
+    //子窗口申请图层时可能把当前图层淘汰掉，使用局部变量保证本次绘制完成
+    SAutoRefPtr<IRenderTarget> layerRT = m_layerRT;
+    m_rcLayer = rcWnd;
+    m_bLayerValid = TRUE; //绘制过程中发生的刷新会使图层重新失效
+    m_nLayerMisses = 0;
+
+    layerRT->BeginDraw();
+    layerRT->SetViewportOrg(-rcWnd.TopLeft());
+    layerRT->SelectObject(pRT->GetCurrentObject(OT_FONT), NULL);
+    layerRT->SelectObject(pRT->GetCurrentObject(OT_PEN), NULL);
+    layerRT->SelectObject(pRT->GetCurrentObject(OT_BRUSH), NULL);
+    layerRT->SetTextColor(pRT->GetTextColor());
+    layerRT->ClearRect(&rcWnd, 0);
+    m_bLayerCapturing = TRUE;
+    DispatchPaint(layerRT, NULL, (UINT)ZORDER_MIN, (UINT)ZORDER_MAX);
+    m_bLayerCapturing = FALSE;
+    layerRT->EndDraw();
+    pContainer->OnLayerPaint(m_swnd, LP_CAPTURE);
+
+    if (IsLayeredWindow())
+        OnCommitSurface(pRT, &rcWnd, layerRT, &rcWnd, GetAlpha());
+    else
+        pRT->AlphaBlend(&rcWnd, layerRT, &rcWnd, 255);
+    if (m_layerRT != layerRT)
+    { //绘制过程中被淘汰，现在才能归还
+        pContainer->RecycleOffscreenRT(layerRT.Detach());
+    }
+    return true;
+}
+
+bool SWindow::_CanRetainLayer(const CRect &rcLayer) const
+{
+    SWindow *pChild = GetWindow(GSW_FIRSTCHILD);
+    while (pChild)
+    {
+        if (pChild->IsVisible(FALSE))
+        {
+            if (pChild->m_pGetRTData || pChild->m_isAnimating || pChild->GetStyle().m_bVideoCanvas)
+                return false;
+            STransformation xform = pChild->GetTransformation();
+            if (xform.hasMatrix() && !xform.getMatrix().isIdentity())
+                return false;
+            CRect rcChild = pChild->GetWindowRect();
+            CRect rcUnion;
+            rcUnion.UnionRect(rcLayer, rcChild);
+            if (rcUnion != rcLayer)
+                return false;
+            if (!pChild->_CanRetainLayer(rcLayer))
+                return false;
+        }
+        pChild = pChild->GetWindow(GSW_NEXTSIBLING);
+    }
+    return true;
+}
+
+void SWindow::_MarkLayerDirty()
+{
+    m_bLayerValid = FALSE;
+    m_nLayerFrames = 0;
+}
+
+void SWindow::MarkLayersDirty()
+{
+    for (SWindow *pLayer = this; pLayer; pLayer = pLayer->GetParent())
+        pLayer->_MarkLayerDirty();
+}
+
+void SWindow::ReleaseLayerCache()
+{
+    m_bLayerValid = FALSE;
+    m_nLayerFrames = 0;
+    m_nLayerMisses = 0;
+    if (!m_layerRT)
+        return;
+    if (m_bLayerCapturing || !GetContainer())
+        m_layerRT = NULL; //正在绘制的图层由_PaintLayer在绘制完成后归还
+    else
+        GetContainer()->RecycleOffscreenRT(m_layerRT.Detach());
+    if (GetContainer())
+        GetContainer()->ReleaseLayer(m_swnd);
+}
+
 void SWindow::TransformPoint(CPoint &pt) const
 {
     STransformation xform = GetTransformation();
@@ -1463,7 +1613,10 @@ void SWindow::InvalidateRect(const CRect &rect, BOOL bFromThis /*=TRUE*/, BOOL b
 {
     ASSERT_UI_THREAD();
     if (!IsVisible(TRUE) || IsUpdateLocked() || !GetContainer())
+    { //不刷新也要让祖先的图层失效，否则解锁或者重新显示后会混合过期的图层
+        MarkLayersDirty();
         return;
+    }
 
     //只能更新窗口有效区域
     CRect rcWnd = GetWindowRect();
@@ -1473,6 +1626,7 @@ void SWindow::InvalidateRect(const CRect &rect, BOOL bFromThis /*=TRUE*/, BOOL b
         return;
     if (!bClip)
         MarkCacheDirty(true);
+    _MarkLayerDirty();
 
     STransformation xForm = GetTransformation();
     if (xForm.hasMatrix() && !xForm.getMatrix().isIdentity())
@@ -1727,6 +1881,14 @@ void SWindow::OnDestroy()
         GetContainer()->UnregisterTrackMouseEvent(m_swnd);
     if (GetStyle().m_bVideoCanvas)
         GetContainer()->UnregisterVideoCanvas(m_swnd);
+    if (GetContainer())
+    {
+        GetContainer()->KillSwndTimers(m_swnd);
+        if (m_bCaretOverlay)
+            GetContainer()->SetCaretOverlay(NULL, m_swnd);
+        m_bCaretOverlay = FALSE;
+        ReleaseLayerCache();
+    }
 
     DestroyAllChildren();
     ClearAnimation();
@@ -2031,6 +2193,8 @@ void SWindow::OnShowWindow(BOOL bShow, UINT nStatus)
     {
         ModifyState(WndState_Invisible, 0);
         accNotifyEvent(EVENT_OBJECT_HIDE);
+        //隐藏期间子窗口的刷新不会通知到这里，重新显示时图层已经不可信
+        ReleaseLayerCache();
     }
 
     SWindow *pChild = m_pFirstChild;
@@ -2430,6 +2594,8 @@ void SWindow::ReleaseRenderTarget(IRenderTarget *pRT)
         { // todo: if matrix transform existed, combine getrt.rgn to the root rgn will not work.
             rgn->CombineRgn(m_pGetRTData->rgn, RGN_AND);
         }
+        //直接绘制的内容没有经过InvalidateRect，祖先窗口的图层需要手动失效
+        MarkLayersDirty();
         if (!rgn->IsEmpty())
             GetContainer()->UpdateRegion(rgn);
     }
@@ -2848,6 +3014,7 @@ HRESULT SWindow::OnAttrVideoCanvas(const SStringW &strValue, BOOL bLoading)
 
 void SWindow::OnSize(UINT nType, CSize size)
 {
+    ReleaseLayerCache();
     if (IsDrawToCache())
     {
         if (!m_cachedRT)
@@ -2939,6 +3106,7 @@ HRESULT SWindow::OnAttrID(const SStringW &strValue, BOOL bLoading)
 HRESULT SWindow::OnAttrName(const SStringW &strValue, BOOL bLoading)
 {
     m_strName = strValue;
+    SAtom(strValue, strValue.GetLength()); //名字入原子表，供FindChildByName的缓存使用
     if (m_nID == 0)
     {
         m_nID = STR2ID(strValue);
@@ -3074,8 +3242,21 @@ void SWindow::ShowCaret(BOOL bShow)
         return;
     if (m_caret->SetVisible(bShow, m_swnd))
     {
-        CRect rcCaret = m_caret->GetRect();
-        InvalidateRect(rcCaret);
+        if (bShow)
+        {
+            m_bCaretOverlay = GetContainer()->SetCaretOverlay(m_caret, m_swnd);
+        }
+        else if (m_bCaretOverlay)
+        {
+            GetContainer()->SetCaretOverlay(NULL, m_swnd);
+            m_bCaretOverlay = FALSE;
+            return;
+        }
+        if (!m_bCaretOverlay)
+        {
+            CRect rcCaret = m_caret->GetRect();
+            InvalidateRect(rcCaret);
+        }
     }
 }
 
@@ -3084,7 +3265,12 @@ void SWindow::SetCaretPos(int x, int y)
     if (!m_caret)
         return;
 
-    if (m_caret->IsVisible())
+    if (m_bCaretOverlay)
+    { //插入符由容器合成，不需要重绘窗口
+        m_caret->SetPosition(x, y);
+        GetContainer()->UpdateCaretOverlay(m_caret);
+    }
+    else if (m_caret->IsVisible())
     {
         {
             CRect rcCaret = m_caret->GetRect();
@@ -3235,6 +3421,7 @@ HRESULT SWindow::OnLanguageChanged()
 {
     m_strText.TranslateText();
     m_strToolTipText.TranslateText();
+    ReleaseLayerCache();
     return GetLayoutParam()->IsWrapContent(Any) ? S_OK : S_FALSE;
 }
 
@@ -3278,6 +3465,7 @@ void SWindow::OnScaleChanged(int scale)
     GetStyle().SetScale(scale);
     GetScaleSkin(m_pNcSkin, scale);
     GetScaleSkin(m_pBgSkin, scale);
+    ReleaseLayerCache();
 
     //标记布局脏
     m_layoutDirty = dirty_self;
@@ -3308,6 +3496,7 @@ void SWindow::GetScaleSkin(SAutoRefPtr<ISkinObj> &pSkin, int nScale)
 void SWindow::OnRebuildFont()
 {
     m_style.UpdateFont();
+    ReleaseLayerCache();
 }
 
 #ifdef _WIN32
@@ -3413,6 +3602,7 @@ void SWindow::OnContainerChanged(ISwndContainer *pOldContainer, ISwndContainer *
 {
     if (pOldContainer)
     {
+        ReleaseLayerCache();
         if (IsFocused())
             pOldContainer->OnSetSwndFocus(0);
         if (GetStyle().m_bTrackMouseEvent)
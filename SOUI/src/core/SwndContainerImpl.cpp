@@ -17,6 +17,8 @@ SwndContainerImpl::SwndContainerImpl()
     , m_bZorderDirty(TRUE)
     , m_pRoot(NULL)
 {
+    memset(&m_layerStats, 0, sizeof(m_layerStats));
+    m_layerStats.cbBudget = kDefLayerCacheBudget;
 }
 
 void SwndContainerImpl::SetRoot(SWindow *pRoot)
@@ -515,4 +517,93 @@ BOOL SwndContainerImpl::UnregisterVideoCanvas(SWND swnd)
     return TRUE;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// retained layers
+BOOL SwndContainerImpl::RetainLayer(SWND swnd, UINT cbLayer)
+{
+    ReleaseLayer(swnd);
+    if (cbLayer > m_layerStats.cbBudget)
+        return FALSE;
+    _EvictLayers(cbLayer);
+    LayerInfo info = { swnd, cbLayer };
+    m_mapLayers[swnd] = m_lstLayers.AddHead(info);
+    m_layerStats.cbUsed += cbLayer;
+    m_layerStats.nLayers++;
+    return TRUE;
+}
+
+void SwndContainerImpl::ReleaseLayer(SWND swnd)
+{
+    SMap<SWND, SPOSITION>::CPair *p = m_mapLayers.Lookup(swnd);
+    if (!p)
+        return;
+    const LayerInfo &info = m_lstLayers.GetAt(p->m_value);
+    m_layerStats.cbUsed -= info.cbLayer;
+    m_layerStats.nLayers--;
+    m_lstLayers.RemoveAt(p->m_value);
+    m_mapLayers.RemoveKey(swnd);
+}
+
+void SwndContainerImpl::OnLayerPaint(SWND swnd, LayerPaint type)
+{
+    switch (type)
+    {
+    case LP_HIT:
+        m_layerStats.nHits++;
+        break;
+    case LP_MISS:
+        m_layerStats.nMisses++;
+        break;
+    case LP_CAPTURE:
+        m_layerStats.nCaptures++;
+        break;
+    }
+    SMap<SWND, SPOSITION>::CPair *p = m_mapLayers.Lookup(swnd);
+    if (p)
+        m_lstLayers.MoveToHead(p->m_value);
+}
+
+void SwndContainerImpl::SetLayerCacheBudget(UINT cbBudget)
+{
+    m_layerStats.cbBudget = cbBudget;
+    _EvictLayers(0);
+}
+
+void SwndContainerImpl::GetLayerCacheStats(LayerCacheStats *pStats) const
+{
+    if (pStats)
+        *pStats = m_layerStats;
+}
+
+void SwndContainerImpl::_EvictLayers(UINT cbNeed)
+{
+    while (!m_lstLayers.IsEmpty() && m_layerStats.cbUsed + cbNeed > m_layerStats.cbBudget)
+    {
+        SWND swnd = m_lstLayers.GetTail().swnd;
+        ReleaseLayer(swnd);
+        m_layerStats.nEvictions++;
+        //窗口释放图层时会再次调用ReleaseLayer，此时已经找不到记录了。
+        SWindow *pWnd = SWindowMgr::GetWindow(swnd);
+        if (pWnd)
+            pWnd->ReleaseLayerCache();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// offscreen render targets
+BOOL SwndContainerImpl::AcquireOffscreenRT(SIZE sz, IRenderTarget **ppRT)
+{
+    return m_rtPool.Acquire(sz, ppRT);
+}
+
+void SwndContainerImpl::RecycleOffscreenRT(IRenderTarget *pRT)
+{
+    m_rtPool.Recycle(pRT);
+}
+
+void SwndContainerImpl::GetOffscreenRTStats(RtPoolStats *pStats) const
+{
+    m_rtPool.GetStats(pStats);
+}
+
 SNSEND
\ No newline at end of file
@@ -79,6 +79,7 @@ void SHostWndAttr::Init()
     m_bAllowSpy = TRUE;
     m_bSendWheel2Hover = FALSE;
     m_bHasMsgLoop = TRUE;
+    m_bParallelPaint = FALSE;
     m_dwStyle = (0);
     m_dwExStyle = (0);
     if (m_hAppIconSmall)
@@ -335,6 +336,8 @@ void SHostWnd::_Init()
     m_szAppSetted = CSize(0, 0);
     m_nAutoSizing = 0;
     m_bResizing = false;
+    m_bPulseArmed = FALSE;
+    m_bHostShown = FALSE;
     m_dwThreadID = 0;
     m_AniState = 0;
     m_pRoot = NULL;
@@ -342,6 +345,9 @@ void SHostWnd::_Init()
     m_msgMouse.message = 0;
 
     m_hostAnimationHandler.m_pHostWnd = this;
+    m_timerHandler.m_pHostWnd = this;
+    m_swndCaretOwner = 0;
+    m_swndTimers.SetListener(&m_timerHandler);
     m_evtHandler.fun = NULL;
     m_evtHandler.ctx = NULL;
     m_cEnableUiDefCount = 0;
@@ -634,6 +640,7 @@ BOOL SHostWnd::InitFromXml(IXmlNode *pNode)
     {
         GETRENDERFACTORY->CreateRenderTarget2(&m_memRT, m_hWnd);
     }
+    m_memRT->EnableRecording(m_hostAttr.m_bParallelPaint);
 
     BuildWndTreeZorder();
 
@@ -801,6 +808,9 @@ void SHostWnd::OnPaint(HDC dc)
 {
     PAINTSTRUCT ps;
     dc = ::BeginPaint(m_hWnd, &ps);
+    //父窗口不是SOUI宿主时收不到它的显示通知，重新显示后的第一次绘制中恢复脉冲
+    if (!m_bPulseArmed)
+        _UpdatePulseTimer();
 #ifdef _WIN32
     OnPrint(m_hostAttr.m_bTranslucent ? NULL : dc);
 #else
@@ -857,6 +867,7 @@ int SHostWnd::OnCreate(LPCREATESTRUCT lpCreateStruct)
     m_memRT = NULL;
     CRect rcWnd = GetClientRect();
     GETRENDERFACTORY->CreateRenderTarget(&m_memRT, rcWnd.Width(), rcWnd.Height());
+    m_memRT->EnableRecording(m_hostAttr.m_bParallelPaint);
     m_rgnInvalidate = NULL;
     GETRENDERFACTORY->CreateRegion(&m_rgnInvalidate);
     m_szAppSetted.cx = lpCreateStruct->cx;
@@ -929,6 +940,13 @@ void SHostWnd::OnDestroy()
     SASSERT(m_cEnableUiDefCount == 0);
     m_privateUiDefInfo = NULL;
 
+    m_swndTimers.KillAll();
+    m_bPulseArmed = FALSE;
+    m_bHostShown = FALSE;
+    m_rtPool.Clear();
+    m_caretOverlay = NULL;
+    m_swndCaretOwner = 0;
+    m_rtCaretBack = NULL;
     m_memRT = NULL;
     m_rgnInvalidate = NULL;
 
@@ -951,6 +969,7 @@ void SHostWnd::OnSize(UINT nType, CSize size)
 {
     SetMsgHandled(FALSE); // chain wm_size to ncpainter.
     SNcPainter::updateSystemButton(GetRoot(), nType);
+    _UpdatePulseTimer();
     if (IsIconic())
         return;
     if (size.cx == 0 || size.cy == 0)
@@ -1017,7 +1036,9 @@ void SHostWnd::OnTimer(UINT_PTR idEvent)
         return;
     if (idEvent == kPulseTimer)
     {
-        if (!IsIconic())
+        //祖先窗口隐藏或者最小化时停止脉冲
+        _UpdatePulseTimer();
+        if (m_bPulseArmed)
         {
             SwndContainerImpl::OnNextFrame();
         }
@@ -1028,6 +1049,11 @@ void SHostWnd::OnTimer(UINT_PTR idEvent)
         OnRunTasks(0, 0, 0);
         return;
     }
+    else if (idEvent == kSwndTimer)
+    {
+        m_swndTimers.OnTick();
+        return;
+    }
 
     STimerID sTimerID((DWORD)idEvent);
     if (sTimerID.bSwndTimer)
@@ -1187,8 +1213,141 @@ HWND SHostWnd::GetHostHwnd()
 void SHostWnd::UpdatePresenter(HDC dc, IRenderTarget *pRT, LPCRECT rcInvalid, BYTE byAlpha, UINT uFlag)
 {
     byAlpha = (BYTE)((int)byAlpha * GetRoot()->GetAlpha() / 255);
-    if (pRT->IsOffscreen() || uFlag != 0)
+    if (!(pRT->IsOffscreen() || uFlag != 0))
+        return;
+    if (pRT != m_memRT || (!m_caretOverlay && m_rcCaretDirty.IsRectEmpty()))
+    {
         m_presenter->OnHostPresent(dc, pRT, rcInvalid, byAlpha);
+        return;
+    }
+
+    //插入符不画到缓存中，提交时临时混合到缓存上，提交后再恢复被覆盖的像素
+    CRect rcPresent = m_rcCaretDirty;
+    if (rcInvalid)
+        rcPresent |= *rcInvalid;
+    m_rcCaretDirty.SetRectEmpty();
+    SAutoRefPtr<IRegionS> rgnCaret;
+    CRect rcCaret = _GetCaretOverlayRect(&rgnCaret);
+    m_rcCaretOverlay = rcCaret;
+    if (rcCaret.IsRectEmpty() || (rcCaret & rcPresent).IsRectEmpty())
+    {
+        m_presenter->OnHostPresent(dc, pRT, rcPresent, byAlpha);
+        return;
+    }
+
+    CSize szCaret = rcCaret.Size();
+    if (!m_rtCaretBack)
+    {
+        GETRENDERFACTORY->CreateRenderTarget(&m_rtCaretBack, szCaret.cx, szCaret.cy);
+    }
+    else
+    {
+        CSize szBack = ((IBitmapS *)m_rtCaretBack->GetCurrentObject(OT_BITMAP))->Size();
+        if (szBack.cx < szCaret.cx || szBack.cy < szCaret.cy)
+            m_rtCaretBack->Resize(CSize(smax(szBack.cx, szCaret.cx), smax(szBack.cy, szCaret.cy)));
+    }
+    CRect rcBack(CPoint(0, 0), szCaret);
+    m_rtCaretBack->BitBlt(&rcBack, m_memRT, rcCaret.left, rcCaret.top, kSrcCopy);
+
+    m_memRT->BeginDraw();
+    if (rgnCaret)
+        m_memRT->PushClipRegion(rgnCaret, RGN_AND);
+    else
+        m_memRT->PushClipRect(&rcCaret, RGN_AND);
+    m_caretOverlay->Draw(m_memRT);
+    m_memRT->PopClip();
+    m_memRT->EndDraw();
+
+    m_presenter->OnHostPresent(dc, pRT, rcPresent, byAlpha);
+
+    m_memRT->BeginDraw();
+    m_memRT->BitBlt(&rcCaret, m_rtCaretBack, 0, 0, kSrcCopy);
+    m_memRT->EndDraw();
+}
+
+CRect SHostWnd::_GetCaretOverlayRect(IRegionS **ppClip) const
+{
+    CRect rcCaret;
+    if (!m_caretOverlay || !m_caretOverlay->IsVisible())
+        return rcCaret;
+    SWindow *pOwner = SWindowMgr::GetWindow(m_swndCaretOwner);
+    if (!pOwner || !pOwner->IsFocused())
+        return rcCaret;
+    CRect rcVisible;
+    pOwner->GetVisibleRect(&rcVisible);
+    rcCaret = m_caretOverlay->GetRect();
+    rcCaret &= rcVisible;
+    rcCaret &= pOwner->GetClientRect();
+    if (rcCaret.IsRectEmpty())
+        return rcCaret;
+
+    //插入符在所有窗口绘制完成后才合成，扣除Z序在它的宿主之上、和它重叠的窗口
+    SAutoRefPtr<IRegionS> rgnClip;
+    for (SWindow *pWnd = pOwner; pWnd; pWnd = pWnd->GetParent())
+    {
+        for (SWindow *pAbove = pWnd->GetWindow(GSW_NEXTSIBLING); pAbove; pAbove = pAbove->GetWindow(GSW_NEXTSIBLING))
+        {
+            CRect rcAbove;
+            pAbove->GetVisibleRect(&rcAbove);
+            rcAbove &= rcCaret;
+            if (rcAbove.IsRectEmpty())
+                continue;
+            if (!rgnClip)
+            {
+                GETRENDERFACTORY->CreateRegion(&rgnClip);
+                rgnClip->CombineRect(&rcCaret, RGN_COPY);
+            }
+            rgnClip->CombineRect(&rcAbove, RGN_DIFF);
+        }
+    }
+    if (rgnClip)
+    {
+        rgnClip->GetRgnBox(&rcCaret);
+        if (ppClip && !rcCaret.IsRectEmpty())
+            *ppClip = rgnClip.Detach();
+    }
+    return rcCaret;
+}
+
+BOOL SHostWnd::SetCaretOverlay(THIS_ ICaret *pCaret, SWND swndOwner)
+{
+    if (!pCaret)
+    {
+        if (m_swndCaretOwner != swndOwner)
+            return FALSE;
+        m_rcCaretDirty |= m_rcCaretOverlay;
+        m_caretOverlay = NULL;
+        m_swndCaretOwner = 0;
+        if (!m_rcCaretDirty.IsRectEmpty())
+            _Invalidate(&m_rcCaretDirty);
+        return TRUE;
+    }
+    if (!m_memRT || !m_memRT->IsOffscreen())
+        return FALSE; //直接绘制到窗口的渲染目标没有缓存可以合成
+    //插入符按宿主坐标不透明地合成到缓存帧上, 窗口或者祖先有变换、半透明或者渲染层时仍由窗口重绘
+    SWindow *pOwner = SWindowMgr::GetWindow(swndOwner);
+    if (!pOwner || !pOwner->_GetMatrixEx().isIdentity() || pOwner->_GetCurrentLayeredWindow())
+    {
+        if (m_swndCaretOwner == swndOwner)
+            SetCaretOverlay(NULL, swndOwner);
+        return FALSE;
+    }
+    m_rcCaretDirty |= m_rcCaretOverlay;
+    m_caretOverlay = pCaret;
+    m_swndCaretOwner = swndOwner;
+    UpdateCaretOverlay(pCaret);
+    return TRUE;
+}
+
+BOOL SHostWnd::UpdateCaretOverlay(THIS_ ICaret *pCaret)
+{
+    if (!pCaret || pCaret != m_caretOverlay)
+        return FALSE;
+    m_rcCaretDirty |= m_rcCaretOverlay;
+    m_rcCaretDirty |= _GetCaretOverlayRect();
+    if (!m_rcCaretDirty.IsRectEmpty())
+        _Invalidate(&m_rcCaretDirty);
+    return TRUE;
 }
 
 void SHostWnd::OnRedraw(LPCRECT rc, BOOL bClip)
@@ -1536,26 +1695,49 @@ BOOL SHostWnd::AnimateHostWindow(DWORD dwTime, DWORD dwFlags)
 
 BOOL SHostWnd::RegisterTimelineHandler(ITimelineHandler *pHandler)
 {
-    bool bEmpty1 = m_timelineHandlerMgr.IsEmpty();
     BOOL bRet = SwndContainerImpl::RegisterTimelineHandler(pHandler);
-    bool bEmpty2 = m_timelineHandlerMgr.IsEmpty();
-    if (bEmpty1 && !bEmpty2)
-    {
-        SNativeWnd::SetTimer(kPulseTimer, kPulseInterval, NULL);
-    }
+    _UpdatePulseTimer();
     return bRet;
 }
 
 BOOL SHostWnd::UnregisterTimelineHandler(ITimelineHandler *pHandler)
 {
-    bool bEmpty1 = m_timelineHandlerMgr.IsEmpty();
     BOOL bRet = SwndContainerImpl::UnregisterTimelineHandler(pHandler);
-    bool bEmpty2 = m_timelineHandlerMgr.IsEmpty();
-    if (!bEmpty1 && bEmpty2)
+    _UpdatePulseTimer();
+    return bRet;
+}
+
+BOOL SHostWnd::_IsHostShown() const
+{
+    if (!IsWindow() || !IsWindowVisible())
+        return FALSE;
+    //子窗口的IsWindowVisible包含了父窗口的可见性，但是不包含父窗口的最小化状态
+    for (HWND hWnd = m_hWnd; hWnd; hWnd = (::GetWindowLongPtr(hWnd, GWL_STYLE) & WS_CHILD) ? ::GetParent(hWnd) : NULL)
     {
-        SNativeWnd::KillTimer(kPulseTimer);
+        if (::IsIconic(hWnd))
+            return FALSE;
     }
-    return bRet;
+    return TRUE;
+}
+
+void SHostWnd::_UpdatePulseTimer()
+{
+    BOOL bShown = _IsHostShown();
+    if (bShown != m_bHostShown)
+    {
+        m_bHostShown = bShown;
+        //子宿主的可见性跟随本窗口变化，通知所有宿主重新检查
+        SHostMgr::getSingletonPtr()->DispatchMessage(UM_UPDATEPULSE);
+    }
+    //没有帧处理器，或者窗口隐藏、最小化时停止脉冲定时器，让消息循环可以完全睡眠。
+    BOOL bPulse = bShown && !m_timelineHandlerMgr.IsEmpty();
+    if (bPulse == m_bPulseArmed)
+        return;
+    m_bPulseArmed = bPulse;
+    if (bPulse)
+        SNativeWnd::SetTimer(kPulseTimer, kPulseInterval, NULL);
+    else
+        SNativeWnd::KillTimer(kPulseTimer);
 }
 
 LPCWSTR SHostWnd::GetTranslatorContext() const
@@ -1743,10 +1925,25 @@ void SHostWnd::OnWindowPosChanging(LPWINDOWPOS lpWndPos)
     }
 }
 
+void SHostWnd::OnShowWindow(BOOL bShow, UINT nStatus)
+{
+    SetMsgHandled(FALSE);
+    //显示状态在这个消息之后才改变，延后检查
+    PostMessage(UM_UPDATEPULSE);
+}
+
+LRESULT SHostWnd::OnUpdatePulse(UINT uMsg, WPARAM wp, LPARAM lp)
+{
+    _UpdatePulseTimer();
+    return 0;
+}
+
 void SHostWnd::OnWindowPosChanged(LPWINDOWPOS lpWndPos)
 {
     //下面这一行不能删除，否则显示不正常。
     SetMsgHandled(FALSE);
+    if (lpWndPos->flags & (SWP_SHOWWINDOW | SWP_HIDEWINDOW))
+        _UpdatePulseTimer();
     if (!m_dummyWnd)
         return;
 
@@ -2102,6 +2299,13 @@ void SHostWnd::OnCommand(UINT uNotifyCode, int nID, HWND wndCtl)
     }
 }
 
+void SHostWnd::PrefetchScale(int nScale)
+{
+    EnablePrivateUiDef(TRUE);
+    GETUIDEF->PrefetchSkins(GetScale(), nScale);
+    EnablePrivateUiDef(FALSE);
+}
+
 void SHostWnd::SetScale(THIS_ int nScale, LPCRECT desRect)
 {
     EnablePrivateUiDef(TRUE);
@@ -2211,6 +2415,50 @@ LRESULT SHostWnd::OnSetLanguage(UINT uMsg, WPARAM wp, LPARAM lp)
     return 0;
 }
 
+//////////////////////////////////////////////////////////////////
+//  SHostWnd::SHostTimerHandler
+void SHostWnd::SHostTimerHandler::OnArmTimer(UINT uElapse)
+{
+    if (uElapse == INFINITE)
+        m_pHostWnd->SNativeWnd::KillTimer(kSwndTimer);
+    else
+        m_pHostWnd->SNativeWnd::SetTimer(kSwndTimer, uElapse, NULL);
+}
+
+void SHostWnd::SHostTimerHandler::OnTimerExpired(UINT_PTR uKey)
+{
+    STimerID sTimerID((DWORD)uKey);
+    SWindow *pSwnd = SWindowMgr::GetWindow((SWND)sTimerID.swnd);
+    if (pSwnd)
+    {
+        pSwnd->SSendMessage(WM_TIMER, sTimerID.uTimerID, 0);
+    }
+    else
+    {
+        //窗口已经删除，自动清除该窗口的定时器
+        m_pHostWnd->m_swndTimers.KillGroup(sTimerID.swnd);
+    }
+}
+
+BOOL SHostWnd::SetSwndTimer(THIS_ SWND swnd, char id, UINT uElapse)
+{
+    if (!SNativeWnd::IsWindow())
+        return FALSE;
+    STimerID timerID(swnd, id);
+    return m_swndTimers.SetTimer(DWORD(timerID), uElapse, TRUE, swnd);
+}
+
+BOOL SHostWnd::KillSwndTimer(THIS_ SWND swnd, char id)
+{
+    STimerID timerID(swnd, id);
+    return m_swndTimers.KillTimer(DWORD(timerID));
+}
+
+int SHostWnd::KillSwndTimers(THIS_ SWND swnd)
+{
+    return m_swndTimers.KillGroup(swnd);
+}
+
 //////////////////////////////////////////////////////////////////
 //  SHostWnd::SHostAnimationHandler
 void SHostWnd::SHostAnimationHandler::OnNextFrame()
@@ -1,5 +1,7 @@
 ﻿#include "souistd.h"
 #include "helper/SDIBHelper.h"
+#include "helper/SParallel.h"
+#include <helper/SPixelConv.h>
 
 #define RGB2GRAY(r, g, b) (((b)*117 + (g)*601 + (r)*306) >> 10)
 
@@ -12,61 +14,70 @@ struct DIBINFO
 };
 
 // ------------------------------------------------------------
-// 有太多的算法需要用某种方式(map)变换位图的每个像素的颜色，比如
-// 彩色转换为灰度图，gamma校正，颜色空间转换,hsl调整.所以写一个模板做为参数调用的通用算法
+// 大图按行分块，多线程并行处理
 // ------------------------------------------------------------
-template <class Mode, class Param>
-bool ColorTransform(DIBINFO *pDib, Mode mode, const Param &param)
+typedef void (*FunProcessRows)(const DIBINFO &di, UINT iRowBegin, UINT iRowEnd, const void *param);
+
+enum
+{
+    kMinPixelsPerThread = 256 * 256, // 小于该值的块不值得并行
+};
+
+struct ROWTASK
+{
+    FunProcessRows fun;
+    const DIBINFO *pDib;
+    UINT iRowBegin;
+    UINT iRowEnd;
+    const void *param;
+};
+
+static void __cdecl RowTaskProc(void *pCtx, int iTask)
+{
+    ROWTASK *pTask = (ROWTASK *)pCtx + iTask;
+    pTask->fun(*pTask->pDib, pTask->iRowBegin, pTask->iRowEnd, pTask->param);
+}
+
+static void ParallelRows(const DIBINFO &di, FunProcessRows fun, const void *param)
 {
-    if (NULL == pDib || NULL == pDib->pBits)
+    int nThreads = (int)smin(di.nWid * di.nHei / kMinPixelsPerThread, (UINT)SParallel::GetThreadCount());
+    nThreads = smin(nThreads, (int)di.nHei);
+    if (nThreads <= 1)
     {
-        return false;
+        fun(di, 0, di.nHei, param);
+        return;
     }
-
-    SMap<DWORD, DWORD> cache;
-    int nPixels = pDib->nWid * pDib->nHei;
-    LPBYTE pBit = pDib->pBits;
-    for (int i = 0; i < nPixels; i++, pBit += 4)
+    ROWTASK tasks[SParallel::kMaxThreads];
+    UINT nRowsPerTask = (di.nHei + nThreads - 1) / nThreads;
+    for (int i = 0; i < nThreads; i++)
     {
-        DWORD crFrom = *(DWORD *)pBit;
-        SMap<DWORD, DWORD>::CPair *p = cache.Lookup(crFrom);
-        if (p)
-        {
-            memcpy(pBit, &p->m_value, 4);
-        }
-        else
-        {
-            mode(pBit, param);
-            cache[crFrom] = *(DWORD *)pBit;
-        }
+        tasks[i].fun = fun;
+        tasks[i].pDib = &di;
+        tasks[i].iRowBegin = smin(i * nRowsPerTask, di.nHei);
+        tasks[i].iRowEnd = smin((i + 1) * nRowsPerTask, di.nHei);
+        tasks[i].param = param;
     }
-
-    return true;
+    SParallel::Run(nThreads, RowTaskProc, tasks);
 }
 
 // 灰度 = 0.299 * red + 0.587 * green + 0.114 * blue
-static void GrayMode(BYTE *pColor, const int &)
+static void GrayRows(const DIBINFO &di, UINT iRowBegin, UINT iRowEnd, const void *)
 {
-    pColor[0] = pColor[1] = pColor[2] = RGB2GRAY(pColor[0], pColor[1], pColor[2]);
+    LPBYTE pLine = di.pBits + (size_t)di.nWid * iRowBegin * 4;
+    // 与RGB2GRAY(p[0],p[1],p[2])结果一致
+    SPixelConv::Gray(pLine, pLine, (size_t)di.nWid * (iRowEnd - iRowBegin), 306, 601, 117);
 }
 
+// 着色结果只依赖像素的亮度(a0==256)或灰度，因此hue,sat确定后HSL->RGB可以预先算成256项的表
 struct COLORIZEPARAM
 {
     BYTE hue;
     BYTE sat;
     int a0; //[0-256]
     int a1; //[0-256]
+    BYTE lut[256][3]; // 亮度或灰度 -> b,g,r
 };
 
-static void FillColorizeParam(COLORIZEPARAM &param, BYTE hue, BYTE sat, float fBlend)
-{
-    param.hue = hue;
-    param.sat = sat;
-    SASSERT(fBlend >= 0.0f && fBlend <= 1.0f);
-    param.a0 = (int)(fBlend * 256);
-    param.a1 = 256 - param.a0;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 #define HSLMAX 255 /* H,L, and S vary over 0-HSLMAX */
 #define RGBMAX 255 /* R,G, and B vary over 0-RGBMAX */
@@ -196,41 +207,60 @@ static RGBQUAD HSLtoRGB(RGBQUAD lHSLColor)
     return rgb;
 }
 
-static void ColorizeMode(BYTE *pArgb, const COLORIZEPARAM &param)
+static void FillColorizeParam(COLORIZEPARAM &param, COLORREF crRef)
+{
+    RGBQUAD hsl = RGBtoHSL(RGBtoRGBQUAD(crRef));
+    float fBlend = 0.8f;
+    BYTE byAlpha = GetAValue(crRef);
+    if (byAlpha != 0)
+        fBlend = byAlpha * 1.0f / 255;
+
+    param.hue = hsl.rgbRed;
+    param.sat = hsl.rgbGreen;
+    SASSERT(fBlend >= 0.0f && fBlend <= 1.0f);
+    param.a0 = (int)(fBlend * 256);
+    param.a1 = 256 - param.a0;
+
+    RGBQUAD color = { 0, param.sat, param.hue, 0 };
+    for (int i = 0; i < 256; i++)
+    {
+        color.rgbBlue = (BYTE)i;
+        RGBQUAD rgb = HSLtoRGB(color);
+        param.lut[i][0] = rgb.rgbBlue;
+        param.lut[i][1] = rgb.rgbGreen;
+        param.lut[i][2] = rgb.rgbRed;
+    }
+}
+
+static inline void ColorizePixel(BYTE *pArgb, const COLORIZEPARAM &param)
 {
-    BYTE blue = pArgb[0], green = pArgb[1], red = pArgb[2], alpha = pArgb[3];
+    int blue = pArgb[0], green = pArgb[1], red = pArgb[2], alpha = pArgb[3];
 
     if (alpha == 0)
         return;
     if (alpha != 255)
     {
-        red = (red * 255) / alpha;
-        green = (green * 255) / alpha;
-        blue = (blue * 255) / alpha;
+        red = (BYTE)((red * 255) / alpha);
+        green = (BYTE)((green * 255) / alpha);
+        blue = (BYTE)((blue * 255) / alpha);
     }
-    RGBQUAD pixel = { blue, green, red };
 
+    const BYTE *pLut;
     if (param.a0 == 256)
     {
-        RGBQUAD color = RGBtoHSL(pixel);
-        color.rgbRed = param.hue;
-        color.rgbGreen = param.sat;
-        pixel = HSLtoRGB(color);
-        red = pixel.rgbRed;
-        green = pixel.rgbGreen;
-        blue = pixel.rgbBlue;
+        int cMax = smax(smax(red, green), blue);
+        int cMin = smin(smin(red, green), blue);
+        pLut = param.lut[(((cMax + cMin) * HSLMAX) + RGBMAX) / (2 * RGBMAX)];
+        blue = pLut[0];
+        green = pLut[1];
+        red = pLut[2];
     }
     else
     {
-        RGBQUAD color = pixel;
-        RGBQUAD hsl;
-        hsl.rgbRed = param.hue;
-        hsl.rgbGreen = param.sat;
-        hsl.rgbBlue = (BYTE)RGB2GRAY(color.rgbRed, color.rgbGreen, color.rgbBlue);
-        hsl = HSLtoRGB(hsl);
-        red = (BYTE)((hsl.rgbRed * param.a0 + color.rgbRed * param.a1) >> 8);
-        blue = (BYTE)((hsl.rgbBlue * param.a0 + color.rgbBlue * param.a1) >> 8);
-        green = (BYTE)((hsl.rgbGreen * param.a0 + color.rgbGreen * param.a1) >> 8);
+        pLut = param.lut[RGB2GRAY(red, green, blue)];
+        blue = (pLut[0] * param.a0 + blue * param.a1) >> 8;
+        green = (pLut[1] * param.a0 + green * param.a1) >> 8;
+        red = (pLut[2] * param.a0 + red * param.a1) >> 8;
     }
     if (alpha != 255)
     {
@@ -238,46 +268,42 @@ static void ColorizeMode(BYTE *pArgb, const COLORIZEPARAM &param)
         green = (green * alpha) / 255;
         blue = (blue * alpha) / 255;
     }
-    pArgb[0] = blue;
-    pArgb[1] = green;
-    pArgb[2] = red;
+    pArgb[0] = (BYTE)blue;
+    pArgb[1] = (BYTE)green;
+    pArgb[2] = (BYTE)red;
+}
+
+static void ColorizeRows(const DIBINFO &di, UINT iRowBegin, UINT iRowEnd, const void *pParam)
+{
+    const COLORIZEPARAM &param = *(const COLORIZEPARAM *)pParam;
+    LPBYTE pBit = di.pBits + (size_t)di.nWid * iRowBegin * 4;
+    size_t nPixels = (size_t)di.nWid * (iRowEnd - iRowBegin);
+    for (size_t i = 0; i < nPixels; i++, pBit += 4)
+    {
+        ColorizePixel(pBit, param);
+    }
 }
 
 bool SDIBHelper::Colorize(IBitmapS *pBmp, COLORREF crRef)
 {
-    RGBQUAD color = RGBtoRGBQUAD(crRef);
-    RGBQUAD hsl = RGBtoHSL(color);
     COLORIZEPARAM param;
-    float fBlend = 0.8f;
-    BYTE byAlpha = GetAValue(crRef);
-    if (byAlpha != 0)
-        fBlend = byAlpha * 1.0f / 255;
-
-    FillColorizeParam(param, hsl.rgbRed, hsl.rgbGreen, fBlend);
+    FillColorizeParam(param, crRef);
 
     DIBINFO di = { (LPBYTE)pBmp->LockPixelBits(), pBmp->Width(), pBmp->Height() };
-
-    bool bRet = ColorTransform(&di, ColorizeMode, param);
-
+    if (!di.pBits)
+        return false;
+    ParallelRows(di, ColorizeRows, &param);
     pBmp->UnlockPixelBits(di.pBits);
-    return bRet;
+    return true;
 }
 
 bool SDIBHelper::Colorize(COLORREF &crTarget, COLORREF crRef)
 {
-    RGBQUAD color = RGBtoRGBQUAD(crRef);
-    RGBQUAD hsl = RGBtoHSL(color);
     COLORIZEPARAM param;
-
-    float fBlend = 0.8f;
-    BYTE byAlpha = GetAValue(crRef);
-    if (byAlpha != 0)
-        fBlend = byAlpha * 1.0f / 255;
-
-    FillColorizeParam(param, hsl.rgbRed, hsl.rgbGreen, fBlend);
+    FillColorizeParam(param, crRef);
 
     RGBQUAD argbTarget = RGBtoRGBQUAD(crTarget);
-    ColorizeMode((BYTE *)&argbTarget, param);
+    ColorizePixel((BYTE *)&argbTarget, param);
     crTarget = RGBQUADtoRGB(argbTarget);
     return true;
 }
@@ -285,9 +311,11 @@ bool SDIBHelper::Colorize(COLORREF &crTarget, COLORREF crRef)
 bool SDIBHelper::GrayImage(IBitmapS *pBmp)
 {
     DIBINFO di = { (LPBYTE)pBmp->LockPixelBits(), pBmp->Width(), pBmp->Height() };
-    bool bRet = ColorTransform(&di, GrayMode, 0);
+    if (!di.pBits)
+        return false;
+    ParallelRows(di, GrayRows, NULL);
     pBmp->UnlockPixelBits(di.pBits);
-    return bRet;
+    return true;
 }
 
 static COLORREF CalcAvarageRectColor(const DIBINFO &di, RECT rc)
@@ -330,6 +358,33 @@ static int RgbCmp(const void *p1, const void *p2)
     return deltaR + deltaG + deltaB;
 }
 
+struct AVGCOLORPARAM
+{
+    int nBlockSize;
+    int xBlocks;
+    COLORREF *pAvgColors;
+};
+
+static void AvarageColorRows(const DIBINFO &di, UINT iRowBegin, UINT iRowEnd, const void *pParam)
+{
+    // 处理起始行落在[iRowBegin,iRowEnd)内的块
+    const AVGCOLORPARAM &param = *(const AVGCOLORPARAM *)pParam;
+    int yBegin = (iRowBegin + param.nBlockSize - 1) / param.nBlockSize;
+    int yEnd = (iRowEnd + param.nBlockSize - 1) / param.nBlockSize;
+    CRect rcBlock(0, yBegin * param.nBlockSize, param.nBlockSize, (yBegin + 1) * param.nBlockSize);
+    int iBlock = yBegin * param.xBlocks;
+    for (int y = yBegin; y < yEnd; y++)
+    {
+        for (int x = 0; x < param.xBlocks; x++)
+        {
+            param.pAvgColors[iBlock++] = CalcAvarageRectColor(di, rcBlock);
+            rcBlock.OffsetRect(param.nBlockSize, 0);
+        }
+        rcBlock.MoveToX(0);
+        rcBlock.OffsetRect(0, param.nBlockSize);
+    }
+}
+
 COLORREF SDIBHelper::CalcAvarageColor(IBitmapS *pBmp, int nPercent, int nBlockSize /*=5*/)
 {
     DIBINFO di = { (LPBYTE)pBmp->LockPixelBits(), pBmp->Width(), pBmp->Height() };
@@ -340,18 +395,8 @@ COLORREF SDIBHelper::CalcAvarageColor(IBitmapS *pBmp, int nPercent, int nBlockSi
     int nBlocks = xBlocks * yBlocks;
     COLORREF *pAvgColors = new COLORREF[nBlocks];
 
-    CRect rcBlock(0, 0, nBlockSize, nBlockSize);
-    int iBlock = 0;
-    for (int y = 0; y < yBlocks; y++)
-    {
-        for (int x = 0; x < xBlocks; x++)
-        {
-            pAvgColors[iBlock++] = CalcAvarageRectColor(di, rcBlock);
-            rcBlock.OffsetRect(nBlockSize, 0);
-        }
-        rcBlock.MoveToX(0);
-        rcBlock.OffsetRect(0, nBlockSize);
-    }
+    AVGCOLORPARAM param = { nBlockSize, xBlocks, pAvgColors };
+    ParallelRows(di, AvarageColorRows, &param);
     // RGB排序
     qsort(pAvgColors, nBlocks, sizeof(COLORREF), RgbCmp);
 
@@ -0,0 +1,365 @@
+﻿#include "souistd.h"
+#include "helper/SIndexView.h"
+#include "helper/SParallel.h"
+
+SNSBEGIN
+
+// ------------------------------------------------------------
+// 稳定归并排序, 大数据量分块多线程排序后归并
+// ------------------------------------------------------------
+enum
+{
+    kInsertionRun = 16,         // 先用插入排序处理的小段长度
+    kMinItemsPerThread = 8192, // 小于该值的块不值得并行
+};
+
+struct SORTCTX
+{
+    FunIndexCompare fun;
+    void *pCtx;
+};
+
+static inline bool IsBefore(const SORTCTX &ctx, int iItem1, int iItem2)
+{
+    int nRet = ctx.fun ? ctx.fun(ctx.pCtx, iItem1, iItem2) : 0;
+    return nRet < 0 || (nRet == 0 && iItem1 < iItem2);
+}
+
+static void InsertionSort(const SORTCTX &ctx, int *pItems, int nCount)
+{
+    for (int i = 1; i < nCount; i++)
+    {
+        int iItem = pItems[i];
+        int j = i;
+        for (; j > 0 && IsBefore(ctx, iItem, pItems[j - 1]); j--)
+            pItems[j] = pItems[j - 1];
+        pItems[j] = iItem;
+    }
+}
+
+// 把pSrc中相邻的两段有序序列[0,n1)和[n1,n1+n2)归并到pDst
+static void MergeRuns(const SORTCTX &ctx, const int *pSrc, int n1, int n2, int *pDst)
+{
+    if (n2 == 0 || !IsBefore(ctx, pSrc[n1], pSrc[n1 - 1]))
+    { // 两段已经有序, 常见于对基本有序的数据重新排序
+        memcpy(pDst, pSrc, (n1 + n2) * sizeof(int));
+        return;
+    }
+    const int *p1 = pSrc, *pEnd1 = pSrc + n1;
+    const int *p2 = pEnd1, *pEnd2 = pEnd1 + n2;
+    while (p1 < pEnd1 && p2 < pEnd2)
+    {
+        if (IsBefore(ctx, *p2, *p1))
+            *pDst++ = *p2++;
+        else
+            *pDst++ = *p1++;
+    }
+    memcpy(pDst, p1, (pEnd1 - p1) * sizeof(int));
+    memcpy(pDst + (pEnd1 - p1), p2, (pEnd2 - p2) * sizeof(int));
+}
+
+// 单线程归并排序, pTmp与pItems等长
+static void MergeSort(const SORTCTX &ctx, int *pItems, int *pTmp, int nCount)
+{
+    for (int i = 0; i < nCount; i += kInsertionRun)
+        InsertionSort(ctx, pItems + i, smin((int)kInsertionRun, nCount - i));
+
+    int *pSrc = pItems, *pDst = pTmp;
+    for (int nRun = kInsertionRun; nRun < nCount; nRun *= 2)
+    {
+        for (int i = 0; i < nCount; i += nRun * 2)
+        {
+            int n1 = smin(nRun, nCount - i);
+            int n2 = smin(nRun, nCount - i - n1);
+            MergeRuns(ctx, pSrc + i, n1, n2, pDst + i);
+        }
+        int *pSwap = pSrc;
+        pSrc = pDst;
+        pDst = pSwap;
+    }
+    if (pSrc != pItems)
+        memcpy(pItems, pSrc, nCount * sizeof(int));
+}
+
+struct SORTTASK
+{
+    const SORTCTX *pCtx;
+    int *pSrc;
+    int *pDst; // 排序任务的临时缓冲, 归并任务的输出
+    int n1;    // 排序任务的数据量, 归并任务第一段的数据量
+    int n2;    // 归并任务第二段的数据量, 排序任务为-1
+};
+
+// pCtx为SORTTASK数组
+static void __cdecl SortTaskFun(void *pCtx, int iTask)
+{
+    SORTTASK *pTask = (SORTTASK *)pCtx + iTask;
+    if (pTask->n2 < 0)
+        MergeSort(*pTask->pCtx, pTask->pSrc, pTask->pDst, pTask->n1);
+    else
+        MergeRuns(*pTask->pCtx, pTask->pSrc, pTask->n1, pTask->n2, pTask->pDst);
+}
+
+void SIndexView::StableSort(int *pItems, int nCount, FunIndexCompare fun, void *pCtx, BOOL bParallel)
+{
+    if (nCount <= 1)
+        return;
+    SORTCTX ctx = { fun, pCtx };
+    int nChunks = bParallel ? smin(nCount / kMinItemsPerThread, SParallel::GetThreadCount()) : 1;
+    if (nChunks <= 1 && nCount <= kInsertionRun)
+    {
+        InsertionSort(ctx, pItems, nCount);
+        return;
+    }
+    SArray<int> arrTmp;
+    arrTmp.SetCount(nCount);
+    int *pTmp = arrTmp.GetData();
+    if (nChunks <= 1)
+    {
+        MergeSort(ctx, pItems, pTmp, nCount);
+        return;
+    }
+
+    // 各块分别排序
+    int nBounds[SParallel::kMaxThreads + 1];
+    SORTTASK tasks[SParallel::kMaxThreads];
+    for (int i = 0; i <= nChunks; i++)
+        nBounds[i] = (int)((__int64)nCount * i / nChunks);
+    for (int i = 0; i < nChunks; i++)
+    {
+        SORTTASK task = { &ctx, pItems + nBounds[i], pTmp + nBounds[i], nBounds[i + 1] - nBounds[i], -1 };
+        tasks[i] = task;
+    }
+    SParallel::Run(nChunks, SortTaskFun, tasks);
+
+    // 相邻的块两两归并, 直到只剩一块
+    int *pSrc = pItems, *pDst = pTmp;
+    while (nChunks > 1)
+    {
+        int nTasks = 0;
+        for (int i = 0; i < nChunks; i += 2)
+        {
+            int iEnd = smin(i + 2, nChunks);
+            SORTTASK task = { &ctx, pSrc + nBounds[i], pDst + nBounds[i], nBounds[i + 1] - nBounds[i], nBounds[iEnd] - nBounds[i + 1] };
+            tasks[nTasks] = task;
+            nBounds[nTasks] = nBounds[i];
+            nTasks++;
+        }
+        nBounds[nTasks] = nCount;
+        SParallel::Run(nTasks, SortTaskFun, tasks);
+        nChunks = nTasks;
+        int *pSwap = pSrc;
+        pSrc = pDst;
+        pDst = pSwap;
+    }
+    if (pSrc != pItems)
+        memcpy(pItems, pSrc, nCount * sizeof(int));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SIndexView
+SIndexView::SIndexView()
+    : m_funCompare(NULL)
+    , m_pCompareCtx(NULL)
+    , m_funFilter(NULL)
+    , m_pFilterCtx(NULL)
+    , m_nItems(0)
+    , m_bIdentity(TRUE)
+    , m_bItemRowsDirty(TRUE)
+{
+}
+
+void SIndexView::SetCompare(FunIndexCompare fun, void *pCtx)
+{
+    m_funCompare = fun;
+    m_pCompareCtx = pCtx;
+}
+
+void SIndexView::SetFilter(FunIndexFilter fun, void *pCtx)
+{
+    m_funFilter = fun;
+    m_pFilterCtx = pCtx;
+}
+
+void SIndexView::Reset(int nItems)
+{
+    m_nItems = nItems;
+    Rebuild();
+}
+
+void SIndexView::Rebuild()
+{
+    m_bItemRowsDirty = TRUE;
+    m_bIdentity = !m_funCompare && !m_funFilter;
+    if (m_bIdentity)
+    {
+        m_arrRows.RemoveAll();
+        m_arrItemRows.RemoveAll();
+        return;
+    }
+    m_arrRows.SetCount(m_nItems);
+    int nRows = 0;
+    for (int i = 0; i < m_nItems; i++)
+    {
+        if (!m_funFilter || m_funFilter(m_pFilterCtx, i))
+            m_arrRows[nRows++] = i;
+    }
+    m_arrRows.SetCount(nRows);
+    if (m_funCompare)
+        StableSort(m_arrRows.GetData(), nRows, m_funCompare, m_pCompareCtx, TRUE);
+    UpdateItemRows();
+}
+
+int SIndexView::GetCount() const
+{
+    return m_bIdentity ? m_nItems : (int)m_arrRows.GetCount();
+}
+
+int SIndexView::ViewToItem(int iRow) const
+{
+    if (iRow < 0 || iRow >= GetCount())
+        return -1;
+    return m_bIdentity ? iRow : m_arrRows[iRow];
+}
+
+int SIndexView::ItemToView(int iItem) const
+{
+    if (iItem < 0 || iItem >= m_nItems)
+        return -1;
+    if (m_bIdentity)
+        return iItem;
+    if (!m_bItemRowsDirty)
+        return m_arrItemRows[iItem];
+    // 增量修改后不重建反向映射, 显示行有序, 二分查找
+    int iRow = FindInsertRow(iItem);
+    if (iRow < (int)m_arrRows.GetCount() && m_arrRows[iRow] == iItem)
+        return iRow;
+    return -1;
+}
+
+void SIndexView::UpdateItemRows() const
+{
+    if (!m_bItemRowsDirty)
+        return;
+    m_arrItemRows.SetCount(m_nItems);
+    int *pItemRows = m_arrItemRows.GetData();
+    for (int i = 0; i < m_nItems; i++)
+        pItemRows[i] = -1;
+    for (int i = 0; i < (int)m_arrRows.GetCount(); i++)
+        pItemRows[m_arrRows[i]] = i;
+    m_bItemRowsDirty = FALSE;
+}
+
+BOOL SIndexView::IsItemBefore(int iItem1, int iItem2) const
+{
+    SORTCTX ctx = { m_funCompare, m_pCompareCtx };
+    return IsBefore(ctx, iItem1, iItem2);
+}
+
+int SIndexView::FindInsertRow(int iItem) const
+{
+    int iLow = 0, iHigh = (int)m_arrRows.GetCount();
+    while (iLow < iHigh)
+    {
+        int iMid = (iLow + iHigh) / 2;
+        if (IsItemBefore(m_arrRows[iMid], iItem))
+            iLow = iMid + 1;
+        else
+            iHigh = iMid;
+    }
+    return iLow;
+}
+
+int SIndexView::InsertItem(int iItem)
+{
+    SASSERT(iItem >= 0 && iItem <= m_nItems);
+    m_nItems++;
+    if (m_bIdentity)
+        return iItem;
+    m_bItemRowsDirty = TRUE;
+    if (iItem < m_nItems - 1)
+    { // 不是追加到末尾, 后面的数据项索引加1
+        int *pRows = m_arrRows.GetData();
+        for (int i = 0; i < (int)m_arrRows.GetCount(); i++)
+        {
+            if (pRows[i] >= iItem)
+                pRows[i]++;
+        }
+    }
+    if (m_funFilter && !m_funFilter(m_pFilterCtx, iItem))
+        return -1;
+    int iRow = FindInsertRow(iItem);
+    m_arrRows.InsertAt(iRow, iItem);
+    return iRow;
+}
+
+void SIndexView::RemoveItem(int iItem)
+{
+    SASSERT(iItem >= 0 && iItem < m_nItems);
+    m_nItems--;
+    if (m_bIdentity)
+        return;
+    m_bItemRowsDirty = TRUE;
+    int *pRows = m_arrRows.GetData();
+    int nRows = 0;
+    for (int i = 0; i < (int)m_arrRows.GetCount(); i++)
+    {
+        if (pRows[i] == iItem)
+            continue;
+        pRows[nRows++] = pRows[i] > iItem ? pRows[i] - 1 : pRows[i];
+    }
+    m_arrRows.SetCount(nRows);
+}
+
+int SIndexView::UpdateItem(int iItem, int *pOldRow)
+{
+    SASSERT(iItem >= 0 && iItem < m_nItems);
+    int iRow = -1;
+    if (m_bIdentity)
+    {
+        iRow = iItem;
+    }
+    else if (!m_bItemRowsDirty)
+    {
+        iRow = m_arrItemRows[iItem];
+    }
+    else
+    { // 数据项内容已经改变, 不能二分查找
+        for (int i = 0; i < (int)m_arrRows.GetCount(); i++)
+        {
+            if (m_arrRows[i] == iItem)
+            {
+                iRow = i;
+                break;
+            }
+        }
+    }
+    if (pOldRow)
+        *pOldRow = iRow;
+    return UpdateItemAt(iItem, iRow);
+}
+
+int SIndexView::UpdateItemAt(int iItem, int iOldRow)
+{
+    SASSERT(iItem >= 0 && iItem < m_nItems);
+    if (m_bIdentity)
+        return iItem;
+    SASSERT(iOldRow == -1 || m_arrRows[iOldRow] == iItem);
+    int iRow = iOldRow;
+    BOOL bShow = !m_funFilter || m_funFilter(m_pFilterCtx, iItem);
+    if (iRow != -1)
+    {
+        int nRows = (int)m_arrRows.GetCount();
+        if (bShow && (iRow == 0 || IsItemBefore(m_arrRows[iRow - 1], iItem)) && (iRow == nRows - 1 || IsItemBefore(iItem, m_arrRows[iRow + 1])))
+            return iRow; // 位置没有变化
+        m_arrRows.RemoveAt(iRow);
+    }
+    m_bItemRowsDirty = TRUE;
+    if (!bShow)
+        return -1;
+    iRow = FindInsertRow(iItem);
+    m_arrRows.InsertAt(iRow, iItem);
+    return iRow;
+}
+
+SNSEND
@@ -0,0 +1,124 @@
+﻿#include "souistd.h"
+#include "helper/SParallel.h"
+#include <helper/SSemaphore.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+SNSBEGIN
+
+static int GetCpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#else
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+// 常驻工作线程. Run唤醒需要的工作线程, 每个被唤醒的工作线程领不到任务后通知一次m_semDone.
+// 线程池不释放: 进程退出时工作线程还阻塞在m_semStart上, 释放信号量会让它们失去同步对象.
+class SParallelPool {
+  public:
+    SParallelPool()
+        : m_nWorkers(0)
+        , m_nBusy(0)
+        , m_fun(NULL)
+        , m_pCtx(NULL)
+        , m_nTasks(0)
+        , m_iNext(0)
+    {
+        int nWorkers = smin(GetCpuCount(), (int)SParallel::kMaxThreads) - 1;
+        for (int i = 0; i < nWorkers; i++)
+        {
+            HANDLE hThread = CreateThread(NULL, 0, WorkerProc, this, 0, NULL);
+            if (!hThread)
+                break;
+            CloseHandle(hThread);
+            m_nWorkers++;
+        }
+    }
+
+    int GetThreadCount() const
+    {
+        return m_nWorkers + 1;
+    }
+
+    void Run(int nTasks, FunParallelTask fun, void *pCtx)
+    {
+        if (nTasks <= 0)
+            return;
+        if (nTasks == 1 || m_nWorkers == 0 || InterlockedCompareExchange(&m_nBusy, 1, 0) != 0)
+        {
+            for (int i = 0; i < nTasks; i++)
+                fun(pCtx, i);
+            return;
+        }
+        m_fun = fun;
+        m_pCtx = pCtx;
+        m_nTasks = nTasks;
+        m_iNext = 0;
+        int nWake = smin(nTasks - 1, m_nWorkers);
+        for (int i = 0; i < nWake; i++)
+            m_semStart.notify();
+        Work();
+        for (int i = 0; i < nWake; i++)
+            m_semDone.wait();
+        InterlockedExchange(&m_nBusy, 0);
+    }
+
+  protected:
+    static DWORD WINAPI WorkerProc(LPVOID pParam)
+    {
+        SParallelPool *_this = (SParallelPool *)pParam;
+        for (;;)
+        {
+            _this->m_semStart.wait();
+            _this->Work();
+            _this->m_semDone.notify();
+        }
+        return 0;
+    }
+
+    void Work()
+    {
+        for (;;)
+        {
+            LONG iTask = InterlockedIncrement(&m_iNext) - 1;
+            if (iTask >= m_nTasks)
+                break;
+            m_fun(m_pCtx, (int)iTask);
+        }
+    }
+
+    int m_nWorkers;
+    volatile LONG m_nBusy; // 1表示有一批任务正在执行
+    SSemaphore m_semStart;
+    SSemaphore m_semDone;
+
+    // 当前这批任务, 由m_nBusy保护
+    FunParallelTask m_fun;
+    void *m_pCtx;
+    LONG m_nTasks;
+    volatile LONG m_iNext; // 下一个待领取的任务
+};
+
+static SParallelPool *GetPool()
+{
+    static SParallelPool *s_pool = new SParallelPool;
+    return s_pool;
+}
+
+int SParallel::GetThreadCount()
+{
+    return GetPool()->GetThreadCount();
+}
+
+void SParallel::Run(int nTasks, FunParallelTask fun, void *pCtx)
+{
+    GetPool()->Run(nTasks, fun, pCtx);
+}
+
+SNSEND
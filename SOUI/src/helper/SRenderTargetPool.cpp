@@ -0,0 +1,125 @@
+﻿#include "souistd.h"
+#include "helper/SRenderTargetPool.h"
+
+SNSBEGIN
+
+SRenderTargetPool::SRenderTargetPool(UINT cbMaxIdle)
+    : m_cbMaxIdle(cbMaxIdle)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+SRenderTargetPool::~SRenderTargetPool()
+{
+    Clear();
+}
+
+CSize SRenderTargetPool::BucketSize(SIZE sz)
+{
+    CSize ret;
+    ret.cx = (smax(sz.cx, 1) + BUCKET_STEP - 1) / BUCKET_STEP * BUCKET_STEP;
+    ret.cy = (smax(sz.cy, 1) + BUCKET_STEP - 1) / BUCKET_STEP * BUCKET_STEP;
+    return ret;
+}
+
+UINT SRenderTargetPool::EntryBytes(const CSize &sz)
+{
+    return sz.cx * sz.cy * 4;
+}
+
+BOOL SRenderTargetPool::Acquire(SIZE sz, IRenderTarget **ppRT)
+{
+    if (!ppRT)
+        return FALSE;
+    CSize szBucket = BucketSize(sz);
+    m_stats.nAcquires++;
+    IRenderTarget *pRT = NULL;
+    SPOSITION pos = m_lstIdle.GetHeadPosition();
+    while (pos)
+    {
+        SPOSITION posCur = pos;
+        const RtEntry &entry = m_lstIdle.GetNext(pos);
+        if (entry.sz == szBucket)
+        {
+            pRT = entry.pRT;
+            m_lstIdle.RemoveAt(posCur);
+            m_stats.nIdle--;
+            m_stats.cbIdle -= EntryBytes(szBucket);
+            m_stats.nReuses++;
+            break;
+        }
+    }
+    if (!pRT)
+    {
+        if (!GETRENDERFACTORY->CreateRenderTarget(&pRT, szBucket.cx, szBucket.cy) || !pRT)
+            return FALSE;
+        m_stats.nCreates++;
+    }
+    m_mapBusy[pRT] = szBucket;
+    *ppRT = pRT;
+    return TRUE;
+}
+
+void SRenderTargetPool::Recycle(IRenderTarget *pRT)
+{
+    if (!pRT)
+        return;
+    SMap<IRenderTarget *, CSize>::CPair *p = m_mapBusy.Lookup(pRT);
+    if (!p)
+    { //不是从池中申请的RT
+        pRT->Release();
+        return;
+    }
+    RtEntry entry = { pRT, p->m_value };
+    m_mapBusy.RemoveKey(pRT);
+    m_stats.nRecycles++;
+
+    //恢复到刚创建时的状态
+    POINT ptOrg = { 0, 0 };
+    pRT->SetViewportOrg(ptOrg);
+    SMatrix mtx;
+    pRT->SetTransform(mtx.fMat, NULL);
+
+    UINT cbEntry = EntryBytes(entry.sz);
+    if (cbEntry > m_cbMaxIdle)
+    {
+        pRT->Release();
+        m_stats.nDrops++;
+        return;
+    }
+    Trim(m_cbMaxIdle - cbEntry);
+    m_lstIdle.AddHead(entry);
+    m_stats.nIdle++;
+    m_stats.cbIdle += cbEntry;
+}
+
+void SRenderTargetPool::SetMaxIdleBytes(UINT cbMaxIdle)
+{
+    m_cbMaxIdle = cbMaxIdle;
+    Trim(m_cbMaxIdle);
+}
+
+void SRenderTargetPool::Clear()
+{
+    Trim(0);
+}
+
+void SRenderTargetPool::GetStats(RtPoolStats *pStats) const
+{
+    if (pStats)
+        *pStats = m_stats;
+}
+
+void SRenderTargetPool::Trim(UINT cbMaxIdle)
+{
+    while (!m_lstIdle.IsEmpty() && m_stats.cbIdle > cbMaxIdle)
+    {
+        RtEntry entry = m_lstIdle.RemoveTail();
+        entry.pRT->Release();
+        m_stats.nIdle--;
+        m_stats.cbIdle -= EntryBytes(entry.sz);
+        m_stats.nDrops++;
+    }
+}
+
+SNSEND
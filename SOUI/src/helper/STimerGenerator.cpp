@@ -1,57 +1,170 @@
-﻿#include "souistd.h"
-#include "helper/STimerGenerator.h"
-#include <event/SEvents.h>
-SNSBEGIN
-//////////////////////////////////////////////////////////////////////////
-//  SScriptTimer
-template <>
-STimerGenerator *SSingleton<STimerGenerator>::ms_Singleton = NULL;
-
-STimerGenerator::~STimerGenerator()
-{
-    SPOSITION pos = m_mapNamedObj->GetStartPosition();
-    while (pos)
-    {
-        SMap<UINT_PTR, TIMERINFO>::CPair *p = m_mapNamedObj->GetNext(pos);
-        ::KillTimer(NULL, p->m_key);
-    }
-}
-
-VOID CALLBACK STimerGenerator::_TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
-{
-    TIMERINFO ti;
-    if (STimerGenerator::getSingleton().GetKeyObject(idEvent, ti))
-    {
-        if (!ti.bRepeat)
-        {
-            STimerGenerator::getSingleton().ClearTimer(idEvent);
-        }
-        EventTimer evt(NULL);
-        evt.uID = (UINT)idEvent;
-        evt.uData = ti.uData;
-        ti.pEvtSlot->Run(&evt);
-    }
-    else
-    {
-        STimerGenerator::getSingleton().ClearTimer(idEvent);
-    }
-}
-
-void STimerGenerator::ClearTimer(UINT_PTR uID)
-{
-    ::KillTimer(NULL, uID);
-    RemoveKeyObject(uID);
-}
-
-UINT STimerGenerator::SetTimer(IEvtSlot *pEvtSlot, UINT nElapse, BOOL bRepeat, LPARAM uData)
-{
-    UINT_PTR uID = ::SetTimer(NULL, 0, nElapse, _TimerProc);
-    if (uID != 0)
-    {
-        TIMERINFO ti = { pEvtSlot, bRepeat, uData };
-        AddKeyObject(uID, ti);
-    }
-    return (UINT)uID;
-}
-
-SNSEND
\ No newline at end of file
+﻿#include "souistd.h"
+#include "helper/STimerGenerator.h"
+#include <event/SEvents.h>
+SNSBEGIN
+//////////////////////////////////////////////////////////////////////////
+//  SScriptTimer
+template <>
+STimerGenerator *SSingleton<STimerGenerator>::ms_Singleton = NULL;
+
+STimerGenerator::SThreadTimers::SThreadTimers(STimerGenerator *pOwner)
+    : m_uSysTimer(0)
+    , m_pOwner(pOwner)
+{
+    m_timerWheel.SetListener(this);
+}
+
+STimerGenerator::SThreadTimers::~SThreadTimers()
+{
+    m_timerWheel.SetListener(NULL);
+    if (m_uSysTimer)
+    {
+        ::KillTimer(NULL, m_uSysTimer);
+        m_uSysTimer = 0;
+    }
+}
+
+void STimerGenerator::SThreadTimers::OnArmTimer(UINT uElapse)
+{
+    //线程定时器不能通过ID重置，先删除再创建
+    if (m_uSysTimer)
+    {
+        ::KillTimer(NULL, m_uSysTimer);
+        m_uSysTimer = 0;
+    }
+    if (uElapse != INFINITE)
+    {
+        m_uSysTimer = ::SetTimer(NULL, 0, uElapse, _TimerProc);
+    }
+}
+
+void STimerGenerator::SThreadTimers::OnTimerExpired(UINT_PTR uKey)
+{
+    TIMERINFO ti;
+    BOOL bValid = FALSE;
+    {
+        SAutoLock lock(m_pOwner->m_cs);
+        bValid = m_pOwner->GetKeyObject(uKey, ti);
+        if (bValid && !ti.bRepeat)
+        {
+            m_pOwner->RemoveKeyObject(uKey);
+        }
+    }
+    if (!bValid)
+    { //定时器已经在其它线程清除
+        m_timerWheel.KillTimer(uKey);
+        return;
+    }
+    //回调中可能清除定时器甚至释放本对象，之后不能再访问成员
+    EventTimer evt(NULL);
+    evt.uID = (UINT)uKey;
+    evt.uData = ti.uData;
+    ti.pEvtSlot->Run(&evt);
+}
+
+//////////////////////////////////////////////////////////////////////////
+STimerGenerator::STimerGenerator()
+    : m_uNextID(0)
+{
+}
+
+STimerGenerator::~STimerGenerator()
+{
+    SPOSITION pos = m_mapThreadTimers.GetStartPosition();
+    while (pos)
+    {
+        delete m_mapThreadTimers.GetNextValue(pos);
+    }
+    m_mapThreadTimers.RemoveAll();
+}
+
+STimerGenerator::SThreadTimers *STimerGenerator::_GetThreadTimers(BOOL bCreate)
+{
+    tid_t tid = GetCurrentThreadId();
+    SAutoLock lock(m_cs);
+    SMap<tid_t, SThreadTimers *>::CPair *p = m_mapThreadTimers.Lookup(tid);
+    if (p)
+        return p->m_value;
+    if (!bCreate)
+        return NULL;
+    SThreadTimers *pRet = new SThreadTimers(this);
+    m_mapThreadTimers[tid] = pRet;
+    return pRet;
+}
+
+VOID CALLBACK STimerGenerator::_TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+{
+    STimerGenerator *_this = STimerGenerator::getSingletonPtr();
+    SThreadTimers *pTimers = _this ? _this->_GetThreadTimers(FALSE) : NULL;
+    if (pTimers && idEvent == pTimers->m_uSysTimer)
+    {
+        pTimers->m_timerWheel.OnTick();
+    }
+    else
+    {
+        //过期的系统定时器
+        ::KillTimer(NULL, idEvent);
+    }
+}
+
+void STimerGenerator::ClearTimer(UINT_PTR uID)
+{
+    TIMERINFO ti;
+    {
+        SAutoLock lock(m_cs);
+        if (!GetKeyObject(uID, ti))
+            return;
+        RemoveKeyObject(uID);
+    }
+    //其它线程的定时器轮只能在它自己的线程上修改，到期时发现定时器信息已经删除会自动清除
+    if (ti.tid == GetCurrentThreadId())
+    {
+        SThreadTimers *pTimers = _GetThreadTimers(FALSE);
+        if (pTimers)
+            pTimers->m_timerWheel.KillTimer(uID);
+    }
+}
+
+UINT STimerGenerator::SetTimer(IEvtSlot *pEvtSlot, UINT nElapse, BOOL bRepeat, LPARAM uData)
+{
+    SThreadTimers *pTimers = _GetThreadTimers(TRUE);
+    UINT uID = 0;
+    {
+        SAutoLock lock(m_cs);
+        //分配一个非0且未使用的ID
+        do
+        {
+            uID = ++m_uNextID;
+        } while (uID == 0 || HasKey(uID));
+        TIMERINFO ti = { pEvtSlot, bRepeat, uData, GetCurrentThreadId() };
+        AddKeyObject(uID, ti);
+    }
+    pTimers->m_timerWheel.SetTimer(uID, nElapse, bRepeat);
+    return uID;
+}
+
+void STimerGenerator::ReleaseThreadTimers()
+{
+    tid_t tid = GetCurrentThreadId();
+    SThreadTimers *pTimers = NULL;
+    {
+        SAutoLock lock(m_cs);
+        SMap<tid_t, SThreadTimers *>::CPair *p = m_mapThreadTimers.Lookup(tid);
+        if (!p)
+            return;
+        pTimers = p->m_value;
+        m_mapThreadTimers.RemoveKey(tid);
+        //删除这个线程上的定时器信息
+        SPOSITION pos = m_mapNamedObj->GetStartPosition();
+        while (pos)
+        {
+            SPOSITION posPrev = pos;
+            const TIMERINFO &ti = m_mapNamedObj->GetNextValue(pos);
+            if (ti.tid == tid)
+                m_mapNamedObj->RemoveAtPos(posPrev);
+        }
+    }
+    delete pTimers;
+}
+
+SNSEND
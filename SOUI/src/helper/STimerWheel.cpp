@@ -0,0 +1,397 @@
+﻿#include "souistd.h"
+#include "helper/STimerWheel.h"
+
+SNSBEGIN
+
+void STimerWheel::ListInit(TimerLink *pHead)
+{
+    pHead->pPrev = pHead->pNext = pHead;
+}
+
+BOOL STimerWheel::ListEmpty(const TimerLink *pHead)
+{
+    return pHead->pNext == pHead;
+}
+
+void STimerWheel::ListAppend(TimerLink *pHead, TimerLink *pNode)
+{
+    pNode->pNext = pHead;
+    pNode->pPrev = pHead->pPrev;
+    pHead->pPrev->pNext = pNode;
+    pHead->pPrev = pNode;
+}
+
+void STimerWheel::ListUnlink(TimerLink *pNode)
+{
+    pNode->pPrev->pNext = pNode->pNext;
+    pNode->pNext->pPrev = pNode->pPrev;
+    pNode->pPrev = pNode->pNext = pNode;
+}
+
+STimerWheel::STimerWheel(ITimerWheelListener *pListener)
+    : m_pListener(pListener)
+    , m_dwCur(GetTickCount())
+    , m_bArmed(FALSE)
+    , m_dwArmedExpire(0)
+    , m_pbDestroyed(NULL)
+{
+    for (int i = 0; i < ARRAYSIZE(m_slots); i++)
+    {
+        ListInit(m_slots + i);
+    }
+    memset(m_nLevelCount, 0, sizeof(m_nLevelCount));
+}
+
+STimerWheel::~STimerWheel()
+{
+    if (m_pbDestroyed)
+        *m_pbDestroyed = TRUE;
+    SPOSITION pos = m_mapTimer.GetStartPosition();
+    while (pos)
+    {
+        TimerNode *pNode = m_mapTimer.GetNextValue(pos);
+        ListUnlink(pNode);
+        delete pNode;
+    }
+    m_mapTimer.RemoveAll();
+    m_mapGroup.RemoveAll();
+}
+
+void STimerWheel::SetListener(ITimerWheelListener *pListener)
+{
+    m_pListener = pListener;
+}
+
+STimerWheel::TimerLink *STimerWheel::GetSlot(int iLevel, UINT iSlot) const
+{
+    TimerLink *pSlots = const_cast<TimerLink *>(m_slots);
+    if (iLevel == 0)
+        return pSlots + iSlot;
+    return pSlots + TVR_SIZE + (iLevel - 1) * TVN_SIZE + iSlot;
+}
+
+void STimerWheel::AddNode(TimerNode *pNode)
+{
+    DWORD dwExpire = pNode->dwExpire;
+    DWORD dwDelta = dwExpire - m_dwCur;
+    int iLevel = 0;
+    UINT iSlot = 0;
+    if ((LONG)dwDelta < 0)
+    { //已经过期，在下一个刻度执行
+        iSlot = m_dwCur & TVR_MASK;
+    }
+    else if (dwDelta < TVR_SIZE)
+    {
+        iSlot = dwExpire & TVR_MASK;
+    }
+    else
+    {
+        UINT uShift = TVR_BITS;
+        iLevel = 1;
+        while (iLevel < TV_LEVELS - 1 && dwDelta >= (1u << (uShift + TVN_BITS)))
+        {
+            iLevel++;
+            uShift += TVN_BITS;
+        }
+        iSlot = (dwExpire >> uShift) & TVN_MASK;
+    }
+    pNode->iLevel = iLevel;
+    m_nLevelCount[iLevel]++;
+    ListAppend(GetSlot(iLevel, iSlot), pNode);
+}
+
+void STimerWheel::DetachNode(TimerNode *pNode)
+{
+    if (pNode->iLevel >= 0)
+    {
+        m_nLevelCount[pNode->iLevel]--;
+        pNode->iLevel = -1;
+    }
+    ListUnlink(pNode);
+}
+
+void STimerWheel::FreeNode(TimerNode *pNode)
+{
+    DetachNode(pNode);
+    //从分组链表中移除
+    if (pNode->pGroupNext)
+        pNode->pGroupNext->pGroupPrev = pNode->pGroupPrev;
+    if (pNode->pGroupPrev)
+        pNode->pGroupPrev->pGroupNext = pNode->pGroupNext;
+    else if (pNode->pGroupNext)
+        m_mapGroup[pNode->dwGroup] = pNode->pGroupNext;
+    else
+        m_mapGroup.RemoveKey(pNode->dwGroup);
+    m_mapTimer.RemoveKey(pNode->uKey);
+    delete pNode;
+}
+
+UINT STimerWheel::Cascade(int iLevel)
+{
+    UINT uShift = TVR_BITS + (iLevel - 1) * TVN_BITS;
+    UINT iSlot = (m_dwCur >> uShift) & TVN_MASK;
+    TimerLink *pSlot = GetSlot(iLevel, iSlot);
+    TimerLink lst;
+    ListInit(&lst);
+    while (!ListEmpty(pSlot))
+    {
+        TimerNode *pNode = static_cast<TimerNode *>(pSlot->pNext);
+        DetachNode(pNode);
+        ListAppend(&lst, pNode);
+    }
+    while (!ListEmpty(&lst))
+    {
+        TimerNode *pNode = static_cast<TimerNode *>(lst.pNext);
+        ListUnlink(pNode);
+        AddNode(pNode);
+    }
+    return iSlot;
+}
+
+void STimerWheel::Advance(DWORD dwNow, TimerLink *pExpired)
+{
+    while ((LONG)(dwNow - m_dwCur) >= 0)
+    {
+        UINT iSlot = m_dwCur & TVR_MASK;
+        if (iSlot == 0)
+        { //低层转完一圈，把高层当前槽中的定时器重新分配到低层
+            for (int i = 1; i < TV_LEVELS && Cascade(i) == 0; i++)
+                ;
+        }
+        if (m_nLevelCount[0] == 0)
+        { // tv1为空，直接跳到下一个需要级联的刻度
+            int nTotal = 0;
+            for (int i = 1; i < TV_LEVELS; i++)
+                nTotal += m_nLevelCount[i];
+            DWORD dwNext = (m_dwCur | TVR_MASK) + 1;
+            if (nTotal == 0 || (LONG)(dwNow - dwNext) < 0)
+            {
+                m_dwCur = dwNow + 1;
+                break;
+            }
+            m_dwCur = dwNext;
+            continue;
+        }
+        TimerLink *pSlot = GetSlot(0, iSlot);
+        while (!ListEmpty(pSlot))
+        {
+            TimerNode *pNode = static_cast<TimerNode *>(pSlot->pNext);
+            DetachNode(pNode);
+            ListAppend(pExpired, pNode);
+        }
+        m_dwCur++;
+    }
+    //当前刻度处理完之后才加入的定时器被放在下一个刻度的槽中，把其中已经到期的也取出来
+    TimerLink *pSlot = GetSlot(0, m_dwCur & TVR_MASK);
+    TimerLink *p = pSlot->pNext;
+    while (p != pSlot)
+    {
+        TimerNode *pNode = static_cast<TimerNode *>(p);
+        p = p->pNext;
+        if ((LONG)(dwNow - pNode->dwExpire) >= 0)
+        {
+            DetachNode(pNode);
+            ListAppend(pExpired, pNode);
+        }
+    }
+}
+
+BOOL STimerWheel::GetNextExpire(DWORD &dwExpire) const
+{
+    BOOL bFound = FALSE;
+    for (int iLevel = 0; iLevel < TV_LEVELS; iLevel++)
+    {
+        if (m_nLevelCount[iLevel] == 0)
+            continue;
+        UINT uShift = iLevel == 0 ? 0 : (TVR_BITS + (iLevel - 1) * TVN_BITS);
+        UINT uSize = iLevel == 0 ? TVR_SIZE : TVN_SIZE;
+        UINT uMask = uSize - 1;
+        UINT iCur = (m_dwCur >> uShift) & uMask;
+        // tv1从当前槽开始查找；高层的当前槽如果还没有级联，它是最早到期的槽，否则它是最晚到期的槽
+        UINT iStart = (iLevel == 0 || (m_dwCur & ((1u << uShift) - 1)) == 0) ? 0 : 1;
+        for (UINT i = iStart; i < iStart + uSize; i++)
+        {
+            const TimerLink *pSlot = GetSlot(iLevel, (iCur + i) & uMask);
+            if (ListEmpty(pSlot))
+                continue;
+            for (const TimerLink *p = pSlot->pNext; p != pSlot; p = p->pNext)
+            {
+                DWORD dw = static_cast<const TimerNode *>(p)->dwExpire;
+                if (!bFound || (LONG)(dw - dwExpire) < 0)
+                {
+                    dwExpire = dw;
+                    bFound = TRUE;
+                }
+            }
+            break;
+        }
+    }
+    return bFound;
+}
+
+void STimerWheel::Rearm(BOOL bForce)
+{
+    DWORD dwExpire = 0;
+    if (!GetNextExpire(dwExpire))
+    {
+        if (m_bArmed)
+        {
+            m_bArmed = FALSE;
+            if (m_pListener)
+                m_pListener->OnArmTimer(INFINITE);
+        }
+        return;
+    }
+    if (m_bArmed && !bForce && dwExpire == m_dwArmedExpire)
+        return;
+    LONG lDelta = (LONG)(dwExpire - GetTickCount());
+    m_bArmed = TRUE;
+    m_dwArmedExpire = dwExpire;
+    if (m_pListener)
+        m_pListener->OnArmTimer(lDelta > 0 ? (UINT)lDelta : 0);
+}
+
+BOOL STimerWheel::SetTimer(UINT_PTR uKey, UINT uElapse, BOOL bRepeat, DWORD dwGroup)
+{
+    if (uElapse > MAX_ELAPSE)
+        uElapse = MAX_ELAPSE;
+    DWORD dwNow = GetTickCount();
+    TimerNode *pNode = NULL;
+    SMap<UINT_PTR, TimerNode *>::CPair *p = m_mapTimer.Lookup(uKey);
+    if (p)
+    {
+        pNode = p->m_value;
+        DetachNode(pNode);
+        if (pNode->dwGroup != dwGroup)
+        { //分组变化，先释放再重新创建
+            FreeNode(pNode);
+            pNode = NULL;
+        }
+    }
+    if (!pNode)
+    {
+        pNode = new TimerNode;
+        ListInit(pNode);
+        pNode->iLevel = -1;
+        pNode->uKey = uKey;
+        pNode->dwGroup = dwGroup;
+        pNode->pGroupPrev = NULL;
+        pNode->pGroupNext = NULL;
+        SMap<DWORD, TimerNode *>::CPair *pGroup = m_mapGroup.Lookup(dwGroup);
+        if (pGroup)
+        {
+            pNode->pGroupNext = pGroup->m_value;
+            pGroup->m_value->pGroupPrev = pNode;
+            pGroup->m_value = pNode;
+        }
+        else
+        {
+            m_mapGroup[dwGroup] = pNode;
+        }
+        m_mapTimer[uKey] = pNode;
+    }
+
+    int nTotal = 0;
+    for (int i = 0; i < TV_LEVELS; i++)
+        nTotal += m_nLevelCount[i];
+    if (nTotal == 0 && (LONG)(dwNow - m_dwCur) > 0)
+    { //定时器轮空闲，直接对齐到当前时间
+        m_dwCur = dwNow;
+    }
+
+    pNode->uElapse = uElapse;
+    pNode->bRepeat = bRepeat;
+    pNode->dwExpire = dwNow + uElapse;
+    AddNode(pNode);
+    Rearm(FALSE);
+    return TRUE;
+}
+
+BOOL STimerWheel::KillTimer(UINT_PTR uKey)
+{
+    SMap<UINT_PTR, TimerNode *>::CPair *p = m_mapTimer.Lookup(uKey);
+    if (!p)
+        return FALSE;
+    FreeNode(p->m_value);
+    Rearm(FALSE);
+    return TRUE;
+}
+
+int STimerWheel::KillGroup(DWORD dwGroup)
+{
+    SMap<DWORD, TimerNode *>::CPair *p = m_mapGroup.Lookup(dwGroup);
+    if (!p)
+        return 0;
+    int nRet = 0;
+    TimerNode *pNode = p->m_value;
+    while (pNode)
+    {
+        TimerNode *pNext = pNode->pGroupNext;
+        FreeNode(pNode);
+        pNode = pNext;
+        nRet++;
+    }
+    Rearm(FALSE);
+    return nRet;
+}
+
+void STimerWheel::KillAll()
+{
+    // FreeNode会修改m_mapTimer，每次都重新取第一个节点
+    while (!m_mapTimer.IsEmpty())
+    {
+        SPOSITION pos = m_mapTimer.GetStartPosition();
+        FreeNode(m_mapTimer.GetNextValue(pos));
+    }
+    Rearm(FALSE);
+}
+
+BOOL STimerWheel::HasTimer(UINT_PTR uKey) const
+{
+    return m_mapTimer.Lookup(uKey) != NULL;
+}
+
+int STimerWheel::GetCount() const
+{
+    return (int)m_mapTimer.GetCount();
+}
+
+void STimerWheel::OnTick()
+{
+    DWORD dwNow = GetTickCount();
+    TimerLink lstExpired;
+    ListInit(&lstExpired);
+    Advance(dwNow, &lstExpired);
+    //回调中可能销毁定时器轮，嵌套的OnTick把标志串起来，销毁时逐层通知
+    BOOL bDestroyed = FALSE;
+    BOOL *pbOuter = m_pbDestroyed;
+    m_pbDestroyed = &bDestroyed;
+    //回调中可能设置或者删除定时器，每次都从队列头部取
+    while (!ListEmpty(&lstExpired))
+    {
+        TimerNode *pNode = static_cast<TimerNode *>(lstExpired.pNext);
+        UINT_PTR uKey = pNode->uKey;
+        if (pNode->bRepeat)
+        {
+            DetachNode(pNode);
+            pNode->dwExpire = dwNow + pNode->uElapse;
+            AddNode(pNode);
+        }
+        else
+        {
+            FreeNode(pNode);
+        }
+        if (m_pListener)
+            m_pListener->OnTimerExpired(uKey);
+        if (bDestroyed)
+        { //定时器轮已经销毁，析构时已经释放了队列中剩余的节点，不能再访问成员
+            if (pbOuter)
+                *pbOuter = TRUE;
+            return;
+        }
+    }
+    m_pbDestroyed = pbOuter;
+    Rearm(TRUE);
+}
+
+SNSEND
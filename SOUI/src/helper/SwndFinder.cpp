@@ -4,9 +4,9 @@
 
 SNSBEGIN
 
-SFindInfo::SFindInfo(SWindow *pParent, const SStringW &_strName, int _nDeep)
+SFindInfo::SFindInfo(SWindow *pParent, const SAtom &_name, int _nDeep)
     : hParent(pParent->GetSwnd())
-    , strName(_strName)
+    , name(_name)
     , nDeep(_nDeep)
     , findByName(true)
 {
@@ -21,9 +21,9 @@ SFindInfo::SFindInfo(SWindow *pParent, int _nID, int _nDeep)
 }
 
 //////////////////////////////////////////////////////////////////////////
-SWindow *SWindowFinder::FindChildByName(SWindow *pParent, const SStringW &strName, int nDeep)
+SWindow *SWindowFinder::FindChildByName(SWindow *pParent, const SAtom &name, int nDeep)
 {
-    SFindInfo fi(pParent, strName, nDeep);
+    SFindInfo fi(pParent, name, nDeep);
     return FindChildByKey(pParent, fi);
 }
 
@@ -51,9 +51,9 @@ SWindow *SWindowFinder::FindChildByKey(SWindow *pParent, const SFindInfo &fi)
     }
 }
 
-void SWindowFinder::CacheResultForName(SWindow *pParent, const SStringW &strName, int nDeep, SWindow *pResult)
+void SWindowFinder::CacheResultForName(SWindow *pParent, const SAtom &name, int nDeep, SWindow *pResult)
 {
-    SFindInfo fi(pParent, strName, nDeep);
+    SFindInfo fi(pParent, name, nDeep);
     SASSERT(m_findCache.Lookup(fi) == NULL);
     SASSERT(pResult);
     m_findCache[fi] = pResult->GetSwnd();
@@ -73,8 +73,23 @@ const static WCHAR KDefFontFace[] = L"宋体";
 
 IFontPtr SFontPool::_GetFont(const SStringW &strFont, int scale)
 {
-    SStringW strFontDesc = GETUIDEF->GetFontDesc(strFont);
-    FontInfo info = FontInfoFromString(strFontDesc, m_defFontInfo);
+    FontCacheKey key = { strFont, scale };
+    SMap<FontCacheKey, IFontPtr>::CPair *pFont = m_fontCache.Lookup(key);
+    if (pFont)
+        return pFont->m_value;
+
+    FontInfo info;
+    SMap<SStringW, FontInfo>::CPair *pInfo = m_descCache.Lookup(strFont);
+    if (pInfo)
+    {
+        info = pInfo->m_value;
+    }
+    else
+    {
+        SStringW strFontDesc = GETUIDEF->GetFontDesc(strFont);
+        info = FontInfoFromString(strFontDesc, m_defFontInfo);
+        m_descCache[strFont] = info;
+    }
     info.scale = scale;
     IFontPtr hftRet = NULL;
     if (HasKey(info))
@@ -86,9 +101,16 @@ IFontPtr SFontPool::_GetFont(const SStringW &strFont, int scale)
         hftRet = _CreateFont(info);
         AddKeyObject(info, hftRet);
     }
+    m_fontCache[key] = hftRet;
     return hftRet;
 }
 
+void SFontPool::_ClearFontCache()
+{
+    m_fontCache.RemoveAll();
+    m_descCache.RemoveAll();
+}
+
 IFontPtr SFontPool::_CreateFont(const FontInfo &fontInfo)
 {
     LOGFONT lfNew = { 0 };
@@ -140,6 +162,7 @@ const FontInfo &SFontPool::_GetDefFontInfo() const
 void SFontPool::_SetDefFontInfo(const FontInfo &fontInfo)
 {
     m_defFontInfo = fontInfo;
+    _ClearFontCache();
     RemoveAll();
     SHostMgr::getSingletonPtr()->DispatchMessage(UM_UPDATEFONT);
 }
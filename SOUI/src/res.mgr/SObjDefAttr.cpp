@@ -10,6 +10,10 @@ BOOL SObjDefAttr::Init(SXmlNode xmlNode)
         return FALSE;
     // clear old data
     RemoveAll();
+    {
+        SAutoWriteLock lock(&m_lockAttrTable);
+        m_mapAttrTable.RemoveAll();
+    }
     m_xmlRoot.root().RemoveAllChilden();
 
     m_xmlRoot.root().append_copy(xmlNode);
@@ -72,4 +76,101 @@ SXmlNode SObjDefAttr::GetDefAttribute(LPCWSTR pszClassName)
     }
 }
 
+const SObjDefAttr::ClassAttrTable &SObjDefAttr::GetClassAttrTable(LPCWSTR pszClassName)
+{
+    SAtom atomClass = SAtom::Find(pszClassName);
+    if (!atomClass.IsNull())
+    {
+        SAutoReadLock lock(&m_lockAttrTable);
+        const SMap<SAtom, ClassAttrTable>::CPair *p = m_mapAttrTable.Lookup(atomClass);
+        if (p)
+            return p->m_value;
+    }
+    else
+    {
+        atomClass = SAtom(pszClassName);
+    }
+
+    //第一次创建该类的窗口时把继承来的默认属性展开成表，之后创建直接使用。
+    //表在写锁内建好才对读者可见；SMap的节点不会移动，返回的引用在下次Init之前一直有效
+    SAutoWriteLock lock(&m_lockAttrTable);
+    const SMap<SAtom, ClassAttrTable>::CPair *p = m_mapAttrTable.Lookup(atomClass);
+    if (p)
+        return p->m_value; //其它线程已经建好
+    ClassAttrTable &table = m_mapAttrTable[atomClass];
+    SXmlNode xmlAttrs = GetDefAttribute(pszClassName);
+    SXmlAttr attrClass = xmlAttrs.attribute(L"class");
+    if (attrClass)
+    {
+        AttrItem item = { attrClass.name(), attrClass.value() };
+        table.arrAttr.Add(item);
+    }
+    for (SXmlAttr attr = xmlAttrs.first_attribute(); attr; attr = attr.next_attribute())
+    {
+        if (wcscmp(attr.name(), L"class") == 0)
+            continue;
+        AttrItem item = { attr.name(), attr.value() };
+        table.arrAttr.Add(item);
+    }
+
+    //按名字排序的索引，属性不多，插入排序即可
+    for (int i = 0; i < (int)table.arrAttr.GetCount(); i++)
+    {
+        int j = i;
+        table.arrSorted.Add(i);
+        while (j > 0 && table.arrAttr[table.arrSorted[j - 1]].strName.CompareNoCase(table.arrAttr[i].strName) > 0)
+        {
+            table.arrSorted[j] = table.arrSorted[j - 1];
+            j--;
+        }
+        table.arrSorted[j] = i;
+    }
+    return table;
+}
+
+void SObjDefAttr::ApplyDefAttribute(IObject *pObject, SXmlNode xmlInit)
+{
+    const ClassAttrTable &table = GetClassAttrTable(pObject->GetObjectClass());
+    int nCount = (int)table.arrAttr.GetCount();
+    if (nCount == 0)
+        return;
+
+    //和xml中显式给出的属性合并：被xml覆盖的默认值不再应用，省掉一次属性分发。
+    //class和layout会影响其它属性，保持原来的先后顺序，不参与合并。
+    bool bSkip[64] = { false };
+    if (xmlInit && nCount <= (int)ARRAYSIZE(bSkip))
+    {
+        for (SXmlAttr attr = xmlInit.first_attribute(); attr; attr = attr.next_attribute())
+        {
+            LPCWSTR pszName = attr.name();
+            if (_wcsicmp(pszName, L"class") == 0 || _wcsicmp(pszName, L"layout") == 0)
+                continue;
+            int nLow = 0, nHigh = nCount - 1;
+            while (nLow <= nHigh)
+            {
+                int nMid = (nLow + nHigh) / 2;
+                int nIdx = table.arrSorted[nMid];
+                int nCmp = table.arrAttr[nIdx].strName.CompareNoCase(pszName);
+                if (nCmp == 0)
+                {
+                    bSkip[nIdx] = true;
+                    break;
+                }
+                if (nCmp < 0)
+                    nLow = nMid + 1;
+                else
+                    nHigh = nMid - 1;
+            }
+        }
+    }
+
+    for (int i = 0; i < nCount; i++)
+    {
+        if (i < (int)ARRAYSIZE(bSkip) && bSkip[i])
+            continue;
+        const AttrItem &item = table.arrAttr[i];
+        pObject->ISetAttribute(&item.strName, &item.strValue, TRUE);
+    }
+}
+
 SNSEND
@@ -3,9 +3,389 @@
 #include "core/SSkin.h"
 #include "SApp.h"
 #include "helper/SDpiScale.h"
+#include "helper/SFunctor.hpp"
+#include <helper/SCriticalSection.h>
 
 SNSBEGIN
 
+// 皮肤池内容变化后作废SUiDef中缓存的皮肤查询结果
+static void InvalidateSkinResolveCache()
+{
+    SApplication *pApp = SApplication::getSingletonPtr();
+    if (!pApp)
+        return;
+    SUiDef *pUiDef = (SUiDef *)pApp->GetInnerSingleton(SUiDef::GetType());
+    if (pUiDef)
+        pUiDef->InvalidateResolveCache();
+}
+
+// 内置缩放比例在SDpiScale::GetBuiltinScales()中的位标志，非内置比例返回0
+static UINT ScaleBit(int nScale)
+{
+    for (int i = 0; i < SDpiScale::GetBuiltinScaleCount(); i++)
+    {
+        if (SDpiScale::GetBuiltinScales()[i] == nScale)
+            return 1u << i;
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SScaledSkinCache
+// 所有皮肤池共享的缩放皮肤缓存，以皮肤池+皮肤名+比例为键。
+// GetSkin交出去的皮肤会被调用者以裸指针长期持有，交出后固定下来，和池中的皮肤一样随皮肤池删除。
+// 只有预缩放出来、还没有被用过的皮肤按估算的位图字节数做LRU淘汰。
+// 预缩放的键先登记为pending，结果只在键仍然pending时入缓存，皮肤池删除皮肤时一并作废。
+
+struct ScaledSkinKey
+{
+    const SSkinPool *pPool;
+    SkinKey key;
+
+    ScaledSkinKey()
+        : pPool(NULL)
+    {
+    }
+
+    ScaledSkinKey(const SSkinPool *pPool_, const SkinKey &key_)
+        : pPool(pPool_)
+        , key(key_)
+    {
+    }
+};
+
+template <>
+class CElementTraits<ScaledSkinKey> : public CElementTraitsBase<ScaledSkinKey> {
+  public:
+    static ULONG Hash(INARGTYPE element)
+    {
+        return (ULONG)((ULONG_PTR)element.pPool >> 4) * 31 + CElementTraits<SkinKey>::Hash(element.key);
+    }
+
+    static bool CompareElements(INARGTYPE element1, INARGTYPE element2)
+    {
+        return element1.pPool == element2.pPool && CElementTraits<SkinKey>::CompareElements(element1.key, element2.key);
+    }
+
+    static int CompareElementsOrdered(INARGTYPE element1, INARGTYPE element2)
+    {
+        if (element1.pPool != element2.pPool)
+            return element1.pPool < element2.pPool ? -1 : 1;
+        return CElementTraits<SkinKey>::CompareElementsOrdered(element1.key, element2.key);
+    }
+};
+
+class SScaledSkinCache {
+    enum
+    {
+        KMinSkinBytes = 256,               // 没有位图的皮肤按固定开销计算
+        KDefBudget = 64 * 1024 * 1024,     // 默认预算64M
+    };
+
+    struct CacheItem
+    {
+        ScaledSkinKey key;
+        ISkinObj *pSkin;
+        size_t cbSize;
+
+        CacheItem(const ScaledSkinKey &key_, ISkinObj *pSkin_, size_t cbSize_)
+            : key(key_)
+            , pSkin(pSkin_)
+            , cbSize(cbSize_)
+        {
+        }
+    };
+
+  public:
+    SScaledSkinCache()
+        : m_cbBudget(KDefBudget)
+        , m_cbUsed(0)
+    {
+    }
+
+    ~SScaledSkinCache()
+    {
+        SPOSITION pos = m_lstItem.GetHeadPosition();
+        while (pos)
+        {
+            m_lstItem.GetNext(pos).pSkin->Release();
+        }
+        pos = m_mapPinned.GetStartPosition();
+        while (pos)
+        {
+            m_mapPinned.GetNextValue(pos)->Release();
+        }
+    }
+
+    void SetBudget(size_t cbBudget)
+    {
+        SList<ISkinObj *> lstEvicted;
+        {
+            SAutoLock lock(m_cs);
+            m_cbBudget = cbBudget;
+            _Evict(0, lstEvicted);
+        }
+        _ReleaseEvicted(lstEvicted);
+    }
+
+    //预算内可淘汰的字节数，不含已经交给调用者的皮肤
+    size_t GetUsed()
+    {
+        SAutoLock lock(m_cs);
+        return m_cbUsed;
+    }
+
+    //查询缓存。皮肤交给调用者后固定下来，不再参与淘汰：ATTR_SKIN等调用者只保存裸指针
+    ISkinObj *Lookup(const ScaledSkinKey &key)
+    {
+        SAutoLock lock(m_cs);
+        return _Lookup(key);
+    }
+
+    //调用者自己缩放得到的皮肤，直接固定。返回缓存中的皮肤
+    ISkinObj *Insert(const ScaledSkinKey &key, ISkinObj *pSkin)
+    {
+        ISkinObj *pRet = NULL;
+        {
+            SAutoLock lock(m_cs);
+            pRet = _Lookup(key);
+            if (!pRet)
+            {
+                m_mapPending.RemoveKey(key);
+                m_mapPinned[key] = pSkin;
+                pRet = pSkin;
+            }
+        }
+        if (pRet != pSkin)
+            pSkin->Release();
+        return pRet;
+    }
+
+    BOOL AddPending(const ScaledSkinKey &key)
+    {
+        SAutoLock lock(m_cs);
+        if (m_mapPinned.Lookup(key) || m_mapItem.Lookup(key) || m_mapPending.Lookup(key))
+            return FALSE;
+        m_mapPending[key] = true;
+        return TRUE;
+    }
+
+    BOOL IsPending(const ScaledSkinKey &key)
+    {
+        SAutoLock lock(m_cs);
+        return m_mapPending.Lookup(key) != NULL;
+    }
+
+    //预缩放完成，键仍然pending时入缓存，需要时淘汰最久未用的预缩放皮肤。单个皮肤超出预算时丢弃
+    void EndPending(const ScaledSkinKey &key, ISkinObj *pSkin)
+    {
+        SList<ISkinObj *> lstEvicted;
+        BOOL bKeep = FALSE;
+        {
+            SAutoLock lock(m_cs);
+            size_t cbSize = EstimateSize(pSkin);
+            if (m_mapPending.RemoveKey(key) && cbSize <= m_cbBudget)
+            {
+                _Evict(cbSize, lstEvicted);
+                SPOSITION pos = m_lstItem.AddHead(CacheItem(key, pSkin, cbSize));
+                m_mapItem[key] = pos;
+                m_cbUsed += cbSize;
+                bKeep = TRUE;
+            }
+        }
+        if (!bKeep)
+            pSkin->Release();
+        _ReleaseEvicted(lstEvicted);
+    }
+
+    //删除皮肤池中指定名字的缩放皮肤，name为空时删除皮肤池的全部缩放皮肤
+    void Remove(const SSkinPool *pPool, const SAtom &name)
+    {
+        SList<ISkinObj *> lstRemoved;
+        {
+            SAutoLock lock(m_cs);
+            SPOSITION pos = m_lstItem.GetHeadPosition();
+            while (pos)
+            {
+                SPOSITION posCur = pos;
+                const CacheItem &item = m_lstItem.GetNext(pos);
+                if (IsMatch(item.key, pPool, name))
+                {
+                    lstRemoved.AddTail(item.pSkin);
+                    m_cbUsed -= item.cbSize;
+                    m_mapItem.RemoveKey(item.key);
+                    m_lstItem.RemoveAt(posCur);
+                }
+            }
+            pos = m_mapPinned.GetStartPosition();
+            while (pos)
+            {
+                SPOSITION posCur = pos;
+                const SMap<ScaledSkinKey, ISkinObj *>::CPair *p = m_mapPinned.GetNext(pos);
+                if (IsMatch(p->m_key, pPool, name))
+                {
+                    lstRemoved.AddTail(p->m_value);
+                    m_mapPinned.RemoveAtPos(posCur);
+                }
+            }
+            pos = m_mapPending.GetStartPosition();
+            while (pos)
+            {
+                SPOSITION posCur = pos;
+                const ScaledSkinKey &key = m_mapPending.GetNextKey(pos);
+                if (IsMatch(key, pPool, name))
+                    m_mapPending.RemoveAtPos(posCur);
+            }
+        }
+        _ReleaseEvicted(lstRemoved);
+    }
+
+    static size_t EstimateSize(ISkinObj *pSkin)
+    {
+        SSkinImgList *pImgList = sobj_cast<SSkinImgList>(pSkin);
+        IBitmapS *pImg = pImgList ? pImgList->GetImage() : NULL;
+        if (!pImg)
+            return KMinSkinBytes;
+        return (size_t)pImg->Width() * pImg->Height() * 4;
+    }
+
+  protected:
+    //命中预缩放的皮肤时把它移出LRU链表固定下来
+    ISkinObj *_Lookup(const ScaledSkinKey &key)
+    {
+        ISkinObj *pSkin = NULL;
+        if (m_mapPinned.Lookup(key, pSkin))
+            return pSkin;
+        const SMap<ScaledSkinKey, SPOSITION>::CPair *p = m_mapItem.Lookup(key);
+        if (!p)
+            return NULL;
+        const CacheItem &item = m_lstItem.GetAt(p->m_value);
+        pSkin = item.pSkin;
+        m_cbUsed -= item.cbSize;
+        m_lstItem.RemoveAt(p->m_value);
+        m_mapItem.RemoveKey(key);
+        m_mapPinned[key] = pSkin;
+        return pSkin;
+    }
+
+    static BOOL IsMatch(const ScaledSkinKey &key, const SSkinPool *pPool, const SAtom &name)
+    {
+        return key.pPool == pPool && (name.IsNull() || key.key.name == name);
+    }
+
+    //淘汰LRU链表尾部的皮肤，直到能容纳cbNeed字节。链表里只有还没有交给调用者的预缩放皮肤
+    void _Evict(size_t cbNeed, SList<ISkinObj *> &lstEvicted)
+    {
+        while (m_cbUsed + cbNeed > m_cbBudget && !m_lstItem.IsEmpty())
+        {
+            const CacheItem &item = m_lstItem.GetTail();
+            lstEvicted.AddTail(item.pSkin);
+            m_cbUsed -= item.cbSize;
+            m_mapItem.RemoveKey(item.key);
+            m_lstItem.RemoveTailNoReturn();
+        }
+    }
+
+    static void _ReleaseEvicted(const SList<ISkinObj *> &lstEvicted)
+    {
+        SPOSITION pos = lstEvicted.GetHeadPosition();
+        while (pos)
+        {
+            lstEvicted.GetNext(pos)->Release();
+        }
+    }
+
+    SCriticalSection m_cs;
+    SList<CacheItem> m_lstItem;                   // 预缩放还没有用过的皮肤，最近缩放的在头部
+    SMap<ScaledSkinKey, SPOSITION> m_mapItem;     // 键到m_lstItem中位置的索引
+    SMap<ScaledSkinKey, ISkinObj *> m_mapPinned;  // 已经交给调用者的皮肤，随皮肤池删除
+    SMap<ScaledSkinKey, bool> m_mapPending;       // 已经提交预缩放但还没有完成的键
+    size_t m_cbBudget;
+    size_t m_cbUsed;
+};
+
+static SScaledSkinCache s_scaledSkinCache;
+
+//////////////////////////////////////////////////////////////////////////
+// SSkinPrefetchTask
+// 一次PrefetchScale提交的全部缩放任务。在UI线程的消息循环里每次缩放一个皮肤：
+// 缩放要读取源皮肤的图片，而OnColorize会原地修改它，两者都留在UI线程上。
+
+class SSkinPrefetchTask : public TObjRefImpl<IObjRef> {
+  public:
+    struct ScaleItem
+    {
+        SkinKey key;
+        SAutoRefPtr<ISkinObj> pSrc;
+    };
+
+    SSkinPrefetchTask(const SSkinPool *pPool)
+        : m_pPool(pPool)
+    {
+    }
+
+    void Add(const SkinKey &key, ISkinObj *pSrc)
+    {
+        ScaleItem item;
+        item.key = key;
+        item.pSrc = pSrc;
+        m_lstItem.AddTail(item);
+    }
+
+    int GetCount() const
+    {
+        return (int)m_lstItem.GetCount();
+    }
+
+    //缩放下一个皮肤，返回是否还有剩余
+    BOOL RunOne()
+    {
+        while (!m_lstItem.IsEmpty())
+        {
+            ScaleItem item = m_lstItem.RemoveHead();
+            ScaledSkinKey key(m_pPool, item.key);
+            //UI线程已经自己缩放或者皮肤池已经删除了这个皮肤
+            if (!s_scaledSkinCache.IsPending(key))
+                continue;
+            ISkinObj *pSkin = item.pSrc->Scale(item.key.scale);
+            if (pSkin)
+                s_scaledSkinCache.EndPending(key, pSkin);
+            break;
+        }
+        return !m_lstItem.IsEmpty();
+    }
+
+  protected:
+    const SSkinPool *m_pPool; // 只作为缓存键使用，不访问皮肤池
+    SList<ScaleItem> m_lstItem;
+};
+
+class SSkinPrefetchRunnable : public SRunnable {
+    IMPL_GETCLASSINFO
+  public:
+    SSkinPrefetchRunnable(SSkinPrefetchTask *pTask, IMessageLoop *pMsgLoop)
+        : m_task(pTask)
+        , m_msgLoop(pMsgLoop)
+    {
+    }
+
+    STDMETHOD_(IRunnable *, clone)(THIS) SCONST OVERRIDE
+    {
+        return new SSkinPrefetchRunnable(m_task, m_msgLoop);
+    }
+
+    STDMETHOD_(void, run)(THIS) OVERRIDE
+    {
+        //一次只缩放一个皮肤，剩下的重新排队，期间的输入消息可以及时处理
+        if (m_task->RunOne())
+            m_msgLoop->PostTask(this);
+    }
+
+  protected:
+    SAutoRefPtr<SSkinPrefetchTask> m_task;
+    SAutoRefPtr<IMessageLoop> m_msgLoop;
+};
+
 //////////////////////////////////////////////////////////////////////////
 // SSkinPool
 
@@ -17,6 +397,7 @@ SSkinPool::SSkinPool(BOOL bAutoScale)
 
 SSkinPool::~SSkinPool()
 {
+    s_scaledSkinCache.Remove(this, SAtom());
 #ifdef _DEBUG
     //查询哪些皮肤运行过程中没有使用过,将结果用输出到Output
     SSLOGD() << "####Detecting Defined Skin Usage BEGIN";
@@ -26,7 +407,7 @@ SSkinPool::~SSkinPool()
         SkinKey skinKey = m_mapNamedObj->GetNextKey(pos);
         if (!m_mapSkinUseCount.Lookup(skinKey))
         {
-            SSLOGD() << "skin of [" << skinKey.strName.c_str() << "." << skinKey.scale << "] was not used.";
+            SSLOGD() << "skin of [" << skinKey.name.GetName() << "." << skinKey.scale << "] was not used.";
         }
     }
     SSLOGD() << "!!!!Detecting Defined Skin Usage END";
@@ -51,14 +432,14 @@ ISkinObj *SSkinPool::_LoadSkin(SXmlNode xmlSkin, int nScale)
         {
             pSkin->SetScale(nScale);
         }
-        SkinKey key = { strSkinName, pSkin->GetScale() };
+        SkinKey key(SAtom(strSkinName), pSkin->GetScale());
         if (HasKey(key))
         {
             SSLOGW() << "load skin duplicated found,type=" << strTypeName << "name=" << strSkinName;
             pSkin->Release();
             return NULL;
         }
-        AddKeyObject(key, pSkin);
+        _AddSkin(key, pSkin);
     }
     else
     {
@@ -100,86 +481,156 @@ int SSkinPool::LoadSkins(IXmlNode *xmlNode)
     GETUIDEF->PushSkinPool(this);
     int nLoaded = _LoadSkins(SXmlNode(xmlNode));
     GETUIDEF->PopSkinPool(this);
+    if (nLoaded)
+        InvalidateSkinResolveCache();
     return nLoaded;
 }
 
 BOOL SSkinPool::AddSkin(ISkinObj *pSkin)
 {
-    SkinKey key = { pSkin->GetName(), pSkin->GetScale() };
+    SkinKey key(SAtom(pSkin->GetName()), pSkin->GetScale());
     if (HasKey(key))
         return FALSE;
-    AddKeyObject(key, pSkin);
+    _AddSkin(key, pSkin);
     pSkin->AddRef();
+    InvalidateSkinResolveCache();
     return TRUE;
 }
 
+void SSkinPool::_AddSkin(const SkinKey &key, ISkinObj *pSkin)
+{
+    AddKeyObject(key, pSkin);
+    if (UINT uBit = ScaleBit(key.scale))
+        m_mapScaleMask[key.name] |= uBit;
+}
+
 BOOL SSkinPool::RemoveSkin(THIS_ ISkinObj *pSkin)
 {
-    SkinKey key = { pSkin->GetName(), pSkin->GetScale() };
-    return !!RemoveKeyObject(key);
+    SkinKey key(SAtom::Find(pSkin->GetName()), pSkin->GetScale());
+    if (!RemoveKeyObject(key))
+        return FALSE;
+    SMap<SAtom, UINT>::CPair *p = m_mapScaleMask.Lookup(key.name);
+    if (p)
+        p->m_value &= ~ScaleBit(key.scale);
+    //由这个名字缩放得到的皮肤可能来自被删除的源皮肤
+    s_scaledSkinCache.Remove(this, key.name);
+    InvalidateSkinResolveCache();
+    return TRUE;
 }
 
 ISkinObj *SSkinPool::GetSkin(LPCWSTR strSkinName, int nScale)
 {
-    SkinKey key = { strSkinName, nScale };
+    //皮肤加入池时名字都已经入了原子表，查不到原子说明没有这个皮肤
+    SkinKey key(SAtom::Find(strSkinName), nScale);
+    if (key.name.IsNull())
+        return NULL;
 
-    if (!HasKey(key))
+    ISkinObj *pRet = NULL;
+    if (!GetKeyObject(key, pRet))
     {
         if (!m_bAutoScale)
             return NULL;
 
-        nScale = SDpiScale::NormalizeScale(nScale);
-        key.scale = nScale;
-        if (!HasKey(key))
+        key.scale = SDpiScale::NormalizeScale(nScale);
+        if (!GetKeyObject(key, pRet))
         {
-            const int kMaxBuiltinScales = 20;
-            SASSERT(SDpiScale::GetBuiltinScaleCount() <= kMaxBuiltinScales);
-            int nScales[kMaxBuiltinScales] = { 0 };
-            int findScales = 0;
-            int bestScale = 0;
-            for (int i = SDpiScale::GetBuiltinScaleCount() - 1; i >= 0; i--)
-            {
-                key.scale = SDpiScale::GetBuiltinScales()[i];
-                if (HasKey(key))
-                {
-                    nScales[findScales++] = key.scale;
-                    if (nScale > key.scale)
-                    {
-                        if (nScale % key.scale == 0)
-                        {
-                            bestScale = key.scale;
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        if (key.scale % nScale == 0)
-                        {
-                            bestScale = key.scale;
-                            break;
-                        }
-                    }
-                }
-            }
-            if (findScales == 0)
+            pRet = _GetScaledSkin(key);
+            if (!pRet)
                 return NULL;
-            if (bestScale == 0)
-                bestScale = nScales[0];
-            key.scale = bestScale;
-            ISkinObj *pSkinSrc = GetKeyObject(key);
-            SASSERT(pSkinSrc);
-            ISkinObj *pSkin = pSkinSrc->Scale(nScale);
-            if (pSkin)
-            {
-                key.scale = nScale;
-                AddKeyObject(key, pSkin);
-            }
         }
     }
+    if (UINT uBit = ScaleBit(key.scale))
+        m_mapUsedScales[key.name] |= uBit;
 #ifdef _DEBUG
     m_mapSkinUseCount[key]++;
 #endif
-    return GetKeyObject(key);
+    return pRet;
+}
+
+ISkinObj *SSkinPool::_FindScaleSource(const SAtom &name, int nScale) const
+{
+    const SMap<SAtom, UINT>::CPair *p = m_mapScaleMask.Lookup(name);
+    if (!p || !p->m_value)
+        return NULL;
+    //优先选择和目标比例成整数倍关系的比例，否则选择最大的比例
+    int bestScale = 0;
+    for (int i = SDpiScale::GetBuiltinScaleCount() - 1; i >= 0; i--)
+    {
+        if (!(p->m_value & (1u << i)))
+            continue;
+        int scale = SDpiScale::GetBuiltinScales()[i];
+        if (bestScale == 0)
+            bestScale = scale;
+        if (nScale > scale ? (nScale % scale == 0) : (scale % nScale == 0))
+        {
+            bestScale = scale;
+            break;
+        }
+    }
+    ISkinObj *pSrc = NULL;
+    GetKeyObject(SkinKey(name, bestScale), pSrc);
+    return pSrc;
+}
+
+ISkinObj *SSkinPool::_GetScaledSkin(const SkinKey &key)
+{
+    ScaledSkinKey cacheKey(this, key);
+    ISkinObj *pSkin = s_scaledSkinCache.Lookup(cacheKey);
+    if (pSkin)
+        return pSkin;
+    ISkinObj *pSrc = _FindScaleSource(key.name, key.scale);
+    if (!pSrc)
+        return NULL;
+    //后台预缩放还没有处理到这个皮肤时直接在当前线程缩放，Insert同时取消pending的后台任务
+    pSkin = pSrc->Scale(key.scale);
+    if (!pSkin)
+        return pSrc;
+    return s_scaledSkinCache.Insert(cacheKey, pSkin);
+}
+
+int SSkinPool::PrefetchScale(int nFromScale, int nToScale)
+{
+    if (!m_bAutoScale)
+        return 0;
+    IMessageLoop *pMsgLoop = SApplication::getSingleton().GetMsgLoop();
+    if (!pMsgLoop)
+        return 0;
+    UINT uFromBit = ScaleBit(SDpiScale::NormalizeScale(nFromScale));
+    nToScale = SDpiScale::NormalizeScale(nToScale);
+    if (!uFromBit || ScaleBit(nToScale) == uFromBit)
+        return 0;
+
+    SAutoRefPtr<SSkinPrefetchTask> task(new SSkinPrefetchTask(this), FALSE);
+    SPOSITION pos = m_mapUsedScales.GetStartPosition();
+    while (pos)
+    {
+        const SMap<SAtom, UINT>::CPair *p = m_mapUsedScales.GetNext(pos);
+        if (!(p->m_value & uFromBit))
+            continue;
+        SkinKey key(p->m_key, nToScale);
+        if (HasKey(key))
+            continue;
+        ISkinObj *pSrc = _FindScaleSource(key.name, nToScale);
+        if (!pSrc || !s_scaledSkinCache.AddPending(ScaledSkinKey(this, key)))
+            continue;
+        task->Add(key, pSrc);
+    }
+    if (task->GetCount() == 0)
+        return 0;
+    int nRet = task->GetCount();
+    SSkinPrefetchRunnable runnable(task, pMsgLoop);
+    pMsgLoop->PostTask(&runnable);
+    return nRet;
+}
+
+void SSkinPool::SetScaledSkinBudget(size_t cbBudget)
+{
+    s_scaledSkinCache.SetBudget(cbBudget);
+}
+
+size_t SSkinPool::GetScaledSkinCacheSize()
+{
+    return s_scaledSkinCache.GetUsed();
 }
 
 void SSkinPool::OnKeyRemoved(const SSkinPtr &obj)
@@ -190,6 +641,9 @@ void SSkinPool::OnKeyRemoved(const SSkinPtr &obj)
 void SSkinPool::RemoveAll(THIS)
 {
     SCmnMap<SSkinPtr, SkinKey>::RemoveAll();
+    m_mapScaleMask.RemoveAll();
+    s_scaledSkinCache.Remove(this, SAtom());
+    InvalidateSkinResolveCache();
 }
 
 SNSEND
\ No newline at end of file
@@ -33,6 +33,7 @@ BOOL SStylePool::Init(SXmlNode xmlStyleRoot)
             xmlChild.remove_attribute(L"name"); //删除name属性，防止该属性被处理
         }
         SASSERT(!xmlChild.attribute(L"name"));
+        SAtom(strClsName, strClsName.GetLength()); //样式名入原子表，SUiDef::GetStyle查找时只做Find
         AddKeyObject(strClsName, xmlChild);
     }
 
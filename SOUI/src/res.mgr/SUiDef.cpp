@@ -340,6 +340,7 @@ SGradientPool *SUiDefInfo::GetGradientPool()
 //////////////////////////////////////////////////////////////////////////
 SUiDef::SUiDef(IRenderFactory *fac)
     : SFontPool(fac)
+    , m_nGeneration(0)
 {
     SAutoLock autolock(m_cs);
     IUiDefInfo *emptyUiInfo = CreateUiDefInfo();
@@ -374,6 +375,7 @@ SUiDef::~SUiDef(void)
         m_lstSkinPools.RemoveAll();
         m_bulitinSkinPool = NULL;
     }
+    InvalidateResolveCache();
 }
 
 BOOL SUiDef::InitDefUiDef(IResProvider *pResProvider, LPCTSTR pszUiDef)
@@ -411,6 +413,8 @@ void SUiDef::SetUiDef(IUiDefInfo *pUiDefInfo, bool bUpdateDefFont)
     // add to uidef list.
     m_lstUiDefInfo.AddHead(pUiDefInfo);
     pUiDefInfo->AddRef();
+    _ClearFontCache(); // named fonts changed
+    InvalidateResolveCache();
 
     SetDefFontInfo(m_defUiDefInfo->GetDefFontInfo());
 }
@@ -420,6 +424,8 @@ void SUiDef::PushUiDefInfo(IUiDefInfo *pUiDefInfo, BOOL bPreivate)
     SAutoLock autolock(m_cs);
     m_lstUiDefInfo.AddTail(pUiDefInfo);
     pUiDefInfo->AddRef();
+    _ClearFontCache();
+    InvalidateResolveCache();
     if (bPreivate)
         m_cs.Enter();
 }
@@ -435,6 +441,8 @@ BOOL SUiDef::PopUiDefInfo(IUiDefInfo *pUiDefInfo, BOOL bPreivate)
             return FALSE;
         pUiDefInfo = m_lstUiDefInfo.RemoveTail();
         pUiDefInfo->Release();
+        _ClearFontCache();
+        InvalidateResolveCache();
         return TRUE;
     }
     else
@@ -444,6 +452,8 @@ BOOL SUiDef::PopUiDefInfo(IUiDefInfo *pUiDefInfo, BOOL bPreivate)
             return FALSE;
         m_lstUiDefInfo.RemoveAt(pos);
         pUiDefInfo->Release();
+        _ClearFontCache();
+        InvalidateResolveCache();
         return TRUE;
     }
 }
@@ -455,6 +465,7 @@ void SUiDef::PushSkinPool(ISkinPool *pSkinPool)
         return;
     m_lstSkinPools.AddTail(pSkinPool);
     pSkinPool->AddRef();
+    InvalidateResolveCache();
 }
 
 BOOL SUiDef::PopSkinPool(ISkinPool *pSkinPool)
@@ -468,12 +479,61 @@ BOOL SUiDef::PopSkinPool(ISkinPool *pSkinPool)
 
     m_lstSkinPools.RemoveAt(pos);
     pSkinPool->Release();
+    InvalidateResolveCache();
     return TRUE;
 }
 
+void SUiDef::InvalidateResolveCache()
+{
+    SAutoWriteLock lock(&m_lockResolve);
+    InterlockedIncrement(&m_nGeneration);
+    m_mapResolvedSkin.RemoveAll();
+    m_mapResolvedBuiltinSkin.RemoveAll();
+    m_mapResolvedStyle.RemoveAll();
+}
+
+int SUiDef::PrefetchSkins(int nFromScale, int nToScale)
+{
+    SAutoLock autolock(m_cs);
+    int nRet = static_cast<SSkinPool *>((ISkinPool *)m_bulitinSkinPool)->PrefetchScale(nFromScale, nToScale);
+    SPOSITION pos = m_lstUiDefInfo.GetHeadPosition();
+    while (pos)
+    {
+        IUiDefInfo *pUiInfo = m_lstUiDefInfo.GetNext(pos);
+        SSkinPool *pSkinPool = pUiInfo->GetSkinPool();
+        if (pSkinPool)
+            nRet += pSkinPool->PrefetchScale(nFromScale, nToScale);
+    }
+    return nRet;
+}
+
 ISkinObj *SUiDef::GetSkin(const SStringW &strSkinName, int nScale)
 {
+    //查找不入原子表：名字没有原子时不走缓存，也不缓存结果
+    SkinKey key(SAtom::Find(strSkinName), nScale);
+    if (key.name.IsNull())
+    {
+        SAutoLock autolock(m_cs);
+        return _GetSkin(strSkinName, nScale);
+    }
+    {
+        SAutoReadLock lock(&m_lockResolve);
+        const SMap<SkinKey, SAutoRefPtr<ISkinObj> >::CPair *p = m_mapResolvedSkin.Lookup(key);
+        if (p)
+            return p->m_value;
+    }
+
     SAutoLock autolock(m_cs);
+    LONG nGeneration = m_nGeneration;
+    ISkinObj *pRet = _GetSkin(strSkinName, nScale);
+    SAutoWriteLock lock(&m_lockResolve);
+    if (nGeneration == m_nGeneration)
+        m_mapResolvedSkin[key] = pRet;
+    return pRet;
+}
+
+ISkinObj *SUiDef::_GetSkin(const SStringW &strSkinName, int nScale)
+{
     {
         SPOSITION pos = m_lstSkinPools.GetTailPosition();
         while (pos)
@@ -513,8 +573,26 @@ static const wchar_t *BUILDIN_SKIN_NAMES[] = {
 
 ISkinObj *SUiDef::GetBuiltinSkin(SYS_SKIN uID, int nScale)
 {
+    SkinKey key(SAtom::Find(BUILDIN_SKIN_NAMES[uID]), nScale);
+    if (key.name.IsNull())
+    {
+        SAutoLock autolock(m_cs);
+        return GetBuiltinSkinPool()->GetSkin(BUILDIN_SKIN_NAMES[uID], nScale);
+    }
+    {
+        SAutoReadLock lock(&m_lockResolve);
+        const SMap<SkinKey, SAutoRefPtr<ISkinObj> >::CPair *p = m_mapResolvedBuiltinSkin.Lookup(key);
+        if (p)
+            return p->m_value;
+    }
+
     SAutoLock autolock(m_cs);
-    return GetBuiltinSkinPool()->GetSkin(BUILDIN_SKIN_NAMES[uID], nScale);
+    LONG nGeneration = m_nGeneration;
+    ISkinObj *pRet = GetBuiltinSkinPool()->GetSkin(BUILDIN_SKIN_NAMES[uID], nScale);
+    SAutoWriteLock lock(&m_lockResolve);
+    if (nGeneration == m_nGeneration)
+        m_mapResolvedBuiltinSkin[key] = pRet;
+    return pRet;
 }
 
 ISkinPool *SUiDef::GetBuiltinSkinPool()
@@ -525,7 +603,30 @@ ISkinPool *SUiDef::GetBuiltinSkinPool()
 
 SXmlNode SUiDef::GetStyle(const SStringW &strName)
 {
+    SAtom name = SAtom::Find(strName);
+    if (name.IsNull())
+    {
+        SAutoLock autolock(m_cs);
+        return _GetStyle(strName);
+    }
+    {
+        SAutoReadLock lock(&m_lockResolve);
+        const SMap<SAtom, SXmlNode>::CPair *p = m_mapResolvedStyle.Lookup(name);
+        if (p)
+            return p->m_value;
+    }
+
     SAutoLock autolock(m_cs);
+    LONG nGeneration = m_nGeneration;
+    SXmlNode ret = _GetStyle(strName);
+    SAutoWriteLock lock(&m_lockResolve);
+    if (nGeneration == m_nGeneration)
+        m_mapResolvedStyle[name] = ret;
+    return ret;
+}
+
+SXmlNode SUiDef::_GetStyle(const SStringW &strName)
+{
     SPOSITION pos = m_lstUiDefInfo.GetTailPosition();
     while (pos)
     {
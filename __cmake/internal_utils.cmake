@@ -91,3 +91,17 @@ macro(config_compiler_and_linker)
         SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /Qspectre")
     endif()
 endmacro()
+
+#
+# 预编译uires目录: xml布局展开style后转换为flat二进制格式, 输出到out_dir
+#
+function(soui_compile_uires target src_dir out_dir)
+    file(GLOB_RECURSE UIRES_FILES ${src_dir}/*)
+    add_custom_command(
+        OUTPUT ${out_dir}/uires.idx
+        COMMAND xml2bin -i ${src_dir} -o ${out_dir}
+        DEPENDS xml2bin ${UIRES_FILES}
+        COMMENT "compiling uires ${src_dir}"
+    )
+    add_custom_target(${target} DEPENDS ${out_dir}/uires.idx)
+endfunction()
@@ -3,6 +3,7 @@
 #include <windows.h>
 #include "imgdecoder-stb.h"
 #include <string/strcpcvt.h>
+#include <helper/SPixelConv.h>
 #include <upng.h>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -13,16 +14,7 @@
 SNSBEGIN
     //////////////////////////////////////////////////////////////////////////
     //  SImgFrame_STB
-SImgFrame_STB::SImgFrame_STB(const BYTE *data, int w, int h, int nDelay)
-        :m_nWid(w),m_nHei(h)
-        ,m_nDelay(nDelay)
-    {
-        m_data = (unsigned char *)malloc(w * h * 4);
-        assert(m_data);
-        memcpy(m_data, data, w * h * 4);
-    }
-
-    SImgFrame_STB::SImgFrame_STB(BYTE *data, int w, int h, int nDelay)
+SImgFrame_STB::SImgFrame_STB(BYTE *data, int w, int h, int nDelay)
         : m_nWid(w)
         , m_nHei(h)
         , m_nDelay(nDelay)
@@ -79,7 +71,7 @@ SImgFrame_STB::SImgFrame_STB(const BYTE *data, int w, int h, int nDelay)
             {
                 m_arrFrames.SetCount(1);
                 BYTE *buf = upng_move_frame_buffer(upng);
-                _DoPromultiply(buf, width, height);
+                _DoPromultiply(buf, buf, width, height);
                 SImgFrame_STB *pFrame = new SImgFrame_STB(buf, width, height, 0);
                 m_arrFrames.SetAt(0, pFrame);
                 pFrame->Release();
@@ -92,10 +84,16 @@ SImgFrame_STB::SImgFrame_STB(const BYTE *data, int w, int h, int nDelay)
                     if(UPNG_EOK==upng_decode_next_frame(upng))
                     {
                         int nDelay = upng_get_frame_delay(upng);
-                        BYTE *buf = (BYTE*)upng_get_frame_buffer(upng);
-                        _DoPromultiply(buf, width, height);
                         // don't move frame buffer from upng. the frame buffer will be reused by upng.
-                        SImgFrame_STB *pFrame = new SImgFrame_STB((const BYTE*)buf, width, height, nDelay);
+                        const BYTE *src = upng_get_frame_buffer(upng);
+                        BYTE *buf = (BYTE *)malloc(width * height * 4);
+                        if (!buf)
+                        {
+                            m_arrFrames.RemoveAll();
+                            break;
+                        }
+                        _DoPromultiply(buf, src, width, height);
+                        SImgFrame_STB *pFrame = new SImgFrame_STB(buf, width, height, nDelay);
                         m_arrFrames.SetAt(i, pFrame);
                         pFrame->Release();
                     }
@@ -123,22 +121,44 @@ SImgFrame_STB::SImgFrame_STB(const BYTE *data, int w, int h, int nDelay)
                 return 0;
             }
             delays = (int *)malloc(sizeof(int));
+            if (!delays)
+            {
+                stbi_image_free(data);
+                return 0;
+            }
             *delays = 0;
             frames = 1;
         }
         SASSERT(data);
         m_arrFrames.SetCount(frames);
-        unsigned char *p = data;
-        for (int i = 0; i < frames; i++)
-        {
-            _DoPromultiply(p, width, height);
-            SImgFrame_STB *pFrame = new SImgFrame_STB((const BYTE*)p, width, height, delays[i]);
-            m_arrFrames.SetAt(i, pFrame);
-            p += (width * height * 4);
+        if (frames == 1)
+        { // convert in place and hand the decoded buffer to the frame.
+            _DoPromultiply(data, data, width, height);
+            SImgFrame_STB *pFrame = new SImgFrame_STB(data, width, height, delays[0]);
+            m_arrFrames.SetAt(0, pFrame);
             pFrame->Release();
         }
+        else
+        { // gif frames share one block, convert each frame straight into its own buffer.
+            const unsigned char *p = data;
+            for (int i = 0; i < frames; i++)
+            {
+                BYTE *buf = (BYTE *)malloc(width * height * 4);
+                if (!buf)
+                {
+                    m_arrFrames.RemoveAll();
+                    frames = 0;
+                    break;
+                }
+                _DoPromultiply(buf, p, width, height);
+                SImgFrame_STB *pFrame = new SImgFrame_STB(buf, width, height, delays[i]);
+                m_arrFrames.SetAt(i, pFrame);
+                p += (width * height * 4);
+                pFrame->Release();
+            }
+            stbi_image_free(data);
+        }
         free(delays);
-        stbi_image_free(data);
         return frames;
     }
 
@@ -203,33 +223,10 @@ SImgFrame_STB::SImgFrame_STB(const BYTE *data, int w, int h, int nDelay)
     {
     }
 
-    void SImgX_STB::_DoPromultiply( BYTE *pdata,int nWid,int nHei )
+    void SImgX_STB::_DoPromultiply(BYTE *pDst, const BYTE *pSrc, int nWid, int nHei)
     {
         //swap rgba to bgra and do premultiply
-        BYTE *p=pdata;
-        int pixel_count = nWid * nHei;
-        for (int i=0; i < pixel_count; ++i) {
-            stbi_uc a = p[3];
-            stbi_uc t = p[0];
-            if (a) 
-            {
-                if (m_bPremultiple)
-                {
-                    p[0] = (p[2] * a) / 255;
-                    p[1] = (p[1] * a) / 255;
-                    p[2] = (t * a) / 255;
-                }
-                else
-                {// swap r and b
-                    p[0] = p[2]; 
-                    p[2] = t; 
-                }
-            }else
-            {
-                memset(p,0,4);
-            }
-            p += 4;
-        }    
+        SPixelConv::RgbaToBgra(pDst, pSrc, (size_t)nWid * nHei, m_bPremultiple);
     }
 
 	IImgFrame * SImgX_STB::GetFrame(UINT iFrame)
@@ -14,7 +14,6 @@ SNSBEGIN
     class SImgFrame_STB : public TObjRefImpl<IImgFrame>
     {
     public:
-        SImgFrame_STB(const BYTE *data,int w,int h,int nDelay);
         SImgFrame_STB(BYTE *data, int w, int h, int nDelay);
         ~SImgFrame_STB();
 
@@ -41,7 +40,7 @@ SNSBEGIN
         SImgX_STB(BOOL bPremultiple);
         ~SImgX_STB(void);
         
-        void _DoPromultiply(BYTE *pdata,int nWid,int nHei);
+        void _DoPromultiply(BYTE *pDst, const BYTE *pSrc, int nWid, int nHei);
 
         BOOL m_bPremultiple;
         SArray<SAutoRefPtr<IImgFrame>> m_arrFrames;
@@ -559,6 +559,7 @@ public:
 	STDMETHOD_(HRESULT,SetXfermode)(THIS_ int mode,int *pOldMode=NULL) OVERRIDE;
 	STDMETHOD_(BOOL,SetAntiAlias)(THIS_ BOOL bAntiAlias) OVERRIDE;
 	STDMETHOD_(BOOL,GetAntiAlias)(THIS) SCONST OVERRIDE;
+	STDMETHOD_(BOOL,EnableRecording)(THIS_ BOOL bEnable) OVERRIDE{return FALSE;}
 
 protected:
 	HWND					   m_hWnd;
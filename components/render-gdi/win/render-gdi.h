@@ -384,6 +384,7 @@ public:
 	STDMETHOD_(HRESULT,SetXfermode)(THIS_ int mode,int *pOldMode=NULL) OVERRIDE;
 	STDMETHOD_(BOOL,SetAntiAlias)(THIS_ BOOL bAntiAlias) OVERRIDE;
 	STDMETHOD_(BOOL,GetAntiAlias)(THIS) SCONST OVERRIDE;
+	STDMETHOD_(BOOL,EnableRecording)(THIS_ BOOL bEnable) OVERRIDE{return FALSE;}
 protected:
 	HDC               m_hdc;
 	SColor            m_curColor;
@@ -1,5 +1,11 @@
 ﻿#include "drawtext-skia.h"
 #include <core/SkTypeface.h>
+#include <core/SkXfermode.h>
+#include <src/core/SkGlyphCache.h>
+#include <src/core/SkBlitMask.h>
+#include <src/core/SkDeviceProperties.h>
+#include <src/core/SkMaskGamma.h>
+#include <core/SkColorPriv.h>
 #include <string/tstring.h>
 #include <string/strcpcvt.h>
 
@@ -41,7 +47,7 @@ SkRect DrawText_Skia(SkCanvas* canvas,const wchar_t *text,int len,SkRect box, Sk
     SkTextLayoutEx layout;
     layout.init(text,len,box,paint,uFormat);
     
-    return layout.draw(canvas);
+    return layout.draw(canvas,box,paint,uFormat);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -74,19 +80,20 @@ void SkTextLayoutEx::init( const wchar_t text[], size_t length,SkRect rc,  SkPai
         m_text=tmp;
     }
 
-    m_paint=&paint;
     m_rcBound=rc;
     m_uFormat=uFormat;
-    buildLines();
+    paint.getFontMetrics(&m_metrics);
+    buildLines(paint);
+    measureLines(paint);
 }
 
-void SkTextLayoutEx::buildLines()
+void SkTextLayoutEx::buildLines(SkPaint &paint)
 {
     m_lines.reset();
 
     if(m_uFormat & DT_SINGLELINE)
     {
-		LineInfo info = { 0,m_text.count() };
+		LineInfo info = { 0,m_text.count(),0,-1 };
         m_lines.push(info);
     }else
     {
@@ -99,10 +106,10 @@ void SkTextLayoutEx::buildLines()
         while(lineHead<m_text.count())
         {
 			int endLen = 0;
-            int line_len = (int)breakTextEx(m_paint,text, stop - text, maxWid,endLen);
+            int line_len = (int)breakTextEx(&paint,text, stop - text, maxWid,endLen);
 			if (line_len + endLen == 0)
 				break;
-			LineInfo info = { lineHead,line_len };
+			LineInfo info = { lineHead,line_len,0,-1 };
 			m_lines.push(info);
 			text += line_len+endLen;
             lineHead += line_len+endLen;
@@ -110,166 +117,186 @@ void SkTextLayoutEx::buildLines()
     }
 }
 
-SkScalar SkTextLayoutEx::drawLine( SkCanvas *canvas, SkScalar x, SkScalar y, int iBegin,int iEnd )
+void SkTextLayoutEx::measureLines(SkPaint &paint)
 {
-    const wchar_t *text=m_text.begin()+iBegin;
+    m_fMaxWidth = 0;
+    if(m_uFormat & DT_SINGLELINE)
+    {
+        m_nVisibleLines = 1;
+        if(m_uFormat & DT_ELLIPSIS)
+            measureLineWithEllipsis(paint,m_lines[0]);
+        else
+            m_lines[0].fWidth = measureText(&paint,m_text.begin(),m_text.count());
+        m_fMaxWidth = m_lines[0].fWidth;
+        return;
+    }
 
-    if(!(m_uFormat & DT_CALCRECT))
+    //lines are laid out from the top of the rect, see draw.
+    float lineSpan = m_metrics.fBottom-m_metrics.fTop;
+    float y = -m_metrics.fTop;
+    int iLine = 0;
+    while(iLine<m_lines.count())
     {
-        drawText(canvas,text,(iEnd-iBegin),x,y,*m_paint);
-        int i=0;
-        while(i<m_prefix.count())
-        {
-            if(m_prefix[i]>=iBegin)
-                break;
-            i++;
-        }
-        
-        SkScalar xBase = x;
-        if(m_paint->getTextAlign() != SkPaint::kLeft_Align)
-        {
-            SkScalar nTextWidth = measureText(m_paint,text,(iEnd-iBegin));
-            switch(m_paint->getTextAlign())
-            {
-            case SkPaint::kCenter_Align:
-                xBase = x - nTextWidth/2.0f;
-                break;
-            case SkPaint::kRight_Align:
-                xBase = x- nTextWidth;
-                break;
-            }
-        }
-        
-        while(i<m_prefix.count() && m_prefix[i]<iEnd)
+        if(y + lineSpan + m_metrics.fTop >= m_rcBound.height())
+            break;  //the last visible line
+        LineInfo &line = m_lines[iLine];
+        line.fWidth = measureText(&paint,m_text.begin()+line.nOffset,line.nLen);
+        m_fMaxWidth = MAX(m_fMaxWidth,line.fWidth);
+        y += lineSpan;
+        iLine ++;
+    }
+    if(iLine<m_lines.count())
+    {//the last visible line
+        LineInfo &line = m_lines[iLine];
+        if(m_uFormat & DT_ELLIPSIS)
+        {//只支持在行尾增加省略号
+            measureLineWithEllipsis(paint,line);
+        }else
         {
-            SkScalar x1 = m_paint->measureText(text,(m_prefix[i]-iBegin)*sizeof(wchar_t));
-            SkScalar x2 = m_paint->measureText(text,(m_prefix[i]-iBegin+1)*sizeof(wchar_t));
-            canvas->drawLine(xBase+x1,y+1,xBase+x2,y+1,*m_paint); //绘制下划线
-            i++;
+            line.fWidth = measureText(&paint,m_text.begin()+line.nOffset,line.nLen);
         }
+        m_fMaxWidth = MAX(m_fMaxWidth,line.fWidth);
+        iLine ++;
     }
-    return measureText(m_paint,text,(iEnd-iBegin));
+    m_nVisibleLines = iLine;
 }
 
-SkScalar SkTextLayoutEx::drawLineEndWithEllipsis( SkCanvas *canvas, SkScalar x, SkScalar y, int iBegin,int iEnd,SkScalar maxWidth )
+void SkTextLayoutEx::measureLineWithEllipsis(SkPaint &paint, LineInfo &line)
 {
-    SkScalar widReq=measureText(m_paint,m_text.begin()+iBegin,(iEnd-iBegin));
+    const wchar_t *text=m_text.begin()+line.nOffset;
+    SkScalar widReq=measureText(&paint,text,line.nLen);
     if(widReq<=m_rcBound.width())
     {
-        return drawLine(canvas,x,y,iBegin,iEnd);
+        line.fWidth = widReq;
+        line.nEllipsis = -1;
     }else
     {
-        SkScalar fWidEllipsis = measureText(m_paint,CH_ELLIPSIS,3);
-        maxWidth-=fWidEllipsis;
+        SkScalar fWidEllipsis = measureText(&paint,CH_ELLIPSIS,3);
+        SkScalar maxWidth = m_rcBound.width() - fWidEllipsis;
         
         int i=0;
-        const wchar_t *text=m_text.begin()+iBegin;
         SkScalar fWid=0.0f;
-        while(i<(iEnd-iBegin))
+        while(i<line.nLen)
         {
-            SkScalar fWord = measureText(m_paint,text+i,1);
+            SkScalar fWord = measureText(&paint,text+i,1);
             if(fWid + fWord > maxWidth) break;
             fWid += fWord;
             i++;
         }
-        if(!(m_uFormat & DT_CALCRECT))
-        {
-            wchar_t *pbuf=new wchar_t[i+3];
-            memcpy(pbuf,text,i*sizeof(wchar_t));
-            memcpy(pbuf+i,CH_ELLIPSIS,3*sizeof(wchar_t));
-            drawText(canvas,pbuf,(i+3),x,y,*m_paint);
-            delete []pbuf;
-        }
-        return fWid+fWidEllipsis;
+        line.fWidth = fWid+fWidEllipsis;
+        line.nEllipsis = i;
     }
 }
 
-SkRect SkTextLayoutEx::draw( SkCanvas* canvas )
+SkScalar SkTextLayoutEx::drawLine( SkCanvas *canvas, SkPaint &paint, SkScalar x, SkScalar y, int iLine, UINT uFormat, SkGlyphAtlas *atlas ) const
 {
-    SkPaint::FontMetrics metrics;
-    m_paint->getFontMetrics(&metrics);
-    float lineSpan = metrics.fBottom-metrics.fTop;
+    const LineInfo &line = m_lines[iLine];
+    if(uFormat & DT_CALCRECT)
+        return line.fWidth;
 
-    SkRect rcDraw = m_rcBound;
+    const wchar_t *text=m_text.begin()+line.nOffset;
+    if(line.nEllipsis >= 0)
+    {
+        int i = line.nEllipsis;
+        wchar_t *pbuf=new wchar_t[i+3];
+        memcpy(pbuf,text,i*sizeof(wchar_t));
+        memcpy(pbuf+i,CH_ELLIPSIS,3*sizeof(wchar_t));
+        drawText(canvas,pbuf,(i+3),x,y,paint,atlas);
+        delete []pbuf;
+        return line.fWidth;
+    }
+
+    int iBegin = line.nOffset;
+    int iEnd = iBegin + line.nLen;
+    drawText(canvas,text,line.nLen,x,y,paint,atlas);
+    int i=0;
+    while(i<m_prefix.count())
+    {
+        if(m_prefix[i]>=iBegin)
+            break;
+        i++;
+    }
+    
+    SkScalar xBase = x;
+    switch(paint.getTextAlign())
+    {
+    case SkPaint::kCenter_Align:
+        xBase = x - line.fWidth/2.0f;
+        break;
+    case SkPaint::kRight_Align:
+        xBase = x- line.fWidth;
+        break;
+    default:
+        break;
+    }
+    
+    while(i<m_prefix.count() && m_prefix[i]<iEnd)
+    {
+        SkScalar x1 = paint.measureText(text,(m_prefix[i]-iBegin)*sizeof(wchar_t));
+        SkScalar x2 = paint.measureText(text,(m_prefix[i]-iBegin+1)*sizeof(wchar_t));
+        canvas->drawLine(xBase+x1,y+1,xBase+x2,y+1,paint); //绘制下划线
+        i++;
+    }
+    return line.fWidth;
+}
+
+SkRect SkTextLayoutEx::draw( SkCanvas* canvas, SkRect rc, SkPaint &paint, UINT uFormat, SkGlyphAtlas *atlas ) const
+{
+    float lineSpan = m_metrics.fBottom-m_metrics.fTop;
+
+    SkRect rcDraw = rc;
 
     float  x;
-    switch (m_paint->getTextAlign()) 
+    switch (paint.getTextAlign()) 
     {
     case SkPaint::kCenter_Align:
-        x = SkScalarHalf(m_rcBound.width());
+        x = SkScalarHalf(rc.width());
         break;
     case SkPaint::kRight_Align:
-        x = m_rcBound.width();
+        x = rc.width();
         break;
     default://SkPaint::kLeft_Align:
         x = 0;
         break;
     }
-    x += m_rcBound.fLeft;
+    x += rc.fLeft;
 
     canvas->save();
 
-    canvas->clipRect(m_rcBound);
+    canvas->clipRect(rc);
 
-    float height = m_rcBound.height();
-    float y=m_rcBound.fTop - metrics.fTop;
+    float height = rc.height();
+    float y=rc.fTop - m_metrics.fTop;
     if(m_uFormat & DT_SINGLELINE)
     {//单行显示
         rcDraw.fBottom = rcDraw.fTop + lineSpan;
-        if(m_uFormat & DT_VCENTER) 
+        if(uFormat & DT_VCENTER) 
         {
             y += (height - lineSpan)/2.0f;
         }
-		else if (m_uFormat & DT_BOTTOM)
+		else if (uFormat & DT_BOTTOM)
 		{
 			y += (height - lineSpan);
 		}
-        if(m_uFormat & DT_ELLIPSIS)
-        {//只支持在行尾增加省略号
-            rcDraw.fRight = rcDraw.fLeft + drawLineEndWithEllipsis(canvas,x,y,0,m_text.count(),m_rcBound.width());
-        }else
-        {
-            rcDraw.fRight = rcDraw.fLeft + drawLine(canvas,x,y,0,m_text.count());
-        }
+        rcDraw.fRight = rcDraw.fLeft + drawLine(canvas,paint,x,y,0,uFormat,atlas);
     }else
     {//多行显示
-        SkScalar maxLineWid=0;
-        int iLine = 0;
-        while(iLine<m_lines.count())
+        for(int iLine = 0; iLine<m_nVisibleLines; iLine++)
         {
-            if(y + lineSpan + metrics.fTop >= m_rcBound.fBottom) 
-                break;  //the last visible line
-            int iBegin=m_lines[iLine].nOffset;
-            int iEnd = iBegin + m_lines[iLine].nLen;
-            SkScalar lineWid = drawLine(canvas,x,y,iBegin,iEnd);
-            maxLineWid = MAX(maxLineWid,lineWid);
-            y += lineSpan;
-            iLine ++;
-        }
-        if(iLine<m_lines.count())
-        {//draw the last visible line
-			int iBegin = m_lines[iLine].nOffset;
-			int iEnd = iBegin + m_lines[iLine].nLen;
-            SkScalar lineWid;
-            if(m_uFormat & DT_ELLIPSIS)
-            {//只支持在行尾增加省略号
-                lineWid=drawLineEndWithEllipsis(canvas,x,y,iBegin,iEnd,m_rcBound.width());
-            }else
-            {
-                lineWid=drawLine(canvas,x,y,iBegin,iEnd);
-            }
-            maxLineWid = MAX(maxLineWid,lineWid);
+            drawLine(canvas,paint,x,y,iLine,uFormat,atlas);
             y += lineSpan;
         }
-        rcDraw.fRight = rcDraw.fLeft + maxLineWid;
-        rcDraw.fBottom = y + metrics.fTop;
+        rcDraw.fRight = rcDraw.fLeft + m_fMaxWidth;
+        rcDraw.fBottom = y + m_metrics.fTop;
     }
     canvas->restore();
     return rcDraw;
 }
 
-void SkTextLayoutEx::drawText(SkCanvas *canvas,const wchar_t* text, size_t length, SkScalar x, SkScalar y,  SkPaint& paint)
+void SkTextLayoutEx::drawText(SkCanvas *canvas,const wchar_t* text, size_t length, SkScalar x, SkScalar y,  SkPaint& paint, SkGlyphAtlas *atlas)
 {
+	if(atlas && atlas->drawText(canvas,text,length,x,y,paint))
+		return;
 	canvas->drawText(text,length*sizeof(wchar_t),x,y,paint);
 }
 
@@ -277,3 +304,514 @@ SkScalar SkTextLayoutEx::measureText( SkPaint *paint,const wchar_t* text, size_t
 {
 	return paint->measureText(text,length*sizeof(wchar_t));
 }
+
+//////////////////////////////////////////////////////////////////////////
+// SkTextLayoutCache
+SkTextLayoutCache::SkTextLayoutCache(int nCapacity):m_nCapacity(nCapacity)
+{
+}
+
+SkTextLayoutCache::~SkTextLayoutCache()
+{
+    clear();
+}
+
+SkTextLayoutEx * SkTextLayoutCache::getLayout(const wchar_t text[], size_t length,SkRect rc,  SkPaint &paint,UINT uFormat)
+{
+    //flags which change the glyph advances.
+    const uint32_t kMeasureFlags = SkPaint::kAntiAlias_Flag | SkPaint::kFakeBoldText_Flag | SkPaint::kLinearText_Flag
+        | SkPaint::kSubpixelText_Flag | SkPaint::kDevKernText_Flag | SkPaint::kEmbeddedBitmapText_Flag
+        | SkPaint::kAutoHinting_Flag | SkPaint::kVerticalText_Flag;
+    //only the flags used by SkTextLayoutEx::init go into the key, the rest are applied by draw.
+    UINT uLayoutFormat = uFormat & (DT_SINGLELINE|DT_NOPREFIX|DT_ELLIPSIS);
+    SkScalar wid = rc.width(), hei = rc.height();
+    if(uFormat & DT_SINGLELINE)
+    {
+        hei = 0;
+        if(!(uFormat & DT_ELLIPSIS))
+            wid = 0;
+    }else
+    {
+        uLayoutFormat |= uFormat & DT_CALCRECT;
+    }
+
+    SOUI::SStringW key;
+    key.Format(L"%u,%g,%g,%x,%d,%g,%g,%x|",SkTypeface::UniqueID(paint.getTypeface()),paint.getTextSize(),paint.getTextScaleX(),
+        paint.getFlags() & kMeasureFlags,(int)paint.getHinting(),wid,hei,uLayoutFormat);
+    key.AppendStr(text,(int)length);
+
+    SOUI::SAutoLock lock(m_cs);
+    SOUI::SMap<SOUI::SStringW, SOUI::SPOSITION>::CPair *pPair = m_map.Lookup(key);
+    if(pPair)
+    {
+        m_lru.MoveToHead(pPair->m_value);
+        SkTextLayoutEx *pRet = m_lru.GetHead().layout;
+        pRet->AddRef();
+        return pRet;
+    }
+
+    SkTextLayoutEx *pRet = new SkTextLayoutEx;
+    SkRect rcLayout = SkRect::MakeWH(wid,hei);
+    pRet->init(text,length,rcLayout,paint,uLayoutFormat);
+    CacheItem item;
+    item.key = key;
+    item.layout = pRet;
+    m_map[key] = m_lru.AddHead(item);
+    while((int)m_lru.GetCount() > m_nCapacity)
+    {
+        m_map.RemoveKey(m_lru.GetTail().key);
+        m_lru.RemoveTailNoReturn();
+    }
+    return pRet;
+}
+
+void SkTextLayoutCache::clear()
+{
+    SOUI::SAutoLock lock(m_cs);
+    m_map.RemoveAll();
+    m_lru.RemoveAll();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SkGlyphAtlas
+static const SkMask::Format kAtlasMaskFormats[] = { SkMask::kA8_Format, SkMask::kLCD16_Format, SkMask::kLCD32_Format };
+
+SkGlyphAtlas::SkGlyphAtlas()
+{
+    memset(m_pages, 0, sizeof(m_pages));
+    memset(m_curPage, 0, sizeof(m_curPage));
+    m_useClock = 0;
+}
+
+SkGlyphAtlas::~SkGlyphAtlas()
+{
+    clear();
+    for(int i = 0; i < kFormatCount; i++)
+    {
+        for(int j = 0; j < kMaxPages; j++)
+            SkSafeUnref(m_pages[i][j].bits);
+    }
+}
+
+void SkGlyphAtlas::clear()
+{
+    SOUI::SAutoLock lock(m_cs);
+    freeStrikes();
+    //keep the page memory, all glyphs are invalidated by the new generation.
+    //pages still referenced by a blit of another thread are released and allocated again on use.
+    for(int i = 0; i < kFormatCount; i++)
+    {
+        for(int j = 0; j < kMaxPages; j++)
+        {
+            Page &page = m_pages[i][j];
+            if(page.bits && !page.bits->unique())
+            {
+                page.bits->unref();
+                page.bits = NULL;
+            }
+            page.shelfX = page.shelfY = page.shelfH = 0;
+            page.gen++;
+        }
+        m_curPage[i] = 0;
+    }
+}
+
+void SkGlyphAtlas::freeStrikes()
+{
+    SOUI::SPOSITION pos = m_strikes.GetStartPosition();
+    while(pos)
+    {
+        delete m_strikes.GetNextValue(pos);
+    }
+    m_strikes.RemoveAll();
+}
+
+void SkGlyphAtlas::evictStrike()
+{
+    SOUI::SPOSITION posOldest = NULL;
+    uint32_t oldest = 0;
+    SOUI::SPOSITION pos = m_strikes.GetStartPosition();
+    while(pos)
+    {
+        SOUI::SPOSITION posCur = pos;
+        Strike *strike = m_strikes.GetNextValue(pos);
+        if(!posOldest || m_useClock - strike->lastUse > m_useClock - oldest)
+        {
+            posOldest = posCur;
+            oldest = strike->lastUse;
+        }
+    }
+    if(posOldest)
+    {
+        delete m_strikes.GetValueAt(posOldest);
+        m_strikes.RemoveAtPos(posOldest);
+    }
+}
+
+int SkGlyphAtlas::bytesPerPixel(int format)
+{
+    switch(format)
+    {
+    case kFormatLCD16:
+        return 2;
+    case kFormatLCD32:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+bool SkGlyphAtlas::drawText(SkCanvas *canvas, const wchar_t *text, size_t length, SkScalar x, SkScalar y, const SkPaint &paint)
+{
+    if(length == 0)
+        return true;
+
+    //paint: a plain color without decorations, see SkCanvas::onDrawText
+    if(paint.getShader() || paint.getMaskFilter() || paint.getPathEffect() || paint.getColorFilter()
+        || paint.getLooper() || paint.getRasterizer() || paint.getImageFilter()
+        || !SkXfermode::IsMode(paint.getXfermode(), SkXfermode::kSrcOver_Mode))
+        return false;
+    const uint32_t kUnsupportedFlags = SkPaint::kUnderlineText_Flag | SkPaint::kStrikeThruText_Flag
+        | SkPaint::kDevKernText_Flag | SkPaint::kVerticalText_Flag | SkPaint::kDistanceFieldTextTEMP_Flag;
+    if(paint.getFlags() & kUnsupportedFlags)
+        return false;
+    //hairline text is drawn as paths, see SkDraw::ShouldDrawTextAsPaths
+    if(paint.getStyle() == SkPaint::kStroke_Style && paint.getStrokeWidth() == 0)
+        return false;
+    if(paint.getTextSize() > SkIntToScalar(kMaxTextSize) || paint.getTextScaleX() != SK_Scalar1 || paint.getTextSkewX() != 0)
+        return false;
+
+    //canvas: translation only, rect clip and N32 raster pixels
+    const SkMatrix &mtx = canvas->getTotalMatrix();
+    if(mtx.getType() & ~SkMatrix::kTranslate_Mask)
+        return false;
+    if(canvas->getDrawFilter() || !canvas->isClipRect())
+        return false;
+    SkImageInfo info;
+    size_t rowBytes = 0;
+    SkIPoint origin;
+    void *pixels = canvas->accessTopLayerPixels(&info, &rowBytes, &origin);
+    if(!pixels || info.colorType() != kN32_SkColorType)
+        return false;
+    SkIRect rcClip;
+    if(!canvas->getClipDeviceBounds(&rcClip))
+        return true;
+    rcClip.offset(-origin.fX, -origin.fY);
+    if(!rcClip.intersect(SkIRect::MakeWH(info.width(), info.height())))
+        return true;
+    SkColor color = paint.getColor();
+    if(SkColorGetA(color) == 0)
+        return true;
+
+    //lcd text is turned into A8 in the same cases as SkBitmapDevice::filterTextFlags
+    uint32_t flags = paint.getFlags();
+    if(paint.isLCDRenderText() && paint.isAntiAlias() && (paint.isFakeBoldText() || paint.getStyle() != SkPaint::kFill_Style))
+    {
+        flags &= ~SkPaint::kLCDRenderText_Flag;
+        flags |= SkPaint::kGenA8FromLCD_Flag;
+    }
+    const uint32_t kGlyphFlags = SkPaint::kAntiAlias_Flag | SkPaint::kFakeBoldText_Flag | SkPaint::kLinearText_Flag
+        | SkPaint::kSubpixelText_Flag | SkPaint::kLCDRenderText_Flag | SkPaint::kEmbeddedBitmapText_Flag
+        | SkPaint::kAutoHinting_Flag | SkPaint::kGenA8FromLCD_Flag;
+    SkGlyphStrikeKey key;
+    key.fontId = SkTypeface::UniqueID(paint.getTypeface());
+    key.textSize = SkScalarToFixed(paint.getTextSize());
+    key.flags = (flags & kGlyphFlags) | ((uint32_t)paint.getHinting() << 16);
+    if(paint.getStyle() == SkPaint::kFill_Style)
+    {
+        key.style = 0;
+        key.strokeWidth = key.strokeMiter = 0;
+    }else
+    {
+        key.style = (uint32_t)paint.getStyle() | ((uint32_t)paint.getStrokeJoin() << 8);
+        key.strokeWidth = SkScalarToFixed(paint.getStrokeWidth());
+        key.strokeMiter = SkScalarToFixed(paint.getStrokeMiter());
+    }
+    //the luminance color only selects one of a few gamma tables, quantize it as SkScalerContext::PostMakeRec
+    //does so that text of similar colors shares the strike. A8 masks use the gray level only, LCD masks the
+    //canonical color; LCD text may still be turned into A8 by the scaler, so the gray level is kept in alpha.
+    U8CPU lum = SkComputeLuminance(SkColorGetR(color), SkColorGetG(color), SkColorGetB(color));
+    SkColor lumGray = SkMaskGamma::CanonicalColor(SkColorSetRGB(lum, lum, lum));
+    if(flags & SkPaint::kLCDRenderText_Flag)
+        key.lumColor = (SkMaskGamma::CanonicalColor(color) & 0x00FFFFFF) | (SkColorGetR(lumGray) << 24);
+    else
+        key.lumColor = lumGray & 0x00FFFFFF;
+
+    //the same mapping as the device matrix of the top layer
+    x += mtx.getTranslateX() - SkIntToScalar(origin.fX);
+    y += mtx.getTranslateY() - SkIntToScalar(origin.fY);
+
+    //look up and place the glyphs in the lock, blend them out of it.
+    SkAutoSTMalloc<64, GlyphBlit> blits;
+    int nBlits = 0;
+    PageBits *usedBits[kFormatCount * kMaxPages];
+    int nUsedBits = 0;
+    {
+        SOUI::SAutoLock lock(m_cs);
+        m_chars.setCount(0);
+        const wchar_t *pEnd = text + length;
+        while(text < pEnd)
+        {
+            SkUnichar uni = (SkUnichar)*text++;
+            if(sizeof(wchar_t) == 2 && uni >= 0xD800 && uni < 0xDC00 && text < pEnd && *text >= 0xDC00 && *text < 0xE000)
+            {//surrogate pair
+                uni = ((uni - 0xD800) << 10) + (*text++ - 0xDC00) + 0x10000;
+            }
+            *m_chars.append() = uni;
+        }
+
+        Strike *strike = NULL;
+        SOUI::SMap<SkGlyphStrikeKey, Strike *>::CPair *pPair = m_strikes.Lookup(key);
+        if(pPair)
+        {
+            strike = pPair->m_value;
+        }else
+        {
+            if((int)m_strikes.GetCount() >= kMaxStrikes)
+                evictStrike();
+            strike = new Strike;
+            strike->bInited = false;
+            strike->bSubpixel = false;
+            m_strikes[key] = strike;
+        }
+        strike->lastUse = ++m_useClock;
+
+        if(!placeGlyphs(strike, NULL, x, y, paint.getTextAlign()))
+        {
+            SkPaint paintGlyph(paint);
+            paintGlyph.setFlags(flags);
+            if(!placeGlyphsWithScaler(strike, paintGlyph, x, y))
+                return false;
+        }
+
+        blits.reset(m_placed.count());
+        bool bUsed[kFormatCount][kMaxPages] = { { false } };
+        for(int i = 0; i < m_placed.count(); i++)
+        {
+            const GlyphPos &pos = m_placed[i];
+            const Glyph &glyph = pos.glyph;
+            if(glyph.width == 0)
+                continue;
+            SkIRect rcGlyph = SkIRect::MakeXYWH(pos.left, pos.top, glyph.width, glyph.height);
+            if(!rcGlyph.intersect(rcClip))
+                continue;
+            const Page &page = m_pages[glyph.format][glyph.page];
+            GlyphBlit &blit = blits[nBlits++];
+            blit.rc = rcGlyph;
+            blit.mask = page.bits->pixels + (glyph.y + rcGlyph.fTop - pos.top) * page.rowBytes
+                + (glyph.x + rcGlyph.fLeft - pos.left) * bytesPerPixel(glyph.format);
+            blit.maskRowBytes = page.rowBytes;
+            blit.format = glyph.format;
+            if(!bUsed[glyph.format][glyph.page])
+            {//keep the page memory alive until the blend is done
+                bUsed[glyph.format][glyph.page] = true;
+                page.bits->ref();
+                usedBits[nUsedBits++] = page.bits;
+            }
+        }
+    }
+
+    SkBlitMask::ColorProc procs[kFormatCount] = { NULL };
+    bool bRet = true;
+    for(int i = 0; i < nBlits && bRet; i++)
+    {
+        int format = blits[i].format;
+        if(!procs[format])
+        {
+            procs[format] = SkBlitMask::ColorFactory(kN32_SkColorType, kAtlasMaskFormats[format], color);
+            bRet = procs[format] != NULL;
+        }
+    }
+
+    for(int i = 0; i < nBlits && bRet; i++)
+    {
+        const GlyphBlit &blit = blits[i];
+        uint8_t *dst = (uint8_t *)pixels + blit.rc.fTop * rowBytes + blit.rc.fLeft * sizeof(SkPMColor);
+        procs[blit.format](dst, rowBytes, blit.mask, blit.maskRowBytes, color, blit.rc.width(), blit.rc.height());
+    }
+
+    for(int i = 0; i < nUsedBits; i++)
+        usedBits[i]->unref();
+    return bRet;
+}
+
+bool SkGlyphAtlas::placeGlyphsWithScaler(Strike *strike, const SkPaint &paint, SkScalar x, SkScalar y)
+{
+    //the device properties of the SkBitmapDevice created by SkCanvas(const SkBitmap&).
+    //masks only depend on the 2x2 part of the matrix, so one strike serves all translations.
+    SkDeviceProperties props(SkDeviceProperties::kLegacyLCD_InitType);
+    SkAutoGlyphCache autoCache(paint, &props, &SkMatrix::I());
+    return placeGlyphs(strike, autoCache.getCache(), x, y, paint.getTextAlign());
+}
+
+bool SkGlyphAtlas::placeGlyphs(Strike *strike, SkGlyphCache *cache, SkScalar x, SkScalar y, SkPaint::Align align)
+{
+    if(!strike->bInited)
+    {
+        if(!cache)
+            return false;
+        strike->bSubpixel = cache->isSubpixel();
+        strike->bInited = true;
+    }
+
+    const int nGlyphs = m_chars.count();
+    m_infos.setCount(nGlyphs);
+    SkFixed stop = 0;
+    for(int i = 0; i < nGlyphs; i++)
+    {
+        CharInfo &info = m_infos[i];
+        if(!strike->chars.Lookup(m_chars[i], info))
+        {
+            if(!cache)
+                return false;
+            info.id = cache->unicharToGlyph(m_chars[i]);
+            info.advance = cache->getGlyphIDAdvance(info.id).fAdvanceX;
+            strike->chars[m_chars[i]] = info;
+        }
+        if(info.id == 0)
+            return false;   //missing glyph, leave it to the font fallback of SkCanvas::drawText
+        stop += info.advance;
+    }
+    if(align != SkPaint::kLeft_Align)
+    {//same as measure_text in SkDraw.cpp
+        SkScalar stopX = SkFixedToScalar(stop);
+        if(align == SkPaint::kCenter_Align)
+            stopX = SkScalarHalf(stopX);
+        x -= stopX;
+    }
+
+    //same sampling as SkDraw::drawText for horizontal text
+    SkFixed fx = SkScalarToFixed(x) + (strike->bSubpixel ? (SK_FixedHalf >> SkGlyph::kSubBits) : SK_FixedHalf);
+    SkFixed fy = SkScalarToFixed(y) + SK_FixedHalf;
+    m_placed.setCount(nGlyphs);
+    for(int i = 0; i < nGlyphs; i++)
+    {
+        uint16_t id = m_infos[i].id;
+        uint32_t glyphKey = id;
+        if(strike->bSubpixel)
+            glyphKey |= SkGlyph::FixedToSub(fx) << 16;
+        GlyphPos &pos = m_placed[i];
+        SOUI::SMap<uint32_t, Glyph>::CPair *pPair = strike->glyphs.Lookup(glyphKey);
+        if(pPair && pPair->m_value.format == kUnsupported)
+            return false;
+        if(pPair && (pPair->m_value.width == 0 || m_pages[pPair->m_value.format][pPair->m_value.page].gen == pPair->m_value.gen))
+        {
+            pos.glyph = pPair->m_value;
+        }else
+        {
+            if(!cache)
+                return false;
+            const SkGlyph &skGlyph = strike->bSubpixel ? cache->getGlyphIDMetrics(id, fx, 0) : cache->getGlyphIDMetrics(id);
+            bool bSupported = addGlyph(cache, skGlyph, pos.glyph);
+            strike->glyphs[glyphKey] = pos.glyph;
+            if(!bSupported)
+                return false;
+        }
+        pos.left = SkFixedFloorToInt(fx) + pos.glyph.left;
+        pos.top = SkFixedFloorToInt(fy) + pos.glyph.top;
+        fx += m_infos[i].advance;
+    }
+
+    if(cache)
+    {//a page may have been recycled by the later glyphs of the text
+        for(int i = 0; i < nGlyphs; i++)
+        {
+            const Glyph &glyph = m_placed[i].glyph;
+            if(glyph.width && m_pages[glyph.format][glyph.page].gen != glyph.gen)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool SkGlyphAtlas::addGlyph(SkGlyphCache *cache, const SkGlyph &skGlyph, Glyph &glyph)
+{
+    memset(&glyph, 0, sizeof(glyph));
+    glyph.format = kUnsupported;
+    if(skGlyph.fWidth == 0)
+    {//nothing to draw
+        glyph.format = kFormatA8;
+        return true;
+    }
+
+    int format;
+    switch(skGlyph.fMaskFormat)
+    {
+    case SkMask::kA8_Format:
+        format = kFormatA8;
+        break;
+    case SkMask::kLCD16_Format:
+        format = kFormatLCD16;
+        break;
+    case SkMask::kLCD32_Format:
+        format = kFormatLCD32;
+        break;
+    default:
+        return false;   //BW and color glyphs use the blitters of SkDraw
+    }
+    if(skGlyph.fWidth > kPageSize || skGlyph.fHeight > kPageSize)
+        return false;
+
+    const uint8_t *image = (const uint8_t *)cache->findImage(skGlyph);
+    if(!image)
+    {//can't rasterize glyph, SkDraw draws nothing either
+        glyph.format = kFormatA8;
+        return true;
+    }
+
+    Page *page = allocRect(format, skGlyph.fWidth, skGlyph.fHeight, glyph);
+    glyph.format = (uint8_t)format;
+    glyph.left = skGlyph.fLeft;
+    glyph.top = skGlyph.fTop;
+    glyph.width = skGlyph.fWidth;
+    glyph.height = skGlyph.fHeight;
+
+    const size_t cbRow = skGlyph.fWidth * bytesPerPixel(format);
+    const size_t srcRowBytes = skGlyph.rowBytes();
+    uint8_t *dst = page->bits->pixels + glyph.y * page->rowBytes + glyph.x * bytesPerPixel(format);
+    for(int i = 0; i < skGlyph.fHeight; i++)
+    {
+        memcpy(dst, image, cbRow);
+        dst += page->rowBytes;
+        image += srcRowBytes;
+    }
+    return true;
+}
+
+SkGlyphAtlas::Page * SkGlyphAtlas::allocRect(int format, int width, int height, Glyph &glyph)
+{
+    Page *page = &m_pages[format][m_curPage[format]];
+    if(page->bits && page->shelfX + width > kPageSize)
+    {//start a new shelf
+        page->shelfY += page->shelfH;
+        page->shelfX = 0;
+        page->shelfH = 0;
+    }
+    if(!page->bits || page->shelfY + height > kPageSize)
+    {//the page is full, move to the next page and recycle it
+        if(page->bits)
+        {
+            m_curPage[format] = (m_curPage[format] + 1) % kMaxPages;
+            page = &m_pages[format][m_curPage[format]];
+        }
+        if(page->bits && !page->bits->unique())
+        {//another thread is still blending from the old memory
+            page->bits->unref();
+            page->bits = NULL;
+        }
+        if(!page->bits)
+        {
+            page->rowBytes = kPageSize * bytesPerPixel(format);
+            page->bits = new PageBits(page->rowBytes * kPageSize);
+        }
+        page->shelfX = page->shelfY = page->shelfH = 0;
+        page->gen++;
+    }
+    glyph.page = (uint8_t)m_curPage[format];
+    glyph.gen = page->gen;
+    glyph.x = (uint16_t)page->shelfX;
+    glyph.y = (uint16_t)page->shelfY;
+    page->shelfX += width;
+    page->shelfH = MAX(page->shelfH, height);
+    return page;
+}
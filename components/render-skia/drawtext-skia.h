@@ -3,38 +3,227 @@
 #include <core/SkPaint.h>
 #include <core/SkCanvas.h>
 #include <core/SkTDArray.h>
+#include <core/SkRefCnt.h>
 #include <windows.h>
+#include <helper/obj-ref-impl.hpp>
+#include <helper/SCriticalSection.h>
+#include <string/tstring.h>
+#include <souicoll.h>
 
-class SkTextLayoutEx {
+class SkGlyphAtlas;
+class SkGlyphCache;
+struct SkGlyph;
+
+//文本排版结果: 分行,行宽,省略号位置及字体度量. 创建后只读,可以在多个绘制间共享
+class SkTextLayoutEx : public SOUI::TObjRefImpl<SOUI::IObjRef> {
+	struct LineInfo {
+		int nOffset;
+		int nLen;
+		SkScalar fWidth;    //行宽,有省略号时包含省略号
+		int nEllipsis;      //-1:不显示省略号,否则为省略号前保留的字符数
+	};
 public:
     //not support for DT_PREFIXONLY
     void init(const wchar_t text[], size_t length,SkRect rc,  SkPaint &paint,UINT uFormat);
 
-    SkRect draw(SkCanvas* canvas);
+    //rc must have the same size as the rect passed to init, only the position may change.
+    //uFormat may differ from init in alignment and DT_CALCRECT of single line text.
+    //atlas: optional glyph atlas used to draw the lines, see SkGlyphAtlas.
+    SkRect draw(SkCanvas* canvas, SkRect rc, SkPaint &paint, UINT uFormat, SkGlyphAtlas *atlas = NULL) const;
+
+    SkScalar width() const { return m_fMaxWidth; }
+
+    const SkPaint::FontMetrics & metrics() const { return m_metrics; }
 
 	static void SetFontFallback(FunFontFallback fun);
+
 private:
-    SkScalar drawLineEndWithEllipsis(SkCanvas *canvas, SkScalar x, SkScalar y, int iBegin,int iEnd,SkScalar maxWidth);
+    SkScalar drawLine(SkCanvas *canvas, SkPaint &paint, SkScalar x, SkScalar y, int iLine, UINT uFormat, SkGlyphAtlas *atlas) const;
+
+    void buildLines(SkPaint &paint);
 
-    SkScalar drawLine(SkCanvas *canvas, SkScalar x, SkScalar y, int iBegin,int iEnd);
+    void measureLines(SkPaint &paint);
 
-    void buildLines();
+    void measureLineWithEllipsis(SkPaint &paint, LineInfo &line);
 
-	void drawText(SkCanvas *canvas,const wchar_t* text, size_t length, SkScalar x, SkScalar y,  SkPaint& paint);
-	SkScalar measureText( SkPaint *paint,const wchar_t* text, size_t length);
+	static void drawText(SkCanvas *canvas,const wchar_t* text, size_t length, SkScalar x, SkScalar y,  SkPaint& paint, SkGlyphAtlas *atlas);
+	static SkScalar measureText( SkPaint *paint,const wchar_t* text, size_t length);
 
 private:
     SkTDArray<wchar_t> m_text;   //文本内容
     SkTDArray<int>  m_prefix;    //前缀符索引
-	struct LineInfo {
-		int nOffset;
-		int nLen;
-	};
     SkTDArray<LineInfo> m_lines;      //分行索引
-    UINT            m_uFormat;    //显示标志
+    int             m_nVisibleLines;  //可见行数
+    SkScalar        m_fMaxWidth;  //最大行宽
+    UINT            m_uFormat;    //排版标志
     SkRect          m_rcBound;    //限制矩形
-    SkPaint  *m_paint;
+    SkPaint::FontMetrics m_metrics;
+};
+
+//排版结果缓存,以(字体,字号,文本,矩形大小,格式)为key,LRU淘汰
+class SkTextLayoutCache {
+public:
+    enum { kDefCapacity = 512 };
+
+    SkTextLayoutCache(int nCapacity = kDefCapacity);
+    ~SkTextLayoutCache();
+
+    //return a layout with a reference added.
+    SkTextLayoutEx * getLayout(const wchar_t text[], size_t length,SkRect rc,  SkPaint &paint,UINT uFormat);
+
+    void clear();
+
+private:
+    struct CacheItem {
+        SOUI::SStringW key;
+        SOUI::SAutoRefPtr<SkTextLayoutEx> layout;
+    };
+    SOUI::SList<CacheItem> m_lru;  //most recently used first
+    SOUI::SMap<SOUI::SStringW, SOUI::SPOSITION> m_map;
+    int m_nCapacity;
+    SOUI::SCriticalSection m_cs;
+};
+
+//字形图集中一组字形的key: 字体,字号及影响光栅化的paint属性
+struct SkGlyphStrikeKey {
+    uint32_t fontId;
+    SkFixed  textSize;
+    uint32_t flags;      //影响光栅化的paint标志及hinting
+    uint32_t style;      //填充样式及描边join
+    SkFixed  strokeWidth;
+    SkFixed  strokeMiter;
+    SkColor  lumColor;   //gamma校正使用的颜色, 按SkScalerContext的方式量化, 见SkGlyphAtlas::drawText
+};
+
+SNSBEGIN
+template <>
+class CElementTraits<SkGlyphStrikeKey> : public CElementTraitsBase<SkGlyphStrikeKey> {
+  public:
+    static ULONG Hash(INARGTYPE key)
+    {
+        ULONG nHash = key.fontId;
+        nHash = nHash * 31 + (ULONG)key.textSize;
+        nHash = nHash * 31 + key.flags;
+        nHash = nHash * 31 + key.style;
+        nHash = nHash * 31 + (ULONG)key.strokeWidth;
+        nHash = nHash * 31 + key.lumColor;
+        return nHash;
+    }
+
+    static bool CompareElements(INARGTYPE element1, INARGTYPE element2)
+    {
+        return memcmp(&element1, &element2, sizeof(SkGlyphStrikeKey)) == 0;
+    }
+
+    static int CompareElementsOrdered(INARGTYPE element1, INARGTYPE element2)
+    {
+        return memcmp(&element1, &element2, sizeof(SkGlyphStrikeKey));
+    }
 };
+SNSEND
+
+//字形图集: 缓存已光栅化的字形覆盖度蒙板, 以(字体,字号,字形,亚像素偏移)为key.
+//只处理轴对齐(变换矩阵只有平移),矩形裁剪,纯色填充的文本, 其它情况返回false由canvas->drawText绘制.
+//蒙板按格式(A8,LCD16,LCD32)分页保存, 每页用货架(shelf)方式分配, 页数满后按FIFO回收最早的页.
+//锁只保护查找和插入, 混合在锁外进行: 绘制时引用用到的页内存, 回收仍被引用的页时换用新内存.
+class SkGlyphAtlas {
+public:
+    enum {
+        kPageSize = 512,    //页的边长
+        kMaxPages = 8,      //每种蒙板格式的最大页数
+        kMaxStrikes = 64,   //最多缓存的(字体,字号,样式)组合数, 超出后淘汰最久未用的
+        kMaxTextSize = 128, //字号超过它的文本不使用图集
+    };
+
+    SkGlyphAtlas();
+    ~SkGlyphAtlas();
+
+    //draw a single line of text at (x,y) with the same result as canvas->drawText.
+    //return false if the text, paint or canvas state is not supported, nothing is drawn then.
+    bool drawText(SkCanvas *canvas, const wchar_t *text, size_t length, SkScalar x, SkScalar y, const SkPaint &paint);
+
+    void clear();
+
+private:
+    struct Glyph {
+        int16_t  left, top;   //相对于原点的蒙板位置
+        uint16_t width, height;
+        uint16_t x, y;        //在页中的位置
+        uint8_t  format;      //页格式索引, kUnsupported表示只能由canvas绘制
+        uint8_t  page;        //页索引
+        uint32_t gen;         //分配时页的代数, 页被回收后失效
+    };
+
+    struct CharInfo {
+        uint16_t id;          //字形ID
+        SkFixed  advance;     //步进
+    };
+
+    struct Strike {
+        bool bInited;
+        bool bSubpixel;
+        uint32_t lastUse;     //最近使用时的m_useClock, 用于LRU淘汰
+        SOUI::SMap<SkUnichar, CharInfo> chars;    //字符->字形ID及步进, 省去每次绘制时查询字体
+        SOUI::SMap<uint32_t, Glyph> glyphs;       //字形ID|亚像素偏移<<16 -> 蒙板
+    };
+
+    //页内存, 绘制线程在锁外混合时持有引用
+    struct PageBits : public SkRefCnt {
+        uint8_t *pixels;
+
+        explicit PageBits(size_t cb) : pixels((uint8_t *)sk_malloc_throw(cb)) {}
+        virtual ~PageBits() { sk_free(pixels); }
+    };
 
+    struct Page {
+        PageBits *bits;
+        size_t   rowBytes;
+        int      shelfX, shelfY, shelfH;
+        uint32_t gen;
+    };
+
+    struct GlyphPos {
+        int left, top;
+        Glyph glyph;
+    };
+
+    struct GlyphBlit {
+        SkIRect rc;           //裁剪后的目标矩形
+        const uint8_t *mask;  //rc左上角对应的蒙板数据
+        size_t maskRowBytes;
+        int format;
+    };
+
+    enum {
+        kFormatA8 = 0,
+        kFormatLCD16,
+        kFormatLCD32,
+        kFormatCount,
+        kUnsupported = 0xFF,
+    };
+
+    void freeStrikes();
+
+    void evictStrike();
+
+    bool placeGlyphs(Strike *strike, SkGlyphCache *cache, SkScalar x, SkScalar y, SkPaint::Align align);
+
+    bool placeGlyphsWithScaler(Strike *strike, const SkPaint &paint, SkScalar x, SkScalar y);
+
+    bool addGlyph(SkGlyphCache *cache, const SkGlyph &skGlyph, Glyph &glyph);
+
+    Page * allocRect(int format, int width, int height, Glyph &glyph);
+
+    static int bytesPerPixel(int format);
+
+    SOUI::SMap<SkGlyphStrikeKey, Strike *> m_strikes;
+    Page m_pages[kFormatCount][kMaxPages];
+    int m_curPage[kFormatCount];
+    uint32_t m_useClock;            //每次绘制加1
+    SkTDArray<SkUnichar> m_chars;   //当前绘制的字符
+    SkTDArray<CharInfo> m_infos;    //当前绘制的字符对应的字形
+    SkTDArray<GlyphPos> m_placed;   //当前绘制的字形位置
+    SOUI::SCriticalSection m_cs;
+};
 
 SkRect DrawText_Skia(SkCanvas* canvas,const wchar_t *text,int len,SkRect box, SkPaint& paint,UINT uFormat);
@@ -0,0 +1,381 @@
+﻿#include "record-skia.h"
+#include <core/SkThread.h>
+#include <src/core/SkRecord.h>
+#include <src/core/SkRecorder.h>
+#include <src/core/SkRecordDraw.h>
+#include <src/utils/SkCondVar.h>
+#include <src/utils/SkThreadUtils.h>
+
+#ifdef _WIN32
+#include <windows.h>
+static int num_cores()
+{
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return (int)sysinfo.dwNumberOfProcessors;
+}
+#else
+#include <unistd.h>
+static int num_cores()
+{
+    return (int)sysconf(_SC_NPROCESSORS_ONLN);
+}
+#endif//_WIN32
+
+//////////////////////////////////////////////////////////////////////////
+// SkTileWorkers
+SkTileWorkers::SkTileWorkers(int nThreads)
+    : m_cond(new SkCondVar)
+    , m_job(NULL)
+    , m_jobId(0)
+    , m_bDraining(false)
+{
+    if (nThreads <= 0)
+        nThreads = num_cores() - 1;
+    for (int i = 0; i < nThreads; i++)
+    {
+        SkThread *pThread = new SkThread(&SkTileWorkers::Loop, this);
+        if (!pThread->start())
+        {
+            delete pThread;
+            break;
+        }
+        m_threads.push(pThread);
+    }
+}
+
+SkTileWorkers::~SkTileWorkers()
+{
+    m_cond->lock();
+    m_bDraining = true;
+    m_cond->broadcast();
+    m_cond->unlock();
+    for (int i = 0; i < m_threads.count(); i++)
+    {
+        m_threads[i]->join();
+        delete m_threads[i];
+    }
+    delete m_cond;
+}
+
+void SkTileWorkers::Work(Job *job)
+{
+    for (;;)
+    {
+        int32_t i = sk_atomic_inc(&job->nNext);
+        if (i >= job->nCount)
+            break;
+        job->proc(job->ctx, i);
+        sk_atomic_inc(&job->nDone);
+    }
+}
+
+void SkTileWorkers::Loop(void *arg)
+{
+    SkTileWorkers *_this = (SkTileWorkers *)arg;
+    uint32_t jobId = 0;
+    for (;;)
+    {
+        _this->m_cond->lock();
+        while (!_this->m_bDraining && (!_this->m_job || _this->m_jobId == jobId))
+            _this->m_cond->wait();
+        if (_this->m_bDraining)
+        {
+            _this->m_cond->unlock();
+            return;
+        }
+        Job *job = _this->m_job;
+        jobId = _this->m_jobId;
+        job->nUsers++;
+        _this->m_cond->unlock();
+
+        Work(job);
+
+        _this->m_cond->lock();
+        job->nUsers--;
+        _this->m_cond->broadcast();
+        _this->m_cond->unlock();
+    }
+}
+
+void SkTileWorkers::run(int nCount, void (*proc)(void *ctx, int i), void *ctx)
+{
+    if (nCount <= 0)
+        return;
+    if (nCount == 1 || m_threads.isEmpty())
+    {
+        for (int i = 0; i < nCount; i++)
+            proc(ctx, i);
+        return;
+    }
+
+    SOUI::SAutoLock lock(m_csRun);
+    Job job = { proc, ctx, nCount, 0, 0, 0 };
+    m_cond->lock();
+    m_job = &job;
+    m_jobId++;
+    m_cond->broadcast();
+    m_cond->unlock();
+
+    Work(&job);
+
+    //调用线程领不到任务时所有任务都已被领取, 等待领取了任务的工作线程完成
+    m_cond->lock();
+    m_job = NULL;
+    while (job.nUsers > 0)
+        m_cond->wait();
+    m_cond->unlock();
+    SkASSERT(job.nDone == nCount);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SkTiledRecording
+
+namespace {
+
+//取命令类型
+struct OpType
+{
+    template <typename T>
+    SkRecords::Type operator()(const T &)
+    {
+        return T::kType;
+    }
+};
+
+//Clear之前的命令类型都是save/clip/matrix等状态命令, 不产生像素
+inline bool IsStateOp(SkRecords::Type type)
+{
+    return type < SkRecords::Clear_Type;
+}
+
+//把命令回放到一个条带. 条带画布的原点平移到了条带顶部,
+//SkRecords::Draw把平移作为初始矩阵处理, 只有使用设备坐标的clipRegion和drawSprite需要另外平移.
+class BandDraw : public SkRecords::Draw {
+  public:
+    BandDraw(SkCanvas *canvas, int nTop)
+        : SkRecords::Draw(canvas)
+        , m_canvas(canvas)
+        , m_nTop(nTop)
+    {
+    }
+
+    template <typename T>
+    void operator()(const T &r)
+    {
+        SkRecords::Draw::operator()(r);
+    }
+
+    void operator()(const SkRecords::ClipRegion &r)
+    {
+        SkRegion rgn(r.region);
+        rgn.translate(0, -m_nTop);
+        m_canvas->clipRegion(rgn, r.op);
+    }
+
+    void operator()(const SkRecords::DrawSprite &r)
+    {
+        SkBitmap bmp = r.bitmap; //各线程使用自己的SkBitmap对象锁定像素
+        m_canvas->drawSprite(bmp, r.left, r.top - m_nTop, r.paint);
+    }
+
+  private:
+    SkCanvas *m_canvas;
+    int m_nTop;
+};
+
+//在调用线程中计算路径的边界和凸性缓存, 避免多个条带线程同时写缓存
+struct PrepareOp
+{
+    template <typename T>
+    void operator()(const T &)
+    {
+    }
+
+    void operator()(const SkRecords::DrawPath &r)
+    {
+        r.path.getBounds();
+        r.path.getConvexity();
+    }
+
+    void operator()(const SkRecords::ClipPath &r)
+    {
+        r.path.getBounds();
+        r.path.getConvexity();
+    }
+};
+
+} // namespace
+
+//收集SkRecordFillBounds计算的每条命令的设备坐标范围. 命令按序号递增插入, 范围为空的命令不插入.
+class SkTiledRecording::BoundsCollector : public SkBBoxHierarchy {
+  public:
+    BoundsCollector(SkTDArray<OpBounds> &ops)
+        : m_ops(ops)
+    {
+    }
+
+    virtual void insert(void *data, const SkRect &bounds, bool defer) SK_OVERRIDE
+    {
+        OpBounds *op = m_ops.append();
+        op->index = (unsigned)(uintptr_t)data;
+        op->bounds = bounds;
+    }
+
+    virtual void flushDeferredInserts() SK_OVERRIDE
+    {
+    }
+
+    virtual void search(const SkRect &query, SkTDArray<void *> *results) const SK_OVERRIDE
+    {
+        for (int i = 0; i < m_ops.count(); i++)
+        {
+            if (SkRect::Intersects(m_ops[i].bounds, query))
+                *results->append() = (void *)(uintptr_t)m_ops[i].index;
+        }
+    }
+
+    virtual void clear() SK_OVERRIDE
+    {
+        m_ops.reset();
+    }
+
+    virtual int getCount() const SK_OVERRIDE
+    {
+        return m_ops.count();
+    }
+
+    virtual int getDepth() const SK_OVERRIDE
+    {
+        return -1;
+    }
+
+    virtual void rewindInserts() SK_OVERRIDE
+    {
+    }
+
+  private:
+    SkTDArray<OpBounds> &m_ops;
+};
+
+struct SkTiledRecording::FlushCtx
+{
+    const SkRecord *record;
+    const SkTDArray<OpBounds> *ops;
+    unsigned nDrawn;
+    SkImageInfo info;
+    char *pixels;
+    size_t rowBytes;
+    int iFirstBand;
+    SkIRect rcDirty;
+};
+
+SkTiledRecording::SkTiledRecording(int nWid, int nHei)
+    : m_nDrawn(0)
+    , m_nWid(nWid)
+    , m_nHei(nHei)
+{
+    m_record = SkNEW(SkRecord);
+    m_recorder = SkNEW_ARGS(SkRecorder, (m_record, nWid, nHei, true));
+}
+
+SkTiledRecording::~SkTiledRecording()
+{
+    m_recorder->unref();
+    SkDELETE(m_record);
+}
+
+SkCanvas *SkTiledRecording::canvas()
+{
+    return m_recorder;
+}
+
+bool SkTiledRecording::isDirty() const
+{
+    return m_record->count() > m_nDrawn;
+}
+
+void SkTiledRecording::DrawBand(void *ctx, int iBand)
+{
+    const FlushCtx *flush = (const FlushCtx *)ctx;
+    iBand += flush->iFirstBand;
+    int nTop = iBand * kBandHeight;
+    int nHei = SkTMin((int)kBandHeight, flush->info.height() - nTop);
+
+    SkBitmap bmpBand;
+    bmpBand.installPixels(flush->info.makeWH(flush->info.width(), nHei), flush->pixels + nTop * flush->rowBytes, flush->rowBytes);
+    SkCanvas canvas(bmpBand);
+    SkRect rcBand = SkRect::MakeLTRB(0, (SkScalar)SkTMax(nTop, flush->rcDirty.fTop), (SkScalar)flush->info.width(), (SkScalar)SkTMin(nTop + nHei, flush->rcDirty.fBottom));
+    canvas.translate(0, -(SkScalar)nTop);
+    BandDraw draw(&canvas, nTop);
+
+    OpType opType;
+    const SkTDArray<OpBounds> &ops = *flush->ops;
+    for (int i = 0; i < ops.count(); i++)
+    {
+        const OpBounds &op = ops[i];
+        if (!SkRect::Intersects(op.bounds, rcBand))
+            continue;
+        if (op.index < flush->nDrawn && !IsStateOp(flush->record->visit<SkRecords::Type>(op.index, opType)))
+            continue; //已经光栅化过
+        flush->record->visit<void>(op.index, draw);
+    }
+}
+
+void SkTiledRecording::flush(const SkBitmap &bmp, SkTileWorkers *workers)
+{
+    unsigned nCount = m_record->count();
+    if (nCount <= m_nDrawn)
+        return;
+    SkASSERT(bmp.width() == m_nWid && bmp.height() == m_nHei);
+
+    SkTDArray<OpBounds> ops;
+    {
+        BoundsCollector collector(ops);
+        SkRecordFillBounds(*m_record, &collector);
+    }
+
+    //新录制的绘制命令覆盖的区域
+    OpType opType;
+    PrepareOp prepare;
+    SkRect rcDirty = SkRect::MakeEmpty();
+    for (int i = 0; i < ops.count(); i++)
+    {
+        if (ops[i].index < m_nDrawn)
+            continue;
+        m_record->visit<void>(ops[i].index, prepare);
+        if (!IsStateOp(m_record->visit<SkRecords::Type>(ops[i].index, opType)))
+            rcDirty.join(ops[i].bounds);
+    }
+    //没有固有范围的命令(如clear)的范围是最大的SkRect, 先裁剪到位图再取整
+    SkIRect irDirty;
+    if (rcDirty.intersect(0, 0, (SkScalar)m_nWid, (SkScalar)m_nHei))
+    {
+        rcDirty.roundOut(&irDirty);
+        SkAutoLockPixels alp(bmp);
+        FlushCtx ctx;
+        ctx.record = m_record;
+        ctx.ops = &ops;
+        ctx.nDrawn = m_nDrawn;
+        ctx.info = bmp.info();
+        ctx.pixels = (char *)bmp.getPixels();
+        ctx.rowBytes = bmp.rowBytes();
+        ctx.iFirstBand = irDirty.fTop / kBandHeight;
+        ctx.rcDirty = irDirty;
+        int nBands = (irDirty.fBottom + kBandHeight - 1) / kBandHeight - ctx.iFirstBand;
+        if (ctx.pixels)
+        {
+            if (workers && irDirty.width() * irDirty.height() >= kMinParallelArea)
+            {
+                workers->run(nBands, &SkTiledRecording::DrawBand, &ctx);
+            }
+            else
+            {
+                for (int i = 0; i < nBands; i++)
+                    DrawBand(&ctx, i);
+            }
+            bmp.notifyPixelsChanged();
+        }
+    }
+    m_nDrawn = nCount;
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <core/SkCanvas.h>
+#include <core/SkBitmap.h>
+#include <core/SkTDArray.h>
+#include <helper/SCriticalSection.h>
+
+class SkRecord;
+class SkRecorder;
+class SkThread;
+class SkCondVar;
+
+//光栅化工作线程池: run把一批编号[0,nCount)的任务分给工作线程, 调用线程也参与执行, 全部完成后返回.
+//多个线程同时调用run时依次执行.
+class SkTileWorkers {
+public:
+    //nThreads: 工作线程数, 0表示CPU核数-1
+    SkTileWorkers(int nThreads = 0);
+    ~SkTileWorkers();
+
+    int threads() const { return m_threads.count(); }
+
+    void run(int nCount, void (*proc)(void *ctx, int i), void *ctx);
+
+private:
+    struct Job {
+        void (*proc)(void *ctx, int i);
+        void *ctx;
+        int32_t nCount;
+        int32_t nNext;  //下一个待领取的任务
+        int32_t nDone;  //已完成的任务数
+        int32_t nUsers; //持有该Job的工作线程数
+    };
+
+    static void Loop(void *arg);
+    static void Work(Job *job);
+
+    SkTDArray<SkThread *> m_threads;
+    SkCondVar *m_cond;
+    Job *m_job;          //当前的Job, 由m_cond保护
+    uint32_t m_jobId;    //每次run加1, 工作线程据此判断是否有新Job
+    bool m_bDraining;
+    SOUI::SCriticalSection m_csRun;
+};
+
+//录制的绘制命令, 按水平条带(band)回放到位图, 各条带互不重叠, 可以并行光栅化.
+//条带划分只与位图尺寸有关, 与线程数无关, 所以结果是确定的.
+//flush只光栅化上次flush以后录制的绘制命令, save/clip/matrix等状态命令总是重放, 所以flush后可以继续录制.
+//在saveLayer中flush会使图层重复合成, 录制期间不要使用saveLayer.
+//录制的位图引用pixelref, 在flush之前不能修改, SRenderTarget_Skia::RecordableBitmap传入的都是只读副本.
+class SkTiledRecording {
+public:
+    enum {
+        kBandHeight = 64,              //条带高度
+        kMinParallelArea = 256 * 256,  //待光栅化区域小于它时在调用线程中回放
+    };
+
+    SkTiledRecording(int nWid, int nHei);
+    ~SkTiledRecording();
+
+    //录制画布, 与SkTiledRecording同生命周期
+    SkCanvas *canvas();
+
+    //是否有未光栅化的绘制命令
+    bool isDirty() const;
+
+    //把上次flush以后录制的绘制命令光栅化到bmp. bmp的尺寸必须和录制尺寸相同.
+    //workers: 可以为NULL, 此时在调用线程中光栅化.
+    void flush(const SkBitmap &bmp, SkTileWorkers *workers);
+
+private:
+    struct OpBounds {
+        unsigned index;
+        SkRect bounds;
+    };
+    class BoundsCollector;
+    struct FlushCtx;
+
+    static void DrawBand(void *ctx, int iBand);
+
+    SkRecord *m_record;
+    SkRecorder *m_recorder;
+    unsigned m_nDrawn; //已经光栅化的命令数
+    int m_nWid, m_nHei;
+};
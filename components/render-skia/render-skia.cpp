@@ -171,7 +171,7 @@ SNSBEGIN
 	//////////////////////////////////////////////////////////////////////////
 	// SRenderFactory_Skia
 
-	SRenderFactory_Skia::SRenderFactory_Skia()
+	SRenderFactory_Skia::SRenderFactory_Skia():m_tileWorkers(NULL)
 	{
 		SkGraphics::Init();
 		SkGraphics::SetFontCacheCountLimit(500);//cache up to 500 font resource.
@@ -188,6 +188,7 @@ SNSBEGIN
 
 	SRenderFactory_Skia::~SRenderFactory_Skia()
 	{
+		delete m_tileWorkers;
 		m_defFont = NULL;
 		SkGraphics::Term();
 	}
@@ -202,6 +203,16 @@ SNSBEGIN
 		return m_imgDecoderFactory;
 	}
 
+	static int s_nTileThreads = 0;//见Render_Skia_SetTileThreads
+
+	SkTileWorkers * SRenderFactory_Skia::GetTileWorkers()
+	{
+		SAutoLock lock(m_csTileWorkers);
+		if(!m_tileWorkers)
+			m_tileWorkers = new SkTileWorkers(s_nTileThreads);
+		return m_tileWorkers->threads()>0?m_tileWorkers:NULL;
+	}
+
 	BOOL SRenderFactory_Skia::CreateRenderTarget( IRenderTarget ** ppRenderTarget ,int nWid,int nHei)
 	{
 		*ppRenderTarget = new SRenderTarget_Skia(this, nWid, nHei);
@@ -324,6 +335,10 @@ SNSBEGIN
 		,m_bAntiAlias(true)
 		,m_xferMode(kSrcOver_Mode)
 		,m_lastSave(0)
+		,m_bRecord(FALSE)
+		,m_recording(NULL)
+		,m_SkCanvasRaster(NULL)
+		,m_nRecordDepth(0)
 	{
 		m_ptOrg.fX=m_ptOrg.fY=0.0f;
 		m_pRenderFactory = pRenderFactory;
@@ -357,15 +372,121 @@ SNSBEGIN
 
 	SRenderTarget_Skia::~SRenderTarget_Skia()
 	{
+		FlushRecording();
+		EndRecording();
 		if(m_SkCanvas) delete m_SkCanvas;
+		if(m_curBmp) m_curBmp->AddSelectCount(-1);
+	}
+
+	//画布处于初始状态:没有save,没有变换,剪裁区是整个位图
+	static bool IsCanvasReset(SkCanvas *pCanvas)
+	{
+		if(pCanvas->getSaveCount()!=1 || !pCanvas->getTotalMatrix().isIdentity() || !pCanvas->isClipRect())
+			return false;
+		SkIRect rcClip;
+		if(!pCanvas->getClipDeviceBounds(&rcClip))
+			return false;
+		SkISize sz = pCanvas->getDeviceSize();
+		return rcClip == SkIRect::MakeSize(sz);
+	}
+
+	void SRenderTarget_Skia::BeginDraw(THIS)
+	{
+		if(m_recording)
+		{
+			m_nRecordDepth++;
+			return;
+		}
+		if(!m_bRecord || m_hGetDC)
+			return;
+		const SkBitmap & bmp = m_curBmp->GetSkBitmap();
+		if(bmp.width()*bmp.height() < SkTiledRecording::kMinParallelArea || !IsCanvasReset(m_SkCanvas))
+			return;
+		if(!static_cast<SRenderFactory_Skia*>((IRenderFactory*)m_pRenderFactory)->GetTileWorkers())
+			return;//单核时直接绘制
+		m_recording = new SkTiledRecording(bmp.width(),bmp.height());
+		m_SkCanvasRaster = m_SkCanvas;
+		m_SkCanvas = m_recording->canvas();
+		m_nRecordDepth = 1;
 	}
 
 	void SRenderTarget_Skia::EndDraw(THIS) {
+		if(m_recording && m_nRecordDepth>0 && --m_nRecordDepth==0)
+		{
+			FlushRecording();
+			//画布状态恢复到初始状态才能换回直接绘制的画布,否则继续录制
+			if(IsCanvasReset(m_SkCanvas))
+				EndRecording();
+		}
 		#ifndef _WIN32
 		m_curBmp->MarkDirty();
 		#endif//_WIN32
 	}
 
+	BOOL SRenderTarget_Skia::EnableRecording(THIS_ BOOL bEnable)
+	{
+		m_bRecord = bEnable;
+		return TRUE;
+	}
+
+	void SRenderTarget_Skia::FlushRecording()
+	{
+		if(!m_recording || !m_recording->isDirty())
+			return;
+		m_recording->flush(m_curBmp->GetSkBitmap(),static_cast<SRenderFactory_Skia*>((IRenderFactory*)m_pRenderFactory)->GetTileWorkers());
+	}
+
+	void SRenderTarget_Skia::EndRecording()
+	{
+		if(!m_recording)
+			return;
+		SASSERT(!m_recording->isDirty());
+		m_SkCanvas = m_SkCanvasRaster;
+		m_SkCanvasRaster = NULL;
+		delete m_recording;
+		m_recording = NULL;
+		m_nRecordDepth = 0;
+	}
+
+	const SkBitmap & SRenderTarget_Skia::RecordableBitmap(SBitmap_Skia *pBmp, SkRect *prcSrc, SkBitmap &bmpCopy)
+	{
+		if(!m_recording)
+			return pBmp->GetSkBitmap();
+		if(pBmp->GetSelectCount()==0)
+		{//图片:引用像素副本的pixelref,图片在flush前被改写或释放也不影响回放
+			return pBmp->GetImmutableBitmap();
+		}
+		//绘制目标:内容还会改变,复制要用到的像素
+		if(pBmp == m_curBmp)
+			FlushRecording();
+		const SkBitmap & bmp = pBmp->GetSkBitmap();
+		SkIRect rcSub;
+		prcSrc->roundOut(&rcSub);
+		SkBitmap bmpSub;
+		if(!rcSub.intersect(0,0,bmp.width(),bmp.height()) || !bmp.extractSubset(&bmpSub,rcSub) || !bmpSub.copyTo(&bmpCopy))
+		{
+			bmpCopy.reset();
+			return bmpCopy;
+		}
+		bmpCopy.setImmutable();
+		prcSrc->offset(-(SkScalar)rcSub.fLeft,-(SkScalar)rcSub.fTop);
+		return bmpCopy;
+	}
+
+	void SRenderTarget_Skia::InitBrushPaint(SkPaint & paint,const SkRect & skrc)
+	{
+		if(m_recording && m_curBrush->GetBrushType()==Brush_Bitmap)
+		{//位图画刷的像素可能属于外部的HBITMAP,和图片一样录制只读副本
+			SBitmap_Skia *pBmp = static_cast<SBitmap_Skia*>(m_curBrush->GetBitmap());
+			SkRect rcBmp = SkRect::MakeWH((SkScalar)pBmp->Width(),(SkScalar)pBmp->Height());
+			SkBitmap bmpCopy;
+			const SkBitmap & bmp = RecordableBitmap(pBmp,&rcBmp,bmpCopy);
+			m_curBrush->InitPaint(paint,skrc,&bmp);
+			return;
+		}
+		m_curBrush->InitPaint(paint,skrc);
+	}
+
 	HRESULT SRenderTarget_Skia::CreatePen( int iStyle,COLORREF cr,int cWidth,IPenS ** ppPen )
 	{
 		*ppPen = new SPen_Skia(m_pRenderFactory,iStyle,cr,cWidth);
@@ -380,8 +501,7 @@ SNSBEGIN
 
 	HRESULT SRenderTarget_Skia::CreateBitmapBrush( IBitmapS *pBmp,TileMode xtm,TileMode ytm, IBrushS ** ppBrush )
 	{
-		SBitmap_Skia *pBmpSkia = (SBitmap_Skia*)pBmp;
-		*ppBrush = new SBrush_Skia(m_pRenderFactory,pBmpSkia->GetSkBitmap(),xtm,ytm);
+		*ppBrush = new SBrush_Skia(m_pRenderFactory,pBmp,xtm,ytm);
 		return S_OK;
 	}
 
@@ -398,6 +518,8 @@ SNSBEGIN
 
 	HRESULT SRenderTarget_Skia::Resize( SIZE sz )
 	{
+		FlushRecording();
+		EndRecording();
 		m_curBmp->Init(sz.cx,sz.cy,NULL);
 		delete m_SkCanvas;
 		m_SkCanvas = new SkCanvas(m_curBmp->GetSkBitmap());
@@ -491,17 +613,19 @@ SNSBEGIN
 		SetPaintXferMode(paint,dwRop);
 
 		SRenderTarget_Skia *pRtSourSkia=(SRenderTarget_Skia*)pRTSour;
-		const SkBitmap  &  bmpSrc=pRtSourSkia->m_curBmp->GetSkBitmap();
+		pRtSourSkia->FlushRecording();
 		POINT ptSourViewport;
 		pRtSourSkia->GetViewportOrg(&ptSourViewport);
 		xSrc += ptSourViewport.x;
 		ySrc += ptSourViewport.y;
 
 
-		SkIRect isrc={xSrc,ySrc,xSrc + RectWid(pRcDest),ySrc+RectHei(pRcDest)};
+		SkRect rcSrc=SkRect::Make(SkIRect::MakeXYWH(xSrc,ySrc,RectWid(pRcDest),RectHei(pRcDest)));
+		SkBitmap bmpCopy;
+		const SkBitmap & bmpSrc=RecordableBitmap(pRtSourSkia->m_curBmp,&rcSrc,bmpCopy);
 		SkRect skrc=toSkRect(pRcDest);
 		skrc.offset(m_ptOrg);
-		m_SkCanvas->drawBitmapRect(bmpSrc,&isrc,skrc,&paint);
+		m_SkCanvas->drawBitmapRectToRect(bmpSrc,&rcSrc,skrc,&paint);
 		return S_OK;
 	}
 
@@ -541,16 +665,19 @@ SNSBEGIN
 			txtPaint.setTextAlign(SkPaint::kLeft_Align);
 		SkRect skrc=toSkRect(pRc);
 		skrc.offset(m_ptOrg);
+		SkTextLayoutCache *pCache = static_cast<SRenderFactory_Skia*>((IRenderFactory*)m_pRenderFactory)->GetTextLayoutCache();
+		SAutoRefPtr<SkTextLayoutEx> layout;
+		layout.Attach(pCache->getLayout(strW,strW.GetLength(),skrc,txtPaint,uFormat));
 		if(uFormat & DT_CALCRECT)
 		{
-			skrc=DrawText_Skia(m_SkCanvas,strW,strW.GetLength(),skrc,txtPaint,uFormat);
+			skrc=layout->draw(m_SkCanvas,skrc,txtPaint,uFormat);
 			pRc->left=(int)skrc.fLeft;
 			pRc->top=(int)skrc.fTop;
 			pRc->right=(int)skrc.fRight;
 			pRc->bottom=(int)skrc.fBottom;
 		}else if(m_curFont->LogFont()->lfEscapement!=0){
 			//calc draw size
-			SkRect skrcContent=DrawText_Skia(m_SkCanvas,strW,strW.GetLength(),skrc,txtPaint,uFormat|DT_CALCRECT);
+			SkRect skrcContent=layout->draw(m_SkCanvas,skrc,txtPaint,uFormat|DT_CALCRECT);
 			if(uFormat&DT_CENTER){
 				skrc.fLeft += (skrc.width()-skrcContent.width())/2;
 			}else if(uFormat&DT_RIGHT){
@@ -576,10 +703,12 @@ SNSBEGIN
 			mtx.postTranslate(fx,fy);
 			mtx.postConcat(oldMtx);
 			m_SkCanvas->setMatrix(mtx);
-			skrc=DrawText_Skia(m_SkCanvas,strW,strW.GetLength(),skrc,txtPaint,uFormat);
+			layout.Attach(pCache->getLayout(strW,strW.GetLength(),skrc,txtPaint,uFormat));
+			skrc=layout->draw(m_SkCanvas,skrc,txtPaint,uFormat);
 			m_SkCanvas->setMatrix(oldMtx);
 		}else{
-			DrawText_Skia(m_SkCanvas,strW,strW.GetLength(),skrc,txtPaint,uFormat);
+			SkGlyphAtlas *pAtlas = static_cast<SRenderFactory_Skia*>((IRenderFactory*)m_pRenderFactory)->GetGlyphAtlas();
+			layout->draw(m_SkCanvas,skrc,txtPaint,uFormat,pAtlas);
 		}
 		return S_OK;
 	}
@@ -590,10 +719,13 @@ SNSBEGIN
 		txtPaint.setTypeface(m_curFont->GetFont());
 		txtPaint.setTextSize(SkIntToScalar(abs(m_curFont->TextSize())));
 		SStringW strW=S_CT2W(SStringT(pszText,cchLen));
-		psz->cx = (int)txtPaint.measureText(strW,strW.GetLength()*sizeof(wchar_t));
+		//shares the layout of single line text drawn with DT_NOPREFIX.
+		SkTextLayoutCache *pCache = static_cast<SRenderFactory_Skia*>((IRenderFactory*)m_pRenderFactory)->GetTextLayoutCache();
+		SAutoRefPtr<SkTextLayoutEx> layout;
+		layout.Attach(pCache->getLayout(strW,strW.GetLength(),SkRect::MakeEmpty(),txtPaint,DT_SINGLELINE|DT_NOPREFIX));
+		psz->cx = (int)layout->width();
 
-		SkPaint::FontMetrics metrics;
-		txtPaint.getFontMetrics(&metrics);
+		const SkPaint::FontMetrics &metrics = layout->metrics();
 		psz->cy = (int)(metrics.fBottom-metrics.fTop);
 		return S_OK;
 	}
@@ -634,7 +766,7 @@ SNSBEGIN
 
 		SkRect skrc=toSkRect(pRect);
 		skrc.offset(m_ptOrg);
-		m_curBrush->InitPaint(paint,skrc);
+		InitBrushPaint(paint,skrc);
 		InflateSkRect(&skrc,-0.5f,-0.5f);
 		m_SkCanvas->drawRect(skrc,paint);
 		return S_OK;
@@ -672,7 +804,7 @@ SNSBEGIN
 		SkRect skrc=toSkRect(pRect);
 		InflateSkRect(&skrc,-0.5f,-0.5f);//要缩小0.5显示效果才和GDI一致。
 		skrc.offset(m_ptOrg);
-		m_curBrush->InitPaint(paint,skrc);
+		InitBrushPaint(paint,skrc);
 
 		m_SkCanvas->drawRoundRect(skrc,(SkScalar)pt.x,(SkScalar)pt.y,paint);
 		return S_OK;
@@ -799,7 +931,6 @@ SNSBEGIN
 	HRESULT SRenderTarget_Skia::DrawBitmap(LPCRECT pRcDest,const IBitmapS *pBitmap,int xSrc,int ySrc,BYTE byAlpha/*=0xFF*/ )
 	{
 		SBitmap_Skia *pBmp = (SBitmap_Skia*)pBitmap;
-		const SkBitmap & bmp=pBmp->GetSkBitmap();
 
 		SIZE szBmp = pBmp->Size();
 		int nWid= (std::min)(pRcDest->right-pRcDest->left,szBmp.cx);
@@ -813,6 +944,8 @@ SNSBEGIN
 
 		skrcDst.offset(m_ptOrg);
 
+		SkBitmap bmpCopy;
+		const SkBitmap & bmp=RecordableBitmap(pBmp,&skrcSrc,bmpCopy);
 		SkPaint paint=m_paint;
 		BYTE oldAlpha = paint.getAlpha();
 		paint.setAlpha(byAlpha);
@@ -850,11 +983,12 @@ SNSBEGIN
 			return DrawBitmap(pRcDest,pBitmap,pRcSrc->left,pRcSrc->top,byAlpha);
 
 		SBitmap_Skia *pBmp = (SBitmap_Skia*)pBitmap;
-		const SkBitmap & bmp=pBmp->GetSkBitmap();
 
-		RECT rcSour={0,0,bmp.width(),bmp.height()};
+		RECT rcSour={0,0,(LONG)pBmp->Width(),(LONG)pBmp->Height()};
 		if(!pRcSrc) pRcSrc = &rcSour;
 		SkRect rcSrc = toSkRect(pRcSrc);
+		SkBitmap bmpCopy;
+		const SkBitmap & bmp=RecordableBitmap(pBmp,&rcSrc,bmpCopy);
 		SkRect rcDest= toSkRect(pRcDest);
 		rcDest.offset(m_ptOrg);
 
@@ -873,15 +1007,16 @@ SNSBEGIN
 		{
 			PushClipRect(pRcDest,RGN_AND);
 
-			SkIRect rcSrc = toSkIRect(pRcSrc);
-			SkRect rcSubDest={0.0f,0.0f,(float)rcSrc.width(),(float)rcSrc.height()};
-			for(float y=rcDest.fTop;y<rcDest.fBottom;y+=rcSrc.height())
+			SkIRect rcSrcTile;//录制时rcSrc已调整为副本中的坐标
+			rcSrc.round(&rcSrcTile);
+			SkRect rcSubDest={0.0f,0.0f,(float)rcSrcTile.width(),(float)rcSrcTile.height()};
+			for(float y=rcDest.fTop;y<rcDest.fBottom;y+=rcSrcTile.height())
 			{
 				rcSubDest.offsetTo(rcDest.fLeft,y);               
-				for(float x=rcDest.fLeft;x<rcDest.fRight;x += rcSrc.width())
+				for(float x=rcDest.fLeft;x<rcDest.fRight;x += rcSrcTile.width())
 				{
-					m_SkCanvas->drawBitmapRect(bmp,&rcSrc,rcSubDest,&paint);
-					rcSubDest.offset((float)rcSrc.width(),0.0f);
+					m_SkCanvas->drawBitmapRect(bmp,&rcSrcTile,rcSubDest,&paint);
+					rcSubDest.offset((float)rcSrcTile.width(),0.0f);
 				}
 			}
 
@@ -973,6 +1108,7 @@ SNSBEGIN
 		switch(uType)
 		{
 		case OT_BITMAP: 
+			FlushRecording();//调用者可能读取位图
 			pRet=m_curBmp;
 			break;
 		case OT_PEN:
@@ -1011,8 +1147,12 @@ SNSBEGIN
 		switch(pObj->ObjectType())
 		{
 		case OT_BITMAP: 
+			FlushRecording();
+			EndRecording();
 			pRet=m_curBmp;
+			if(m_curBmp) m_curBmp->AddSelectCount(-1);
 			m_curBmp=(SBitmap_Skia*)pObj;
+			m_curBmp->AddSelectCount(1);
 			//重新生成clip
 			SASSERT(m_SkCanvas);
 			delete m_SkCanvas;
@@ -1077,6 +1217,7 @@ SNSBEGIN
 			return m_hGetDC;
 		}
 
+		FlushRecording();//GDI直接修改位图
 		HBITMAP bmp=m_curBmp->GetGdiBitmap();//bmp可能为NULL
 		HDC hdc_desk = ::GetDC(0);
 		m_hGetDC = CreateCompatibleDC(hdc_desk);
@@ -1360,7 +1501,7 @@ SNSBEGIN
 		paint.setStyle(SkPaint::kFill_Style);
 		SkRect skrc=toSkRect(pRect);
 		skrc.offset(m_ptOrg);
-		m_curBrush->InitPaint(paint,skrc);
+		InitBrushPaint(paint,skrc);
 		m_SkCanvas->drawOval(skrc,paint);
 		return S_OK;
 	}
@@ -1421,7 +1562,7 @@ SNSBEGIN
 		m_SkCanvas->rotate(startAngle);
 		SkRect skrc2 = skrc;
 		skrc2.offset(-skrc.centerX(), -skrc.centerY());
-		m_curBrush->InitPaint(paint, skrc2);
+		InitBrushPaint(paint, skrc2);
 		
 		if (!m_curBrush->IsFullArc()) {
 			SkMatrix matrix;
@@ -1440,7 +1581,7 @@ SNSBEGIN
 		paint.setStyle(SkPaint::kFill_Style);
 		SkRect skrc=toSkRect(pRect);
 		skrc.offset(m_ptOrg);
-		m_curBrush->InitPaint(paint,skrc);
+		InitBrushPaint(paint,skrc);
 		m_SkCanvas->drawArc(skrc,startAngle, sweepAngle,true,paint);
 		return S_OK;
 	}
@@ -1488,6 +1629,7 @@ SNSBEGIN
 	COLORREF SRenderTarget_Skia::GetPixel( int x, int y )
 	{
 		if(!m_curBmp) return CR_INVALID;
+		FlushRecording();
 		const COLORREF *pBits = (const COLORREF*)m_curBmp->GetPixelBits();
 		POINT pt;
 		GetViewportOrg(&pt);
@@ -1502,6 +1644,7 @@ SNSBEGIN
 	COLORREF SRenderTarget_Skia::SetPixel( int x, int y, COLORREF cr )
 	{
 		if(!m_curBmp) return CR_INVALID;
+		FlushRecording();
 		COLORREF *pBits = (COLORREF*)m_curBmp->LockPixelBits();
 		POINT pt;
 		GetViewportOrg(&pt);
@@ -1570,7 +1713,7 @@ SNSBEGIN
 		SkPath skPath;
 		path2->m_skPath.offset(m_ptOrg.fX,m_ptOrg.fY,&skPath);
 		const SkRect &rcBound = skPath.getBounds();
-		m_curBrush->InitPaint(paint,rcBound);
+		InitBrushPaint(paint,rcBound);
 
 		m_SkCanvas->drawPath(skPath,paint);
 
@@ -1661,13 +1804,14 @@ SNSBEGIN
 	//////////////////////////////////////////////////////////////////////////
 	// SBitmap_Skia
 	static int s_cBmp = 0;
-	SBitmap_Skia::SBitmap_Skia( IRenderFactory *pRenderFac ) :TSkiaRenderObjImpl<IBitmapS,OT_BITMAP>(pRenderFac),m_hBmp(0)
+	SBitmap_Skia::SBitmap_Skia( IRenderFactory *pRenderFac ) :TSkiaRenderObjImpl<IBitmapS,OT_BITMAP>(pRenderFac),m_hBmp(0),m_nSelected(0)
 	{
 		//         STRACE(L"bitmap new; objects = %d",++s_cBmp);
 	}
 
 	SBitmap_Skia::~SBitmap_Skia()
 	{
+		m_bmpImmutable.reset();
 		m_bitmap.reset();
 		if(m_hBmp) DeleteObject(m_hBmp);
 		//         STRACE(L"bitmap delete objects = %d",--s_cBmp);
@@ -1691,8 +1835,28 @@ SNSBEGIN
 		return hBmp;
 	}
 
+	const SkBitmap & SBitmap_Skia::GetImmutableBitmap()
+	{
+		if(m_bmpImmutable.isNull() && m_bitmap.getPixels())
+		{//复制像素:m_bitmap的像素属于m_hBmp,录制的命令不能持有它
+			if(m_bitmap.copyTo(&m_bmpImmutable))
+				m_bmpImmutable.setImmutable();
+			else
+				m_bmpImmutable.reset();
+		}
+		return m_bmpImmutable;
+	}
+
+	void SBitmap_Skia::AddSelectCount(int nDelta)
+	{
+		m_nSelected += nDelta;
+		if(m_nSelected>0)
+			m_bmpImmutable.reset();
+	}
+
 	HRESULT SBitmap_Skia::Init( int nWid,int nHei ,const LPVOID pBits/*=NULL*/)
 	{
+		m_bmpImmutable.reset();
 		m_bitmap.reset();
 		m_bitmap.setInfo(SkImageInfo::Make(nWid,nHei,kN32_SkColorType,kPremul_SkAlphaType));
 		if(m_hBmp) DeleteObject(m_hBmp);
@@ -1717,6 +1881,7 @@ SNSBEGIN
 		pFrame->GetSize(&uWid,&uHei);
 
 		if(m_hBmp) DeleteObject(m_hBmp);
+		m_bmpImmutable.reset();
 		m_bitmap.reset();
 		m_bitmap.setInfo(SkImageInfo::Make(uWid, uHei,kN32_SkColorType,kPremul_SkAlphaType));
 		void * pBits=NULL;
@@ -1758,6 +1923,7 @@ SNSBEGIN
 		pFrame->GetSize(&uWid,&uHei);
 
 		if(m_hBmp) DeleteObject(m_hBmp);
+		m_bmpImmutable.reset();
 		m_bitmap.reset();
 		m_bitmap.setInfo(SkImageInfo::Make(uWid, uHei,kN32_SkColorType,kPremul_SkAlphaType));
 		void * pBits=NULL;
@@ -1788,6 +1954,7 @@ SNSBEGIN
 
 	LPVOID SBitmap_Skia::LockPixelBits()
 	{
+		m_bmpImmutable.reset();//像素将被修改
 		return m_bitmap.getPixels();
 	}
 
@@ -2218,10 +2385,11 @@ SNSBEGIN
 		memcpy(m_arrGradItem.GetData(),pGradients,sizeof(GradientItem)*nCount);
 	}
 
-	SBrush_Skia::SBrush_Skia(IRenderFactory * pRenderFac,SkBitmap bmp,TileMode xtm,TileMode ytm)
+	SBrush_Skia::SBrush_Skia(IRenderFactory * pRenderFac,IBitmapS *pBmp,TileMode xtm,TileMode ytm)
 		:TSkiaRenderObjImpl<IBrushS,OT_BRUSH>(pRenderFac),m_brushType(Brush_Bitmap)
 	{
-		m_bmp = bmp;
+		m_pBmp = pBmp;
+		m_bmp = static_cast<SBitmap_Skia*>(pBmp)->GetSkBitmap();
 		m_xtm = (SkShader::TileMode)xtm;
 		m_ytm = (SkShader::TileMode)ytm;
 	}
@@ -2237,7 +2405,7 @@ SNSBEGIN
 	{
 	}
 
-	void SBrush_Skia::InitPaint(SkPaint & paint,const SkRect & skrc)
+	void SBrush_Skia::InitPaint(SkPaint & paint,const SkRect & skrc,const SkBitmap *pBmp)
 	{
 		if(m_brushType == Brush_Color)
 		{
@@ -2246,7 +2414,7 @@ SNSBEGIN
 		}else if(m_brushType == Brush_Bitmap){
 			SkMatrix mtx;
 			mtx.setTranslate(skrc.fLeft,skrc.fTop);
-			paint.setShader(SkShader::CreateBitmapShader(m_bmp,m_xtm,m_ytm,&mtx))->unref();
+			paint.setShader(SkShader::CreateBitmapShader(pBmp?*pBmp:m_bmp,m_xtm,m_ytm,&mtx))->unref();
 		}else//if(m_brushType == Brush_Shader)
 		{
 			SkShader *pShader = CreateShader(skrc,&m_gradInfo,m_arrGradItem.GetData(),m_arrGradItem.GetCount(),m_byAlpha,m_tileMode);
@@ -2690,10 +2858,12 @@ EXTERN_C BOOL Render_Skia_SCreateInstance(IObjRef ** ppRenderFactory)
 }
 
 static FontFallback s_fontFallback=NULL;
+static SOUI::SCriticalSection s_csFontFallback;//录制的文字可能在多个工作线程中光栅化
 SkTypeface *SkiaFontFallback(SkTypeface *font, const wchar_t *text, size_t len)
 {
 	if(!s_fontFallback)
 		return NULL;
+	SOUI::SAutoLock lock(s_csFontFallback);
 	SkString curFontName;
 	font->getFamilyName(&curFontName);
 
@@ -2705,6 +2875,11 @@ SkTypeface *SkiaFontFallback(SkTypeface *font, const wchar_t *text, size_t len)
 }
 
 
+EXTERN_C void Render_Skia_SetTileThreads(int nThreads)
+{
+	SOUI::s_nTileThreads = nThreads;
+}
+
 EXTERN_C void Render_Skia_SetFontFallback(FontFallback fontFallback)
 {
 	s_fontFallback = fontFallback;
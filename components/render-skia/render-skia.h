@@ -12,6 +12,8 @@
 #include <string/strcpcvt.h>
 #include <souicoll.h>
 #include <core/SkShader.h>
+#include "drawtext-skia.h"
+#include "record-skia.h"
 SNSBEGIN
 
 //////////////////////////////////////////////////////////////////////////
@@ -46,9 +48,24 @@ public:
     STDMETHOD_(IFontS *,GetDefFont)(CTHIS) OVERRIDE{
 		return m_defFont;
 	}
+
+	SkTextLayoutCache * GetTextLayoutCache() {
+		return &m_textLayoutCache;
+	}
+
+	SkGlyphAtlas * GetGlyphAtlas() {
+		return &m_glyphAtlas;
+	}
+
+	//录制模式下回放绘制命令的工作线程池, 第一次使用时创建, 线程数见Render_Skia_SetTileThreads. 没有工作线程时返回NULL
+	SkTileWorkers * GetTileWorkers();
 protected:
 	SAutoRefPtr<IImgDecoderFactory> m_imgDecoderFactory;
 	SAutoRefPtr<IFontS> m_defFont;
+	SkTextLayoutCache m_textLayoutCache; //shared by all render targets created by this factory
+	SkGlyphAtlas m_glyphAtlas;           //rasterized glyphs shared by all render targets created by this factory
+	SkTileWorkers *m_tileWorkers;        //shared by all render targets created by this factory
+	SCriticalSection m_csTileWorkers;
 };
 
 
@@ -150,7 +167,7 @@ class SBrush_Skia : public TSkiaRenderObjImpl<IBrushS,OT_BRUSH>
 {
 public:
 	SBrush_Skia(IRenderFactory * pRenderFac,COLORREF cr);
-	SBrush_Skia(IRenderFactory * pRenderFac,SkBitmap bmp,TileMode xtm,TileMode ytm);
+	SBrush_Skia(IRenderFactory * pRenderFac,IBitmapS *pBmp,TileMode xtm,TileMode ytm);
 	SBrush_Skia(IRenderFactory * pRenderFac,const GradientItem *pGradients, int nCount, const GradientInfo *info, BYTE byAlpha,TileMode tileMode);
 
 	~SBrush_Skia();
@@ -159,13 +176,16 @@ public:
 	STDMETHOD_(BrushType,GetBrushType)(CTHIS) SCONST OVERRIDE{
 		return m_brushType;
 	}
-	void InitPaint(SkPaint & paint,const SkRect & skrc);
+	//pBmp: 录制时代替位图画刷位图的只读副本
+	void InitPaint(SkPaint & paint,const SkRect & skrc,const SkBitmap *pBmp=NULL);
 	BOOL IsFullArc() const;
+	IBitmapS * GetBitmap() const {return m_pBmp;}
 protected:
 	BrushType m_brushType;
 
 	SkColor m_cr;		//颜色画刷
 	SkBitmap  m_bmp;	//位图画刷
+	SAutoRefPtr<IBitmapS> m_pBmp;	//位图画刷的位图, 保证m_bmp引用的像素有效
 	SkShader::TileMode m_xtm,m_ytm;
 	//gradient info
 	int m_nWid,m_nHei;
@@ -221,6 +241,14 @@ public:
 		MarkPixmapDirty(m_hBmp);
 	}
 	#endif//_WIN32
+
+	//m_bitmap的只读副本,有自己的pixelref. 录制的绘制命令引用该pixelref,之后改写或释放位图不影响回放.
+	//副本在像素可能被改写时丢弃,下次录制时重新复制
+	const SkBitmap & GetImmutableBitmap();
+
+	//被选入渲染目标的次数,大于0时位图是绘制目标,内容随时可能改变
+	int GetSelectCount() const {return m_nSelected;}
+	void AddSelectCount(int nDelta);
 protected:
 	HBITMAP CreateGDIBitmap(int nWid,int nHei,void ** ppBits);
 
@@ -228,6 +256,8 @@ protected:
 
 	SkBitmap    m_bitmap;   //skia 管理的BITMAP
 	HBITMAP     m_hBmp;     //标准的32位位图，和m_bitmap共享内存
+	SkBitmap    m_bmpImmutable; //见GetImmutableBitmap
+	int         m_nSelected;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -393,7 +423,7 @@ class SRenderTarget_Skia: public TObjRefImpl<IRenderTarget>
 public:
 	SRenderTarget_Skia(IRenderFactory* pRenderFactory,int nWid,int nHei);
 	~SRenderTarget_Skia();
-	STDMETHOD_(void, BeginDraw)(THIS) OVERRIDE{}
+	STDMETHOD_(void, BeginDraw)(THIS) OVERRIDE;
 	STDMETHOD_(void, EndDraw)(THIS) OVERRIDE;
 	STDMETHOD_(BOOL,IsOffscreen)(CTHIS) SCONST {return TRUE;}
 
@@ -472,13 +502,23 @@ public:
 	STDMETHOD_(HRESULT,SetXfermode)(THIS_ int mode,int *pOldMode=NULL) OVERRIDE;
 	STDMETHOD_(BOOL,SetAntiAlias)(THIS_ BOOL bAntiAlias) OVERRIDE;
 	STDMETHOD_(BOOL,GetAntiAlias)(THIS) SCONST OVERRIDE;
+	STDMETHOD_(BOOL,EnableRecording)(THIS_ BOOL bEnable) OVERRIDE;
 public:
 	SkCanvas *GetCanvas(){return m_SkCanvas;}
 
 protected:
 	bool SetPaintXferMode(SkPaint & paint,int nRopMode);
+
+	//把录制的绘制命令光栅化到位图
+	void FlushRecording();
+	//结束录制,恢复直接绘制的画布. 调用前需要FlushRecording
+	void EndRecording();
+	//录制时返回可以在flush时再读取的位图. 图片位图引用像素;绘制目标的位图复制prcSrc范围的像素,并把prcSrc调整为副本中的坐标
+	const SkBitmap & RecordableBitmap(SBitmap_Skia *pBmp, SkRect *prcSrc, SkBitmap &bmpCopy);
+	//用当前画刷初始化paint,录制时位图画刷使用位图的只读副本
+	void InitBrushPaint(SkPaint & paint,const SkRect & skrc);
 protected:
-	SkCanvas *m_SkCanvas;
+	SkCanvas *m_SkCanvas;	//当前画布,录制时是m_recording的录制画布
 	int		  m_lastSave;
 	SColor            m_curColor;
 	SAutoRefPtr<SBitmap_Skia> m_curBmp;
@@ -504,6 +544,11 @@ protected:
 	bool			m_bAntiAlias;
 	SList<int>		m_lstLayerId;	//list to save layer ids
 	int				m_xferMode;
+
+	BOOL			m_bRecord;			//EnableRecording
+	SkTiledRecording *m_recording;		//录制中的绘制命令
+	SkCanvas		*m_SkCanvasRaster;	//录制时保存的直接绘制画布
+	int				m_nRecordDepth;		//录制中BeginDraw的嵌套层数
 };
 
 namespace RENDER_SKIA
@@ -514,3 +559,5 @@ SNSEND
 
 EXTERN_C BOOL SOUI_COM_API Render_Skia_SCreateInstance(IObjRef ** ppRenderFactory);
 EXTERN_C void SOUI_COM_API Render_Skia_SetFontFallback(FontFallback fontFallback);
+//设置之后创建的渲染工厂回放录制命令的工作线程数, 0(默认)表示CPU核数-1
+EXTERN_C void SOUI_COM_API Render_Skia_SetTileThreads(int nThreads);
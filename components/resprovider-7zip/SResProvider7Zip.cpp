@@ -100,9 +100,10 @@ IImgX   * SResProvider7Zip::LoadImgX( LPCTSTR strType,LPCTSTR pszResName )
 	return pImgX;
 }
 
-BOOL SResProvider7Zip::_Init( LPCTSTR pszZipFile ,LPCSTR pszPsw)
+BOOL SResProvider7Zip::_Init( LPCTSTR pszZipFile ,LPCSTR pszPsw, BOOL bLazy, DWORD dwCacheSize)
 {
-	if (!m_zipFile.Open(pszZipFile, pszPsw)) return FALSE;
+	BOOL bOpen = bLazy ? m_zipFile.OpenLazy(pszZipFile, pszPsw, dwCacheSize) : m_zipFile.Open(pszZipFile, pszPsw);
+	if (!bOpen) return FALSE;
 	_InitFileMap();
 	return TRUE;
 }
@@ -129,7 +130,7 @@ BOOL SResProvider7Zip::Init( WPARAM wParam,LPARAM lParam )
 		m_childDir += _T("\\");
 	}
 	if (zipParam->type == ZIP7_FILE)
-		return _Init(zipParam->pszZipFile,zipParam->pszPsw);
+		return _Init(zipParam->pszZipFile,zipParam->pszPsw,zipParam->bLazy,zipParam->dwCacheSize);
 	else
 		return _Init(zipParam->peInfo.hInst,zipParam->peInfo.pszResName,zipParam->peInfo.pszResType,zipParam->pszPsw);
 }
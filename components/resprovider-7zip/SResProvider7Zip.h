@@ -32,7 +32,7 @@ public:
 	STDMETHOD_(void,EnumResource)(THIS_ EnumResCallback funEnumCB,LPARAM lp);
 	STDMETHOD_(void, EnumFile)(THIS_ EnumFileCallback funEnumCB, LPARAM lp);
 protected:
-    BOOL _Init(LPCTSTR pszZipFile ,LPCSTR pszPsw);
+    BOOL _Init(LPCTSTR pszZipFile ,LPCSTR pszPsw, BOOL bLazy, DWORD dwCacheSize);
     BOOL _Init(HINSTANCE hInst,LPCTSTR pszResName,LPCTSTR pszType ,LPCSTR pszPsw);
 	BOOL _InitFileMap();
 	SStringT _GetFilePath(LPCTSTR pszResName,LPCTSTR pszType);
@@ -1,6 +1,7 @@
 ﻿#include "Zip7Archive.h"
 #include <assert.h>
 #include <memory>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <crtdbg.h>
@@ -23,8 +24,49 @@
 
 namespace SevenZip{
 
+	CZipBlob::CZipBlob(const BYTE *pData, DWORD dwSize)
+		: m_nRef(1)
+		, m_dwSize(dwSize)
+	{
+		m_pData = (BYTE*)malloc(dwSize ? dwSize : 1);
+		if (dwSize)
+			memcpy(m_pData, pData, dwSize);
+	}
+
+	CZipBlob::~CZipBlob()
+	{
+		free(m_pData);
+	}
+
+	LONG CZipBlob::AddRef()
+	{
+		return InterlockedIncrement(&m_nRef);
+	}
+
+	LONG CZipBlob::Release()
+	{
+		LONG nRet = InterlockedDecrement(&m_nRef);
+		if (nRet == 0)
+			delete this;
+		return nRet;
+	}
+
+	BYTE *CZipBlob::GetData()
+	{
+		return m_pData;
+	}
+
+	DWORD CZipBlob::GetSize() const
+	{
+		return m_dwSize;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//CZipFile
+	//////////////////////////////////////////////////////////////////////////
     CZipFile::CZipFile(DWORD dwSize/*=0*/)
 		: m_dwPos(0)
+		, m_pShared(NULL)
 	{
 
 	}
@@ -46,13 +88,13 @@ namespace SevenZip{
 		if (pdwRead != NULL)
 			*pdwRead = 0;
 
-		if (m_blob.GetBlobLength()==0)
+		if (_Size()==0)
 			return FALSE;
 
-		if (m_dwPos + dwSize > m_blob.GetBlobLength())
-			dwSize = m_blob.GetBlobLength() - m_dwPos;
+		if (m_dwPos + dwSize > _Size())
+			dwSize = _Size() - m_dwPos;
 
-		::CopyMemory(pBuffer, m_blob.GetBlobPtr() + m_dwPos, dwSize);
+		::CopyMemory(pBuffer, _Data() + m_dwPos, dwSize);
 		m_dwPos += dwSize;
 		if (pdwRead != NULL)
 			*pdwRead = dwSize;
@@ -61,24 +103,30 @@ namespace SevenZip{
 	}
 	BOOL CZipFile::Close()
 	{
-		m_blob.ClearContent();
-		m_dwPos = 0;
-
+		Detach();
 		return TRUE;
 	}
 	BOOL CZipFile::IsOpen() const 
 	{
-		return (m_blob.GetBlobLength() > 0);
+		return (_Size() > 0);
 	}
 	BYTE* CZipFile::GetData() 
 	{
 		_ASSERTE(IsOpen());
-		return m_blob.GetBlobRealPtr();
+		return _Data();
 	}
 	DWORD CZipFile::GetSize() const
 	{
 		_ASSERTE(IsOpen());
-		return m_blob.GetBlobLength();
+		return _Size();
+	}
+	BYTE* CZipFile::_Data()
+	{
+		return m_pShared ? m_pShared->GetData() : m_blob.GetBlobRealPtr();
+	}
+	DWORD CZipFile::_Size() const
+	{
+		return m_pShared ? m_pShared->GetSize() : m_blob.GetBlobLength();
 	}
 	DWORD CZipFile::GetPosition() const
 	{
@@ -95,7 +143,7 @@ namespace SevenZip{
 			m_dwPos = dwOffset;
 			break;
 		case FILE_END:
-			m_dwPos = m_blob.GetBlobLength() + dwOffset;
+			m_dwPos = _Size() + dwOffset;
 			break;
 		case FILE_CURRENT:
 			m_dwPos += dwOffset;
@@ -103,8 +151,8 @@ namespace SevenZip{
 		}
 		if (m_dwPos < 0)
 			m_dwPos = 0;
-		if (m_dwPos >= m_blob.GetBlobLength())
-			m_dwPos = m_blob.GetBlobLength();
+		if (m_dwPos >= _Size())
+			m_dwPos = _Size();
 		return dwPos;
 	} 
 
@@ -113,20 +161,41 @@ namespace SevenZip{
 		_ASSERTE(pData);
 		//_ASSERTE(!::IsBadReadPtr(pData,dwSize));
 
+		Detach();
 		m_blob.SetBlobContent(pData, dwSize);
 		return TRUE;
 	}
 
+	BOOL CZipFile::Attach(CZipBlob *pBlob)
+	{
+		_ASSERTE(pBlob);
+		Detach();
+		m_pShared = pBlob;
+		m_pShared->AddRef();
+		return TRUE;
+	}
+
 	void CZipFile::Detach()
 	{ 
 		m_blob.ClearContent();
+		if (m_pShared)
+		{
+			m_pShared->Release();
+			m_pShared = NULL;
+		}
 		m_dwPos = 0;
 	}
 	//////////////////////////////////////////////////////////////////////////
 	//CZipArchive
 	//////////////////////////////////////////////////////////////////////////
 	
+	// default budget of the lazy cache
+	static const DWORD kDefLazyCacheSize = 8 * 1024 * 1024;
+
 	CZipArchive::CZipArchive()
+		: m_bLazy(FALSE)
+		, m_dwCacheSize(kDefLazyCacheSize)
+		, m_dwCacheUsage(0)
 	{
 	}
 	CZipArchive::~CZipArchive()
@@ -137,6 +206,19 @@ namespace SevenZip{
 	void CZipArchive::Close()
 	{
 		CloseFile(); 
+		std::lock_guard<std::mutex> lock(m_lazyMutex);
+		for (size_t i = 0; i < m_lazyItems.size(); i++)
+		{
+			if (m_lazyItems[i].pBlob)
+				m_lazyItems[i].pBlob->Release();
+		}
+		m_lazyItems.clear();
+		m_lazyLru.clear();
+		m_lazyIndex.clear();
+		m_lazyBlocks.clear();
+		m_dwCacheUsage = 0;
+		m_lazyExtractor.CloseArchive();
+		m_bLazy = FALSE;
 	}
 	BOOL CZipArchive::IsOpen() const
 	{
@@ -157,14 +239,122 @@ namespace SevenZip{
 	}
 	// ZIP File API
 
+	static std::string tolowerstring(std::string str)
+	{
+		std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+		return str;
+	}
+
 	BOOL CZipArchive::GetFile(LPCTSTR pszFileName, CZipFile& file)
 	{
 		std::string fileName = toUtf8String(pszFileName);
+		if (m_bLazy)
+		{
+			int index = _FindLazyItem(fileName);
+			if (index < 0)
+				return FALSE;
+			std::lock_guard<std::mutex> lock(m_lazyMutex);
+			CZipBlob *pBlob = _LoadLazyItem(index);
+			if (!pBlob)
+				return FALSE;
+			file.Attach(pBlob);
+			return TRUE;
+		}
 		if (m_fileStreams.GetFile(fileName.c_str(),file.getBlob()))
 			return TRUE;
 
 		return FALSE;
 	}
+
+	int CZipArchive::_FindLazyItem(const std::string &fileName) const
+	{
+		std::map<std::string, UInt32>::const_iterator it = m_lazyIndex.find(tolowerstring(fileName));
+		if (it == m_lazyIndex.end())
+			return -1;
+		return (int)it->second;
+	}
+
+	void CZipArchive::_TouchLazyItem(UInt32 index)
+	{
+		LazyItem &item = m_lazyItems[index];
+		if (item.itLru != m_lazyLru.end())
+			m_lazyLru.erase(item.itLru);
+		m_lazyLru.push_front(index);
+		item.itLru = m_lazyLru.begin();
+	}
+
+	void CZipArchive::_TrimLazyCache(UInt32 keepIndex)
+	{
+		while (m_dwCacheUsage > m_dwCacheSize && !m_lazyLru.empty() && m_lazyLru.back() != keepIndex)
+		{
+			LazyItem &item = m_lazyItems[m_lazyLru.back()];
+			m_lazyLru.pop_back();
+			item.itLru = m_lazyLru.end();
+			m_dwCacheUsage -= item.pBlob->GetSize();
+			item.pBlob->Release();
+			item.pBlob = NULL;
+		}
+	}
+
+	CZipBlob *CZipArchive::_LoadLazyItem(UInt32 index)
+	{
+		if (m_lazyItems[index].pBlob)
+		{
+			_TouchLazyItem(index);
+			return m_lazyItems[index].pBlob;
+		}
+
+		// decoding a file of a solid block decodes the block up to it anyway, so take the
+		// siblings of the block along as long as the whole block fits in the cache budget.
+		std::vector<UInt32> indices;
+		const SevenZipExtractorLazy::ItemInfo &info = m_lazyExtractor.GetItem(index);
+		if (info.block != (UInt32)SevenZipExtractorLazy::kNoBlock)
+		{
+			const std::vector<UInt32> &siblings = m_lazyBlocks[info.block];
+			UInt64 blockSize = 0;
+			for (size_t i = 0; i < siblings.size(); i++)
+				blockSize += m_lazyExtractor.GetItem(siblings[i]).size;
+			if (blockSize <= m_dwCacheSize)
+			{
+				for (size_t i = 0; i < siblings.size(); i++)
+				{
+					if (!m_lazyItems[siblings[i]].pBlob)
+						indices.push_back(siblings[i]);
+				}
+			}
+		}
+		if (indices.empty())
+			indices.push_back(index);
+
+		CFileStream fileStreams;
+		if (S_OK != m_lazyExtractor.ExtractItems(&indices[0], (UInt32)indices.size(), fileStreams))
+			return NULL;
+
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			UInt32 idx = indices[i];
+			if (idx == index)
+				continue;
+			const char *pszName = m_lazyExtractor.GetItem(idx).name.c_str();
+			const unsigned char *pData = fileStreams.GetFilePtr(pszName);
+			if (!pData)
+				continue;
+			CZipBlob *pBlob = new CZipBlob(pData, fileStreams.GetFileSize(pszName));
+			m_lazyItems[idx].pBlob = pBlob;
+			m_dwCacheUsage += pBlob->GetSize();
+			_TouchLazyItem(idx);
+		}
+		const char *pszName = info.name.c_str();
+		const unsigned char *pData = fileStreams.GetFilePtr(pszName);
+		if (!pData)
+			return NULL;
+		CZipBlob *pBlob = new CZipBlob(pData, fileStreams.GetFileSize(pszName));
+		m_lazyItems[index].pBlob = pBlob;
+		m_dwCacheUsage += pBlob->GetSize();
+		_TouchLazyItem(index);
+		_TrimLazyCache(index);
+		return pBlob;
+	}
 	 
 	BOOL CZipArchive::Open(LPCTSTR pszFileName,LPCSTR pszPassword)
 	{
@@ -180,6 +370,34 @@ namespace SevenZip{
 		return (S_OK == decompress.ExtractArchive(m_fileStreams, NULL, &pwd));
 	}
 
+	BOOL CZipArchive::OpenLazy(LPCTSTR pszFileName, LPCSTR pszPassword, DWORD dwCacheSize)
+	{
+		Close();
+#ifdef _UNICODE
+		TString strPwd = ToWstring(pszPassword ? pszPassword : "");
+#else
+		TString strPwd = pszPassword ? pszPassword : "";
+#endif
+		SevenZip::SevenZipPassword pwd(true, strPwd);
+		m_lazyExtractor.SetArchivePath(pszFileName);
+		if (S_OK != m_lazyExtractor.OpenArchive(&pwd))
+			return FALSE;
+
+		UInt32 nItems = m_lazyExtractor.GetItemCount();
+		LazyItem item = { NULL, m_lazyLru.end() };
+		m_lazyItems.assign(nItems, item);
+		for (UInt32 i = 0; i < nItems; i++)
+		{
+			const SevenZipExtractorLazy::ItemInfo &info = m_lazyExtractor.GetItem(i);
+			m_lazyIndex[info.name] = i;
+			if (info.block != (UInt32)SevenZipExtractorLazy::kNoBlock)
+				m_lazyBlocks[info.block].push_back(i);
+		}
+		m_dwCacheSize = dwCacheSize ? dwCacheSize : kDefLazyCacheSize;
+		m_bLazy = TRUE;
+		return TRUE;
+	}
+
 #ifdef _WIN32
 	BOOL CZipArchive::Open(HMODULE hModule, LPCTSTR pszName, LPCSTR pszPassword, LPCTSTR pszType)
 	{
@@ -219,39 +437,67 @@ namespace SevenZip{
 	DWORD CZipArchive::GetFileSize( LPCTSTR pszFileName )
 	{
 		std::string fileName = toUtf8String(pszFileName);
+		if (m_bLazy)
+		{
+			int index = _FindLazyItem(fileName);
+			return index < 0 ? 0 : (DWORD)m_lazyExtractor.GetItem(index).size;
+		}
 		return m_fileStreams.GetFileSize(fileName.c_str());
 	} 
 
 	BOOL CZipArchive::IsFileExist( LPCTSTR pszFileName )
 	{
 		std::string fileName = toUtf8String(pszFileName);
+		if (m_bLazy)
+			return _FindLazyItem(fileName) >= 0;
 		return m_fileStreams.GetFilePtr(fileName.c_str())!=NULL;
 	} 
 
 	int CZipArchive::GetFileCount()
 	{
+		if (m_bLazy)
+			return (int)m_lazyExtractor.GetItemCount();
 		return m_fileStreams.GetFileCount();
 	}
 
 	unsigned int CZipArchive::GetFirstFilePos()
 	{
+		if (m_bLazy)
+			return 0;
 		return m_fileStreams.First();
 	}
 
 	unsigned int CZipArchive::GetNextFilePos(unsigned int pos)
 	{
+		if (m_bLazy)
+			return pos + 1;
 		return m_fileStreams.Next(pos);
 	}
 
 	bool CZipArchive::Eof(unsigned int pos)
 	{
+		if (m_bLazy)
+			return pos >= m_lazyExtractor.GetItemCount();
 		return m_fileStreams.Eof(pos);
 	}
 
 	std::string CZipArchive::GetFileName(unsigned int pos)
 	{
+		if (m_bLazy)
+			return m_lazyExtractor.GetItem(pos).name;
 		return m_fileStreams.getParamName(pos);
 	}
 
+	BOOL CZipArchive::IsLazy() const
+	{
+		return m_bLazy;
+	}
+
+	DWORD CZipArchive::GetCacheUsage()
+	{
+		std::lock_guard<std::mutex> lock(m_lazyMutex);
+		return m_dwCacheUsage;
+	}
+
 
 	}//end of ns
\ No newline at end of file
@@ -22,12 +22,35 @@ typedef BYTE *LPBYTE;
 
 #endif
 #include "SevenZip/FileStream.h"
+#include "SevenZip/SevenZipExtractorLazy.h"
+#include <map>
+#include <list>
+#include <vector>
+#include <mutex>
 
 namespace SevenZip{
 
 class CZipFile;
 class CZipArchive;
 
+//	Reference counted data of a file extracted on demand, shared by the archive cache and CZipFile
+class CZipBlob
+{
+public:
+	CZipBlob(const BYTE *pData, DWORD dwSize);
+	LONG AddRef();
+	LONG Release();
+
+	BYTE *GetData();
+	DWORD GetSize() const;
+private:
+	~CZipBlob();
+
+	LONG m_nRef;
+	BYTE *m_pData;
+	DWORD m_dwSize;
+};
+
 //	ZIP file wrapper from zip archive
 class CZipFile
 {
@@ -46,10 +69,16 @@ public:
 	DWORD Seek(DWORD dwOffset, UINT nFrom);
 
 	BOOL Attach(LPBYTE pData, DWORD dwSize);
+	//	share the data instead of copying it
+	BOOL Attach(CZipBlob *pBlob);
 	void Detach();
 	BlobBuffer &getBlob();
 protected: 
+	BYTE *_Data();
+	DWORD _Size() const;
+
 	BlobBuffer m_blob;
+	CZipBlob *m_pShared;
 };
 
 //	ZIP Archive class, load files from a zip archive
@@ -60,6 +89,8 @@ public:
 	~CZipArchive();
 
 	BOOL Open(LPCTSTR pszFileName, LPCSTR pszPassword);
+	//	read the archive index only, files are extracted on first access into a LRU cache of dwCacheSize bytes
+	BOOL OpenLazy(LPCTSTR pszFileName, LPCSTR pszPassword, DWORD dwCacheSize = 0);
 #ifdef _WIN32
 	BOOL Open(HMODULE hModule, LPCTSTR pszName, LPCSTR pszPassword, LPCTSTR pszType = _T("7Z"));
 #endif // _WIN32
@@ -77,12 +108,37 @@ public:
 	bool Eof(unsigned int pos);
 
 	std::string GetFileName(unsigned int pos);
+
+	BOOL IsLazy() const;
+	//	bytes of extracted data currently held by the lazy cache
+	DWORD GetCacheUsage();
 protected:
 	void CloseFile();
 
 	DWORD ReadFile(void* pBuffer, DWORD dwBytes);
+
+	int _FindLazyItem(const std::string &fileName) const;
+	CZipBlob *_LoadLazyItem(UInt32 index);
+	void _TouchLazyItem(UInt32 index);
+	void _TrimLazyCache(UInt32 keepIndex);
 private:
+	struct LazyItem
+	{
+		CZipBlob *pBlob;
+		std::list<UInt32>::iterator itLru;
+	};
+
 	CFileStream m_fileStreams;
+
+	BOOL m_bLazy;
+	SevenZipExtractorLazy m_lazyExtractor;
+	std::map<std::string, UInt32> m_lazyIndex;			// file name -> item
+	std::map<UInt32, std::vector<UInt32> > m_lazyBlocks;	// solid block -> items
+	std::vector<LazyItem> m_lazyItems;
+	std::list<UInt32> m_lazyLru;							// cached items, most recently used first
+	DWORD m_dwCacheSize;
+	DWORD m_dwCacheUsage;
+	std::mutex m_lazyMutex;
 };
 
 }//end of ns
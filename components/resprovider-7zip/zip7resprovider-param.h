@@ -20,15 +20,19 @@ SNSBEGIN
         };
         LPCSTR          pszPsw; 
 		LPCTSTR			pszChildDir;
+		BOOL			bLazy;			// ZIP7_FILE only: read the index on init, extract files on first access
+		DWORD			dwCacheSize;	// budget in bytes of the cache of extracted files in lazy mode, 0 for default
     };
     
-         inline   void Zip7File(ZIP7RES_PARAM *param,IRenderFactory *_pRenderFac,LPCTSTR _pszFile,LPCSTR _pszPsw =NULL, LPCTSTR _pszChildDir = NULL)
+         inline   void Zip7File(ZIP7RES_PARAM *param,IRenderFactory *_pRenderFac,LPCTSTR _pszFile,LPCSTR _pszPsw =NULL, LPCTSTR _pszChildDir = NULL, BOOL _bLazy = FALSE, DWORD _dwCacheSize = 0)
         {
             param->type=ZIP7_FILE;
             param->pszZipFile = _pszFile;
 			param->pszChildDir = _pszChildDir;
             param->pRenderFac = _pRenderFac;
             param->pszPsw     = _pszPsw;
+            param->bLazy      = _bLazy;
+            param->dwCacheSize = _dwCacheSize;
         }
        inline  void Zip7Resource(ZIP7RES_PARAM *param,IRenderFactory *_pRenderFac,HINSTANCE hInst,LPCTSTR pszResName,LPCTSTR pszResType=_T("7z"),LPCSTR _pszPsw =NULL, LPCTSTR _pszChildDir = NULL)
         {
@@ -39,6 +43,8 @@ SNSBEGIN
             param->peInfo.pszResName=pszResName;
             param->peInfo.pszResType=pszResType;
             param->pszPsw     = _pszPsw;
+            param->bLazy      = FALSE;
+            param->dwCacheSize = 0;
         }
 
 SNSEND
@@ -18,9 +18,10 @@ class SHexEditAction {
     } type;
 
   protected:
+    // 撤销记录只保存片段, 片段引用的数据不会改变
     UINT position;
-    SByteArray replaceData;
-    SByteArray insertData;
+    SHexPieceTable::PIECES replaceData;
+    SHexPieceTable::PIECES insertData;
     SHexEditAction *next;
 
   public:
@@ -28,14 +29,14 @@ class SHexEditAction {
     ~SHexEditAction();
     BOOL set(ActionType type,
              UINT position,
-             const SByteArray &replaceData,
-             const SByteArray &insertData,
+             const SHexPieceTable::PIECES &replaceData,
+             const SHexPieceTable::PIECES &insertData,
              SHexEditAction *next = 0);
     void setNext(SHexEditAction *next)
     {
         this->next = next;
     }
-    BOOL append(const SByteArray &replaceData, const SByteArray &insertData);
+    BOOL append(const SHexPieceTable::PIECES &replaceData, const SHexPieceTable::PIECES &insertData);
     ActionType getType() const
     {
         return type;
@@ -44,21 +45,21 @@ class SHexEditAction {
     {
         return position;
     }
-    const SByteArray &getReplaceData() const
+    const SHexPieceTable::PIECES &getReplaceData() const
     {
         return replaceData;
     }
     UINT getReplaceLen() const
     {
-        return replaceData.Size();
+        return SHexPieceTable::GetLength(replaceData);
     }
-    const SByteArray &getInsertData() const
+    const SHexPieceTable::PIECES &getInsertData() const
     {
         return insertData;
     }
     UINT getInsertLen() const
     {
-        return insertData.Size();
+        return SHexPieceTable::GetLength(insertData);
     }
     SHexEditAction *getNext() const
     {
@@ -80,8 +81,8 @@ SHexEditAction::~SHexEditAction()
 
 BOOL SHexEditAction::set(ActionType type,
                          UINT position,
-                         const SByteArray &replaceData,
-                         const SByteArray &insertData,
+                         const SHexPieceTable::PIECES &replaceData,
+                         const SHexPieceTable::PIECES &insertData,
                          SHexEditAction *next)
 {
     this->type = type;
@@ -92,10 +93,10 @@ BOOL SHexEditAction::set(ActionType type,
     return TRUE;
 }
 
-BOOL SHexEditAction::append(const SByteArray &replaceData, const SByteArray &insertData)
+BOOL SHexEditAction::append(const SHexPieceTable::PIECES &replaceData, const SHexPieceTable::PIECES &insertData)
 {
-    this->replaceData.Append(replaceData);
-    this->insertData.Append(insertData);
+    SHexPieceTable::AppendPieces(this->replaceData, replaceData);
+    SHexPieceTable::AppendPieces(this->insertData, insertData);
     return TRUE;
 }
 
@@ -203,6 +204,12 @@ void SHexEdit::OnSize(UINT nType, CSize size)
 }
 
 void SHexEdit::ReInitialize()
+{
+    m_xData.Clear();
+    ResetEditState();
+}
+
+void SHexEdit::ResetEditState()
 {
     m_nSelectingBeg = NOSECTION_VAL;
     m_nSelectingEnd = NOSECTION_VAL;
@@ -210,7 +217,6 @@ void SHexEdit::ReInitialize()
     m_nSelectionEnd = NOSECTION_VAL;
     m_nHighlightedBegin = NOSECTION_VAL;
     m_nHighlightedEnd = NOSECTION_VAL;
-    m_xData.Clear();
     delete m_undo;
     delete m_redo;
     m_undo = 0;
@@ -221,7 +227,8 @@ void SHexEdit::ReInitialize()
 void SHexEdit::SetData(const SByteArray &data)
 {
     ReInitialize();
-    m_xData = data;
+    if (data.Size() > 0)
+        m_xData.SetData(&*data.cbegin(), data.Size());
     m_bRecalc = true;
 
     SetEditCaretPos(0, true);
@@ -233,8 +240,7 @@ void SHexEdit::SetData(const SByteArray &data)
 void SHexEdit::SetData(const BYTE *data, UINT len)
 {
     ReInitialize();
-    if (data && len > 0)
-        m_xData.Append(data, len);
+    m_xData.SetData(data, len);
     m_bRecalc = true;
 
     SetEditCaretPos(0, true);
@@ -243,6 +249,20 @@ void SHexEdit::SetData(const BYTE *data, UINT len)
     FireEvent(evt);
 }
 
+BOOL SHexEdit::OpenFile(LPCTSTR pszFileName)
+{
+    // 打开失败时保留原来的数据
+    if (!m_xData.OpenFile(pszFileName, MAXHEXEDITLENGTH))
+        return FALSE;
+    ResetEditState();
+
+    SetEditCaretPos(0, true);
+    Invalidate();
+    EventHexEditDataChanged evt(this);
+    FireEvent(evt);
+    return TRUE;
+}
+
 bool SHexEdit::IsSelection() const
 {
     return (m_nSelectionEnd != NOSECTION_VAL) && (m_nSelectionBegin != NOSECTION_VAL);
@@ -703,11 +723,11 @@ void SHexEdit::PaintHexData(IRenderTarget *pRT)
     TCHAR *pSelectionBufPtrBegin;
     TCHAR *pSelectionBufPtrEnd;
 
+    SByteArray visibleData;
     BYTE *pDataPtr;
     BYTE *pEndDataPtr;
     BYTE *pEndLineDataPtr;
-    BYTE *pSelectionPtrBegin;
-    BYTE *pSelectionPtrEnd;
+    bool bSelection;
 
     CRect cHexRect(m_tPaintDetails.cPaintingRect);
 
@@ -721,17 +741,8 @@ void SHexEdit::PaintHexData(IRenderTarget *pRT)
     pRT->FillSolidRect(cHexRect, m_tHexBkgCol);
     cHexRect.bottom = cHexRect.top + m_tPaintDetails.nLineHeight;
 
-    // selection (pointers)
-    if ((m_nSelectionBegin != NOSECTION_VAL) && (m_nSelectionEnd != NOSECTION_VAL))
-    {
-        pSelectionPtrBegin = m_xData.GetData(m_nSelectionBegin);
-        pSelectionPtrEnd = m_xData.GetData(m_nSelectionEnd);
-    }
-    else
-    {
-        pSelectionPtrBegin = NULL;
-        pSelectionPtrEnd = NULL;
-    }
+    // selection
+    bSelection = (m_nSelectionBegin != NOSECTION_VAL) && (m_nSelectionEnd != NOSECTION_VAL);
 
     // start & end-address (& pointers)
     nAdr = m_nScrollPostionY * m_tPaintDetails.nBytesPerRow;
@@ -740,8 +751,15 @@ void SHexEdit::PaintHexData(IRenderTarget *pRT)
     {
         nEndAdr = GetDataSize() - 1;
     }
-    pDataPtr = m_xData.GetData(nAdr);
-    pEndDataPtr = m_xData.GetData(nEndAdr);
+    if (nAdr > nEndAdr)
+    {
+        return;
+    }
+    // 只读取可见行的数据
+    visibleData.Resize(nEndAdr - nAdr + 1);
+    m_xData.Read(nAdr, visibleData.GetData(), visibleData.Size());
+    pDataPtr = visibleData.GetData();
+    pEndDataPtr = pDataPtr + (nEndAdr - nAdr);
 
     //  paint
     while (pDataPtr < pEndDataPtr + 1)
@@ -754,18 +772,18 @@ void SHexEdit::PaintHexData(IRenderTarget *pRT)
         pSelectionBufPtrBegin = NULL;
         pSelectionBufPtrEnd = NULL;
 
-        if ((pDataPtr >= pSelectionPtrBegin) && (pDataPtr <= pSelectionPtrEnd))
+        if (bSelection && (nAdr >= m_nSelectionBegin) && (nAdr <= m_nSelectionEnd))
         {
             pSelectionBufPtrBegin = pBuf;
         }
 
-        for (pBufPtr = pBuf; pDataPtr < pEndLineDataPtr; ++pDataPtr)
+        for (pBufPtr = pBuf; pDataPtr < pEndLineDataPtr; ++pDataPtr, ++nAdr)
         {
-            if (pDataPtr == pSelectionPtrBegin)
+            if (bSelection && nAdr == m_nSelectionBegin)
             {
                 pSelectionBufPtrBegin = pBufPtr;
             }
-            if (pDataPtr == pSelectionPtrEnd)
+            if (bSelection && nAdr == m_nSelectionEnd)
             {
                 if (pSelectionBufPtrBegin == NULL)
                 {
@@ -825,11 +843,11 @@ void SHexEdit::PaintAsciiData(IRenderTarget *pRT)
     char pBuf[512];
     char *pBufPtr;
 
+    SByteArray visibleData;
     BYTE *pDataPtr;
     BYTE *pDataPtrEnd;
 
-    BYTE *pSelectionPtrBegin;
-    BYTE *pSelectionPtrEnd;
+    bool bSelection;
     BYTE *pEndDataPtr;
     char *pSelectionBufPtrBegin;
     char *pSelectionBufPtrEnd;
@@ -843,17 +861,8 @@ void SHexEdit::PaintAsciiData(IRenderTarget *pRT)
     cAsciiRect.bottom = cAsciiRect.top + m_tPaintDetails.nLineHeight;
 
     // highlighting section
-    // selection (pointers)
-    if ((m_nSelectionBegin != NOSECTION_VAL) && (m_nSelectionEnd != NOSECTION_VAL))
-    {
-        pSelectionPtrBegin = m_xData.GetData(m_nSelectionBegin);
-        pSelectionPtrEnd = m_xData.GetData(m_nSelectionEnd);
-    }
-    else
-    {
-        pSelectionPtrBegin = NULL;
-        pSelectionPtrEnd = NULL;
-    }
+    // selection
+    bSelection = (m_nSelectionBegin != NOSECTION_VAL) && (m_nSelectionEnd != NOSECTION_VAL);
     // highlighting section
 
     // start & end-address
@@ -864,12 +873,19 @@ void SHexEdit::PaintAsciiData(IRenderTarget *pRT)
         nEndAdr = GetDataSize() - 1;
     }
 
-    pDataPtr = m_xData.GetData(nAdr);
-    pEndDataPtr = m_xData.GetData(nEndAdr);
+    if (nAdr > nEndAdr)
+    {
+        return;
+    }
+    // 只读取可见行的数据
+    visibleData.Resize(nEndAdr - nAdr + 1);
+    m_xData.Read(nAdr, visibleData.GetData(), visibleData.Size());
+    pDataPtr = visibleData.GetData();
+    pEndDataPtr = pDataPtr + (nEndAdr - nAdr);
 
     //  paint
 
-    for (; nAdr <= nEndAdr; nAdr += m_tPaintDetails.nBytesPerRow)
+    while (nAdr <= nEndAdr)
     {
         pDataPtrEnd = pDataPtr + m_tPaintDetails.nBytesPerRow;
         if (pDataPtrEnd > pEndDataPtr)
@@ -880,19 +896,19 @@ void SHexEdit::PaintAsciiData(IRenderTarget *pRT)
         pSelectionBufPtrBegin = NULL;
         pSelectionBufPtrEnd = NULL;
 
-        if ((pDataPtr >= pSelectionPtrBegin) && (pDataPtr <= pSelectionPtrEnd))
+        if (bSelection && (nAdr >= m_nSelectionBegin) && (nAdr <= m_nSelectionEnd))
         {
             pSelectionBufPtrBegin = pBuf;
         }
 
-        for (pBufPtr = pBuf; pDataPtr < pDataPtrEnd; ++pDataPtr, ++pBufPtr)
+        for (pBufPtr = pBuf; pDataPtr < pDataPtrEnd; ++pDataPtr, ++pBufPtr, ++nAdr)
         {
 
-            if (pDataPtr == pSelectionPtrBegin)
+            if (bSelection && nAdr == m_nSelectionBegin)
             {
                 pSelectionBufPtrBegin = pBufPtr;
             }
-            if (pDataPtr == pSelectionPtrEnd)
+            if (bSelection && nAdr == m_nSelectionEnd)
             {
                 if (pSelectionBufPtrBegin == NULL)
                 {
@@ -1707,13 +1723,8 @@ void SHexEdit::OnEditPaste()
     else
         pasteData.Append((BYTE *)clipText.c_str(), clipText.length());
 
-    SaveUndoAction(SHexEditAction::paste, nPasteAdr, m_xData.Mid(nPasteAdr, nReplaceLength),
-                   pasteData);
-
-    if (nReplaceLength > 0)
-        m_xData.Remove(nPasteAdr, nReplaceLength);
-
-    m_xData.Insert(nPasteAdr, pasteData);
+    ReplaceData(SHexEditAction::paste, nPasteAdr, nReplaceLength,
+                pasteData.Size() > 0 ? pasteData.GetData() : NULL, pasteData.Size());
     m_bRecalc = true;
 
     SetEditCaretPos(nPasteAdr + pasteData.Size(), true);
@@ -1741,10 +1752,7 @@ void SHexEdit::OnEditCut()
 
         if (nCutLength > 0)
         {
-            SaveUndoAction(SHexEditAction::cut, m_nSelectionBegin,
-                           m_xData.Mid(m_nSelectionBegin, nCutLength), SByteArray());
-
-            m_xData.Remove(m_nSelectionBegin, nCutLength);
+            ReplaceData(SHexEditAction::cut, m_nSelectionBegin, nCutLength, NULL, 0);
             m_bRecalc = true;
 
             SetEditCaretPos(m_nSelectionBegin, true);
@@ -1760,21 +1768,22 @@ void SHexEdit::OnEditCut()
     }
 }
 
-bool SHexEdit::PrepareReplace(UINT pos, const SByteArray &oldData, const SByteArray &newData)
+bool SHexEdit::PrepareReplace(UINT pos,
+                              const SHexPieceTable::PIECES &oldPieces,
+                              const SHexPieceTable::PIECES &newPieces)
 {
-    if (oldData.Size() > 0)
-        m_xData.Remove(pos, oldData.Size());
-    if (newData.Size() > 0)
-        m_xData.Insert(pos, newData);
+    UINT nOldLen = SHexPieceTable::GetLength(oldPieces);
+    UINT nNewLen = SHexPieceTable::GetLength(newPieces);
+    m_xData.Replace(pos, nOldLen, newPieces);
 
-    if (oldData.Size() != newData.Size())
+    if (nOldLen != nNewLen)
     {
         m_bRecalc = true;
     }
     // m_bRecalc = true;
-    MakeVisible(pos + newData.Size(), pos + newData.Size(), true);
+    MakeVisible(pos + nNewLen, pos + nNewLen, true);
     SetSelection(NOSECTION_VAL, NOSECTION_VAL, true, false);
-    SetEditCaretPos(pos + newData.Size(), true);
+    SetEditCaretPos(pos + nNewLen, true);
     Invalidate();
 
     EventHexEditDataChanged evt(this);
@@ -1817,9 +1826,7 @@ void SHexEdit::OnDelete(WPARAM wParam)
         if (delAddress == GetDataSize())
             return;
 
-        SaveUndoAction(SHexEditAction::cut, delAddress, m_xData.Mid(delAddress, 1), SByteArray());
-
-        m_xData.Remove(delAddress, 1);
+        ReplaceData(SHexEditAction::cut, delAddress, 1, NULL, 0);
         MoveCurrentAddress(0, true);
         Invalidate();
 
@@ -1854,25 +1861,24 @@ bool SHexEdit::OnEditInput(WORD nInput)
         return false;
 
     UINT replaceLen = 0;
+    BYTE nOld = 0;
     if (m_nCurrentAddress >= GetDataSize() || (!m_overwriteMode && (m_bCaretAscii || m_bHighBits)))
     {
         if (m_nCurrentAddress >= GetDataSize())
             m_bHighBits = true;
-        m_xData.Insert(m_nCurrentAddress, 0);
         m_bRecalc = true;
     }
     else if (m_nCurrentAddress < GetDataSize())
     { // we are overwriting 1 char
         replaceLen = 1;
+        nOld = m_xData.GetAt(m_nCurrentAddress);
     }
     if (!m_bCaretAscii)
         if (m_bHighBits)
-            nValue = (nValue << 4) | (m_xData[m_nCurrentAddress] & 0x0f);
+            nValue = (nValue << 4) | (nOld & 0x0f);
         else
-            nValue = (m_xData[m_nCurrentAddress] & 0xf0) | nValue;
-    SaveUndoAction(SHexEditAction::input, m_nCurrentAddress,
-                   m_xData.Mid(m_nCurrentAddress, replaceLen), SByteArray(&nValue, 1));
-    m_xData[m_nCurrentAddress] = nValue;
+            nValue = (nOld & 0xf0) | nValue;
+    ReplaceData(SHexEditAction::input, m_nCurrentAddress, replaceLen, &nValue, 1);
     if (m_bCaretAscii)
         MoveCurrentAddress(1, true, true);
     else if (m_bHighBits)
@@ -2073,8 +2079,8 @@ HRESULT SHexEdit::OnAttrAsciiBkColor(const SStringW &strValue, BOOL bLoading)
 
 BOOL SHexEdit::SaveUndoAction(UINT type,
                               UINT position,
-                              const SByteArray &replaceData,
-                              const SByteArray &insertData)
+                              const SHexPieceTable::PIECES &replaceData,
+                              const SHexPieceTable::PIECES &insertData)
 {
     delete m_redo; // m_pData will change invalidating m_redo
     m_redo = NULL;
@@ -2104,6 +2110,16 @@ BOOL SHexEdit::SaveUndoAction(UINT type,
     return TRUE;
 }
 
+void SHexEdit::ReplaceData(UINT type, UINT pos, UINT nRemove, const BYTE *pInsert, UINT nInsert)
+{
+    // 撤销记录只保存片段引用, 被替换的数据仍在原始数据或追加缓冲区中
+    SHexPieceTable::PIECES oldPieces, newPieces;
+    m_xData.GetPieces(pos, nRemove, oldPieces);
+    m_xData.AddData(pInsert, nInsert, newPieces);
+    SaveUndoAction(type, pos, oldPieces, newPieces);
+    m_xData.Replace(pos, nRemove, newPieces);
+}
+
 void SHexEdit::Undo()
 {
     if (!CanUndo())
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "SByteArray.h"
+#include "SHexPieceTable.h"
 #include "core/SPanel.h"
 
 SNSBEGIN
@@ -23,9 +24,27 @@ class SHexEdit : public SPanel {
 
     void SetData(const SByteArray &data);
     void SetData(const BYTE *data, UINT len);
-    const SByteArray &GetData() const
+
+    /**
+     * SHexEdit::OpenFile
+     * @brief    只读映射打开文件, 编辑不会修改文件
+     * @param    LPCTSTR pszFileName -- 文件名
+     * @return   成功返回TRUE
+     */
+    BOOL OpenFile(LPCTSTR pszFileName);
+
+    /**
+     * SHexEdit::GetData
+     * @brief    获取全部数据的副本, 大文件请用ReadData分段读取
+     */
+    SByteArray GetData() const
+    {
+        return m_xData.Mid(0, m_xData.Size());
+    }
+
+    UINT ReadData(UINT nPos, BYTE *pBuf, UINT nLen) const
     {
-        return m_xData;
+        return m_xData.Read(nPos, pBuf, nLen);
     }
 
     bool IsSelection() const;
@@ -102,6 +121,7 @@ class SHexEdit : public SPanel {
     void OnDestroy();
     void OnSize(UINT nType, CSize size);
 
+    void ResetEditState();
     void SetScrollbarRanges();
     void CalculatePaintingDetails(IRenderTarget *pRT);
     void PaintAddresses(IRenderTarget *pRT);
@@ -131,8 +151,10 @@ class SHexEdit : public SPanel {
     void OnEditCopy();
     void OnEditPaste();
     void OnEditCut();
-    bool PrepareReplace(UINT pos, const SByteArray &oldData, const SByteArray &newData);
-    bool PrepareReplace(UINT pos, UINT oldlen, UINT newlen);
+    bool PrepareReplace(UINT pos,
+                        const SHexPieceTable::PIECES &oldPieces,
+                        const SHexPieceTable::PIECES &newPieces);
+    void ReplaceData(UINT type, UINT pos, UINT nRemove, const BYTE *pInsert, UINT nInsert);
     void OnEditClear();
     void OnEditSelectAll();
     void OnDelete(WPARAM wParam);
@@ -147,11 +169,11 @@ class SHexEdit : public SPanel {
 
     BOOL SaveUndoAction(UINT type,
                         UINT position,
-                        const SByteArray &replaceData,
-                        const SByteArray &insertData);
+                        const SHexPieceTable::PIECES &replaceData,
+                        const SHexPieceTable::PIECES &insertData);
 
   protected:
-    SByteArray m_xData;
+    SHexPieceTable m_xData;
 
     struct PAINTINGDETAILS
     {
@@ -0,0 +1,250 @@
+﻿#include "stdafx.h"
+#include "SHexPieceTable.h"
+#include "SByteArray.h"
+#include <algorithm>
+
+SNSBEGIN
+
+SHexPieceTable::SHexPieceTable()
+    : m_pOriginal(NULL)
+    , m_pMapView(NULL)
+    , m_nSize(0)
+{
+}
+
+SHexPieceTable::~SHexPieceTable()
+{
+    Clear();
+}
+
+void SHexPieceTable::Clear()
+{
+    if (m_pMapView)
+    {
+        UnmapViewOfFile(m_pMapView);
+        m_pMapView = NULL;
+    }
+    m_pOriginal = NULL;
+    std::vector<BYTE>().swap(m_original);
+    std::vector<BYTE>().swap(m_add);
+    m_pieces.clear();
+    m_pos.clear();
+    m_nSize = 0;
+}
+
+BOOL SHexPieceTable::OpenFile(LPCTSTR pszFileName, UINT nMaxSize)
+{
+    HANDLE hFile = CreateFile(pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_RANDOM_ACCESS, 0);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+    DWORD dwSizeHigh = 0;
+    DWORD dwSize = GetFileSize(hFile, &dwSizeHigh);
+    if (dwSizeHigh != 0 || dwSize > nMaxSize)
+    {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+    LPVOID pView = NULL;
+    if (dwSize > 0)
+    { // 空文件不能映射
+        HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMapping)
+        {
+            pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(hMapping);
+        }
+        if (!pView)
+        {
+            CloseHandle(hFile);
+            return FALSE;
+        }
+    }
+    CloseHandle(hFile);
+
+    Clear();
+    m_pMapView = pView;
+    m_pOriginal = (const BYTE *)pView;
+    if (dwSize > 0)
+    {
+        PIECE piece = { SRC_ORIGINAL, 0, dwSize };
+        m_pieces.push_back(piece);
+        m_pos.push_back(0);
+    }
+    m_nSize = dwSize;
+    return TRUE;
+}
+
+void SHexPieceTable::SetData(const BYTE *pData, UINT nLen)
+{
+    Clear();
+    if (!pData || nLen == 0)
+        return;
+    m_original.assign(pData, pData + nLen);
+    m_pOriginal = &m_original[0];
+    PIECE piece = { SRC_ORIGINAL, 0, nLen };
+    m_pieces.push_back(piece);
+    m_pos.push_back(0);
+    m_nSize = nLen;
+}
+
+const BYTE *SHexPieceTable::GetPieceData(const PIECE &piece) const
+{
+    return (piece.nSource == SRC_ORIGINAL ? m_pOriginal : &m_add[0]) + piece.nOffset;
+}
+
+bool SHexPieceTable::IsContinuous(const PIECE &piece1, const PIECE &piece2)
+{
+    return piece1.nSource == piece2.nSource && piece1.nOffset + piece1.nLength == piece2.nOffset;
+}
+
+int SHexPieceTable::FindPiece(UINT nPos) const
+{
+    // 最后一个开始位置不大于nPos的片段
+    return (int)(std::upper_bound(m_pos.begin(), m_pos.end(), nPos) - m_pos.begin()) - 1;
+}
+
+BYTE SHexPieceTable::GetAt(UINT nPos) const
+{
+    SASSERT(nPos < m_nSize);
+    int i = FindPiece(nPos);
+    return GetPieceData(m_pieces[i])[nPos - m_pos[i]];
+}
+
+UINT SHexPieceTable::Read(UINT nPos, BYTE *pBuf, UINT nLen) const
+{
+    if (nPos >= m_nSize)
+        return 0;
+    if (nLen > m_nSize - nPos)
+        nLen = m_nSize - nPos;
+    UINT nRead = 0;
+    for (size_t i = FindPiece(nPos); nRead < nLen; i++)
+    {
+        const PIECE &piece = m_pieces[i];
+        UINT nOffset = nPos + nRead - m_pos[i];
+        UINT nCopy = smin(piece.nLength - nOffset, nLen - nRead);
+        memcpy(pBuf + nRead, GetPieceData(piece) + nOffset, nCopy);
+        nRead += nCopy;
+    }
+    return nRead;
+}
+
+SByteArray SHexPieceTable::Mid(UINT nPos, UINT nLen) const
+{
+    SByteArray ret;
+    if (nPos < m_nSize)
+    {
+        ret.Resize(smin(nLen, m_nSize - nPos));
+        if (ret.Size() > 0)
+            Read(nPos, ret.GetData(), ret.Size());
+    }
+    return ret;
+}
+
+void SHexPieceTable::GetPieces(UINT nPos, UINT nLen, PIECES &pieces) const
+{
+    pieces.clear();
+    if (nPos >= m_nSize)
+        return;
+    if (nLen > m_nSize - nPos)
+        nLen = m_nSize - nPos;
+    UINT nGot = 0;
+    for (size_t i = FindPiece(nPos); nGot < nLen; i++)
+    {
+        PIECE piece = m_pieces[i];
+        UINT nOffset = nPos + nGot - m_pos[i];
+        piece.nOffset += nOffset;
+        piece.nLength = smin(piece.nLength - nOffset, nLen - nGot);
+        pieces.push_back(piece);
+        nGot += piece.nLength;
+    }
+}
+
+void SHexPieceTable::AddData(const BYTE *pData, UINT nLen, PIECES &pieces)
+{
+    pieces.clear();
+    if (nLen == 0)
+        return;
+    PIECE piece = { SRC_ADD, (UINT)m_add.size(), nLen };
+    m_add.insert(m_add.end(), pData, pData + nLen);
+    pieces.push_back(piece);
+}
+
+size_t SHexPieceTable::SplitAt(UINT nPos)
+{
+    if (nPos >= m_nSize)
+        return m_pieces.size();
+    int i = FindPiece(nPos);
+    UINT nOffset = nPos - m_pos[i];
+    if (nOffset == 0)
+        return i;
+    PIECE tail = m_pieces[i];
+    tail.nOffset += nOffset;
+    tail.nLength -= nOffset;
+    m_pieces[i].nLength = nOffset;
+    m_pieces.insert(m_pieces.begin() + i + 1, tail);
+    m_pos.insert(m_pos.begin() + i + 1, nPos);
+    return i + 1;
+}
+
+void SHexPieceTable::UpdatePositions(size_t iBegin)
+{
+    m_pos.resize(m_pieces.size());
+    UINT nPos = iBegin > 0 ? m_pos[iBegin - 1] + m_pieces[iBegin - 1].nLength : 0;
+    for (size_t i = iBegin; i < m_pieces.size(); i++)
+    {
+        m_pos[i] = nPos;
+        nPos += m_pieces[i].nLength;
+    }
+}
+
+void SHexPieceTable::Replace(UINT nPos, UINT nRemove, const PIECES &pieces)
+{
+    SASSERT(nPos <= m_nSize && nRemove <= m_nSize - nPos);
+    size_t iBegin = SplitAt(nPos);
+    size_t iEnd = SplitAt(nPos + nRemove);
+    m_pieces.erase(m_pieces.begin() + iBegin, m_pieces.begin() + iEnd);
+    m_pos.erase(m_pos.begin() + iBegin, m_pos.begin() + iEnd);
+    m_nSize -= nRemove;
+
+    // 插入新片段, 和前后首尾相接的片段合并, 连续输入时片段数不会增加
+    size_t iInsert = iBegin;
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        const PIECE &piece = pieces[i];
+        if (piece.nLength == 0)
+            continue;
+        if (iInsert > 0 && IsContinuous(m_pieces[iInsert - 1], piece))
+            m_pieces[iInsert - 1].nLength += piece.nLength;
+        else
+            m_pieces.insert(m_pieces.begin() + iInsert++, piece);
+        m_nSize += piece.nLength;
+    }
+    if (iInsert > 0 && iInsert < m_pieces.size() && IsContinuous(m_pieces[iInsert - 1], m_pieces[iInsert]))
+    {
+        m_pieces[iInsert - 1].nLength += m_pieces[iInsert].nLength;
+        m_pieces.erase(m_pieces.begin() + iInsert);
+    }
+    UpdatePositions(iBegin > 0 ? iBegin - 1 : 0);
+}
+
+UINT SHexPieceTable::GetLength(const PIECES &pieces)
+{
+    UINT nLen = 0;
+    for (size_t i = 0; i < pieces.size(); i++)
+        nLen += pieces[i].nLength;
+    return nLen;
+}
+
+void SHexPieceTable::AppendPieces(PIECES &dst, const PIECES &src)
+{
+    for (size_t i = 0; i < src.size(); i++)
+    {
+        if (!dst.empty() && IsContinuous(dst.back(), src[i]))
+            dst.back().nLength += src[i].nLength;
+        else
+            dst.push_back(src[i]);
+    }
+}
+
+SNSEND
@@ -0,0 +1,114 @@
+﻿#pragma once
+#include <vector>
+
+SNSBEGIN
+
+class SByteArray;
+
+/**
+ * SHexPieceTable
+ * @brief    SHexEdit的数据存储
+ *
+ * Describe  文档由一组片段(piece)依次拼接而成, 每个片段引用原始数据或者新增数据中的一段.
+ *           原始数据只读, 可以是只读映射的文件; 新增数据只追加. 插入和删除只修改片段表, 不移动数据,
+ *           两块数据的内容都不会改变, 所以撤销记录可以只保存片段.
+ */
+class SHexPieceTable {
+  public:
+    enum
+    {
+        SRC_ORIGINAL = 0, // 原始数据
+        SRC_ADD = 1,      // 新增数据
+    };
+
+    struct PIECE
+    {
+        BYTE nSource; // SRC_ORIGINAL或者SRC_ADD
+        UINT nOffset; // 在数据源中的偏移
+        UINT nLength; // 长度
+    };
+    typedef std::vector<PIECE> PIECES;
+
+    SHexPieceTable();
+    ~SHexPieceTable();
+
+    /**
+     * SHexPieceTable::OpenFile
+     * @brief    只读映射文件作为原始数据
+     * @param    LPCTSTR pszFileName -- 文件名
+     * @param    UINT nMaxSize -- 可以打开的最大文件长度
+     * @return   成功返回TRUE, 失败时数据不变
+     */
+    BOOL OpenFile(LPCTSTR pszFileName, UINT nMaxSize);
+
+    /**
+     * SHexPieceTable::SetData
+     * @brief    复制一块数据作为原始数据
+     */
+    void SetData(const BYTE *pData, UINT nLen);
+
+    void Clear();
+
+    UINT Size() const
+    {
+        return m_nSize;
+    }
+
+    BYTE GetAt(UINT nPos) const;
+
+    /**
+     * SHexPieceTable::Read
+     * @brief    读取一段数据
+     * @param    UINT nPos -- 开始位置
+     * @param    BYTE * pBuf -- 输出缓冲区
+     * @param    UINT nLen -- 读取长度
+     * @return   实际读取的长度
+     */
+    UINT Read(UINT nPos, BYTE *pBuf, UINT nLen) const;
+
+    SByteArray Mid(UINT nPos, UINT nLen) const;
+
+    /**
+     * SHexPieceTable::GetPieces
+     * @brief    获取引用[nPos,nPos+nLen)这段数据的片段
+     */
+    void GetPieces(UINT nPos, UINT nLen, PIECES &pieces) const;
+
+    /**
+     * SHexPieceTable::AddData
+     * @brief    把数据追加到新增数据, 返回引用它的片段
+     */
+    void AddData(const BYTE *pData, UINT nLen, PIECES &pieces);
+
+    /**
+     * SHexPieceTable::Replace
+     * @brief    把[nPos,nPos+nRemove)这段数据替换为片段pieces引用的数据
+     */
+    void Replace(UINT nPos, UINT nRemove, const PIECES &pieces);
+
+    static UINT GetLength(const PIECES &pieces);
+
+    /**
+     * SHexPieceTable::AppendPieces
+     * @brief    把src追加到dst, 首尾相接的片段合并为一个
+     */
+    static void AppendPieces(PIECES &dst, const PIECES &src);
+
+  protected:
+    int FindPiece(UINT nPos) const;
+    size_t SplitAt(UINT nPos);
+    void UpdatePositions(size_t iBegin);
+    const BYTE *GetPieceData(const PIECE &piece) const;
+    static bool IsContinuous(const PIECE &piece1, const PIECE &piece2);
+
+    const BYTE *m_pOriginal;     // 原始数据
+    std::vector<BYTE> m_original; // SetData复制的原始数据
+    LPVOID m_pMapView;           // 映射的文件视图
+    std::vector<BYTE> m_add;     // 新增数据, 只追加
+
+    PIECES m_pieces;         // 片段表
+    std::vector<UINT> m_pos; // 每个片段在文档中的开始位置
+    UINT m_nSize;            // 文档长度
+};
+
+SNSEND
@@ -276,6 +276,14 @@ DECLARE_INTERFACE_(IMcListViewEx, IObjRef)
 			(pColWid);
 			(nCols);
 		}
+		STDMETHOD_(int, ViewToItem)(THIS_ int position) SCONST OVERRIDE
+		{
+			return position;
+		}
+		STDMETHOD_(int, ItemToView)(THIS_ int iItem) SCONST OVERRIDE
+		{
+			return iItem;
+		}
 	};
 	//////////////////////////////////////////////////////////////////////////
 	//  SMCListViewEx
@@ -0,0 +1,7 @@
+// precompiled header expected by the controls.extend sources built into fun_test
+#ifndef __STDAFX_H_
+#define __STDAFX_H_
+
+#include <souistd.h>
+
+#endif // __STDAFX_H_
@@ -23,15 +23,24 @@
 #include <souistd.h>
 #include <SouiFactory.h>
 #include <helper/SSemaphore.h>
+#include <helper/SPixelConv.h>
+#include <helper/SIndexView.h>
+#include <helper/SParallel.h>
+#include <helper/STimerWheel.h>
+#include <helper/SRenderTargetPool.h>
+#include <SByteArray.h>
+#include <SHexPieceTable.h>
 #include "common.h"
 
 #if defined(__linux__) || _MSC_VER >= 1700 // VS2012
 #include <functional>
+#include <vector>
 #include <thread>
 #endif
 
 
 #include "../components/resprovider-zip/zipresprovider-param.h"
+#include "../components/resprovider-7zip/zip7resprovider-param.h"
 #include <helper/SFunctor.hpp>
 #include <helper/SMenu.h>
 #include <helper/SMenuEx.h>
@@ -141,6 +150,464 @@ TEST(soui, semaphore) {
     semaphore.notify();
 }
 
+static void __cdecl ParallelCountTask(void *pCtx, int iTask) {
+    InterlockedIncrement((LONG *)pCtx + iTask);
+}
+
+TEST(soui, parallel) {
+    EXPECT_TRUE(SParallel::GetThreadCount() >= 1 && SParallel::GetThreadCount() <= SParallel::kMaxThreads);
+    // every task runs exactly once, also when several threads share the pool.
+    const int kTasks = 1000;
+    std::vector<LONG> counts[4];
+    for (int i = 0; i < ARRAYSIZE(counts); i++)
+        counts[i].resize(kTasks, 0);
+    SParallel::Run(kTasks, ParallelCountTask, counts[0].data());
+    for (int i = 0; i < kTasks; i++)
+        EXPECT_EQ(counts[0][i], 1);
+#if defined(__linux__) || _MSC_VER >= 1700
+    std::thread callers[ARRAYSIZE(counts)];
+    for (int i = 0; i < ARRAYSIZE(callers); i++) {
+        callers[i] = std::thread([&counts, i]() {
+            for (int j = 0; j < 100; j++)
+                SParallel::Run(kTasks, ParallelCountTask, counts[i].data());
+        });
+    }
+    for (int i = 0; i < ARRAYSIZE(callers); i++)
+        callers[i].join();
+    for (int i = 0; i < ARRAYSIZE(counts); i++) {
+        for (int j = 0; j < kTasks; j++)
+            EXPECT_EQ(counts[i][j], i == 0 ? 101 : 100);
+    }
+#endif
+}
+
+struct TestWheelListener : ITimerWheelListener {
+    STimerWheel *pWheel;
+    UINT_PTR uDestroyKey;
+    int nExpired;
+    UINT uArmed;
+    TestWheelListener() : pWheel(NULL), uDestroyKey(0), nExpired(0), uArmed(INFINITE) {}
+    virtual void OnArmTimer(UINT uElapse) { uArmed = uElapse; }
+    virtual void OnTimerExpired(UINT_PTR uKey) {
+        nExpired++;
+        if (uKey == uDestroyKey) {
+            // the host owning the wheel goes away inside its own callback
+            delete pWheel;
+            pWheel = NULL;
+        }
+    }
+};
+
+TEST(soui, timer_wheel) {
+    TestWheelListener listener;
+    STimerWheel *pWheel = new STimerWheel(&listener);
+    listener.pWheel = pWheel;
+    pWheel->SetTimer(1, 0, FALSE, 7);
+    pWheel->SetTimer(2, 0, TRUE, 7);
+    pWheel->SetTimer(3, 100000, TRUE, 8);
+    EXPECT_EQ(pWheel->GetCount(), 3);
+    EXPECT_TRUE(listener.uArmed != INFINITE);
+    Sleep(2);
+    pWheel->OnTick();
+    EXPECT_EQ(listener.nExpired, 2);
+    EXPECT_FALSE(pWheel->HasTimer(1));
+    EXPECT_TRUE(pWheel->HasTimer(2));
+    EXPECT_EQ(pWheel->KillGroup(7), 1);
+    EXPECT_EQ(pWheel->GetCount(), 1);
+
+    // destroying the wheel from a callback stops the tick without touching it again
+    listener.nExpired = 0;
+    listener.uDestroyKey = 4;
+    pWheel->SetTimer(4, 0, TRUE);
+    pWheel->SetTimer(5, 0, TRUE);
+    Sleep(2);
+    pWheel->OnTick();
+    EXPECT_TRUE(listener.pWheel == NULL);
+    EXPECT_TRUE(listener.nExpired >= 1);
+}
+
+// the render factory and application the host and render tests run on.
+struct TestEnv {
+    SComMgr2 comMgr;
+    SAutoRefPtr<IRenderFactory> renderFac;
+    SAutoRefPtr<IImgDecoderFactory> imgDecoder;
+    SApplication *app;
+
+    TestEnv() : app(NULL) {}
+    ~TestEnv() { delete app; }
+
+    // render-gdi with an image decoder, and an application on top of it.
+    BOOL InitApp() {
+        if (!comMgr.CreateRender_GDI((IObjRef **)&renderFac)) {
+            printf("load render-gdi failed!\n");
+            return FALSE;
+        }
+        comMgr.CreateImgDecoder((IObjRef **)&imgDecoder);
+        renderFac->SetImgDecoderFactory(imgDecoder);
+        app = new SApplication(renderFac, 0);
+        return TRUE;
+    }
+
+    // render-skia only, for the tests that draw on render targets directly.
+    BOOL InitSkia() {
+        if (!comMgr.CreateRender_Skia((IObjRef **)&renderFac)) {
+            printf("load render-skia failed!\n");
+            return FALSE;
+        }
+        return TRUE;
+    }
+};
+
+class PulseTestHost : public SHostWnd {
+  public:
+    PulseTestHost() : SHostWnd((LPCWSTR)NULL) {}
+    BOOL IsPulseArmed() const { return m_bPulseArmed; }
+};
+
+struct NullTimeline : public ITimelineHandler {
+    STDMETHOD_(void, OnNextFrame)(THIS) OVERRIDE {}
+};
+
+static void PumpMessages(int nMs) {
+    DWORD dwEnd = GetTickCount() + nMs;
+    do {
+        MSG msg;
+        while (PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        Sleep(1);
+    } while ((LONG)(GetTickCount() - dwEnd) < 0);
+}
+
+TEST(soui, host_pulse_follows_parent) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+
+    // a child host only learns about its parent's visibility through the parent.
+    PulseTestHost parent, child;
+    parent.CreateEx(NULL, WS_POPUP, 0, 0, 0, 200, 200);
+    child.CreateEx(parent.m_hWnd, WS_CHILD | WS_VISIBLE, 0, 0, 0, 100, 100);
+    NullTimeline timeline;
+    child.RegisterTimelineHandler(&timeline);
+    EXPECT_FALSE(child.IsPulseArmed());
+    parent.ShowWindow(SW_SHOW);
+    PumpMessages(50);
+    EXPECT_TRUE(child.IsPulseArmed());
+    parent.ShowWindow(SW_HIDE);
+    PumpMessages(50);
+    EXPECT_FALSE(child.IsPulseArmed());
+    parent.ShowWindow(SW_SHOW);
+    PumpMessages(50);
+    EXPECT_TRUE(child.IsPulseArmed());
+    child.UnregisterTimelineHandler(&timeline);
+    EXPECT_FALSE(child.IsPulseArmed());
+    child.DestroyWindow();
+    parent.DestroyWindow();
+}
+
+static void PaintHostFrame(SHostWnd &host) {
+    host.GetRoot()->Invalidate();
+    host.UpdateWindow();
+    PumpMessages(5);
+}
+
+TEST(soui, retained_layer_invalidation) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+
+    PulseTestHost host;
+    host.CreateEx(NULL, WS_POPUP | WS_VISIBLE, 0, 0, 0, 400, 200);
+    SWindow *pRoot = host.GetRoot();
+    pRoot->CreateChildrenFromXml(L"<window name=\"outer\" pos=\"10,10,@150,@150\" retainLayer=\"1\">"
+                                 L"<window name=\"inner\" pos=\"10,10,@100,@100\" retainLayer=\"1\"/></window>"
+                                 L"<window name=\"plain\" pos=\"200,10,@150,@150\"/>");
+    SWindow *pInner = pRoot->FindChildByName(L"inner");
+    ASSERT_TRUE(pInner != NULL);
+    for (int i = 0; i < 5; i++)
+        PaintHostFrame(host);
+    LayerCacheStats stats;
+    host.GetLayerCacheStats(&stats);
+    // only the outer window: inner paints into its ancestor's layer and plain did not opt in.
+    EXPECT_EQ(stats.nLayers, 1u);
+    EXPECT_EQ(stats.nCaptures, 1u);
+    EXPECT_TRUE(stats.nHits >= 1);
+
+    // a change inside a window whose updates are locked still outdates the ancestor's layer.
+    UINT nHits = stats.nHits, nMisses = stats.nMisses;
+    pInner->LockUpdate();
+    pInner->Invalidate();
+    pInner->UnlockUpdate();
+    PaintHostFrame(host);
+    host.GetLayerCacheStats(&stats);
+    EXPECT_EQ(stats.nHits, nHits);
+    EXPECT_EQ(stats.nMisses, nMisses + 1);
+
+    // so does a change inside a hidden window.
+    for (int i = 0; i < 5; i++)
+        PaintHostFrame(host);
+    host.GetLayerCacheStats(&stats);
+    EXPECT_EQ(stats.nCaptures, 2u);
+    pInner->SetVisible(FALSE, TRUE);
+    for (int i = 0; i < 5; i++)
+        PaintHostFrame(host);
+    host.GetLayerCacheStats(&stats);
+    nHits = stats.nHits;
+    pInner->Invalidate();
+    PaintHostFrame(host);
+    host.GetLayerCacheStats(&stats);
+    EXPECT_EQ(stats.nHits, nHits);
+    host.DestroyWindow();
+}
+
+TEST(soui, lookup_does_not_intern) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+
+    // names that are looked up but never defined stay out of the atom table.
+    EXPECT_TRUE(GETSKIN(L"fun_test.lookup.skin", 100) == NULL);
+    EXPECT_TRUE(SAtom::Find(L"fun_test.lookup.skin").IsNull());
+    EXPECT_TRUE(!GETSTYLE(L"fun_test.lookup.style"));
+    EXPECT_TRUE(SAtom::Find(L"fun_test.lookup.style").IsNull());
+
+    SHostWnd host;
+    host.CreateEx(NULL, WS_POPUP, 0, 0, 0, 200, 100);
+    SWindow *pRoot = host.GetRoot();
+    pRoot->CreateChildrenFromXml(L"<window name=\"fun_test.lookup.child\" pos=\"0,0,@10,@10\"/>");
+    EXPECT_TRUE(pRoot->FindChildByName(L"fun_test.lookup.window") == NULL);
+    EXPECT_TRUE(SAtom::Find(L"fun_test.lookup.window").IsNull());
+
+    // a defined window name is interned and found through the finder cache.
+    EXPECT_FALSE(SAtom::Find(L"fun_test.lookup.child").IsNull());
+    SWindow *pChild = pRoot->FindChildByName(L"fun_test.lookup.child");
+    ASSERT_TRUE(pChild != NULL);
+    EXPECT_TRUE(pRoot->FindChildByName(L"fun_test.lookup.child") == pChild);
+    host.DestroyWindow();
+}
+
+TEST(soui, def_attr_merge) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+    SApplication &app = *env.app;
+
+    SXmlDoc xmlUiDef;
+    ASSERT_TRUE(xmlUiDef.load_string(L"<uidef><objattr><window data=\"7\" text=\"def\"/><text alpha=\"100\"/></objattr></uidef>"));
+    SXmlNode xmlRoot = xmlUiDef.root().child(L"uidef");
+    SAutoRefPtr<IUiDefInfo> uiDef;
+    uiDef.Attach(SUiDef::CreateUiDefInfo());
+    uiDef->Init2(&xmlRoot, TRUE);
+    GETUIDEF->SetUiDef(uiDef, false);
+
+    SHostWnd host;
+    host.CreateEx(NULL, WS_POPUP, 0, 0, 0, 200, 100);
+    SWindow *pRoot = host.GetRoot();
+    pRoot->CreateChildrenFromXml(L"<text name=\"plain\" pos=\"0,0,@10,@10\"/>"
+                                 L"<text name=\"reset\" pos=\"0,0,@10,@10\" DATA=\"9\" alpha=\"200\"/>");
+    // defaults inherited from window and from the class itself.
+    SWindow *pPlain = pRoot->FindChildByName(L"plain");
+    ASSERT_TRUE(pPlain != NULL);
+    EXPECT_EQ(pPlain->GetUserData(), 7u);
+    EXPECT_EQ(pPlain->GetAlpha(), 100);
+    EXPECT_TRUE(pPlain->GetWindowText() == _T("def"));
+    // attributes the xml sets again win over the defaults, the others keep their defaults.
+    SWindow *pReset = pRoot->FindChildByName(L"reset");
+    ASSERT_TRUE(pReset != NULL);
+    EXPECT_EQ(pReset->GetUserData(), 9u);
+    EXPECT_EQ(pReset->GetAlpha(), 200);
+    EXPECT_TRUE(pReset->GetWindowText() == _T("def"));
+    // a window created by code gets every default.
+    SWindow *pCode = (SWindow *)app.CreateWindowByName(L"text");
+    EXPECT_EQ(pCode->GetUserData(), 7u);
+    EXPECT_EQ(pCode->GetAlpha(), 100);
+    pCode->Release();
+
+#if defined(__linux__) || _MSC_VER >= 1700
+    // tables are built once and shared by threads that ask for them at the same time.
+    SObjDefAttr *pDefAttr = GETUIDEF->GetUiDef()->GetObjDefAttr();
+    ASSERT_TRUE(pDefAttr != NULL);
+    const SObjDefAttr::ClassAttrTable *tables[4] = { NULL };
+    std::thread workers[ARRAYSIZE(tables)];
+    for (int i = 0; i < ARRAYSIZE(workers); i++)
+        workers[i] = std::thread([pDefAttr, &tables, i]() { tables[i] = &pDefAttr->GetClassAttrTable(L"check"); });
+    for (int i = 0; i < ARRAYSIZE(workers); i++)
+        workers[i].join();
+    for (int i = 1; i < ARRAYSIZE(tables); i++)
+        EXPECT_TRUE(tables[i] == tables[0]);
+    EXPECT_EQ(tables[0]->arrAttr.GetCount(), 2u);
+#endif
+    host.DestroyWindow();
+}
+
+class ShowIndexTree : public STreeCtrl {
+    DEF_SOBJECT(STreeCtrl, L"fun_test_tree")
+  public:
+    // compares the show indexes with a walk over the whole tree.
+    void CheckShowIndex() {
+        int iShow = 0;
+        for (HSTREEITEM hItem = GetRootItem(); hItem; hItem = GetNextItem(hItem)) {
+            BOOL bShown = TRUE;
+            for (HSTREEITEM hParent = GetParentItem(hItem); hParent; hParent = GetParentItem(hParent))
+                bShown = bShown && !GetItem(hParent)->bCollapsed;
+            if (!bShown) {
+                ASSERT_EQ(GetItemShowIndex(hItem), -1);
+                continue;
+            }
+            ASSERT_EQ(GetItemShowIndex(hItem), iShow);
+            ASSERT_TRUE(GetItemByShowIndex(iShow) == hItem);
+            iShow++;
+        }
+        ASSERT_EQ(iShow, m_nVisibleItems);
+        ASSERT_TRUE(GetItemByShowIndex(iShow) == 0);
+    }
+
+    void GetAllItems(SArray<HSTREEITEM> &arrItems) {
+        arrItems.RemoveAll();
+        for (HSTREEITEM hItem = GetRootItem(); hItem; hItem = GetNextItem(hItem))
+            arrItems.Add(hItem);
+    }
+
+    BOOL IsItemMeasured(HSTREEITEM hItem) {
+        return GetItem(hItem)->nContentWidth > 0;
+    }
+};
+
+static int NextRand(unsigned int &seed) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+TEST(soui, tree_show_index) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+    SApplication &app = *env.app;
+    app.RegisterWindowClass<ShowIndexTree>();
+
+    SHostWnd host;
+    host.CreateEx(NULL, WS_POPUP, 0, 0, 0, 200, 300);
+    host.GetRoot()->CreateChildrenFromXml(L"<fun_test_tree name=\"tree\" pos=\"0,0,-0,-0\"/>");
+    ShowIndexTree *pTree = host.GetRoot()->FindChildByName2<ShowIndexTree>(L"tree");
+    ASSERT_TRUE(pTree != NULL);
+
+    // random inserts at the end, the front and the middle of sibling lists, expands, collapses and removals.
+    unsigned int seed = 1;
+    SArray<HSTREEITEM> arrItems;
+    for (int i = 0; i < 600; i++) {
+        pTree->GetAllItems(arrItems);
+        int nCount = (int)arrItems.GetCount();
+        int nOp = NextRand(seed) % 10;
+        if (nCount == 0 || nOp < 5) {
+            HSTREEITEM hParent = (nCount == 0 || NextRand(seed) % 4 == 0) ? STVI_ROOT : arrItems[NextRand(seed) % nCount];
+            HSTREEITEM hAfter = STVI_LAST;
+            int nPos = NextRand(seed) % 3;
+            if (nPos == 1)
+                hAfter = STVI_FIRST;
+            else if (nPos == 2 && pTree->GetChildItem(hParent))
+                hAfter = pTree->GetChildItem(hParent);
+            pTree->InsertItem(_T("item"), hParent, hAfter);
+        } else if (nOp < 8) {
+            pTree->Expand(arrItems[NextRand(seed) % nCount], nOp == 5 ? TVE_COLLAPSE : (nOp == 6 ? TVE_EXPAND : TVE_TOGGLE));
+        } else if (nCount > 20) {
+            pTree->RemoveItem(arrItems[NextRand(seed) % nCount]);
+        }
+        pTree->CheckShowIndex();
+        if (HasFatalFailure())
+            break;
+    }
+
+    // nested batches: items are measured and the statistics rebuilt when the outermost batch ends.
+    pTree->RemoveAllItems();
+    pTree->BeginBatchInsert();
+    pTree->BeginBatchInsert();
+    HSTREEITEM hFirst = 0;
+    for (int i = 0; i < 1000; i++) {
+        HSTREEITEM hItem = pTree->InsertItem(_T("batch"), STVI_ROOT, i % 2 ? STVI_LAST : STVI_FIRST);
+        if (i == 0)
+            hFirst = hItem;
+        for (int j = 0; j < 3; j++)
+            pTree->InsertItem(_T("child"), hItem, STVI_LAST);
+        if (i % 3 == 0)
+            pTree->Expand(hItem, TVE_COLLAPSE);
+    }
+    pTree->EndBatchInsert();
+    EXPECT_FALSE(pTree->IsItemMeasured(hFirst));
+    pTree->EndBatchInsert();
+    EXPECT_TRUE(pTree->IsItemMeasured(hFirst));
+    pTree->CheckShowIndex();
+    // 334 collapsed items show 1 row, the others 4.
+    EXPECT_EQ(pTree->GetItemShowIndex(pTree->GetItemByShowIndex(334 + 666 * 4 - 1)), 334 + 666 * 4 - 1);
+    host.DestroyWindow();
+}
+
+static CSize GetRTSize(IRenderTarget *pRT) {
+    return ((IBitmapS *)pRT->GetCurrentObject(OT_BITMAP))->Size();
+}
+
+TEST(render, rt_pool) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+
+    const UINT cb64 = 64 * 64 * 4, cb96 = 96 * 64 * 4;
+    SRenderTargetPool pool(cb64 * 2);
+    RtPoolStats stats;
+
+    // sizes are rounded up to the bucket.
+    IRenderTarget *pRT1 = NULL;
+    ASSERT_TRUE(pool.Acquire(CSize(50, 40), &pRT1));
+    EXPECT_EQ(GetRTSize(pRT1), CSize(64, 64));
+    pRT1->SetViewportOrg(CPoint(-5, -5));
+    pool.Recycle(pRT1);
+    pool.GetStats(&stats);
+    EXPECT_EQ(stats.nIdle, 1u);
+    EXPECT_EQ(stats.cbIdle, cb64);
+
+    // the same bucket hands the idle target back, reset to its initial state.
+    IRenderTarget *pRT2 = NULL;
+    ASSERT_TRUE(pool.Acquire(CSize(64, 33), &pRT2));
+    EXPECT_TRUE(pRT2 == pRT1);
+    CPoint ptOrg(1, 1);
+    pRT2->GetViewportOrg(&ptOrg);
+    EXPECT_EQ(ptOrg, CPoint(0, 0));
+    pool.GetStats(&stats);
+    EXPECT_EQ(stats.nCreates, 1u);
+    EXPECT_EQ(stats.nReuses, 1u);
+    EXPECT_EQ(stats.nIdle, 0u);
+
+    // another bucket gets a target of its own.
+    IRenderTarget *pRT3 = NULL;
+    ASSERT_TRUE(pool.Acquire(CSize(65, 64), &pRT3));
+    EXPECT_TRUE(pRT3 != pRT2);
+    EXPECT_EQ(GetRTSize(pRT3), CSize(96, 64));
+
+    // idle targets stay within the budget, the least recently recycled goes first.
+    pool.Recycle(pRT2);
+    pool.Recycle(pRT3);
+    pool.GetStats(&stats);
+    EXPECT_EQ(stats.nIdle, 1u);
+    EXPECT_EQ(stats.cbIdle, cb96);
+    EXPECT_EQ(stats.nDrops, 1u);
+
+    // a target larger than the whole budget is dropped as soon as it comes back.
+    IRenderTarget *pBig = NULL;
+    ASSERT_TRUE(pool.Acquire(CSize(200, 200), &pBig));
+    pool.Recycle(pBig);
+    pool.GetStats(&stats);
+    EXPECT_EQ(stats.nIdle, 1u);
+    EXPECT_EQ(stats.nDrops, 2u);
+
+    pool.SetMaxIdleBytes(0);
+    pool.GetStats(&stats);
+    EXPECT_EQ(stats.nIdle, 0u);
+    EXPECT_EQ(stats.cbIdle, 0u);
+    EXPECT_EQ(stats.nAcquires, 4u);
+    EXPECT_EQ(stats.nRecycles, 4u);
+}
+
 TEST(soui,mb){
     const wchar_t * src = L"中文字符串test";
     char sz936[100];
@@ -150,6 +617,109 @@ TEST(soui,mb){
     EXPECT_TRUE(wcscmp(src,szWd)==0);
 }
 
+TEST(string, short_buffer) {
+    SStringW str(L"i");
+    str += L"d2";
+    EXPECT_TRUE(str == L"id2");
+    str += SStringW(L'x', 200);
+    EXPECT_EQ(str.GetLength(), 203);
+    SStringA strA("class");
+    SStringA strA2 = strA;
+    strA2.MakeUpper();
+    EXPECT_TRUE(strA == "class" && strA2 == "CLASS");
+}
+
+#if defined(__linux__) || _MSC_VER >= 1700
+TEST(string, share_across_threads) {
+    SStringW strShared(L"shared between worker threads");
+    std::thread workers[4];
+    for (int i = 0; i < ARRAYSIZE(workers); i++)
+    {
+        workers[i] = std::thread([&strShared]() {
+            for (int j = 0; j < 10000; j++)
+            {
+                SStringW strCopy = strShared;
+                strCopy += L"!";
+                EXPECT_EQ(strCopy.GetLength(), strShared.GetLength() + 1);
+            }
+        });
+    }
+    for (int i = 0; i < ARRAYSIZE(workers); i++)
+        workers[i].join();
+    EXPECT_TRUE(strShared == L"shared between worker threads");
+}
+#endif
+
+TEST(string, atom) {
+    EXPECT_TRUE(SAtom::Find(L"fun_test.atom.Name").IsNull());
+    SAtom atom(L"fun_test.atom.Name");
+    EXPECT_TRUE(atom == SAtom(SStringW(L"fun_test.atom.Name")));
+    EXPECT_TRUE(atom == SAtom::Find(L"fun_test.atom.Name"));
+    SAtom atomUpper(L"FUN_TEST.ATOM.NAME");
+    EXPECT_TRUE(atom != atomUpper && atom.EqualNoCase(atomUpper));
+    EXPECT_EQ(atom.GetHashNoCase(), atomUpper.GetHashNoCase());
+    EXPECT_TRUE(wcscmp(atom.GetFolded().GetName(), L"fun_test.atom.name") == 0);
+    EXPECT_TRUE(SAtom::FindNoCase(L"Fun_Test.Atom.NAME") == atom.GetFolded());
+}
+
+TEST(mem, tag_stat_and_arena) {
+    SMemStat before[MEM_TAG_MAX], after[MEM_TAG_MAX];
+    soui_mem_wrapper::GetMemStat(before);
+    void *p = soui_mem_wrapper::SouiMalloc(100, MEM_TAG_USER);
+    EXPECT_TRUE(soui_mem_wrapper::SouiMemSize(p) >= 100);
+    soui_mem_wrapper::GetMemStat(after);
+    EXPECT_EQ(after[MEM_TAG_USER].nBytes - before[MEM_TAG_USER].nBytes, 100);
+    EXPECT_EQ(after[MEM_TAG_USER].nAllocs - before[MEM_TAG_USER].nAllocs, 1);
+    soui_mem_wrapper::SouiFree(p);
+
+    // parse a layout inside an arena: the xml pages come from the arena and are released with it.
+    SStringT strXml = getSourceDir() + kPath_TestXml;
+    SMemArena arena;
+    SStringW strKept;
+    soui_mem_wrapper::GetMemStat(before);
+    {
+        SMemArenaScope scope(&arena, MEM_TAG_XML);
+        SXmlDoc xmlDoc;
+        EXPECT_TRUE(xmlDoc.load_file(strXml.c_str()));
+        EXPECT_TRUE(arena.GetUsedBytes() > 0);
+        // other tags are not routed to the arena and outlive it.
+        size_t cbUsed = arena.GetUsedBytes();
+        strKept = xmlDoc.root().first_child().name();
+        strKept += L".kept";
+        EXPECT_EQ(arena.GetUsedBytes(), cbUsed);
+    }
+    soui_mem_wrapper::GetMemStat(after);
+    EXPECT_TRUE(after[MEM_TAG_XML].nAllocs > before[MEM_TAG_XML].nAllocs);
+    EXPECT_EQ(after[MEM_TAG_XML].nBlocks, before[MEM_TAG_XML].nBlocks);
+    EXPECT_EQ(after[MEM_TAG_XML].nBytes, before[MEM_TAG_XML].nBytes);
+    arena.Reset();
+    EXPECT_EQ(arena.GetUsedBytes(), 0);
+    EXPECT_TRUE(strKept.EndsWith(L".kept"));
+
+    // growing a block of an outer arena inside a nested arena moves it to the heap, not into the inner arena.
+    SMemArena inner;
+    char *pOuter = NULL;
+    {
+        SMemArenaScope scope(&arena, MEM_TAG_USER);
+        pOuter = (char *)soui_mem_wrapper::SouiMalloc(64, MEM_TAG_USER);
+        memset(pOuter, 'a', 64);
+        {
+            SMemArenaScope scopeInner(&inner, MEM_TAG_USER);
+            void *pInner = soui_mem_wrapper::SouiMalloc(16, MEM_TAG_USER);
+            size_t cbInner = inner.GetUsedBytes();
+            pOuter = (char *)soui_mem_wrapper::SouiRealloc(pOuter, 4096);
+            EXPECT_EQ(inner.GetUsedBytes(), cbInner);
+            soui_mem_wrapper::SouiFree(pInner);
+        }
+    }
+    inner.Reset();
+    arena.Reset();
+    EXPECT_EQ(pOuter[0], 'a');
+    EXPECT_EQ(pOuter[63], 'a');
+    EXPECT_EQ(soui_mem_wrapper::SouiMemSize(pOuter), 4096u);
+    soui_mem_wrapper::SouiFree(pOuter);
+}
+
 class TaskHost {
 public:
     TaskHost(int id_) :id(id_) {}
@@ -228,6 +798,699 @@ TEST(com, resprovider_zip) {
 }
 
 
+static BOOL CALLBACK OnEnum7zFile(LPCTSTR pszFileName, LPARAM lp) {
+    ((SArray<SStringT> *)lp)->Add(pszFileName);
+    return TRUE;
+}
+
+TEST(com, resprovider_7zip_lazy) {
+    // the lazy provider only reads the archive index on init, files must match the eager provider.
+    SOUI::SStringT str7z = getSourceDir() + _T("/../../third-part/wke/wke.7z");
+    SComMgr2 comMgr;
+    SAutoRefPtr<IResProvider> lazyProvider, eagerProvider;
+    if (!comMgr.CreateResProvider_7ZIP((IObjRef **)&lazyProvider) || !comMgr.CreateResProvider_7ZIP((IObjRef **)&eagerProvider)) {
+        printf("load resprovider-7zip failed!\n");
+        return;
+    }
+    ZIP7RES_PARAM param;
+    Zip7File(&param, NULL, str7z.c_str(), "", NULL, TRUE, 1024 * 1024);
+    EXPECT_TRUE(lazyProvider->Init((WPARAM)&param, 0));
+    Zip7File(&param, NULL, str7z.c_str(), "");
+    EXPECT_TRUE(eagerProvider->Init((WPARAM)&param, 0));
+
+    SArray<SStringT> lazyFiles, eagerFiles;
+    lazyProvider->EnumFile(OnEnum7zFile, (LPARAM)&lazyFiles);
+    eagerProvider->EnumFile(OnEnum7zFile, (LPARAM)&eagerFiles);
+    EXPECT_EQ(lazyFiles.GetCount(), eagerFiles.GetCount());
+    for (size_t i = 0; i < lazyFiles.GetCount(); i++) {
+        size_t szLazy = lazyProvider->GetRawBufferSize(NULL, lazyFiles[i]);
+        size_t szEager = eagerProvider->GetRawBufferSize(NULL, lazyFiles[i]);
+        EXPECT_EQ(szLazy, szEager);
+        if (szLazy == 0 || szLazy != szEager)
+            continue;
+        SAutoBuf bufLazy, bufEager;
+        EXPECT_TRUE(lazyProvider->GetRawBuffer(NULL, lazyFiles[i], bufLazy.Allocate(szLazy), szLazy));
+        EXPECT_TRUE(eagerProvider->GetRawBuffer(NULL, lazyFiles[i], bufEager.Allocate(szEager), szEager));
+        EXPECT_EQ(memcmp((char *)bufLazy, (char *)bufEager, szLazy), 0);
+    }
+}
+
+TEST(image, pixel_conv) {
+    // every simd kernel must produce the same bytes as the scalar reference, tail pixels included.
+    const int kPixels = 256 * 256 + 7;
+    SAutoBuf src, ref, out;
+    BYTE *pSrc = (BYTE *)src.Allocate(kPixels * 4);
+    BYTE *pRef = (BYTE *)ref.Allocate(kPixels * 4);
+    BYTE *pOut = (BYTE *)out.Allocate(kPixels * 4);
+    for (int i = 0; i < kPixels; i++) {
+        BYTE *p = pSrc + i * 4;
+        p[0] = (BYTE)(i >> 8);
+        p[1] = (BYTE)(i * 7);
+        p[2] = (BYTE)~(i >> 8);
+        p[3] = (BYTE)i; // all color x alpha combinations
+    }
+    for (int bPremultiply = 0; bPremultiply < 2; bPremultiply++) {
+        SPixelConv::RgbaToBgra_Scalar(pRef, pSrc, kPixels, bPremultiply);
+        EXPECT_EQ(pRef[0], 0); // alpha 0 is cleared
+        for (int n = 0; n < 40; n++) {
+            memset(pOut, 0xcd, kPixels * 4);
+            SPixelConv::RgbaToBgra(pOut, pSrc + n * 4, kPixels - n, bPremultiply);
+            EXPECT_EQ(memcmp(pOut, pRef + n * 4, (kPixels - n) * 4), 0);
+        }
+        memcpy(pOut, pSrc, kPixels * 4);
+        SPixelConv::RgbaToBgra(pOut, pOut, kPixels, bPremultiply);
+        EXPECT_EQ(memcmp(pOut, pRef, kPixels * 4), 0);
+    }
+    SPixelConv::Gray_Scalar(pRef, pSrc, kPixels, 306, 601, 117);
+    SPixelConv::Gray(pOut, pSrc, kPixels, 306, 601, 117);
+    EXPECT_EQ(memcmp(pOut, pRef, kPixels * 4), 0);
+    BYTE px[4] = { 10, 20, 30, 128 };
+    SPixelConv::RgbaToBgra(px, px, 1, TRUE);
+    EXPECT_EQ(px[0], 30 * 128 / 255);
+    EXPECT_EQ(px[2], 10 * 128 / 255);
+    EXPECT_EQ(px[3], 128);
+}
+
+static int __cdecl IndexViewCompare(void *pCtx, int iItem1, int iItem2)
+{
+    const int *pKeys = (const int *)pCtx;
+    return pKeys[iItem1] - pKeys[iItem2];
+}
+
+static BOOL __cdecl IndexViewFilter(void *pCtx, int iItem)
+{
+    const int *pKeys = (const int *)pCtx;
+    return pKeys[iItem] % 3 != 0;
+}
+
+TEST(soui, index_view) {
+    // large enough for the threaded sort; few distinct keys so stability is exercised.
+    const int kItems = 50000;
+    std::vector<int> keys(kItems + 1);
+    for (int i = 0; i < kItems; i++)
+        keys[i] = (i * 7919) % 101;
+    std::vector<int> order(kItems);
+    for (int bParallel = 0; bParallel < 2; bParallel++) {
+        for (int i = 0; i < kItems; i++)
+            order[i] = i;
+        SIndexView::StableSort(order.data(), kItems, IndexViewCompare, keys.data(), bParallel);
+        for (int i = 1; i < kItems; i++) {
+            int d = keys[order[i - 1]] - keys[order[i]];
+            EXPECT_TRUE(d < 0 || (d == 0 && order[i - 1] < order[i]));
+        }
+    }
+
+    SIndexView view;
+    view.SetCompare(IndexViewCompare, keys.data());
+    view.SetFilter(IndexViewFilter, keys.data());
+    view.Reset(kItems);
+    int nShown = 0;
+    for (int i = 0; i < kItems; i++) {
+        int iRow = view.ItemToView(i);
+        EXPECT_EQ(iRow == -1, keys[i] % 3 == 0);
+        if (iRow != -1) {
+            EXPECT_EQ(view.ViewToItem(iRow), i);
+            nShown++;
+        }
+    }
+    EXPECT_EQ(view.GetCount(), nShown);
+
+    // appended item goes after the shown items with the same key
+    keys[kItems] = 50;
+    int iRow = view.InsertItem(kItems);
+    EXPECT_EQ(view.ViewToItem(iRow), kItems);
+    EXPECT_EQ(keys[view.ViewToItem(iRow - 1)], 50);
+    EXPECT_TRUE(iRow + 1 == view.GetCount() || keys[view.ViewToItem(iRow + 1)] > 50);
+    // after an incremental change ItemToView binary searches the sorted rows
+    EXPECT_EQ(view.ItemToView(kItems), iRow);
+    EXPECT_EQ(view.ItemToView(0), -1); // keys[0] == 0 is filtered
+    int iOldRow = view.ItemToView(1);
+    keys[1] = 101; // moves after every other item
+    int iNewRow = view.UpdateItemAt(1, iOldRow);
+    EXPECT_EQ(iNewRow, view.GetCount() - 1);
+    EXPECT_EQ(view.ItemToView(1), iNewRow);
+    keys[kItems] = 3;
+    iOldRow = -2;
+    EXPECT_EQ(view.UpdateItem(kItems, &iOldRow), -1);
+    EXPECT_EQ(iOldRow, iRow - 1); // item 1 (key 41) moved from before it
+    EXPECT_EQ(view.GetCount(), nShown);
+    view.RemoveItem(0);
+    EXPECT_EQ(view.GetItemCount(), kItems);
+}
+
+static std::vector<BYTE> ReadPieceTable(const SHexPieceTable &table)
+{
+    std::vector<BYTE> data(table.Size());
+    if (!data.empty())
+        EXPECT_EQ(table.Read(0, &data[0], table.Size()), table.Size());
+    return data;
+}
+
+static std::vector<BYTE> BytesOf(const char *psz)
+{
+    return std::vector<BYTE>(psz, psz + strlen(psz));
+}
+
+static void ReplaceText(SHexPieceTable &table, UINT nPos, UINT nRemove, const char *pszInsert)
+{
+    SHexPieceTable::PIECES pieces;
+    table.AddData((const BYTE *)pszInsert, (UINT)strlen(pszInsert), pieces);
+    table.Replace(nPos, nRemove, pieces);
+}
+
+TEST(hexedit, piece_table_replace) {
+    SHexPieceTable table;
+    table.SetData((const BYTE *)"0123456789", 10);
+    ReplaceText(table, 4, 0, "ab"); // insert
+    EXPECT_TRUE(ReadPieceTable(table) == BytesOf("0123ab456789"));
+    ReplaceText(table, 0, 0, "<"); // insert at the head
+    ReplaceText(table, table.Size(), 0, ">"); // append
+    EXPECT_TRUE(ReadPieceTable(table) == BytesOf("<0123ab456789>"));
+    ReplaceText(table, 3, 5, ""); // delete across pieces
+    EXPECT_TRUE(ReadPieceTable(table) == BytesOf("<0156789>"));
+    ReplaceText(table, 5, 2, "XY"); // overwrite
+    EXPECT_TRUE(ReadPieceTable(table) == BytesOf("<0156XY9>"));
+    EXPECT_EQ(table.Size(), 9u);
+    EXPECT_EQ(table.GetAt(5), 'X');
+    EXPECT_EQ(table.GetAt(8), '>');
+    SByteArray mid = table.Mid(6, 100); // clamped to the end
+    EXPECT_EQ(mid.Size(), 3);
+    EXPECT_EQ(memcmp(mid.GetData(), "Y9>", 3), 0);
+    ReplaceText(table, 0, table.Size(), ""); // delete all
+    EXPECT_EQ(table.Size(), 0u);
+    BYTE b = 0;
+    EXPECT_EQ(table.Read(0, &b, 1), 0u);
+}
+
+TEST(hexedit, piece_table_merge) {
+    SHexPieceTable table;
+    table.SetData((const BYTE *)"0123456789", 10);
+    SHexPieceTable::PIECES pieces;
+    // typing byte by byte appends to the add buffer and extends one piece
+    for (int i = 0; i < 100; i++) {
+        BYTE b = (BYTE)('a' + i % 26);
+        table.AddData(&b, 1, pieces);
+        table.Replace(5 + i, 0, pieces);
+    }
+    table.GetPieces(0, table.Size(), pieces);
+    EXPECT_EQ(pieces.size(), 3u);
+    EXPECT_EQ(pieces[1].nSource, SHexPieceTable::SRC_ADD);
+    EXPECT_EQ(pieces[1].nLength, 100u);
+
+    // removing the typed run joins the two halves of the original data again
+    table.Replace(5, 100, SHexPieceTable::PIECES());
+    table.GetPieces(0, table.Size(), pieces);
+    EXPECT_EQ(pieces.size(), 1u);
+    EXPECT_EQ(pieces[0].nSource, SHexPieceTable::SRC_ORIGINAL);
+    EXPECT_EQ(pieces[0].nLength, 10u);
+
+    // putting back a range read with GetPieces does not fragment the table
+    SHexPieceTable::PIECES mid;
+    table.GetPieces(3, 4, mid);
+    table.Replace(3, 4, mid);
+    table.GetPieces(0, table.Size(), pieces);
+    EXPECT_EQ(pieces.size(), 1u);
+    EXPECT_TRUE(ReadPieceTable(table) == BytesOf("0123456789"));
+}
+
+TEST(hexedit, piece_table_get_pieces) {
+    SHexPieceTable table;
+    table.SetData((const BYTE *)"0123456789", 10);
+    ReplaceText(table, 4, 2, "ab"); // 0123 ab 6789
+    SHexPieceTable::PIECES pieces;
+    table.GetPieces(2, 6, pieces); // 23 ab 67
+    EXPECT_EQ(pieces.size(), 3u);
+    EXPECT_EQ(SHexPieceTable::GetLength(pieces), 6u);
+    EXPECT_EQ(pieces[0].nSource, SHexPieceTable::SRC_ORIGINAL);
+    EXPECT_EQ(pieces[0].nOffset, 2u);
+    EXPECT_EQ(pieces[0].nLength, 2u);
+    EXPECT_EQ(pieces[1].nSource, SHexPieceTable::SRC_ADD);
+    EXPECT_EQ(pieces[1].nLength, 2u);
+    EXPECT_EQ(pieces[2].nSource, SHexPieceTable::SRC_ORIGINAL);
+    EXPECT_EQ(pieces[2].nOffset, 6u);
+    EXPECT_EQ(pieces[2].nLength, 2u);
+
+    table.GetPieces(5, 1, pieces); // inside one piece
+    EXPECT_EQ(pieces.size(), 1u);
+    EXPECT_EQ(pieces[0].nSource, SHexPieceTable::SRC_ADD);
+    EXPECT_EQ(pieces[0].nOffset, 1u);
+    EXPECT_EQ(pieces[0].nLength, 1u);
+    table.GetPieces(8, 100, pieces); // clamped to the end
+    EXPECT_EQ(SHexPieceTable::GetLength(pieces), 2u);
+    table.GetPieces(10, 1, pieces); // past the end
+    EXPECT_TRUE(pieces.empty());
+
+    // AppendPieces joins pieces that continue each other
+    SHexPieceTable::PIECES head, tail, all;
+    table.GetPieces(0, 2, head);
+    table.GetPieces(2, 2, tail);
+    SHexPieceTable::AppendPieces(all, head);
+    SHexPieceTable::AppendPieces(all, tail);
+    EXPECT_EQ(all.size(), 1u);
+    EXPECT_EQ(all[0].nLength, 4u);
+}
+
+TEST(hexedit, piece_table_undo_redo) {
+    // the same records SHexEdit keeps: old pieces and new pieces at a position
+    struct EDIT
+    {
+        UINT nPos;
+        SHexPieceTable::PIECES oldPieces;
+        SHexPieceTable::PIECES newPieces;
+    };
+    unsigned int seed = 12345;
+    std::vector<BYTE> plain(4096);
+    for (size_t i = 0; i < plain.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        plain[i] = (BYTE)(seed >> 16);
+    }
+    SHexPieceTable table;
+    table.SetData(&plain[0], (UINT)plain.size());
+    std::vector<EDIT> undo, redo;
+    std::vector<std::vector<BYTE> > undoPlain, redoPlain;
+    for (int i = 0; i < 3000; i++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = seed >> 8;
+        int op = r % 10;
+        r /= 10;
+        if (op < 6 || undo.empty()) {
+            UINT nSize = table.Size();
+            EDIT edit;
+            edit.nPos = r % (nSize + 1);
+            r /= nSize + 1;
+            UINT nRemove = smin((UINT)(r % 4), nSize - edit.nPos);
+            BYTE data[3] = { (BYTE)r, (BYTE)(r >> 8), (BYTE)(r >> 16) };
+            UINT nInsert = (r >> 4) % 4;
+            table.GetPieces(edit.nPos, nRemove, edit.oldPieces);
+            EXPECT_EQ(SHexPieceTable::GetLength(edit.oldPieces), nRemove);
+            table.AddData(data, nInsert, edit.newPieces);
+            table.Replace(edit.nPos, nRemove, edit.newPieces);
+
+            undoPlain.push_back(plain);
+            plain.erase(plain.begin() + edit.nPos, plain.begin() + edit.nPos + nRemove);
+            plain.insert(plain.begin() + edit.nPos, data, data + nInsert);
+            undo.push_back(edit);
+            redo.clear();
+            redoPlain.clear();
+        } else if (op < 8 || redo.empty()) {
+            EDIT edit = undo.back();
+            undo.pop_back();
+            table.Replace(edit.nPos, SHexPieceTable::GetLength(edit.newPieces), edit.oldPieces);
+            redo.push_back(edit);
+            redoPlain.push_back(plain);
+            plain = undoPlain.back();
+            undoPlain.pop_back();
+        } else {
+            EDIT edit = redo.back();
+            redo.pop_back();
+            table.Replace(edit.nPos, SHexPieceTable::GetLength(edit.oldPieces), edit.newPieces);
+            undo.push_back(edit);
+            undoPlain.push_back(plain);
+            plain = redoPlain.back();
+            redoPlain.pop_back();
+        }
+        EXPECT_EQ(table.Size(), (UINT)plain.size());
+        if (i % 100 == 0)
+            EXPECT_TRUE(ReadPieceTable(table) == plain);
+    }
+    EXPECT_TRUE(ReadPieceTable(table) == plain);
+
+    // undoing everything restores the original data
+    while (!undo.empty()) {
+        EDIT edit = undo.back();
+        undo.pop_back();
+        table.Replace(edit.nPos, SHexPieceTable::GetLength(edit.newPieces), edit.oldPieces);
+        plain = undoPlain.back();
+        undoPlain.pop_back();
+    }
+    EXPECT_TRUE(ReadPieceTable(table) == plain);
+    SHexPieceTable::PIECES pieces;
+    table.GetPieces(0, table.Size(), pieces);
+    EXPECT_EQ(pieces.size(), 1u);
+}
+
+TEST(xml, bin_flat) {
+    SXmlDoc xmlDoc;
+    EXPECT_TRUE(xmlDoc.load_string(L"<root a=\"1\" b=\"\u4e2d\u6587\"><child name=\"x\">text</child><child/></root>"));
+    for (int nCharSize = 1; nCharSize <= 4; nCharSize *= 2) {
+        FILE *f = tmpfile();
+        EXPECT_TRUE(f != NULL);
+        if (!f)
+            break;
+        xmlDoc.save_bin_flat(f, nCharSize);
+        size_t len = (size_t)ftell(f);
+        rewind(f);
+        SAutoBuf buf(len);
+        EXPECT_EQ(fread((char *)buf, 1, len, f), len);
+        fclose(f);
+
+        SXmlDoc xmlBin;
+        EXPECT_TRUE(xmlBin.load_buffer_inplace((char *)buf, len));
+        SXmlNode xmlRoot = xmlBin.root().child(L"root");
+        EXPECT_EQ(xmlRoot.attribute(L"a").as_int(), 1);
+        EXPECT_TRUE(wcscmp(xmlRoot.attribute(L"b").value(), L"\u4e2d\u6587") == 0);
+        SXmlNode xmlChild = xmlRoot.child(L"child");
+        EXPECT_TRUE(wcscmp(xmlChild.attribute(L"name").value(), L"x") == 0);
+        EXPECT_TRUE(wcscmp(xmlChild.child_value(), L"text") == 0);
+        EXPECT_TRUE(xmlChild.next_sibling());
+        if (nCharSize == sizeof(wchar_t)) {
+            // strings are used from the buffer in place.
+            const char *pName = (const char *)xmlChild.attribute(L"name").value();
+            EXPECT_TRUE(pName >= (char *)buf && pName < (char *)buf + len);
+        }
+    }
+}
+
+TEST(render, skia_text_grid) {
+    // a 200x80 grid of text cells per frame. the first pass draws from the glyph atlas, the second pass is
+    // the baseline: a clip region which is not a rect makes every cell go through skia's generic text path.
+    const int kCols = 200, kRows = 80, kCellWid = 36, kCellHei = 14, kFrames = 10;
+    TestEnv env;
+    if (!env.InitSkia())
+        return;
+    IRenderFactory *renderFac = env.renderFac;
+    SAutoRefPtr<IRenderTarget> rt;
+    EXPECT_TRUE(renderFac->CreateRenderTarget(&rt, kCols * kCellWid, kRows * kCellHei));
+    LOGFONT lf = { 0 };
+    lf.lfHeight = -12;
+    _tcscpy(lf.lfFaceName, _T("Arial"));
+    SAutoRefPtr<IFontS> font;
+    EXPECT_TRUE(renderFac->CreateFont(&font, &lf));
+    rt->SelectObject(font, NULL);
+    rt->SetTextColor(RGBA(0, 0, 0, 255));
+
+    CRect rcAll(0, 0, kCols * kCellWid, kRows * kCellHei);
+    CRect rcCorner(rcAll.right - 1, rcAll.bottom - 1, rcAll.right, rcAll.bottom);
+    SAutoRefPtr<IRegionS> rgn;
+    renderFac->CreateRegion(&rgn);
+    rgn->CombineRect(&rcAll, RGN_COPY);
+    rgn->CombineRect(&rcCorner, RGN_DIFF);
+
+    const size_t cbFrame = rcAll.Width() * rcAll.Height() * 4;
+    SAutoBuf bufAtlas, bufGeneric;
+    SStringT strCell;
+    for (int nPass = 0; nPass < 2; nPass++) {
+        if (nPass == 1)
+            rt->PushClipRegion(rgn, RGN_AND);
+        DWORD ts = GetTickCount();
+        for (int iFrame = 0; iFrame < kFrames; iFrame++) {
+            rt->FillSolidRect(&rcAll, RGBA(255, 255, 255, 255));
+            for (int iRow = 0; iRow < kRows; iRow++) {
+                for (int iCol = 0; iCol < kCols; iCol++) {
+                    // the text changes every frame, as in a scrolling list
+                    strCell.Format(_T("%04d:%02d"), (iFrame * kRows + iRow) % 10000, iCol % 100);
+                    CRect rc(iCol * kCellWid, iRow * kCellHei, (iCol + 1) * kCellWid, (iRow + 1) * kCellHei);
+                    rt->DrawText(strCell, strCell.GetLength(), &rc, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_NOPREFIX);
+                }
+            }
+        }
+        DWORD elapsed = GetTickCount() - ts;
+        printf("skia text grid, %s: %d frames in %u ms, %u cells/s\n", nPass == 0 ? "atlas" : "generic", kFrames, elapsed,
+               (UINT)((double)kCols * kRows * kFrames * 1000 / (elapsed ? elapsed : 1)));
+        if (nPass == 1)
+            rt->PopClip();
+        IBitmapS *bmp = (IBitmapS *)rt->GetCurrentObject(OT_BITMAP);
+        SAutoBuf &buf = nPass == 0 ? bufAtlas : bufGeneric;
+        memcpy(buf.Allocate(cbFrame), bmp->GetPixelBits(), cbFrame);
+    }
+    // the corner pixel is clipped out of the baseline pass.
+    memset((char *)bufAtlas + cbFrame - 4, 0, 4);
+    memset((char *)bufGeneric + cbFrame - 4, 0, 4);
+    EXPECT_EQ(memcmp((char *)bufAtlas, (char *)bufGeneric, cbFrame), 0);
+}
+
+#ifdef LIB_SOUI_COM
+EXTERN_C void Render_Skia_SetTileThreads(int nThreads);
+#endif
+
+typedef void (*FunSetTileThreads)(int nThreads);
+
+static FunSetTileThreads GetSkiaSetTileThreads(SComMgr2 &comMgr)
+{
+#ifdef LIB_SOUI_COM
+    (void)comMgr;
+    return Render_Skia_SetTileThreads;
+#else
+    HMODULE hMod = comMgr.GetRenderModule();
+    return hMod ? (FunSetTileThreads)GetProcAddress(hMod, "Render_Skia_SetTileThreads") : NULL;
+#endif
+}
+
+TEST(render, skia_parallel_repaint) {
+    // full-window repaints of a 4K host. the second pass records the commands and rasterizes them in bands
+    // on 3 worker threads plus the calling thread, it must produce the same pixels as the first pass, which draws directly.
+    // the worker count is explicit so that the bands are rasterized in parallel on single core machines too.
+    const int kWid = 3840, kHei = 2160, kCellWid = 160, kCellHei = 90, kFrames = 10;
+    TestEnv env;
+    if (!env.InitSkia())
+        return;
+    IRenderFactory *renderFac = env.renderFac;
+    FunSetTileThreads funSetTileThreads = GetSkiaSetTileThreads(env.comMgr);
+    ASSERT_TRUE(funSetTileThreads != NULL);
+    funSetTileThreads(3); // read when the factory creates its worker pool on the first flush
+    SAutoRefPtr<IBitmapS> icon;
+    EXPECT_TRUE(renderFac->CreateBitmap(&icon));
+    DWORD icoPixels[32 * 32];
+    for (int i = 0; i < 32 * 32; i++)
+        icoPixels[i] = RGBA((i % 32) * 8, (i / 32) * 8, 128, 255);
+    icon->Init(32, 32, icoPixels);
+    LOGFONT lf = { 0 };
+    lf.lfHeight = -14;
+    _tcscpy(lf.lfFaceName, _T("Arial"));
+    SAutoRefPtr<IFontS> font;
+    EXPECT_TRUE(renderFac->CreateFont(&font, &lf));
+
+    CRect rcAll(0, 0, kWid, kHei);
+    const size_t cbFrame = kWid * kHei * 4;
+    SAutoBuf bufDirect, bufRecord;
+    SStringT strCell;
+    for (int nPass = 0; nPass < 2; nPass++) {
+        SAutoRefPtr<IRenderTarget> rt;
+        EXPECT_TRUE(renderFac->CreateRenderTarget(&rt, kWid, kHei));
+        if (nPass == 1)
+            EXPECT_TRUE(rt->EnableRecording(TRUE));
+        rt->SelectObject(font, NULL);
+        DWORD ts = GetTickCount();
+        for (int iFrame = 0; iFrame < kFrames; iFrame++) {
+            rt->BeginDraw();
+            rt->FillSolidRect(&rcAll, RGBA(240, 240, 240, 255));
+            for (int y = 0; y < kHei; y += kCellHei) {
+                for (int x = 0; x < kWid; x += kCellWid) {
+                    CRect rc(x, y, x + kCellWid, y + kCellHei);
+                    rt->PushClipRect(&rc, RGN_AND);
+                    CRect rcBody = rc;
+                    rcBody.DeflateRect(4, 4);
+                    rt->FillSolidRect(&rcBody, RGBA(x * 255 / kWid, y * 255 / kHei, iFrame * 20, 255));
+                    CRect rcIcon(rcBody.left + 4, rcBody.top + 4, rcBody.left + 36, rcBody.top + 36);
+                    rt->DrawBitmap(&rcIcon, icon, 0, 0, 200);
+                    strCell.Format(_T("item %d,%d #%d"), x / kCellWid, y / kCellHei, iFrame);
+                    rt->SetTextColor(RGBA(0, 0, 0, 255));
+                    rt->DrawText(strCell, strCell.GetLength(), &rcBody, DT_SINGLELINE | DT_VCENTER | DT_CENTER | DT_NOPREFIX);
+                    rt->PopClip();
+                }
+            }
+            rt->EndDraw();
+        }
+        DWORD elapsed = GetTickCount() - ts;
+        printf("skia full repaint %dx%d, %s: %u ms per frame\n", kWid, kHei, nPass == 0 ? "direct" : "recorded", elapsed / kFrames);
+        IBitmapS *bmp = (IBitmapS *)rt->GetCurrentObject(OT_BITMAP);
+        SAutoBuf &buf = nPass == 0 ? bufDirect : bufRecord;
+        memcpy(buf.Allocate(cbFrame), bmp->GetPixelBits(), cbFrame);
+    }
+    funSetTileThreads(0);
+    EXPECT_EQ(memcmp((char *)bufDirect, (char *)bufRecord, cbFrame), 0);
+}
+
+TEST(render, skia_record_image_snapshot) {
+    // a recorded DrawBitmap must rasterize the pixels the image had when it was drawn,
+    // even if the image is changed or reinitialized before the recording is flushed.
+    const int kSize = 16;
+    TestEnv env;
+    if (!env.InitSkia())
+        return;
+    IRenderFactory *renderFac = env.renderFac;
+    DWORD red[kSize * kSize], green[kSize * kSize];
+    for (int i = 0; i < kSize * kSize; i++) {
+        red[i] = RGBA(255, 0, 0, 255);
+        green[i] = RGBA(0, 255, 0, 255);
+    }
+    SAutoRefPtr<IBitmapS> img1, img2;
+    EXPECT_TRUE(renderFac->CreateBitmap(&img1));
+    EXPECT_TRUE(renderFac->CreateBitmap(&img2));
+    img1->Init(kSize, kSize, red);
+    img2->Init(kSize, kSize, red);
+
+    SAutoRefPtr<IRenderTarget> rt;
+    EXPECT_TRUE(renderFac->CreateRenderTarget(&rt, kSize * 2, kSize));
+    EXPECT_TRUE(rt->EnableRecording(TRUE));
+    rt->BeginDraw();
+    CRect rc1(0, 0, kSize, kSize), rc2(kSize, 0, kSize * 2, kSize);
+    rt->DrawBitmap(&rc1, img1, 0, 0, 255);
+    rt->DrawBitmap(&rc2, img2, 0, 0, 255);
+    // change the pixels in place and reallocate them before the flush in EndDraw.
+    LPVOID pBits = img1->LockPixelBits();
+    memcpy(pBits, green, sizeof(green));
+    img1->UnlockPixelBits(pBits);
+    img2->Init(kSize, kSize, green);
+    img2 = NULL;
+    rt->EndDraw();
+
+    IBitmapS *bmp = (IBitmapS *)rt->GetCurrentObject(OT_BITMAP);
+    const DWORD *pixels = (const DWORD *)bmp->GetPixelBits();
+    for (int i = 0; i < kSize * kSize * 2; i++) {
+        if (pixels[i] != red[0]) {
+            ADD_FAILURE() << "pixel " << i << " is not the recorded red";
+            break;
+        }
+    }
+}
+
+TEST(render, skia_record_bitmap_brush_snapshot) {
+    // a recorded bitmap brush fill must rasterize the pixels its bitmap had when it was drawn.
+    const int kSize = 16;
+    TestEnv env;
+    if (!env.InitSkia())
+        return;
+    IRenderFactory *renderFac = env.renderFac;
+    DWORD red[kSize * kSize], green[kSize * kSize];
+    for (int i = 0; i < kSize * kSize; i++) {
+        red[i] = RGBA(255, 0, 0, 255);
+        green[i] = RGBA(0, 255, 0, 255);
+    }
+    SAutoRefPtr<IBitmapS> img;
+    EXPECT_TRUE(renderFac->CreateBitmap(&img));
+    img->Init(kSize, kSize, red);
+
+    SAutoRefPtr<IRenderTarget> rt;
+    EXPECT_TRUE(renderFac->CreateRenderTarget(&rt, kSize * 2, kSize));
+    EXPECT_TRUE(rt->EnableRecording(TRUE));
+    rt->BeginDraw();
+    SAutoRefPtr<IBrushS> br, oldBr;
+    EXPECT_EQ(rt->CreateBitmapBrush(img, kRepeat_TileMode, kRepeat_TileMode, &br), S_OK);
+    rt->SelectObject(br, (IRenderObj **)&oldBr);
+    CRect rc(0, 0, kSize * 2, kSize);
+    rt->FillRectangle(&rc);
+    rt->SelectObject(oldBr, NULL);
+    // change the pixels in place before the flush in EndDraw.
+    LPVOID pBits = img->LockPixelBits();
+    memcpy(pBits, green, sizeof(green));
+    img->UnlockPixelBits(pBits);
+    rt->EndDraw();
+
+    IBitmapS *bmp = (IBitmapS *)rt->GetCurrentObject(OT_BITMAP);
+    const DWORD *pixels = (const DWORD *)bmp->GetPixelBits();
+    for (int i = 0; i < kSize * kSize * 2; i++) {
+        if (pixels[i] != red[0]) {
+            ADD_FAILURE() << "pixel " << i << " is not the recorded red";
+            break;
+        }
+    }
+}
+
+TEST(render, colorized_skin_cache) {
+    TestEnv env;
+    if (!env.InitSkia())
+        return;
+    IRenderFactory *renderFac = env.renderFac;
+    const int kSize = 64, kSkins = 3;
+    const size_t cbImg = kSize * kSize * 4;
+    DWORD pixels[kSize * kSize];
+    for (int i = 0; i < kSize * kSize; i++)
+        pixels[i] = RGBA(i % 256, (i / kSize) * 4, 100, 255);
+    const COLORREF colors[] = { RGB(200, 0, 0), RGB(0, 200, 0), RGB(0, 0, 200), RGB(200, 200, 0), RGB(0, 200, 200) };
+
+    // room for 6 copies: each skin keeps at most 4, all skins together at most 6.
+    SSkinImgList::SetColorizedCacheBudget(cbImg * 6);
+    SAutoRefPtr<SSkinImgList> skins[kSkins];
+    SAutoBuf bufFirst;
+    for (int i = 0; i < kSkins; i++) {
+        SAutoRefPtr<IBitmapS> bmp;
+        EXPECT_TRUE(renderFac->CreateBitmap(&bmp));
+        bmp->Init(kSize, kSize, pixels);
+        skins[i].Attach(new SSkinImgList);
+        skins[i]->SetImage(bmp);
+        for (int j = 0; j < ARRAYSIZE(colors); j++) {
+            skins[i]->OnColorize(colors[j]);
+            if (i == 0 && j == 0)
+                memcpy(bufFirst.Allocate(cbImg), bmp->GetPixelBits(), cbImg);
+            EXPECT_LE(SSkinImgList::GetColorizedCacheSize(), cbImg * 6);
+        }
+    }
+    EXPECT_EQ(SSkinImgList::GetColorizedCacheSize(), cbImg * 6);
+
+    // the first color of the first skin was evicted, colorizing again gives the same pixels.
+    skins[0]->OnColorize(colors[0]);
+    EXPECT_EQ(memcmp(skins[0]->GetImage()->GetPixelBits(), (char *)bufFirst, cbImg), 0);
+    skins[0]->OnColorize(0);
+    EXPECT_EQ(memcmp(skins[0]->GetImage()->GetPixelBits(), pixels, cbImg), 0);
+
+    SSkinImgList::SetColorizedCacheBudget(cbImg * 2);
+    EXPECT_EQ(SSkinImgList::GetColorizedCacheSize(), cbImg * 2);
+    for (int i = 0; i < kSkins; i++)
+        skins[i] = NULL;
+    EXPECT_EQ(SSkinImgList::GetColorizedCacheSize(), 0u);
+    SSkinImgList::SetColorizedCacheBudget(16 * 1024 * 1024); // the default
+}
+
+TEST(render, scaled_skin_cache) {
+    TestEnv env;
+    if (!env.InitApp())
+        return;
+    SApplication &app = *env.app;
+    IRenderFactory *renderFac = env.renderFac;
+
+    const int kSize = 32;
+    const size_t cbScaled = kSize * 2 * kSize * 2 * 4; // one skin at scale 200
+    DWORD pixels[kSize * kSize];
+    for (int i = 0; i < kSize * kSize; i++)
+        pixels[i] = RGBA(i % 256, 50, 100, 255);
+    const wchar_t *names[] = { L"fun_test.scaled.a", L"fun_test.scaled.b", L"fun_test.scaled.c" };
+    SAutoRefPtr<SSkinPool> pool(new SSkinPool(TRUE), FALSE);
+    for (int i = 0; i < ARRAYSIZE(names); i++) {
+        SAutoRefPtr<IBitmapS> bmp;
+        EXPECT_TRUE(renderFac->CreateBitmap(&bmp));
+        bmp->Init(kSize, kSize, pixels);
+        SAutoRefPtr<SSkinImgList> skin(new SSkinImgList, FALSE);
+        skin->SetName(names[i]);
+        skin->SetImage(bmp);
+        EXPECT_TRUE(pool->AddSkin(skin));
+        EXPECT_TRUE(pool->GetSkin(names[i], 100) == skin);
+    }
+    SSkinPool::SetScaledSkinBudget(cbScaled * 2);
+
+    // a skin scaled on demand is handed out, so it does not count against the budget.
+    ISkinObj *pA = pool->GetSkin(names[0], 200);
+    ASSERT_TRUE(pA != NULL);
+    EXPECT_EQ(pA->GetScale(), 200);
+    EXPECT_EQ(SSkinPool::GetScaledSkinCacheSize(), 0u);
+
+    // prefetching runs one skin per task on the message loop and skips skins already handed out.
+    EXPECT_EQ(pool->PrefetchScale(100, 200), 2);
+    for (int i = 0; i < 4; i++)
+        app.GetMsgLoop()->ExecutePendingTask();
+    EXPECT_EQ(SSkinPool::GetScaledSkinCacheSize(), cbScaled * 2);
+
+    // a smaller budget evicts the oldest prefetched skin, never a skin handed out.
+    SSkinPool::SetScaledSkinBudget(cbScaled);
+    EXPECT_EQ(SSkinPool::GetScaledSkinCacheSize(), cbScaled);
+    EXPECT_TRUE(pool->GetSkin(names[0], 200) == pA);
+
+    // handing out the kept skin pins it, it survives a zero budget.
+    ISkinObj *pC = pool->GetSkin(names[2], 200);
+    ASSERT_TRUE(pC != NULL);
+    EXPECT_EQ(SSkinPool::GetScaledSkinCacheSize(), 0u);
+    SSkinPool::SetScaledSkinBudget(0);
+    EXPECT_TRUE(pool->GetSkin(names[2], 200) == pC);
+    EXPECT_EQ(pC->GetScale(), 200);
+    EXPECT_EQ(pA->GetSkinSize().cx, kSize * 2);
+
+    // the evicted skin is scaled again on demand.
+    ISkinObj *pB = pool->GetSkin(names[1], 200);
+    ASSERT_TRUE(pB != NULL);
+    EXPECT_EQ(pB->GetScale(), 200);
+    SSkinPool::SetScaledSkinBudget(64 * 1024 * 1024); // the default
+}
+
 #define evt_name1 _T("/tmp/hello_event_soui1")
 #define evt_name2 _T("/tmp/hello_event_soui2")
 
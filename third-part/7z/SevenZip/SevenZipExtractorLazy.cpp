@@ -0,0 +1,160 @@
+#include "SevenZipExtractorLazy.h"
+#include "GUIDs.h"
+#include "FileSys.h"
+#include "ArchiveOpenCallback.h"
+#include "ArchiveExtractCallbackMemory.h"
+#include "InStreamWrapper.h"
+#include "PropVariant2.h"
+#include "UsefulFunctions.h"
+#include "SevenString.h"
+#include <algorithm>
+
+namespace SevenZip
+{
+
+    using namespace intl;
+
+	static std::string tolowerstring(std::string str)
+	{
+		std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+		return str;
+	}
+
+    SevenZipExtractorLazy::SevenZipExtractorLazy()
+        : SevenZipArchive()
+		, m_passwordIsDefined(false)
+    {
+    }
+
+    SevenZipExtractorLazy::~SevenZipExtractorLazy()
+    {
+		CloseArchive();
+    }
+
+	HRESULT SevenZipExtractorLazy::OpenArchive(SevenZipPassword *pSevenZipPassword)
+	{
+		CloseArchive();
+		DetectCompressionFormat();
+#if defined(_UNICODE)
+		FILE* fileStream = _wfopen(m_archivePath.c_str(), L"rb");
+#else
+		FILE* fileStream = fopen(m_archivePath.c_str(), "rb");
+#endif
+		if (fileStream == NULL)
+		{
+			m_message = _T("Could not open archive");
+			return E_FAIL;
+		}
+
+		if (NULL != pSevenZipPassword)
+		{
+			m_passwordIsDefined = pSevenZipPassword->PasswordIsDefined;
+			m_password = pSevenZipPassword->Password.c_str();
+		}
+
+		CMyComPtr< IInArchive > archive = UsefulFunctions::GetArchiveReader(m_compressionFormat);
+		if (!archive)
+		{
+			fclose(fileStream);
+			m_message = _T("unsupported format");
+			return E_FAIL;
+		}
+		// the wrapper is created with one reference, attach it so the file gets closed with the archive.
+		CMyComPtr< IInStream > inFile;
+		inFile.Attach(new InStreamWrapper(fileStream));
+		CMyComPtr< ArchiveOpenCallback > openCallback = new ArchiveOpenCallback();
+		openCallback->PasswordIsDefined = m_passwordIsDefined;
+		openCallback->Password = m_password;
+
+		HRESULT hr = archive->Open(inFile, 0, openCallback);
+		if (hr != S_OK)
+		{
+			m_message = _T("open error");
+			return hr;
+		}
+
+		UInt32 numItems = 0;
+		archive->GetNumberOfItems(&numItems);
+		m_items.reserve(numItems);
+		m_archiveIndices.reserve(numItems);
+		for (UInt32 i = 0; i < numItems; ++i)
+		{
+			CPropVariant prop;
+			if (archive->GetProperty(i, kpidIsDir, &prop) == S_OK && prop.vt == VT_BOOL && prop.boolVal != VARIANT_FALSE)
+				continue;
+
+			ItemInfo item;
+			prop.Clear();
+			archive->GetProperty(i, kpidPath, &prop);
+			if (prop.vt == VT_BSTR)
+				item.name = tolowerstring(ToPathNativeStr(std::wstring(prop.bstrVal)));
+			else
+				item.name = tolowerstring(ToPathNativeStr(L"[Content]"));
+
+			prop.Clear();
+			archive->GetProperty(i, kpidSize, &prop);
+			item.size = prop.vt == VT_UI8 ? prop.uhVal.QuadPart : (prop.vt == VT_UI4 ? prop.ulVal : 0);
+
+			prop.Clear();
+			archive->GetProperty(i, kpidBlock, &prop);
+			item.block = prop.vt == VT_UI4 ? prop.ulVal : (UInt32)kNoBlock;
+
+			m_items.push_back(item);
+			m_archiveIndices.push_back(i);
+		}
+		m_archive = archive;
+		return S_OK;
+	}
+
+	void SevenZipExtractorLazy::CloseArchive()
+	{
+		if (m_archive)
+		{
+			m_archive->Close();
+			m_archive.Release();
+		}
+		m_items.clear();
+		m_archiveIndices.clear();
+	}
+
+	bool SevenZipExtractorLazy::IsArchiveOpen() const
+	{
+		return m_archive != NULL;
+	}
+
+	UInt32 SevenZipExtractorLazy::GetItemCount() const
+	{
+		return (UInt32)m_items.size();
+	}
+
+	const SevenZipExtractorLazy::ItemInfo &SevenZipExtractorLazy::GetItem(UInt32 index) const
+	{
+		return m_items[index];
+	}
+
+	HRESULT SevenZipExtractorLazy::ExtractItems(const UInt32 *indices, UInt32 count, CFileStream &fileStreams)
+	{
+		if (!m_archive || count == 0)
+			return E_FAIL;
+		std::vector<UInt32> archiveIndices(count);
+		for (UInt32 i = 0; i < count; i++)
+			archiveIndices[i] = m_archiveIndices[indices[i]];
+
+		CMyComPtr< ArchiveExtractCallbackMemory > extractCallback = new ArchiveExtractCallbackMemory(m_archive, NULL, fileStreams);
+		extractCallback->PasswordIsDefined = m_passwordIsDefined;
+		extractCallback->Password = m_password;
+
+		HRESULT hr = m_archive->Extract(&archiveIndices[0], count, false, extractCallback);
+		if (hr != S_OK)
+		{
+			m_message = _T("extract error");
+		}
+		return hr;
+	}
+
+    const TString& SevenZipExtractorLazy::GetErrorString()
+    {
+        return m_message;
+    }
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "SevenZipArchive.h"
+#include "SevenZipPwd.h"
+#include "FileStream.h"
+#include "../CPP/7zip/Archive/IArchive.h"
+#include "../CPP/Common/MyString.h"
+#include <string>
+
+namespace SevenZip
+{
+
+	// Reads only the archive index on open and keeps the archive open, so that
+	// single files (or the solid blocks holding them) can be extracted on demand.
+    class SevenZipExtractorLazy : public SevenZipArchive
+    {
+    public:
+		enum { kNoBlock = 0xFFFFFFFF };
+
+		struct ItemInfo
+		{
+			std::string name;	// lower case, encoded the same way as names in CFileStream
+			UInt64 size;		// uncompressed size
+			UInt32 block;		// solid block (7z folder) index, kNoBlock if not known
+		};
+
+        SevenZipExtractorLazy();
+        virtual ~SevenZipExtractorLazy();
+
+		HRESULT OpenArchive(SevenZipPassword *pSevenZipPassword = NULL);
+		void CloseArchive();
+		bool IsArchiveOpen() const;
+
+		UInt32 GetItemCount() const;
+		const ItemInfo &GetItem(UInt32 index) const;
+
+		// indices refer to GetItem and must be sorted ascending; extracted files are put into fileStreams.
+		HRESULT ExtractItems(const UInt32 *indices, UInt32 count, CFileStream &fileStreams);
+        const TString& GetErrorString();
+    private:
+		CMyComPtr< IInArchive > m_archive;
+		std::vector<ItemInfo> m_items;
+		std::vector<UInt32> m_archiveIndices;	// item -> index in the archive
+		bool m_passwordIsDefined;
+		UString m_password;
+        TString m_message;
+    };
+}
@@ -10,8 +10,9 @@
 #include "SkPicture.h"
 
 // SkCanvas will fail in mysterious ways if it doesn't know the real width and height.
-SkRecorder::SkRecorder(SkRecord* record, int width, int height)
-    : SkCanvas(width, height, SkCanvas::kConservativeRasterClip_InitFlag)
+SkRecorder::SkRecorder(SkRecord* record, int width, int height, bool exactClip)
+    : SkCanvas(width, height, exactClip ? SkCanvas::kDefault_InitFlags
+                                        : SkCanvas::kConservativeRasterClip_InitFlag)
     , fRecord(record)
     , fSaveLayerCount(0) {}
 
@@ -18,7 +18,9 @@
 class SkRecorder : public SkCanvas {
 public:
     // Does not take ownership of the SkRecord.
-    SkRecorder(SkRecord*, int width, int height);
+    // exactClip: track clips exactly instead of as conservative rects, so that clip queries on the
+    // recorder answer the same as on a raster canvas.
+    SkRecorder(SkRecord*, int width, int height, bool exactClip = false);
 
     // Make SkRecorder forget entirely about its SkRecord*; all calls to SkRecorder will fail.
     void forgetRecord();
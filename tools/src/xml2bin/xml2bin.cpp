@@ -1,62 +1,574 @@
-// dui-demo.cpp : main source file
+// xml2bin.cpp : convert soui xml resources to binary xml.
 //
+// usage:
+//   xml2bin dir [tobin|toxml]
+//       convert every xml file in dir in place.
+//   xml2bin -i srcdir -o outdir [-c charsize] [-r repeat] [-s] [-W]
+//       compile a uires pack ahead of time: styles referenced by "class" are inlined into
+//       layouts, skin/class/id references are validated and every xml file is saved as flat
+//       binary xml which the runtime loads without copying strings. other files are copied.
 
 #include "stdafx.h"
-using namespace pugi;
+#include <chrono>
+
 using namespace SNS;
 
-void convertDir(LPCTSTR pszDir,bool toBin)
+#ifdef _WIN32
+#define KPathSlash _T('\\')
+#else
+#define KPathSlash _T('/')
+#endif
+
+static const TCHAR KUiresIdx[] = _T("uires.idx");
+
+struct ResFile
+{
+	SStringW strType;
+	SStringW strName;
+	SStringT strPath;	//path relative to the pack root, using native slash.
+};
+
+struct CompileOption
+{
+	SStringT strSrc;
+	SStringT strOut;
+	int  nCharSize;
+	int  nRepeat;
+	bool bInlineStyle;
+	bool bWarningAsError;
+};
+
+static int s_nWarnings = 0;
+
+static void Warning(const SStringT & strFile, const SStringW & strMsg)
+{
+	s_nWarnings++;
+	printf("warning: %s: %s\n", S_CT2A(strFile).c_str(), S_CW2A(strMsg, CP_UTF8).c_str());
+}
+
+static SStringT NativePath(SStringT strPath)
+{
+#ifdef _WIN32
+	strPath.ReplaceChar(_T('/'), KPathSlash);
+#else
+	strPath.ReplaceChar(_T('\\'), KPathSlash);
+#endif
+	return strPath;
+}
+
+static bool MakeDir(const SStringT & strDir)
+{
+	for (int i = 1; i <= strDir.GetLength(); i++)
+	{
+		if (i < strDir.GetLength() && strDir[i] != KPathSlash)
+			continue;
+		SStringT strSub = strDir.Left(i);
+#ifdef _WIN32
+		CreateDirectory(strSub, NULL);
+#else
+		mkdir(strSub.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+#endif
+	}
+	return true;
+}
+
+static bool MakeFileDir(const SStringT & strPath)
+{
+	int iSlash = strPath.ReverseFind(KPathSlash);
+	if (iSlash <= 0)
+		return true;
+	return MakeDir(strPath.Left(iSlash));
+}
+
+static bool ReadFileData(const SStringT & strPath, SAutoBuf & buf)
+{
+	FILE *f = _tfopen(strPath, _T("rb"));
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	size_t len = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf.Allocate(len);
+	bool bOk = fread((char*)buf, 1, len, f) == len;
+	fclose(f);
+	return bOk;
+}
+
+static bool CopyFileData(const SStringT & strSrc, const SStringT & strDst)
+{
+	SAutoBuf buf;
+	if (!ReadFileData(strSrc, buf))
+		return false;
+	MakeFileDir(strDst);
+	FILE *f = _tfopen(strDst, _T("wb"));
+	if (!f)
+		return false;
+	bool bOk = fwrite((char*)buf, 1, buf.size(), f) == buf.size();
+	fclose(f);
+	return bOk;
+}
+
+//enumerate files of a dir recursively, strRelPath is relative to strRoot.
+typedef void (*FunEnumFile)(const SStringT & strRoot, const SStringT & strRelPath, LPVOID ctx);
+
+static void EnumDir(const SStringT & strRoot, const SStringT & strRelDir, FunEnumFile fun, LPVOID ctx)
+{
+	SStringT strDir = strRelDir.IsEmpty() ? strRoot : (strRoot + KPathSlash + strRelDir);
+#ifdef _WIN32
+	WIN32_FIND_DATA wfd;
+	SStringT strFilter = strDir + _T("\\*.*");
+	HANDLE hFind = FindFirstFile(strFilter, &wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		if (_tcscmp(wfd.cFileName, _T(".")) == 0 || _tcscmp(wfd.cFileName, _T("..")) == 0)
+			continue;
+		SStringT strRel = strRelDir.IsEmpty() ? SStringT(wfd.cFileName) : (strRelDir + KPathSlash + wfd.cFileName);
+		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			EnumDir(strRoot, strRel, fun, ctx);
+		else
+			fun(strRoot, strRel, ctx);
+	} while (FindNextFile(hFind, &wfd));
+	FindClose(hFind);
+#else
+	DIR *dir = opendir(strDir.c_str());
+	if (!dir)
+		return;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (_tcscmp(entry->d_name, _T(".")) == 0 || _tcscmp(entry->d_name, _T("..")) == 0)
+			continue;
+		SStringT strRel = strRelDir.IsEmpty() ? SStringT(entry->d_name) : (strRelDir + KPathSlash + entry->d_name);
+		//d_type is an enumeration, not a bitmask. some filesystems report DT_UNKNOWN,
+		//and a symlink is only followed when it points to a regular file.
+		bool bDir = entry->d_type == DT_DIR;
+		bool bFile = entry->d_type == DT_REG;
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+		{
+			struct stat st;
+			SStringT strPath = strDir + KPathSlash + entry->d_name;
+			if (stat(strPath.c_str(), &st) == 0)
+			{
+				bDir = entry->d_type == DT_UNKNOWN && S_ISDIR(st.st_mode);
+				bFile = S_ISREG(st.st_mode);
+			}
+		}
+		if (bDir)
+			EnumDir(strRoot, strRel, fun, ctx);
+		else if (bFile)
+			fun(strRoot, strRel, ctx);
+	}
+	closedir(dir);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+// legacy mode: convert xml files in place.
+static void OnConvertFile(const SStringT & strRoot, const SStringT & strRelPath, LPVOID ctx)
+{
+	bool toBin = *(bool*)ctx;
+	SStringT strName = strRelPath;
+	strName.MakeLower();
+	if (!strName.EndsWith(_T("xml")) && !strName.EndsWith(KUiresIdx))
+		return;
+	SStringT strPath = strRoot + KPathSlash + strRelPath;
+	SXmlDoc xmlDoc;
+	if (xmlDoc.load_file(strPath))
+	{
+		bool bOk = xmlDoc.save_file(strPath, L"\t", 0, toBin ? enc_bin : enc_utf8);
+		printf("convert %s to %s return %s!\n", S_CT2A(strPath).c_str(), toBin ? "bin" : "xml", bOk ? "succeed" : "failed");
+	}
+	else
+	{
+		printf("load %s failed!\n", S_CT2A(strPath).c_str());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ahead-of-time compiler of uires pack
+class SUiresCompiler
 {
-	WIN32_FIND_DATAW wfd;
-	TCHAR szFilter[MAX_PATH];
-	_stprintf(szFilter,_T("%s\\*.*"),pszDir);
-	HANDLE hFind = FindFirstFile(szFilter,&wfd);
-	if(hFind)
+public:
+	SUiresCompiler(const CompileOption & opt) :m_opt(opt)
 	{
-		do 
+	}
+
+	bool Run()
+	{
+		if (!LoadIndex())
+			return false;
+		LoadUidef();
+
+		EnumDir(m_opt.strSrc, SStringT(), OnEnumFile, this);
+
+		printf("%-40s %10s %10s %12s %12s\n", "file", "xml(B)", "bin(B)", "xml(us)", "bin(us)");
+		size_t szXml = 0, szBin = 0;
+		double tmXml = 0, tmBin = 0;
+		bool bOk = true;
+		for (size_t i = 0; i < m_lstFile.GetCount(); i++)
 		{
-			SOUI::SStringT strName(wfd.cFileName);
+			const ResFile & res = m_lstFile[i];
+			SStringT strName = res.strPath;
 			strName.MakeLower();
-			SOUI::SStringT strPath=SOUI::SStringT().Format(_T("%s\\%s"),pszDir,wfd.cFileName);
-			if(wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			if (!strName.EndsWith(_T(".xml")))
 			{
-				if(strName != _T(".") && strName!=_T("..") )
-				{
-					convertDir(strPath,toBin);
-				}
-			}else if(strName.EndsWith(_T("xml")) || strName==_T("uires.idx"))
+				bOk = CopyFileData(m_opt.strSrc + KPathSlash + res.strPath, m_opt.strOut + KPathSlash + res.strPath) && bOk;
+				continue;
+			}
+			FileStat stat = { 0 };
+			if (!CompileFile(res, stat))
 			{
-				pugi::xml_document xmlDoc;
-				if(xmlDoc.load_file(strPath))
+				bOk = false;
+				continue;
+			}
+			printf("%-40s %10u %10u %12.1f %12.1f\n", S_CT2A(res.strPath).c_str(), (unsigned)stat.szXml, (unsigned)stat.szBin, stat.tmXml, stat.tmBin);
+			szXml += stat.szXml;
+			szBin += stat.szBin;
+			tmXml += stat.tmXml;
+			tmBin += stat.tmBin;
+		}
+		printf("%-40s %10u %10u %12.1f %12.1f\n", "total", (unsigned)szXml, (unsigned)szBin, tmXml, tmBin);
+		if (tmBin > 0 && tmXml > 0)
+			printf("size saved %d%%, parse time saved %d%%, %d warnings\n", szXml ? (int)(100 - szBin * 100 / szXml) : 0, (int)(100 - tmBin * 100 / tmXml), s_nWarnings);
+		if (m_opt.bWarningAsError && s_nWarnings > 0)
+			return false;
+		return bOk;
+	}
+
+protected:
+	struct FileStat
+	{
+		size_t szXml;
+		size_t szBin;
+		double tmXml;	//average parse time in us.
+		double tmBin;
+	};
+
+	static void OnEnumFile(const SStringT & strRoot, const SStringT & strRelPath, LPVOID ctx)
+	{
+		SUiresCompiler * _this = (SUiresCompiler*)ctx;
+		if (strRelPath.CompareNoCase(KUiresIdx) == 0)
+		{
+			CopyFileData(strRoot + KPathSlash + strRelPath, _this->m_opt.strOut + KPathSlash + strRelPath);
+			return;
+		}
+		if (_this->m_mapPath.Lookup(strRelPath))
+			return;
+		//files which are not listed in uires.idx are compiled or copied too.
+		ResFile res;
+		res.strPath = strRelPath;
+		_this->m_lstFile.Add(res);
+	}
+
+	bool LoadIndex()
+	{
+		SXmlDoc xmlIdx;
+		SStringT strIdx = m_opt.strSrc + KPathSlash + KUiresIdx;
+		if (!xmlIdx.load_file(strIdx))
+		{
+			printf("error: load %s failed!\n", S_CT2A(strIdx).c_str());
+			return false;
+		}
+		SXmlNode xmlType = xmlIdx.root().child(L"resource").first_child();
+		for (; xmlType; xmlType = xmlType.next_sibling())
+		{
+			for (SXmlNode xmlFile = xmlType.child(L"file"); xmlFile; xmlFile = xmlFile.next_sibling(L"file"))
+			{
+				ResFile res;
+				res.strType = xmlType.name();
+				res.strName = xmlFile.attribute(L"name").value();
+				res.strPath = NativePath(S_CW2T(xmlFile.attribute(L"path").value()));
+				m_mapPath[res.strPath] = (int)m_lstFile.GetCount();
+				m_lstFile.Add(res);
+			}
+		}
+		return true;
+	}
+
+	const ResFile * FindRes(const SStringW & strType, const SStringW & strName) const
+	{
+		for (size_t i = 0; i < m_lstFile.GetCount(); i++)
+		{
+			if (m_lstFile[i].strType.CompareNoCase(strType) == 0 && m_lstFile[i].strName.CompareNoCase(strName) == 0)
+				return &m_lstFile[i];
+		}
+		return NULL;
+	}
+
+	//get uidef child node, follow its "src" attribute which is a "type:name" resource id.
+	SXmlNode GetSourceNode(SXmlNode xmlRoot, LPCWSTR pszName, SXmlDoc & docSrc)
+	{
+		SXmlNode xmlNode = xmlRoot.child(pszName);
+		SXmlAttr attrSrc = xmlNode.attribute(L"src");
+		if (!attrSrc)
+			return xmlNode;
+		SStringW strSrc = attrSrc.value();
+		int iSep = strSrc.Find(L':');
+		const ResFile * pRes = iSep > 0 ? FindRes(strSrc.Left(iSep), strSrc.Mid(iSep + 1)) : NULL;
+		if (!pRes || !docSrc.load_file(m_opt.strSrc + KPathSlash + pRes->strPath))
+		{
+			Warning(KUiresIdx, SStringW().Format(L"uidef source %s was not found", strSrc.c_str()));
+			return SXmlNode();
+		}
+		m_mapDefFile[pRes->strPath] = true;
+		return docSrc.root().child(pszName);
+	}
+
+	void AddDefinitions(SXmlNode xmlStyle, SXmlNode xmlSkin)
+	{
+		for (SXmlNode xmlChild = xmlStyle.first_child(); xmlChild; xmlChild = xmlChild.next_sibling())
+		{
+			if (xmlChild.type() != node_element)
+				continue;
+			SStringW strName = xmlChild.name();
+			bool bClass = strName.CompareNoCase(L"class") == 0;
+			if (bClass)
+				strName = xmlChild.attribute(L"name", false).value();
+			if (strName.IsEmpty())
+				continue;
+			SXmlNode xmlDef = m_docDefs.root().append_copy(xmlChild);
+			if (bClass)
+				xmlDef.remove_attribute(L"name"); //same as SStylePool: the style name is not an attribute to inline
+			m_mapStyle[strName] = xmlDef;
+		}
+		for (SXmlNode xmlChild = xmlSkin.first_child(); xmlChild; xmlChild = xmlChild.next_sibling())
+		{
+			SStringW strName = xmlChild.attribute(L"name").value();
+			if (!strName.IsEmpty())
+				m_mapSkin[strName] = true;
+		}
+	}
+
+	void LoadUidef()
+	{
+		for (size_t i = 0; i < m_lstFile.GetCount(); i++)
+		{
+			const ResFile & res = m_lstFile[i];
+			if (res.strType.CompareNoCase(L"uidef") != 0)
+				continue;
+			SXmlDoc xmlDoc;
+			if (!xmlDoc.load_file(m_opt.strSrc + KPathSlash + res.strPath))
+				continue;
+			m_mapDefFile[res.strPath] = true;
+			SXmlNode xmlRoot = xmlDoc.root().child(L"uidef");
+			SXmlDoc docStyle, docSkin;
+			AddDefinitions(GetSourceNode(xmlRoot, L"style", docStyle), GetSourceNode(xmlRoot, L"skin", docSkin));
+		}
+	}
+
+	//merge the style named by "class" into xmlNode in the order SWindow applies it at runtime:
+	//layout of style wins, then style attributes, then the explicit ones.
+	void InlineStyle(SXmlNode xmlNode, SXmlNode xmlStyle)
+	{
+		SXmlAttr attrPos;
+		SXmlAttr attrLayout = xmlStyle.attribute(L"layout", false);
+		if (attrLayout)
+		{
+			xmlNode.remove_attribute(xmlNode.attribute(L"layout", false));
+			attrPos = xmlNode.prepend_copy(attrLayout);
+		}
+		for (SXmlAttr attr = xmlStyle.first_attribute(); attr; attr = attr.next_attribute())
+		{
+			if (_wcsicmp(attr.name(), L"class") == 0 || _wcsicmp(attr.name(), L"layout") == 0)
+				continue;
+			if (xmlNode.attribute(attr.name(), false))
+				continue;
+			if (attrPos)
+				attrPos = xmlNode.insert_copy_after(attr, attrPos);
+			else
+				attrPos = xmlNode.prepend_copy(attr);
+		}
+		xmlNode.remove_attribute(xmlNode.attribute(L"class", false));
+	}
+
+	void ProcessNode(const SStringT & strFile, SXmlNode xmlNode, SMap<SStringW, bool> & mapId, bool bInTemplate, bool bInline)
+	{
+		for (; xmlNode; xmlNode = xmlNode.next_sibling())
+		{
+			if (xmlNode.type() != node_element)
+				continue;
+			//attribute names match case-insensitively, like _wcsicmp in SWindow::OnAttrClass
+			SXmlAttr attrClass = xmlNode.attribute(L"class", false);
+			if (attrClass)
+			{
+				SMap<SStringW, SXmlNode>::CPair *p = m_mapStyle.Lookup(attrClass.value());
+				if (!p)
+					Warning(strFile, SStringW().Format(L"<%s> refers to unknown class \"%s\"", xmlNode.name(), attrClass.value()));
+				else if (bInline)
+					InlineStyle(xmlNode, p->m_value);
+			}
+			for (SXmlAttr attr = xmlNode.first_attribute(); attr; attr = attr.next_attribute())
+			{
+				SStringW strName = attr.name();
+				if (strName.EndsWith(L"skin", true))
 				{
-					bool bOk=xmlDoc.save_file(strPath,_T("\t"),0,toBin?encoding_bin:encoding_utf8);
-					_tprintf(_T("convert %s to %s return %s!\n"),strPath.c_str(),toBin?_T("bin"):_T("xml"),bOk?_T("succeed"):_T("failed"));
-				}else
+					SStringW strSkin = attr.value();
+					//builtin skins start with '_', and a skin can be defined by an expression like "skin:xxx".
+					if (!strSkin.IsEmpty() && strSkin[0] != L'_' && strSkin.Find(L':') == -1 && !m_mapSkin.Lookup(strSkin))
+						Warning(strFile, SStringW().Format(L"<%s %s> refers to unknown skin \"%s\"", xmlNode.name(), attr.name(), attr.value()));
+				}
+				else if (!bInTemplate && strName.CompareNoCase(L"id") == 0)
 				{
-					_tprintf(_T("load %s failed!\n"),strPath.c_str());
+					if (mapId.Lookup(attr.value()))
+						Warning(strFile, SStringW().Format(L"<%s> id \"%s\" is duplicated", xmlNode.name(), attr.value()));
+					else
+						mapId[attr.value()] = true;
 				}
 			}
+			bool bTemplate = bInTemplate || _wcsicmp(xmlNode.name(), L"template") == 0;
+			ProcessNode(strFile, xmlNode.first_child(), mapId, bTemplate, bInline);
+		}
+	}
+
+	bool CompileFile(const ResFile & res, FileStat & stat)
+	{
+		SStringT strSrc = m_opt.strSrc + KPathSlash + res.strPath;
+		SStringT strDst = m_opt.strOut + KPathSlash + res.strPath;
+		SAutoBuf bufXml;
+		SXmlDoc xmlDoc;
+		if (!ReadFileData(strSrc, bufXml) || !xmlDoc.load_buffer((char*)bufXml, bufXml.size()))
+		{
+			printf("error: load %s failed!\n", S_CT2A(res.strPath).c_str());
+			return false;
+		}
+		stat.szXml = bufXml.size();
+
+		//definitions are kept as they are, layouts get styles inlined and references validated.
+		if (!m_mapDefFile.Lookup(res.strPath) && res.strType.CompareNoCase(L"values") != 0)
+		{
+			SXmlNode xmlRoot = xmlDoc.root().first_child();
+			//styles and skins defined in a host layout are visible in the layout only.
+			SMap<SStringW, SXmlNode> mapStyleBackup;
+			SMap<SStringW, bool> mapSkinBackup;
+			CopyMap(m_mapStyle, mapStyleBackup);
+			CopyMap(m_mapSkin, mapSkinBackup);
+			AddDefinitions(xmlRoot.child(L"style"), xmlRoot.child(L"skin"));
+			SMap<SStringW, bool> mapId;
+			ProcessNode(res.strPath, xmlRoot, mapId, false, m_opt.bInlineStyle);
+			CopyMap(mapStyleBackup, m_mapStyle);
+			CopyMap(mapSkinBackup, m_mapSkin);
+		}
+
+		MakeFileDir(strDst);
+		FILE *f = _tfopen(strDst, _T("wb"));
+		if (!f)
+		{
+			printf("error: open %s failed!\n", S_CT2A(strDst).c_str());
+			return false;
+		}
+		xmlDoc.save_bin_flat(f, m_opt.nCharSize);
+		fclose(f);
+
+		SAutoBuf bufBin;
+		if (!ReadFileData(strDst, bufBin))
+			return false;
+		stat.szBin = bufBin.size();
 
-		} while (FindNextFile(hFind,&wfd));
-		FindClose(hFind);
+		//measure runtime load cost of both forms.
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < m_opt.nRepeat; i++)
+		{
+			SXmlDoc doc;
+			doc.load_buffer((char*)bufXml, bufXml.size());
+		}
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		for (int i = 0; i < m_opt.nRepeat; i++)
+		{
+			SXmlDoc doc;
+			doc.load_buffer_inplace((char*)bufBin, bufBin.size());
+		}
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+		stat.tmXml = std::chrono::duration<double, std::micro>(t1 - t0).count() / m_opt.nRepeat;
+		stat.tmBin = std::chrono::duration<double, std::micro>(t2 - t1).count() / m_opt.nRepeat;
+		return true;
 	}
+
+	template<class K, class V>
+	static void CopyMap(const SMap<K, V> & src, SMap<K, V> & dst)
+	{
+		dst.RemoveAll();
+		SPOSITION pos = src.GetStartPosition();
+		while (pos)
+		{
+			const typename SMap<K, V>::CPair * p = src.GetNext(pos);
+			dst[p->m_key] = p->m_value;
+		}
+	}
+
+	const CompileOption & m_opt;
+	SArray<ResFile> m_lstFile;
+	SMap<SStringT, int> m_mapPath;
+	SMap<SStringT, bool> m_mapDefFile;
+	SMap<SStringW, SXmlNode> m_mapStyle;
+	SMap<SStringW, bool> m_mapSkin;
+	SXmlDoc m_docDefs;	//holds copies of style nodes.
+};
+
+static void Usage()
+{
+	printf("usage: xml2bin destFolder [tobin|toxml]\n");
+	printf("       xml2bin -i srcdir -o outdir [-c 1|2|4] [-r repeat] [-s] [-W]\n");
+	printf("           -c char size of string table, default is sizeof(wchar_t) of the host\n");
+	printf("           -r repeat times to measure parse time, default 20\n");
+	printf("           -s keep \"class\" attribute instead of inlining the style\n");
+	printf("           -W treat warnings as errors\n");
 }
 
-int _tmain(int argc,TCHAR **argv)
+int main(int argc, char **argv)
 {
-	if(argc <2)
+	if (argc < 2)
 	{
-		_tprintf(_T("usage: xml2bin destFolder [tobin|toxml]\n"));
-	}else
+		Usage();
+		return 1;
+	}
+	if (strcmp(argv[1], "-i") != 0)
 	{
 		bool bCvt2Bin = true;
+		if (argc == 3)
+		{
+			SStringA str(argv[2]);
+			bCvt2Bin = str.CompareNoCase("toxml") != 0;
+		}
+		EnumDir(S_CA2T(argv[1]), SStringT(), OnConvertFile, &bCvt2Bin);
+		return 0;
+	}
 
-		if(argc==3)
+	CompileOption opt;
+	opt.nCharSize = sizeof(wchar_t);
+	opt.nRepeat = 20;
+	opt.bInlineStyle = true;
+	opt.bWarningAsError = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			opt.strSrc = S_CA2T(argv[++i]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			opt.strOut = S_CA2T(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			opt.nCharSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			opt.nRepeat = smax(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "-s") == 0)
+			opt.bInlineStyle = false;
+		else if (strcmp(argv[i], "-W") == 0)
+			opt.bWarningAsError = true;
+		else
 		{
-			SOUI::SStringT str(argv[2]);
-			bCvt2Bin = str.CompareNoCase(_T("toxml"))!=0;
+			Usage();
+			return 1;
 		}
-		convertDir(argv[1],bCvt2Bin);
 	}
-	return 0;
-}
\ No newline at end of file
+	if (opt.strSrc.IsEmpty() || opt.strOut.IsEmpty() || (opt.nCharSize != 1 && opt.nCharSize != 2 && opt.nCharSize != 4))
+	{
+		Usage();
+		return 1;
+	}
+	opt.strSrc = NativePath(opt.strSrc);
+	opt.strOut = NativePath(opt.strOut);
+	MakeDir(opt.strOut);
+
+	SUiresCompiler compiler(opt);
+	return compiler.Run() ? 0 : 2;
+}
@@ -0,0 +1,69 @@
+﻿#ifndef __SPIXELCONV__H__
+#define __SPIXELCONV__H__
+
+#include <utilities-def.h>
+
+SNSBEGIN
+
+/**
+ * @class SPixelConv
+ * @brief 32 bit pixel conversion helpers used by the image decoders and SDIBHelper.
+ * @details Converts decoder output (RGBA) to the BGRA layout used by the renders, optionally
+ *          premultiplying the color channels by alpha in the same pass. The kernel is chosen
+ *          at runtime (AVX2/SSE2 on x86, NEON on arm) and falls back to a scalar loop.
+ */
+class UTILITIES_API SPixelConv {
+  public:
+    /**
+     * @brief Instruction set used by RgbaToBgra.
+     */
+    enum Isa
+    {
+        ISA_SCALAR = 0, /**< plain C loop. */
+        ISA_SSE2,       /**< 4 pixels per step. */
+        ISA_AVX2,       /**< 8 pixels per step. */
+        ISA_NEON,       /**< 16 pixels per step. */
+    };
+
+    /**
+     * @brief Swap R and B and optionally premultiply by alpha.
+     * @param pDst Destination pixels, may be the same as pSrc.
+     * @param pSrc Source pixels in RGBA order.
+     * @param nPixels Number of pixels.
+     * @param bPremultiply TRUE to premultiply color by alpha, computed as c*a/255 truncated.
+     * @note Pixels with zero alpha are cleared to 0 in both modes.
+     */
+    static void RgbaToBgra(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply);
+
+    /**
+     * @brief Reference implementation of RgbaToBgra.
+     */
+    static void RgbaToBgra_Scalar(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply);
+
+    /**
+     * @brief Replace the first three channels with their weighted sum, alpha is kept.
+     * @param pDst Destination pixels, may be the same as pSrc.
+     * @param pSrc Source pixels.
+     * @param nPixels Number of pixels.
+     * @param w0 Weight of channel 0.
+     * @param w1 Weight of channel 1.
+     * @param w2 Weight of channel 2.
+     * @note Weights must sum to at most 1024, the result is (c0*w0+c1*w1+c2*w2)>>10.
+     */
+    static void Gray(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2);
+
+    /**
+     * @brief Reference implementation of Gray.
+     */
+    static void Gray_Scalar(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2);
+
+    /**
+     * @brief Get the instruction set selected for this cpu.
+     * @details All kernels produce the same bytes as their _Scalar version.
+     */
+    static Isa GetIsa();
+};
+
+SNSEND
+
+#endif // __SPIXELCONV__H__
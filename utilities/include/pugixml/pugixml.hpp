@@ -1056,6 +1056,17 @@ namespace pugi
 		int  nStrMapLen;    //str map length
 	};
 
+	//flat sxml: string table is saved in the target char size and referenced by char offset,
+	//so a document can be built on top of a mapped buffer without copying any string.
+	#define SXML_VER_FLAT	3
+	struct sxml_flat_info
+	{
+		int  nCharSize;     //size of a char in string table: 1(utf8), 2(utf16) or 4(utf32)
+		int  nNodes;        //node count, excluding document node
+		int  nAttrs;        //attribute count
+		int  nReserved;
+	};
+
 	// Document class (DOM tree root)
 	class PUGIXML_CLASS xml_document: public xml_node
 	{
@@ -1121,6 +1132,8 @@ namespace pugi
 		// Save XML document to writer (semantics is slightly different from xml_node::print, see documentation for details).
 		void save(xml_writer& writer, const char_t* indent = PUGIXML_TEXT("\t"), unsigned int flags = format_default, xml_encoding encoding = encoding_auto) const;
 		void save_bin(FILE *f) const;
+		// Save XML document as flat binary xml, nCharSize is the char size of string table. 
+		void save_bin_flat(FILE *f, int nCharSize = sizeof(char_t)) const;
 
 	#ifndef PUGIXML_NO_STL
 		// Save XML document to stream (semantics is slightly different from xml_node::print, see documentation for details).
@@ -11,13 +11,119 @@
 #include "utilities-def.h"
 
 SNSBEGIN
+    /**
+     * @enum SMemTag
+     * @brief 内存分配的统计标签，每个标签单独统计占用的字节数和块数
+     */
+    enum SMemTag
+    {
+        MEM_TAG_DEFAULT = 0, //未分类
+        MEM_TAG_COLL,        // souicoll容器
+        MEM_TAG_STRING,      //字符串数据及原子
+        MEM_TAG_XML,         // pugixml的内存页
+        MEM_TAG_BUFFER,      // SAutoBuf
+        MEM_TAG_USER = 8,    //应用自定义标签的起始值
+        MEM_TAG_MAX = 16,
+    };
+
+    /**
+     * @struct SMemStat
+     * @brief 一个标签的内存统计
+     */
+    struct SMemStat
+    {
+        INT_PTR nBytes;  //当前占用的字节数(不含块头)
+        INT_PTR nBlocks; //当前占用的块数
+        INT_PTR nAllocs; //累计分配次数，两次查询的差值即为期间的分配次数
+    };
+
+    /**
+     * @struct IMemAllocator
+     * @brief 底层内存分配器，默认使用CRT的malloc/realloc/free
+     * @details 大块内存、小块的slab及arena的内存页都从这里申请。
+     */
+    struct IMemAllocator
+    {
+        virtual void *Alloc(size_t cb) = 0;
+        virtual void *Realloc(void *p, size_t cb) = 0;
+        virtual void Free(void *p) = 0;
+    };
+
     class UTILITIES_API soui_mem_wrapper
     {
     public:
-        static void * SouiMalloc(size_t szMem);
+        // 512字节以内的块按大小分档，由线程缓存分配;标签和当前线程压入的SMemArenaScope一致时从arena分配。
+        // 块头记录了标签和来源，只能用SouiFree/SouiRealloc释放。
+        static void * SouiMalloc(size_t szMem, int nTag = MEM_TAG_DEFAULT);
+        // 保留原块的标签
         static void * SouiRealloc(void *p,size_t szMem);
-        static void * SouiCalloc(size_t count, size_t szEle);
+        static void * SouiCalloc(size_t count, size_t szEle, int nTag = MEM_TAG_DEFAULT);
         static void   SouiFree(void *p);
+
+        // 返回块的可用字节数，可能大于申请的大小
+        static size_t SouiMemSize(void *p);
+
+        // 替换底层分配器，必须在第一次分配之前调用，否则返回FALSE
+        static BOOL SetAllocator(IMemAllocator *pAllocator);
+
+        // 汇总所有线程的统计，pStats需要MEM_TAG_MAX个元素
+        static void GetMemStat(SMemStat *pStats);
+        static LPCSTR GetMemTagName(int nTag);
+    };
+
+    /**
+     * @class SMemArena
+     * @brief 顺序分配的内存池，适合布局、解析一次xml这类短时的工作
+     * @details 内存按页从底层分配器申请，只在Reset或者析构时整体释放。
+     *          通过SMemArenaScope压入当前线程后，期间指定标签的SouiMalloc从arena分配，
+     *          这些块必须在arena Reset/析构之前释放(SouiFree只更新统计)。
+     *          arena只能在创建它的线程使用。
+     */
+    class UTILITIES_API SMemArena
+    {
+    public:
+        explicit SMemArena(size_t cbPage = 16 * 1024);
+        ~SMemArena();
+
+        void *Alloc(size_t cb);
+        // 改变最后分配的块的大小，不能原地完成时返回FALSE
+        BOOL Resize(void *p, size_t cb);
+        void Reset();
+
+        // 自上次Reset以来分配出去的字节数
+        size_t GetUsedBytes() const;
+
+    private:
+        SMemArena(const SMemArena &);
+        SMemArena &operator=(const SMemArena &);
+
+        struct Page;
+        Page *m_pPage;
+        char *m_pCur;
+        char *m_pEnd;
+        char *m_pLast;
+        size_t m_cbPage;
+        size_t m_cbUsed;
+    };
+
+    /**
+     * @class SMemArenaScope
+     * @brief 在作用域内把当前线程指定标签的SouiMalloc转到arena
+     * @details 只有标签为nTag的分配进入arena，其它标签照常分配，不会随arena一起失效。
+     *          嵌套时内层覆盖外层，传入NULL时暂停外层的arena。
+     */
+    class UTILITIES_API SMemArenaScope
+    {
+    public:
+        SMemArenaScope(SMemArena *pArena, int nTag);
+        ~SMemArenaScope();
+
+    private:
+        SMemArenaScope(const SMemArenaScope &);
+        SMemArenaScope &operator=(const SMemArenaScope &);
+
+        SMemArena *m_pPrev;
+        int m_nPrevTag;
     };
 SNSEND
 
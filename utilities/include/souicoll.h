@@ -231,7 +231,7 @@ inline SPlex* SPlex::Create( SPlex*& pHead, size_t nMax, size_t nElementSize )
     {
         return NULL;
     }
-    pPlex = static_cast< SPlex* >( soui_mem_wrapper::SouiMalloc( nBytes ) );
+    pPlex = static_cast< SPlex* >( soui_mem_wrapper::SouiMalloc( nBytes, MEM_TAG_COLL ) );
     if( pPlex == NULL )
     {
         return( NULL );
@@ -681,7 +681,7 @@ bool SArray< E, ETraits >::GrowBuffer( size_t nNewSize )
         if( m_pData == NULL )
         {
             size_t nAllocSize =  size_t( m_nGrowBy ) > nNewSize ? size_t( m_nGrowBy ) : nNewSize ;
-            m_pData = static_cast< E* >( soui_mem_wrapper::SouiCalloc( nAllocSize,sizeof( E ) ) );
+            m_pData = static_cast< E* >( soui_mem_wrapper::SouiCalloc( nAllocSize,sizeof( E ),MEM_TAG_COLL ) );
             if( m_pData == NULL )
             {
                 return( false );
@@ -709,7 +709,7 @@ bool SArray< E, ETraits >::GrowBuffer( size_t nNewSize )
 #ifdef SIZE_T_MAX
             SASSERT( nNewMax <= SIZE_T_MAX/sizeof( E ) ); // no overflow
 #endif
-            E* pNewData = static_cast< E* >( soui_mem_wrapper::SouiCalloc( nNewMax,sizeof( E ) ) );
+            E* pNewData = static_cast< E* >( soui_mem_wrapper::SouiCalloc( nNewMax,sizeof( E ),MEM_TAG_COLL ) );
             if( pNewData == NULL )
             {
                 return false;
@@ -832,7 +832,7 @@ void SArray< E, ETraits >::FreeExtra()
         E* pNewData = NULL;
         if( m_nSize != 0 )
         {
-            pNewData = (E*)soui_mem_wrapper::SouiCalloc( m_nSize,sizeof( E ) );
+            pNewData = (E*)soui_mem_wrapper::SouiCalloc( m_nSize,sizeof( E ),MEM_TAG_COLL );
             if( pNewData == NULL )
             {
                 return;
@@ -2395,7 +2395,7 @@ bool SMap< K, V, KTraits, VTraits >::InitHashTable( UINT nBins, bool bAllocNow )
     if( bAllocNow )
     {
         //hjx            STRY( m_ppBins = new CNode*[nBins] );
-        m_ppBins = (CNode**)soui_mem_wrapper::SouiMalloc(nBins*sizeof(CNode*));
+        m_ppBins = (CNode**)soui_mem_wrapper::SouiMalloc(nBins*sizeof(CNode*), MEM_TAG_COLL);
         if( m_ppBins == NULL )
         {
             return false;
@@ -2706,7 +2706,7 @@ void SMap< K, V, KTraits, VTraits >::Rehash( UINT nBins )
     }
 
     //hjx        STRY(ppBins = new CNode*[nBins]);
-    ppBins = (CNode**)soui_mem_wrapper::SouiMalloc(nBins*sizeof(CNode*));
+    ppBins = (CNode**)soui_mem_wrapper::SouiMalloc(nBins*sizeof(CNode*), MEM_TAG_COLL);
     if (ppBins == NULL)
     {
         return;
@@ -3263,7 +3263,7 @@ typename SRBTree< K, V, KTraits, VTraits >::CNode* SRBTree< K, V, KTraits, VTrai
     {
         if (m_pNil == NULL)
         {
-            m_pNil = reinterpret_cast<CNode *>(soui_mem_wrapper::SouiMalloc(sizeof( CNode )));
+            m_pNil = reinterpret_cast<CNode *>(soui_mem_wrapper::SouiMalloc(sizeof( CNode ), MEM_TAG_COLL));
             if (m_pNil == NULL)
             {
                 SThrow( E_OUTOFMEMORY );
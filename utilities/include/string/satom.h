@@ -0,0 +1,137 @@
+﻿#ifndef __SATOM__H__
+#define __SATOM__H__
+
+#include "utilities-def.h"
+#include <souicoll.h>
+
+SNSBEGIN
+
+struct SAtomEntry;
+
+/**
+ * @class SAtom
+ * @brief Handle to an interned, immutable wide string.
+ * @details Interning the same text always yields the same handle, so two atoms are equal exactly when
+ * their pointers are. Each atom also carries its case-sensitive hash, its case-folded hash and the atom
+ * of its lower case form, so case-insensitive comparison is a pointer comparison as well.
+ * Atoms live for the whole process. Insertion is thread safe, and Find takes no lock.
+ */
+class UTILITIES_API SAtom
+{
+public:
+    /**
+     * @brief Constructs the null atom.
+     */
+    SAtom() : m_pEntry(NULL)
+    {
+    }
+
+    /**
+     * @brief Interns a string and constructs its atom.
+     * @param pszName String to intern, NULL is treated as an empty string.
+     * @param nLen Length of pszName in characters, -1 if it is null terminated.
+     */
+    explicit SAtom(LPCWSTR pszName, int nLen = -1);
+
+    /**
+     * @brief Looks up the atom of a string without interning it.
+     * @param pszName String to look up.
+     * @param nLen Length of pszName in characters, -1 if it is null terminated.
+     * @return The atom, or the null atom if the string was never interned.
+     */
+    static SAtom Find(LPCWSTR pszName, int nLen = -1);
+
+    /**
+     * @brief Looks up the atom of a string ignoring case, without interning it.
+     * @param pszName String to look up.
+     * @param nLen Length of pszName in characters, -1 if it is null terminated.
+     * @return The lower case atom of pszName, or the null atom if no string of that spelling was interned.
+     */
+    static SAtom FindNoCase(LPCWSTR pszName, int nLen = -1);
+
+    /**
+     * @brief Checks whether this is the null atom.
+     */
+    BOOL IsNull() const
+    {
+        return m_pEntry == NULL;
+    }
+
+    /**
+     * @brief Gets the interned text, L"" for the null atom.
+     */
+    LPCWSTR GetName() const;
+
+    /**
+     * @brief Gets the length of the interned text in characters.
+     */
+    int GetLength() const;
+
+    /**
+     * @brief Gets the case-sensitive hash of the text, 0 for the null atom.
+     */
+    ULONG GetHash() const;
+
+    /**
+     * @brief Gets the hash of the lower case form of the text, 0 for the null atom.
+     */
+    ULONG GetHashNoCase() const;
+
+    /**
+     * @brief Gets the atom of the lower case form of the text.
+     * @return Itself if the text has no upper case character.
+     */
+    SAtom GetFolded() const;
+
+    /**
+     * @brief Compares two atoms ignoring case.
+     */
+    bool EqualNoCase(const SAtom &src) const
+    {
+        return GetFolded().m_pEntry == src.GetFolded().m_pEntry;
+    }
+
+    bool operator==(const SAtom &src) const
+    {
+        return m_pEntry == src.m_pEntry;
+    }
+
+    bool operator!=(const SAtom &src) const
+    {
+        return m_pEntry != src.m_pEntry;
+    }
+
+private:
+    static SAtom FromEntry(const SAtomEntry *pEntry)
+    {
+        SAtom ret;
+        ret.m_pEntry = pEntry;
+        return ret;
+    }
+
+    const SAtomEntry *m_pEntry;
+};
+
+template <>
+class CElementTraits<SAtom> : public CElementTraitsBase<SAtom>
+{
+public:
+    static ULONG Hash(INARGTYPE atom)
+    {
+        return atom.GetHash();
+    }
+
+    static bool CompareElements(INARGTYPE element1, INARGTYPE element2)
+    {
+        return element1 == element2;
+    }
+
+    static int CompareElementsOrdered(INARGTYPE element1, INARGTYPE element2)
+    {
+        return wcscmp(element1.GetName(), element2.GetName());
+    }
+};
+
+SNSEND
+
+#endif // __SATOM__H__
@@ -6,12 +6,16 @@ SNSBEGIN
 
 struct TStringData
 {
-	int nRefs;            // Reference count: negative == locked
+	LONG nRefs;           // Reference count: negative == locked, changed with interlocked operations
 	int nDataLength;    // Length of currently used data in XCHARs (not including terminating null)
 	int nAllocLength;    // Length of allocated data in XCHARs (not including terminating null)
 
 	void* data() const;
 
+	// Allocates (or grows pOldData to) a buffer for nLength XCHARs of cbChar bytes each.
+	// nAllocLength reports the whole block, short buffers get the size class of the allocator.
+	static TStringData* Alloc(int nLength, int cbChar, TStringData* pOldData = NULL);
+
 	void AddRef();
 	void Release();
 	bool IsShared() const;
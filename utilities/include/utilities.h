@@ -180,6 +180,19 @@ HANDLE UTILITIES_API LoadIconFromMemory(const void* buf, UINT cbSize, BOOL fIcon
  */
 HRGN UTILITIES_API CreateRegionFromBitmap(HBITMAP hBmp, COLORREF cr, COLORREF crMask);
 
+/**
+ * @brief Creates a region from part of a bitmap.
+ * 
+ * Only pixels inside prcScan are tested, so a caller can rebuild the shape of a changed area
+ * and patch it into an existing region.
+ * @param hBmp Handle to a 32 bit top-down DIB section.
+ * @param prcScan Rectangle to scan, in bitmap coordinates. NULL scans the whole bitmap.
+ * @param cr Color value for the region.
+ * @param crMask Mask color value.
+ * @return Handle to the created region, or NULL if no pixel in prcScan belongs to it.
+ */
+HRGN UTILITIES_API CreateRegionFromBitmapRect(HBITMAP hBmp, LPCRECT prcScan, COLORREF cr, COLORREF crMask);
+
 #ifdef __cplusplus
 }
 #endif//__cplusplus
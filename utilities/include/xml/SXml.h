@@ -1101,6 +1101,12 @@ public:
     /// @return TRUE if the document was successfully saved, FALSE otherwise.
     bool save_file(const wchar_t* path, const wchar_t* indent = L"\t", unsigned int flags = xml_parse_default, XmlEncoding encoding = enc_auto) const;
 
+    /// @brief Saves the XML document as flat binary xml.
+    /// @param f The file pointer to write to.
+    /// @param nCharSize Char size of the string table: 1(utf8), 2(utf16) or 4(utf32).
+    /// @note A flat binary xml loaded by load_buffer_inplace/load_file with a matching char size uses its strings in place, without any copy.
+    void save_bin_flat(FILE *f, int nCharSize = sizeof(wchar_t)) const;
+
     /// @brief Retrieves the root node of the document.
     /// @return The root node.
     SXmlNode root() const;
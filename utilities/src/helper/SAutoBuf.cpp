@@ -41,7 +41,7 @@ SAutoBuf::SAutoBuf(size_t nElements)
 	{
         Free();
 		SASSERT(nBytes <= SIZE_MAX-1);
-		m_pBuf = static_cast<char*>(soui_mem_wrapper::SouiMalloc(nBytes+1));
+		m_pBuf = static_cast<char*>(soui_mem_wrapper::SouiMalloc(nBytes+1, MEM_TAG_BUFFER));
         if (m_pBuf)
         {
             m_nSize = nBytes;
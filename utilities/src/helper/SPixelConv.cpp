@@ -0,0 +1,378 @@
+#include <helper/SPixelConv.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SPIXEL_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SPIXEL_TARGET(x)
+#else
+#include <cpuid.h>
+#define SPIXEL_TARGET(x) __attribute__((target(x)))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__) || defined(_M_ARM64)
+#define SPIXEL_NEON
+#include <arm_neon.h>
+#endif
+
+SNSBEGIN
+
+typedef void (*FunRgbaToBgra)(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply);
+typedef void (*FunGray)(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2);
+
+void SPixelConv::RgbaToBgra_Scalar(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply)
+{
+    for (size_t i = 0; i < nPixels; i++)
+    {
+        BYTE r = pSrc[0], g = pSrc[1], b = pSrc[2], a = pSrc[3];
+        if (a == 0)
+        {
+            pDst[0] = pDst[1] = pDst[2] = pDst[3] = 0;
+        }
+        else if (bPremultiply)
+        {
+            pDst[0] = (BYTE)(b * a / 255);
+            pDst[1] = (BYTE)(g * a / 255);
+            pDst[2] = (BYTE)(r * a / 255);
+            pDst[3] = a;
+        }
+        else
+        {
+            pDst[0] = b;
+            pDst[1] = g;
+            pDst[2] = r;
+            pDst[3] = a;
+        }
+        pSrc += 4;
+        pDst += 4;
+    }
+}
+
+void SPixelConv::Gray_Scalar(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2)
+{
+    for (size_t i = 0; i < nPixels; i++)
+    {
+        BYTE gray = (BYTE)((pSrc[0] * w0 + pSrc[1] * w1 + pSrc[2] * w2) >> 10);
+        pDst[0] = pDst[1] = pDst[2] = gray;
+        pDst[3] = pSrc[3];
+        pSrc += 4;
+        pDst += 4;
+    }
+}
+
+// x/255 for x in [0,255*255]: ((x+1) + ((x+1)>>8)) >> 8, exact without a division.
+#ifdef SPIXEL_X86
+
+SPIXEL_TARGET("sse2")
+static inline __m128i Premultiply_SSE2(__m128i v16, __m128i alphaMask, __m128i alpha255)
+{
+    // v16: 2 pixels as 8 x u16, r g b a r g b a
+    __m128i bgra = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v16, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_or_si128(_mm_andnot_si128(alphaMask, alpha), alpha255); // keep alpha itself: a*255/255
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(bgra, alpha), _mm_set1_epi16(1));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+SPIXEL_TARGET("sse2")
+static void RgbaToBgra_SSE2(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply)
+{
+    size_t nBlocks = nPixels / 4;
+    const __m128i zero = _mm_setzero_si128();
+    if (bPremultiply)
+    {
+        const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+        const __m128i alpha255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        for (size_t i = 0; i < nBlocks; i++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)pSrc);
+            __m128i lo = Premultiply_SSE2(_mm_unpacklo_epi8(v, zero), alphaMask, alpha255);
+            __m128i hi = Premultiply_SSE2(_mm_unpackhi_epi8(v, zero), alphaMask, alpha255);
+            _mm_storeu_si128((__m128i *)pDst, _mm_packus_epi16(lo, hi));
+            pSrc += 16;
+            pDst += 16;
+        }
+    }
+    else
+    {
+        const __m128i maskAG = _mm_set1_epi32((int)0xFF00FF00);
+        const __m128i maskA = _mm_set1_epi32((int)0xFF000000);
+        for (size_t i = 0; i < nBlocks; i++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)pSrc);
+            __m128i rb = _mm_andnot_si128(maskAG, v);
+            __m128i res = _mm_or_si128(_mm_and_si128(v, maskAG), _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)));
+            __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(v, maskA), zero);
+            _mm_storeu_si128((__m128i *)pDst, _mm_andnot_si128(transparent, res));
+            pSrc += 16;
+            pDst += 16;
+        }
+    }
+    SPixelConv::RgbaToBgra_Scalar(pDst, pSrc, nPixels % 4, bPremultiply);
+}
+
+SPIXEL_TARGET("sse2")
+static void Gray_SSE2(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2)
+{
+    // c0,c2 and c1,0 are 16 bit pairs inside each 32 bit pixel, madd sums each pair.
+    size_t nBlocks = nPixels / 4;
+    const __m128i maskRB = _mm_set1_epi32(0x00FF00FF);
+    const __m128i maskA = _mm_set1_epi32((int)0xFF000000);
+    const __m128i w02 = _mm_set1_epi32(w0 | (w2 << 16));
+    const __m128i w1_ = _mm_set1_epi32(w1);
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)pSrc);
+        __m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_and_si128(v, maskRB), w02), _mm_madd_epi16(_mm_and_si128(_mm_srli_epi32(v, 8), maskRB), w1_));
+        __m128i gray = _mm_srli_epi32(sum, 10);
+        gray = _mm_or_si128(gray, _mm_or_si128(_mm_slli_epi32(gray, 8), _mm_slli_epi32(gray, 16)));
+        _mm_storeu_si128((__m128i *)pDst, _mm_or_si128(gray, _mm_and_si128(v, maskA)));
+        pSrc += 16;
+        pDst += 16;
+    }
+    SPixelConv::Gray_Scalar(pDst, pSrc, nPixels % 4, w0, w1, w2);
+}
+
+SPIXEL_TARGET("avx2")
+static inline __m256i Premultiply_AVX2(__m256i v16, __m256i alphaMask, __m256i alpha255)
+{
+    __m256i bgra = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v16, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+    __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_or_si256(_mm256_andnot_si256(alphaMask, alpha), alpha255);
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(bgra, alpha), _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+SPIXEL_TARGET("avx2")
+static void RgbaToBgra_AVX2(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply)
+{
+    size_t nBlocks = nPixels / 8;
+    const __m256i zero = _mm256_setzero_si256();
+    if (bPremultiply)
+    {
+        const __m256i alphaMask = _mm256_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+        const __m256i alpha255 = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+        for (size_t i = 0; i < nBlocks; i++)
+        {
+            // unpack and pack both work per 128 bit lane, so the pixel order survives the round trip.
+            __m256i v = _mm256_loadu_si256((const __m256i *)pSrc);
+            __m256i lo = Premultiply_AVX2(_mm256_unpacklo_epi8(v, zero), alphaMask, alpha255);
+            __m256i hi = Premultiply_AVX2(_mm256_unpackhi_epi8(v, zero), alphaMask, alpha255);
+            _mm256_storeu_si256((__m256i *)pDst, _mm256_packus_epi16(lo, hi));
+            pSrc += 32;
+            pDst += 32;
+        }
+    }
+    else
+    {
+        const __m256i maskAG = _mm256_set1_epi32((int)0xFF00FF00);
+        const __m256i maskA = _mm256_set1_epi32((int)0xFF000000);
+        for (size_t i = 0; i < nBlocks; i++)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)pSrc);
+            __m256i rb = _mm256_andnot_si256(maskAG, v);
+            __m256i res = _mm256_or_si256(_mm256_and_si256(v, maskAG), _mm256_or_si256(_mm256_slli_epi32(rb, 16), _mm256_srli_epi32(rb, 16)));
+            __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(v, maskA), zero);
+            _mm256_storeu_si256((__m256i *)pDst, _mm256_andnot_si256(transparent, res));
+            pSrc += 32;
+            pDst += 32;
+        }
+    }
+    SPixelConv::RgbaToBgra_Scalar(pDst, pSrc, nPixels % 8, bPremultiply);
+}
+
+SPIXEL_TARGET("avx2")
+static void Gray_AVX2(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2)
+{
+    size_t nBlocks = nPixels / 8;
+    const __m256i maskRB = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i maskA = _mm256_set1_epi32((int)0xFF000000);
+    const __m256i w02 = _mm256_set1_epi32(w0 | (w2 << 16));
+    const __m256i w1_ = _mm256_set1_epi32(w1);
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)pSrc);
+        __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(_mm256_and_si256(v, maskRB), w02), _mm256_madd_epi16(_mm256_and_si256(_mm256_srli_epi32(v, 8), maskRB), w1_));
+        __m256i gray = _mm256_srli_epi32(sum, 10);
+        gray = _mm256_or_si256(gray, _mm256_or_si256(_mm256_slli_epi32(gray, 8), _mm256_slli_epi32(gray, 16)));
+        _mm256_storeu_si256((__m256i *)pDst, _mm256_or_si256(gray, _mm256_and_si256(v, maskA)));
+        pSrc += 32;
+        pDst += 32;
+    }
+    SPixelConv::Gray_Scalar(pDst, pSrc, nPixels % 8, w0, w1, w2);
+}
+
+static SPixelConv::Isa DetectIsa()
+{
+    int regs[4] = { 0 };
+#ifdef _MSC_VER
+    __cpuid(regs, 0);
+    int nIds = regs[0];
+    __cpuid(regs, 1);
+#else
+    unsigned int nIds = __get_cpuid_max(0, NULL);
+    __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    BOOL bSSE2 = (regs[3] & (1 << 26)) != 0;
+    BOOL bOsAvx = FALSE;
+    if ((regs[2] & (1 << 27)) && (regs[2] & (1 << 28)))
+    { // OSXSAVE and AVX: check that the os saves ymm registers.
+#ifdef _MSC_VER
+        unsigned __int64 xcr0 = _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+#endif
+        bOsAvx = (xcr0 & 6) == 6;
+    }
+    if (bOsAvx && nIds >= 7)
+    {
+#ifdef _MSC_VER
+        __cpuidex(regs, 7, 0);
+#else
+        __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        if (regs[1] & (1 << 5))
+            return SPixelConv::ISA_AVX2;
+    }
+    return bSSE2 ? SPixelConv::ISA_SSE2 : SPixelConv::ISA_SCALAR;
+}
+
+#elif defined(SPIXEL_NEON)
+
+static void RgbaToBgra_NEON(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply)
+{
+    size_t nBlocks = nPixels / 16;
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        uint8x16x4_t v = vld4q_u8(pSrc);
+        uint8x16x4_t res;
+        res.val[3] = v.val[3];
+        if (bPremultiply)
+        {
+            const uint16x8_t one = vdupq_n_u16(1);
+            for (int c = 0; c < 3; c++)
+            {
+                uint16x8_t lo = vaddq_u16(vmull_u8(vget_low_u8(v.val[c]), vget_low_u8(v.val[3])), one);
+                uint16x8_t hi = vaddq_u16(vmull_u8(vget_high_u8(v.val[c]), vget_high_u8(v.val[3])), one);
+                lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+                hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+                res.val[2 - c] = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+            }
+        }
+        else
+        {
+            uint8x16_t transparent = vceqq_u8(v.val[3], vdupq_n_u8(0));
+            res.val[0] = vbicq_u8(v.val[2], transparent);
+            res.val[1] = vbicq_u8(v.val[1], transparent);
+            res.val[2] = vbicq_u8(v.val[0], transparent);
+        }
+        vst4q_u8(pDst, res);
+        pSrc += 64;
+        pDst += 64;
+    }
+    SPixelConv::RgbaToBgra_Scalar(pDst, pSrc, nPixels % 16, bPremultiply);
+}
+
+static inline uint8x8_t Gray_NEON8(uint8x8_t c0, uint8x8_t c1, uint8x8_t c2, WORD w0, WORD w1, WORD w2)
+{
+    uint16x8_t c016 = vmovl_u8(c0), c116 = vmovl_u8(c1), c216 = vmovl_u8(c2);
+    uint32x4_t lo = vmull_n_u16(vget_low_u16(c016), w0);
+    uint32x4_t hi = vmull_n_u16(vget_high_u16(c016), w0);
+    lo = vmlal_n_u16(lo, vget_low_u16(c116), w1);
+    hi = vmlal_n_u16(hi, vget_high_u16(c116), w1);
+    lo = vmlal_n_u16(lo, vget_low_u16(c216), w2);
+    hi = vmlal_n_u16(hi, vget_high_u16(c216), w2);
+    return vmovn_u16(vcombine_u16(vshrn_n_u32(lo, 10), vshrn_n_u32(hi, 10)));
+}
+
+static void Gray_NEON(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2)
+{
+    size_t nBlocks = nPixels / 16;
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        uint8x16x4_t v = vld4q_u8(pSrc);
+        uint8x8_t lo = Gray_NEON8(vget_low_u8(v.val[0]), vget_low_u8(v.val[1]), vget_low_u8(v.val[2]), w0, w1, w2);
+        uint8x8_t hi = Gray_NEON8(vget_high_u8(v.val[0]), vget_high_u8(v.val[1]), vget_high_u8(v.val[2]), w0, w1, w2);
+        v.val[0] = v.val[1] = v.val[2] = vcombine_u8(lo, hi);
+        vst4q_u8(pDst, v);
+        pSrc += 64;
+        pDst += 64;
+    }
+    SPixelConv::Gray_Scalar(pDst, pSrc, nPixels % 16, w0, w1, w2);
+}
+
+static SPixelConv::Isa DetectIsa()
+{
+    return SPixelConv::ISA_NEON;
+}
+
+#else
+
+static SPixelConv::Isa DetectIsa()
+{
+    return SPixelConv::ISA_SCALAR;
+}
+
+#endif
+
+static SPixelConv::Isa s_isa = (SPixelConv::Isa)-1;
+
+SPixelConv::Isa SPixelConv::GetIsa()
+{
+    if (s_isa == (Isa)-1)
+        s_isa = DetectIsa(); // result is the same on every thread, a race here is harmless.
+    return s_isa;
+}
+
+static FunRgbaToBgra GetRgbaToBgraFun()
+{
+    switch (SPixelConv::GetIsa())
+    {
+#ifdef SPIXEL_X86
+    case SPixelConv::ISA_AVX2:
+        return RgbaToBgra_AVX2;
+    case SPixelConv::ISA_SSE2:
+        return RgbaToBgra_SSE2;
+#elif defined(SPIXEL_NEON)
+    case SPixelConv::ISA_NEON:
+        return RgbaToBgra_NEON;
+#endif
+    default:
+        return SPixelConv::RgbaToBgra_Scalar;
+    }
+}
+
+static FunGray GetGrayFun()
+{
+    switch (SPixelConv::GetIsa())
+    {
+#ifdef SPIXEL_X86
+    case SPixelConv::ISA_AVX2:
+        return Gray_AVX2;
+    case SPixelConv::ISA_SSE2:
+        return Gray_SSE2;
+#elif defined(SPIXEL_NEON)
+    case SPixelConv::ISA_NEON:
+        return Gray_NEON;
+#endif
+    default:
+        return SPixelConv::Gray_Scalar;
+    }
+}
+
+void SPixelConv::RgbaToBgra(BYTE *pDst, const BYTE *pSrc, size_t nPixels, BOOL bPremultiply)
+{
+    static FunRgbaToBgra s_fun = GetRgbaToBgraFun();
+    s_fun(pDst, pSrc, nPixels, bPremultiply);
+}
+
+void SPixelConv::Gray(BYTE *pDst, const BYTE *pSrc, size_t nPixels, WORD w0, WORD w1, WORD w2)
+{
+    static FunGray s_fun = GetGrayFun();
+    s_fun(pDst, pSrc, nPixels, w0, w1, w2);
+}
+
+SNSEND
@@ -42,6 +42,7 @@
 #endif
 // For placement new
 #include <snew.h>
+#include <soui_mem_wrapper.h>
 #include <string/strcpcvt.h>
 
 #ifdef _MSC_VER
@@ -533,7 +534,8 @@ PUGI__NS_BEGIN
 			size_t size = sizeof(xml_memory_page) + data_size;
 
 			// allocate block with some alignment, leaving memory for worst-case padding
-			void* memory = xml_memory::allocate(size);
+			// soui: pages go through soui_mem_wrapper so that they are counted as MEM_TAG_XML, unless custom functions are set
+			void* memory = xml_memory::allocate == default_allocate ? SNS::soui_mem_wrapper::SouiMalloc(size, SNS::MEM_TAG_XML) : xml_memory::allocate(size);
 			if (!memory) return 0;
 
 			// prepare page structure
@@ -547,7 +549,10 @@ PUGI__NS_BEGIN
 
 		static void deallocate_page(xml_memory_page* page)
 		{
-			xml_memory::deallocate(page);
+			if (xml_memory::deallocate == default_deallocate)
+				SNS::soui_mem_wrapper::SouiFree(page);
+			else
+				xml_memory::deallocate(page);
 		}
 
 		void* allocate_memory_oob(size_t size, xml_memory_page*& out_page);
@@ -4755,67 +4760,283 @@ PUGI__NS_BEGIN
 		return ret;
 	}
 
-	PUGI__FN void _load_bin_impl(xml_document_struct *doc,xml_node_struct * xmlStrut,const char * & buf,int & nLen,char_t ** ppStrMap,int nMapSize)
+	//string table of a binary xml. ver 2 maps string index to an entry of ppStrMap,
+	//ver 3 (flat) stores (char offset + 1) of the string inside pszTable directly.
+	struct bin_str_table
 	{
-		//read type
-		int nIdxSize = index_size(nMapSize);
+		char_t ** ppStrMap;
+		int nMapSize;
+		const char_t * pszTable;
+		size_t nChars;
+		const uint32_t * pRemap;
 
-		xml_node xmlNode(xmlStrut);
-		if(xmlNode.type() != node_document)
+		const char_t * get(int nIdx) const
 		{
-			int nIdx = read_index(buf,nLen,nIdxSize);
-			if(nIdx>0)
+			if(nIdx<=0) return 0;
+			if(ppStrMap)
+				return nIdx<=nMapSize?ppStrMap[nIdx-1]:0;
+			if((size_t)(nIdx-1)>=nChars) return 0;
+			return pszTable + (pRemap?pRemap[nIdx-1]:(uint32_t)(nIdx-1));
+		}
+	};
+
+	//allocate all nodes and attributes of a binary xml from one memory block.
+	struct bin_node_allocator
+	{
+		char * block;
+		char * block_end;
+		xml_memory_page * page;
+		xml_allocator * alloc;
+
+		bin_node_allocator(xml_allocator * alloc_):block(0),block_end(0),page(0),alloc(alloc_){}
+
+		void reserve(size_t nNodes,size_t nAttrs)
+		{
+		#ifndef PUGIXML_COMPACT
+			size_t size = nNodes*sizeof(xml_node_struct)+nAttrs*sizeof(xml_attribute_struct);
+			//page offset is encoded in the high bits of node header.
+			if(size==0 || size > (~static_cast<uintptr_t>(0)>>8)) return;
+			block = static_cast<char*>(alloc->allocate_memory(size,page));
+			if(block) block_end = block + size;
+		#else
+			(void)nNodes; (void)nAttrs;
+		#endif
+		}
+
+		xml_node_struct * new_node(xml_node_struct * parent, xml_node_type type)
+		{
+			if(block && block + sizeof(xml_node_struct) <= block_end)
 			{
-				xmlStrut->name = ppStrMap[nIdx-1];
+				xml_node_struct * ret = new (block) xml_node_struct(page,type);
+				block += sizeof(xml_node_struct);
+				append_node(ret,parent);
+				return ret;
 			}
-			nIdx = read_index(buf,nLen,nIdxSize);
-			if(nIdx>0)
+			return append_new_node(parent,*alloc,type);
+		}
+
+		xml_attribute_struct * new_attribute(xml_node_struct * node)
+		{
+			if(block && block + sizeof(xml_attribute_struct) <= block_end)
 			{
-				xmlStrut->value = ppStrMap[nIdx-1];
+				xml_attribute_struct * ret = new (block) xml_attribute_struct(page);
+				block += sizeof(xml_attribute_struct);
+				append_attribute(ret,node);
+				return ret;
 			}
-			//read attributes
-			nIdx = read_index(buf,nLen,nIdxSize);
+			return append_new_attribute(node,*alloc);
+		}
+	};
+
+	//walk the binary structure without building nodes, used to size the node block of ver 2 documents.
+	PUGI__FN bool _count_bin_impl(bool bRoot,const char * & buf,int & nLen,int nIdxSize,size_t & nNodes,size_t & nAttrs)
+	{
+		if(!bRoot)
+		{
+			if(nLen < nIdxSize*3) return false;
+			buf += nIdxSize*2;
+			nLen -= nIdxSize*2;
+			int nIdx = read_index(buf,nLen,nIdxSize);
 			while(nIdx)
 			{
-				xml_attribute_struct * attr = impl::append_new_attribute(xmlStrut, impl::get_allocator(xmlStrut));
-				attr->name = ppStrMap[nIdx-1];
+				if(nLen < nIdxSize*2) return false;
+				buf += nIdxSize;
+				nLen -= nIdxSize;
+				nAttrs ++;
 				nIdx = read_index(buf,nLen,nIdxSize);
-				if(nIdx>0) attr->value = ppStrMap[nIdx-1];
+			}
+		}
+		if(nLen<1) return false;
+		char ct = read_buf<char>(buf,nLen);
+		while(ct != node_null)
+		{
+			nNodes++;
+			if(!_count_bin_impl(false,buf,nLen,nIdxSize,nNodes,nAttrs))
+				return false;
+			if(nLen<1) return false;
+			ct = read_buf<char>(buf,nLen);
+		}
+		return true;
+	}
+
+	PUGI__FN bool _load_bin_impl(bin_node_allocator & alloc,xml_node_struct * xmlStrut,const char * & buf,int & nLen,const bin_str_table & strTable,int nIdxSize)
+	{
+		xml_node xmlNode(xmlStrut);
+		if(xmlNode.type() != node_document)
+		{
+			if(nLen < nIdxSize*3) return false;
+			xmlStrut->name = const_cast<char_t*>(strTable.get(read_index(buf,nLen,nIdxSize)));
+			xmlStrut->value = const_cast<char_t*>(strTable.get(read_index(buf,nLen,nIdxSize)));
+			//read attributes
+			int nIdx = read_index(buf,nLen,nIdxSize);
+			while(nIdx)
+			{
+				if(nLen < nIdxSize*2) return false;
+				xml_attribute_struct * attr = alloc.new_attribute(xmlStrut);
+				if(!attr) return false;
+				attr->name = const_cast<char_t*>(strTable.get(nIdx));
+				attr->value = const_cast<char_t*>(strTable.get(read_index(buf,nLen,nIdxSize)));
 				//read attribute
 				nIdx = read_index(buf,nLen,nIdxSize);
 			}
 		}
 		//read children
+		if(nLen<1) return false;
 		char ct = read_buf<char>(buf,nLen);
 		while(ct != node_null)
 		{
-			xml_node_struct * xmlChild = impl::append_new_node(xmlStrut, impl::get_allocator(xmlStrut), (xml_node_type)ct);
-			_load_bin_impl(doc,xmlChild,buf,nLen,ppStrMap,nMapSize);
+			xml_node_struct * xmlChild = alloc.new_node(xmlStrut,(xml_node_type)ct);
+			if(!xmlChild) return false;
+			if(!_load_bin_impl(alloc,xmlChild,buf,nLen,strTable,nIdxSize))
+				return false;
+			if(nLen<1) return false;
 			ct = read_buf<char>(buf,nLen);
 		}
+		return true;
 	}
 
-	PUGI__FN xml_parse_result load_bin_impl(xml_document_struct *doc,xml_node_struct * xmlStrut,const char * buf,int nLen)
+#ifdef PUGIXML_WCHAR_MODE
+	typedef wchar_counter bin_str_counter;
+	typedef wchar_writer bin_str_writer;
+#else
+	typedef utf8_counter bin_str_counter;
+	typedef utf8_writer bin_str_writer;
+#endif
+
+	//convert a flat string table saved with a foreign char size to char_t. pRemap receives the new offset of each string.
+	template <typename D> PUGI__FN char_t* convert_bin_str_table(const void* table, size_t nChars, uint32_t* pRemap)
 	{
-		xml_parse_result res;
-		sxml_info header = read_buf<sxml_info>(buf,nLen);
-		if(memcmp(header.flag, SXML_BOM, 4)!=0 || header.ver!= SXML_VER)
+		const typename D::type* src = static_cast<const typename D::type*>(table);
+		size_t nTotal = 0;
+		for(size_t i=0;i<nChars;)
+		{
+			size_t len = 0;
+			while(i+len<nChars && src[i+len]) len++;
+			nTotal += D::process(src+i,len,0,bin_str_counter())+1;
+			i += len+1;
+		}
+		char_t* ret = static_cast<char_t*>(xml_memory::allocate((nTotal+1)*sizeof(char_t)));
+		if(!ret) return 0;
+		char_t* p = ret;
+		for(size_t i=0;i<nChars;)
 		{
-			res.status = status_bad_doctype;
-			return res;
+			size_t len = 0;
+			while(i+len<nChars && src[i+len]) len++;
+			pRemap[i] = static_cast<uint32_t>(p-ret);
+			p = reinterpret_cast<char_t*>(D::process(src+i,len,reinterpret_cast<bin_str_writer::value_type>(p),bin_str_writer()));
+			*p++ = 0;
+			i += len+1;
 		}
+		return ret;
+	}
+
+	PUGI__FN xml_parse_result load_bin_flat_impl(xml_document_struct *doc,xml_node_struct * xmlStrut,const sxml_info & header,const char * buf,int nLen,bool is_mutable,bool own,void * contents,char_t** out_buffer)
+	{
+		if(nLen < (int)sizeof(sxml_flat_info)) return make_parse_result(status_bad_doctype);
+		sxml_flat_info flat = read_buf<sxml_flat_info>(buf,nLen);
+		if(header.nStrMapLen<0 || header.nStrMapLen>nLen || flat.nNodes<0 || flat.nAttrs<0
+			|| (flat.nCharSize!=1 && flat.nCharSize!=2 && flat.nCharSize!=4))
+			return make_parse_result(status_bad_doctype);
+
+		bin_str_table strTable = {0};
+		strTable.nChars = header.nStrMapLen/flat.nCharSize;
+		uint32_t * pRemap = NULL;
+		char_t * pOwnBuf = NULL;
+		if(flat.nCharSize == sizeof(char_t))
+		{
+			if(is_mutable && (reinterpret_cast<uintptr_t>(buf) % sizeof(char_t))==0)
+			{//zero copy: strings are used from the blob directly.
+				strTable.pszTable = reinterpret_cast<const char_t*>(buf);
+			}
+			else
+			{
+				pOwnBuf = static_cast<char_t*>(xml_memory::allocate(header.nStrMapLen+sizeof(char_t)));
+				if(!pOwnBuf) return make_parse_result(status_out_of_memory);
+				memcpy(pOwnBuf,buf,header.nStrMapLen);
+				pOwnBuf[strTable.nChars] = 0;//a truncated table still ends with a terminator
+				strTable.pszTable = pOwnBuf;
+			}
+		}
+		else
+		{
+			const void * table = buf;
+			void * aligned = NULL;
+			if(reinterpret_cast<uintptr_t>(buf) % flat.nCharSize)
+			{
+				aligned = malloc(header.nStrMapLen);
+				if(!aligned) return make_parse_result(status_out_of_memory);
+				memcpy(aligned,buf,header.nStrMapLen);
+				table = aligned;
+			}
+			pRemap = static_cast<uint32_t*>(malloc((strTable.nChars+1)*sizeof(uint32_t)));
+			if(pRemap)
+			{
+				switch(flat.nCharSize)
+				{
+				case 1:pOwnBuf = convert_bin_str_table<utf8_decoder>(table,strTable.nChars,pRemap);break;
+				case 2:pOwnBuf = convert_bin_str_table<utf16_decoder<opt_false> >(table,strTable.nChars,pRemap);break;
+				default:pOwnBuf = convert_bin_str_table<utf32_decoder<opt_false> >(table,strTable.nChars,pRemap);break;
+				}
+			}
+			if(aligned) free(aligned);
+			if(!pOwnBuf)
+			{
+				if(pRemap) free(pRemap);
+				return make_parse_result(status_out_of_memory);
+			}
+			strTable.pszTable = pOwnBuf;
+			strTable.pRemap = pRemap;
+		}
+		buf += header.nStrMapLen;
+		nLen -= header.nStrMapLen;
+
+		if(pOwnBuf)
+		{
+			*out_buffer = pOwnBuf;
+			if(own && contents) xml_memory::deallocate(contents);
+		}
+		else if(own)
+		{
+			*out_buffer = static_cast<char_t*>(contents);
+		}
+		doc->buffer = strTable.pszTable;
+
+		bin_node_allocator alloc(doc);
+		alloc.reserve(flat.nNodes,flat.nAttrs);
+		bool bOK = _load_bin_impl(alloc,xmlStrut,buf,nLen,strTable,sizeof(int));
+		if(pRemap) free(pRemap);
+		return make_parse_result(bOK?status_ok:status_internal_error);
+	}
+
+	PUGI__FN xml_parse_result load_bin_impl(xml_document_struct *doc,xml_node_struct * xmlStrut,void * contents,int nLen,bool is_mutable,bool own,char_t** out_buffer)
+	{
+		const char * buf = static_cast<const char*>(contents);
+		if(nLen < (int)sizeof(sxml_info)) return make_parse_result(status_bad_doctype);
+		sxml_info header = read_buf<sxml_info>(buf,nLen);
+		if(memcmp(header.flag, SXML_BOM, 4)!=0)
+			return make_parse_result(status_bad_doctype);
+		if(header.ver == SXML_VER_FLAT)
+			return load_bin_flat_impl(doc,xmlStrut,header,buf,nLen,is_mutable,own,contents,out_buffer);
+		if(header.ver!= SXML_VER || header.nStrMapLen<0 || header.nStrMapLen>nLen || header.nStrMapSize<=0)
+			return make_parse_result(status_bad_doctype);
 
 		char_t ** strMap = (char_t **)malloc(header.nStrMapSize*sizeof(char_t *));
+		if(!strMap) return make_parse_result(status_out_of_memory);
 		char_t * strBuf = NULL;
 
 #ifdef PUGIXML_WCHAR_MODE
 		int nStrLen = MultiByteToWideChar(CP_UTF8, 0, buf, header.nStrMapLen, NULL, 0);//convert utf8 2 wide char.
-		strBuf = static_cast<wchar_t *>(impl::xml_memory::allocate(nStrLen * sizeof(wchar_t)));
-		MultiByteToWideChar(CP_UTF8, 0, buf, header.nStrMapLen, strBuf, nStrLen);
+		strBuf = static_cast<wchar_t *>(impl::xml_memory::allocate((nStrLen+1) * sizeof(wchar_t)));
+		if(strBuf) MultiByteToWideChar(CP_UTF8, 0, buf, header.nStrMapLen, strBuf, nStrLen);
 #else
-		strBuf = static_cast<char *>(impl::xml_memory::allocate(nLen));
-		memcpy(strBuf, buf, nLen);
+		strBuf = static_cast<char *>(impl::xml_memory::allocate(header.nStrMapLen+1));
+		if(strBuf) memcpy(strBuf, buf, header.nStrMapLen);
 #endif        
+		if(!strBuf)
+		{
+			free(strMap);
+			return make_parse_result(status_out_of_memory);
+		}
 		buf += header.nStrMapLen;
 		nLen -= header.nStrMapLen;
 
@@ -4828,12 +5049,27 @@ PUGI__NS_BEGIN
 		}
 
 		doc->buffer = strBuf;
+		*out_buffer = strBuf;
+		if(own && contents) xml_memory::deallocate(contents);
+
+		bin_str_table strTable = {0};
+		strTable.ppStrMap = strMap;
+		strTable.nMapSize = header.nStrMapSize;
+		int nIdxSize = index_size(header.nStrMapSize);
 
-		_load_bin_impl(doc,xmlStrut,buf,nLen,strMap,header.nStrMapSize);
+		//count nodes first so that the whole tree comes from a single allocation.
+		bin_node_allocator alloc(doc);
+		{
+			const char * buf2 = buf;
+			int nLen2 = nLen;
+			size_t nNodes = 0, nAttrs = 0;
+			if(_count_bin_impl(xml_node(xmlStrut).type() == node_document,buf2,nLen2,nIdxSize,nNodes,nAttrs))
+				alloc.reserve(nNodes,nAttrs);
+		}
+		bool bOK = _load_bin_impl(alloc,xmlStrut,buf,nLen,strTable,nIdxSize);
 
 		free(strMap);
-		res.status = status_ok;
-		return res;
+		return make_parse_result(bOK?status_ok:status_internal_error);
 	}
 
 	PUGI__FN xml_parse_result load_buffer_impl(xml_document_struct* doc, xml_node_struct* root, void* contents, size_t size, unsigned int options, xml_encoding encoding, bool is_mutable, bool own, char_t** out_buffer)
@@ -4845,7 +5081,7 @@ PUGI__NS_BEGIN
 		xml_encoding buffer_encoding = impl::get_buffer_encoding(encoding, contents, size);
 		if (buffer_encoding == encoding_bin)
 		{
-			return load_bin_impl(doc,root,(const char *)contents, (int)size);
+			return load_bin_impl(doc,root,contents,(int)size,is_mutable,own,out_buffer);
 		}
 
 		// get private buffer
@@ -7458,13 +7694,18 @@ namespace pugi
 		typedef SNS::SMap<SNS::SStringA,int> STRMAP;	//utf8_name ->index
 
 		static void _AddStr2Map(STRMAP & strMap, const char_t * str) ;
-		static void _build_str_map(xml_node xmlNode,STRMAP &strMap) ;
-		static void _write_str(const STRMAP & strMap,const char_t * str,FILE * f) ;
+		static void _build_str_map(xml_node xmlNode,STRMAP &strMap,int &nNodes,int &nAttrs) ;
+		static void _write_str(const STRMAP & strMap,const char_t * str,int nIdxSize,FILE * f) ;
 		static void _write_str_map(FILE *f,STRMAP & strMap) ;
 
 		static int _index_str_map(STRMAP & strMap);
-		static void _save_bin(const STRMAP & strMap,xml_node xmlNode,FILE * f) ;
+		static void _save_bin(const STRMAP & strMap,xml_node xmlNode,int nIdxSize,FILE * f) ;
 		static void _save_bin(xml_node root,FILE *f) ;
+
+		static int _convert_str(const SNS::SStringA & str,int nCharSize,void * pBuf);
+		static int _index_str_map_flat(STRMAP & strMap,int nCharSize);
+		static void _write_str_map_flat(FILE *f,STRMAP & strMap,int nCharSize,int nTableLen) ;
+		static void _save_bin_flat(xml_node root,FILE *f,int nCharSize) ;
 	};
 
 	void SaveAsBin::_AddStr2Map(STRMAP & strMap, const char_t * str) 
@@ -7483,10 +7724,8 @@ namespace pugi
 		}
 	}
 
-	void SaveAsBin::_write_str(const STRMAP & strMap,const char_t * str,FILE * f) 
+	void SaveAsBin::_write_str(const STRMAP & strMap,const char_t * str,int nIdxSize,FILE * f) 
 	{
-		size_t sz = strMap.GetCount();
-		int nIdxSize= impl::index_size((int)strMap.GetCount());
 		int nIdx = 0;
 
 #ifdef PUGIXML_WCHAR_MODE
@@ -7501,10 +7740,12 @@ namespace pugi
 		fwrite(&nIdx,1,nIdxSize,f);
 	}
 
-	void SaveAsBin::_build_str_map(xml_node xmlNode,STRMAP &strMap) 
+	void SaveAsBin::_build_str_map(xml_node xmlNode,STRMAP &strMap,int &nNodes,int &nAttrs) 
 	{
 		if(xmlNode.type()<node_document || xmlNode.type()>node_comment)
 			return;
+		if(xmlNode.type()>node_document)
+			nNodes++;
 		_AddStr2Map(strMap,xmlNode.name());
 		_AddStr2Map(strMap,xmlNode.value());
 
@@ -7513,12 +7754,13 @@ namespace pugi
 		{
 			_AddStr2Map(strMap,it->name());
 			_AddStr2Map(strMap,it->value());
+			nAttrs++;
 			it++;
 		}
 		xml_node xmlChild = xmlNode.first_child();
 		while(xmlChild)
 		{
-			_build_str_map(xmlChild,strMap);
+			_build_str_map(xmlChild,strMap,nNodes,nAttrs);
 			xmlChild = xmlChild.next_sibling();
 		}
 	}
@@ -7548,7 +7790,55 @@ namespace pugi
 		}
 	}
 
-	void SaveAsBin::_save_bin(const STRMAP & strMap,xml_node xmlNode,FILE * f) 
+	//convert utf8 string to nCharSize encoding, return char count without the terminating zero. pBuf can be NULL to get the length only.
+	int SaveAsBin::_convert_str(const SNS::SStringA & str,int nCharSize,void * pBuf)
+	{
+		const uint8_t * src = reinterpret_cast<const uint8_t*>(str.c_str());
+		size_t len = str.GetLength();
+		switch(nCharSize)
+		{
+		case 2:
+			if(!pBuf) return (int)impl::utf8_decoder::process(src,len,0,impl::utf16_counter());
+			return (int)(impl::utf8_decoder::process(src,len,static_cast<uint16_t*>(pBuf),impl::utf16_writer())-static_cast<uint16_t*>(pBuf));
+		case 4:
+			if(!pBuf) return (int)impl::utf8_decoder::process(src,len,0,impl::utf32_counter());
+			return (int)(impl::utf8_decoder::process(src,len,static_cast<uint32_t*>(pBuf),impl::utf32_writer())-static_cast<uint32_t*>(pBuf));
+		default:
+			if(pBuf) memcpy(pBuf,src,len);
+			return (int)len;
+		}
+	}
+
+	//index of flat string map is (char offset + 1), return total char count of the string table.
+	int SaveAsBin::_index_str_map_flat(STRMAP & strMap,int nCharSize) 
+	{
+		int nRet = 0;
+		SNS::SPOSITION pos = strMap.GetStartPosition();
+		while(pos)
+		{
+			STRMAP::CPair *p = strMap.GetNext(pos);
+			p->m_value = nRet + 1;
+			nRet += _convert_str(p->m_key,nCharSize,NULL)+1;
+		}
+		return nRet;
+	}
+
+	void SaveAsBin::_write_str_map_flat(FILE *f,STRMAP & strMap,int nCharSize,int nTableLen) 
+	{
+		char * buf = static_cast<char*>(calloc(nTableLen?nTableLen:1,1));
+		if(!buf) return;
+		char * p = buf;
+		SNS::SPOSITION pos = strMap.GetStartPosition();
+		while(pos)
+		{
+			STRMAP::CPair *pair = strMap.GetNext(pos);
+			p += (_convert_str(pair->m_key,nCharSize,p)+1)*nCharSize;
+		}
+		fwrite(buf,1,nTableLen,f);
+		free(buf);
+	}
+
+	void SaveAsBin::_save_bin(const STRMAP & strMap,xml_node xmlNode,int nIdxSize,FILE * f) 
 	{
 		//save node type
 		xml_node_type type = xmlNode.type();
@@ -7557,19 +7847,19 @@ namespace pugi
 		if(type > node_document)
 		{//save string with the last end character
 			//save node name: todo:wcslen
-			_write_str(strMap,xmlNode.name(),f);
+			_write_str(strMap,xmlNode.name(),nIdxSize,f);
 			//save node value
-			_write_str(strMap,xmlNode.value(),f);
+			_write_str(strMap,xmlNode.value(),nIdxSize,f);
 			//save attribute
 			xml_attribute_iterator it = xmlNode.attributes_begin();
 			while(it != xmlNode.attributes_end())
 			{
-				_write_str(strMap,it->name(),f);
-				_write_str(strMap,it->value(),f);
+				_write_str(strMap,it->name(),nIdxSize,f);
+				_write_str(strMap,it->value(),nIdxSize,f);
 				it++;
 			}
 			//write attribute end flag
-			_write_str(strMap,NULL,f);
+			_write_str(strMap,NULL,nIdxSize,f);
 		}
 		//write children
 		xml_node xmlChild = xmlNode.first_child();
@@ -7578,7 +7868,7 @@ namespace pugi
 			//write child
 			char cT = (char)xmlChild.type();
 			fwrite(&cT,1,1,f);
-			_save_bin(strMap,xmlChild,f);
+			_save_bin(strMap,xmlChild,nIdxSize,f);
 			xmlChild = xmlChild.next_sibling();
 		}
 		//save child end
@@ -7589,7 +7879,8 @@ namespace pugi
 	void SaveAsBin::_save_bin(xml_node root,FILE *f) 
 	{
 		STRMAP strMap;
-		_build_str_map(root,strMap);
+		int nNodes = 0, nAttrs = 0;
+		_build_str_map(root,strMap,nNodes,nAttrs);
 		int nSize = _index_str_map(strMap);
 
 		//write header
@@ -7600,7 +7891,26 @@ namespace pugi
 		_write_str_map(f,strMap);
 
 		//write xml structure
-		_save_bin(strMap,root,f);
+		_save_bin(strMap,root,impl::index_size((int)strMap.GetCount()),f);
+	}
+
+	void SaveAsBin::_save_bin_flat(xml_node root,FILE *f,int nCharSize) 
+	{
+		STRMAP strMap;
+		int nNodes = 0, nAttrs = 0;
+		_build_str_map(root,strMap,nNodes,nAttrs);
+		int nChars = _index_str_map_flat(strMap,nCharSize);
+		//keep the structure after string table 4 bytes aligned.
+		int nTableLen = (nChars*nCharSize+3)&~3;
+
+		sxml_info info = { {SXML_BOM[0],SXML_BOM [1],SXML_BOM [2],SXML_BOM [3]},SXML_VER_FLAT,(int)strMap.GetCount(),nTableLen };
+		fwrite(&info,1,sizeof(info),f);
+		sxml_flat_info flat = { nCharSize,nNodes,nAttrs,0 };
+		fwrite(&flat,1,sizeof(flat),f);
+
+		_write_str_map_flat(f,strMap,nCharSize,nTableLen);
+
+		_save_bin(strMap,root,sizeof(int),f);
 	}
 
 	PUGI__FN void xml_document::save_bin(FILE *f) const
@@ -7608,6 +7918,13 @@ namespace pugi
 		SaveAsBin::_save_bin(*this,f);
 	}
 
+	PUGI__FN void xml_document::save_bin_flat(FILE *f, int nCharSize) const
+	{
+		if(nCharSize!=1 && nCharSize!=2 && nCharSize!=4)
+			nCharSize = sizeof(char_t);
+		SaveAsBin::_save_bin_flat(*this,f,nCharSize);
+	}
+
 #ifndef PUGIXML_NO_STL
 	PUGI__FN void xml_document::save(std::basic_ostream<char, std::char_traits<char> >& stream, const char_t* indent, unsigned int flags, xml_encoding encoding) const
 	{
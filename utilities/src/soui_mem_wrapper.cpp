@@ -1,27 +1,624 @@
 ﻿#include "soui_mem_wrapper.h"
 #include "utilities-def.h"
+#include "helper/SCriticalSection.h"
+#include <windows.h>
 #include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
-SNSBEGIN  
-    void * soui_mem_wrapper::SouiMalloc( size_t szMem )
+SNSBEGIN
+    //////////////////////////////////////////////////////////////////////////
+    // 每个块前有一个块头，记录申请的大小、统计标签和块的来源。
+    // 块头在64位下是16字节，32位下是8字节，保持和malloc一样的对齐。
+    struct SMemHead
     {
-        return malloc(szMem);
+        size_t cbSize;
+        unsigned short nTag;
+        unsigned short nClass; // 0:底层分配器，KClassArena:arena，其它:小块的档位
+    };
+
+    enum
+    {
+        KGranule = 16,
+        KSmallMax = 512, //含块头
+        KClasses = 15,
+        KClassArena = 0xFFFF,
+        KSlabSize = 16 * 1024,
+        KArenaAlign = 16,
+        KPageHead = 16, // arena页头(SMemArena::Page)对齐后的大小
+    };
+
+    //小块按含块头的大小分档，档位之间的浪费不超过1/4
+    static const unsigned short s_cbClass[KClasses + 1] = { 0, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512 };
+
+    static const char *s_tagNames[] = { "default", "coll", "string", "xml", "buffer" };
+
+    static IMemAllocator *s_pAllocator = NULL;
+    static bool s_bAllocatorUsed = false;
+
+    static void *RawAlloc(size_t cb)
+    {
+        s_bAllocatorUsed = true;
+        return s_pAllocator ? s_pAllocator->Alloc(cb) : malloc(cb);
+    }
+
+    static void *RawRealloc(void *p, size_t cb)
+    {
+        return s_pAllocator ? s_pAllocator->Realloc(p, cb) : realloc(p, cb);
+    }
+
+    static void RawFree(void *p)
+    {
+        if (s_pAllocator)
+            s_pAllocator->Free(p);
+        else
+            free(p);
+    }
+
+    struct SMemFreeBlock
+    {
+        SMemFreeBlock *pNext;
+    };
+
+    //每个线程一份，分配和释放小块时不加锁，统计也只写本线程的计数
+    struct SMemThreadCache
+    {
+        SMemThreadCache *pPrev;
+        SMemThreadCache *pNext;
+        SMemFreeBlock *freeList[KClasses + 1];
+        int nFree[KClasses + 1];
+        SMemStat stats[MEM_TAG_MAX];
+        SMemArena *pArena;
+        int nArenaTag; //只有这个标签的分配进入pArena
+    };
+
+#ifdef _WIN32
+    typedef VOID(WINAPI *FunFlsCallback)(PVOID);
+    typedef DWORD(WINAPI *FunFlsAlloc)(FunFlsCallback);
+    typedef PVOID(WINAPI *FunFlsGetValue)(DWORD);
+    typedef BOOL(WINAPI *FunFlsSetValue)(DWORD, PVOID);
+#endif
+
+    class SMemPool
+    {
+      public:
+        SMemPool();
+
+        SMemThreadCache *GetThreadCache();
+        void ReleaseThreadCache(SMemThreadCache *pCache);
+
+        void *Alloc(SMemThreadCache *pCache, size_t cb, int nTag, BOOL bArena);
+        void Free(SMemThreadCache *pCache, void *p);
+        void *Realloc(SMemThreadCache *pCache, void *p, size_t cb);
+
+        void GetStat(SMemStat *pStats);
+
+      private:
+        void *AllocSmall(SMemThreadCache *pCache, int nClass);
+        void FreeSmall(SMemThreadCache *pCache, void *p, int nClass);
+        BOOL AddSlab(int nClass);
+        void Count(SMemThreadCache *pCache, int nTag, INT_PTR cbDelta, INT_PTR nBlockDelta, INT_PTR nAllocs);
+
+        unsigned char m_classOf[KSmallMax / KGranule + 1];
+        int m_nBatch[KClasses + 1]; //线程缓存和中心链表之间一次搬动的块数
+
+        SCriticalSection m_cs; //保护中心链表
+        SMemFreeBlock *m_central[KClasses + 1];
+
+        SCriticalSection m_csCache; //保护线程缓存的链表和退出线程的统计
+        SMemThreadCache *m_pCaches;
+        SMemStat m_retired[MEM_TAG_MAX];
+
+#ifdef _WIN32
+        FunFlsGetValue m_funGetValue;
+        FunFlsSetValue m_funSetValue;
+        DWORD m_dwSlot;
+#else
+        pthread_key_t m_key;
+#endif
+        bool m_bTls;
+    };
+
+#ifndef _WIN32
+    //pthread的key只用来在线程退出时回收缓存，查找走编译器的线程局部变量
+    static __thread SMemThreadCache *t_pCache = NULL;
+#endif
+
+    static SMemPool *GetPool()
+    {
+        //不析构：静态对象可能在池析构之后才释放内存
+        static SMemPool *s_pool = new SMemPool;
+        return s_pool;
+    }
+
+#ifdef _WIN32
+    static VOID WINAPI OnThreadExit(PVOID p)
+    {
+        if (p)
+            GetPool()->ReleaseThreadCache((SMemThreadCache *)p);
+    }
+#else
+    static void OnThreadExit(void *p)
+    {
+        t_pCache = NULL;
+        GetPool()->ReleaseThreadCache((SMemThreadCache *)p);
+    }
+#endif
+
+    SMemPool::SMemPool()
+        : m_pCaches(NULL)
+    {
+        memset(m_central, 0, sizeof(m_central));
+        memset(m_retired, 0, sizeof(m_retired));
+        int nClass = 1;
+        m_classOf[0] = 1;
+        for (int i = 1; i <= KSmallMax / KGranule; i++)
+        {
+            while (s_cbClass[nClass] < i * KGranule)
+                nClass++;
+            m_classOf[i] = (unsigned char)nClass;
+        }
+        //小档一次搬64块，大档至少8块
+        for (int i = 1; i <= KClasses; i++)
+            m_nBatch[i] = smax(8, smin(64, 8192 / (int)s_cbClass[i]));
+#ifdef _WIN32
+        //线程退出时需要回调来回收线程缓存，FLS在Vista之后才有，XP下退回到TLS
+        HMODULE hKernel = GetModuleHandle(TEXT("kernel32.dll"));
+        FunFlsAlloc funAlloc = hKernel ? (FunFlsAlloc)GetProcAddress(hKernel, "FlsAlloc") : NULL;
+        m_funGetValue = hKernel ? (FunFlsGetValue)GetProcAddress(hKernel, "FlsGetValue") : NULL;
+        m_funSetValue = hKernel ? (FunFlsSetValue)GetProcAddress(hKernel, "FlsSetValue") : NULL;
+        if (funAlloc && m_funGetValue && m_funSetValue)
+        {
+            m_dwSlot = funAlloc(OnThreadExit);
+        }
+        else
+        {
+            m_funGetValue = (FunFlsGetValue)TlsGetValue;
+            m_funSetValue = (FunFlsSetValue)TlsSetValue;
+            m_dwSlot = TlsAlloc();
+        }
+        m_bTls = m_dwSlot != TLS_OUT_OF_INDEXES;
+#else
+        m_bTls = pthread_key_create(&m_key, OnThreadExit) == 0;
+#endif
+    }
+
+    SMemThreadCache *SMemPool::GetThreadCache()
+    {
+        if (!m_bTls)
+            return NULL;
+#ifdef _WIN32
+        SMemThreadCache *pCache = (SMemThreadCache *)m_funGetValue(m_dwSlot);
+#else
+        SMemThreadCache *pCache = t_pCache;
+#endif
+        if (pCache)
+            return pCache;
+        pCache = (SMemThreadCache *)RawAlloc(sizeof(SMemThreadCache));
+        if (!pCache)
+            return NULL;
+        memset(pCache, 0, sizeof(SMemThreadCache));
+#ifdef _WIN32
+        m_funSetValue(m_dwSlot, pCache);
+#else
+        pthread_setspecific(m_key, pCache);
+        t_pCache = pCache;
+#endif
+        SAutoLock lock(m_csCache);
+        pCache->pNext = m_pCaches;
+        if (m_pCaches)
+            m_pCaches->pPrev = pCache;
+        m_pCaches = pCache;
+        return pCache;
+    }
+
+    void SMemPool::ReleaseThreadCache(SMemThreadCache *pCache)
+    {
+        {
+            SAutoLock lock(m_cs);
+            for (int i = 1; i <= KClasses; i++)
+            {
+                while (pCache->freeList[i])
+                {
+                    SMemFreeBlock *pBlock = pCache->freeList[i];
+                    pCache->freeList[i] = pBlock->pNext;
+                    pBlock->pNext = m_central[i];
+                    m_central[i] = pBlock;
+                }
+            }
+        }
+        {
+            SAutoLock lock(m_csCache);
+            for (int i = 0; i < MEM_TAG_MAX; i++)
+            {
+                m_retired[i].nBytes += pCache->stats[i].nBytes;
+                m_retired[i].nBlocks += pCache->stats[i].nBlocks;
+                m_retired[i].nAllocs += pCache->stats[i].nAllocs;
+            }
+            if (pCache->pPrev)
+                pCache->pPrev->pNext = pCache->pNext;
+            else
+                m_pCaches = pCache->pNext;
+            if (pCache->pNext)
+                pCache->pNext->pPrev = pCache->pPrev;
+        }
+        RawFree(pCache);
+    }
+
+    void SMemPool::Count(SMemThreadCache *pCache, int nTag, INT_PTR cbDelta, INT_PTR nBlockDelta, INT_PTR nAllocs)
+    {
+        if (pCache)
+        {
+            SMemStat &stat = pCache->stats[nTag];
+            stat.nBytes += cbDelta;
+            stat.nBlocks += nBlockDelta;
+            stat.nAllocs += nAllocs;
+        }
+        else
+        {
+            SAutoLock lock(m_csCache);
+            SMemStat &stat = m_retired[nTag];
+            stat.nBytes += cbDelta;
+            stat.nBlocks += nBlockDelta;
+            stat.nAllocs += nAllocs;
+        }
+    }
+
+    void SMemPool::GetStat(SMemStat *pStats)
+    {
+        //其它线程的计数在查询时可能还在变化，结果是近似的快照
+        SAutoLock lock(m_csCache);
+        memcpy(pStats, m_retired, sizeof(m_retired));
+        for (SMemThreadCache *pCache = m_pCaches; pCache; pCache = pCache->pNext)
+        {
+            for (int i = 0; i < MEM_TAG_MAX; i++)
+            {
+                pStats[i].nBytes += pCache->stats[i].nBytes;
+                pStats[i].nBlocks += pCache->stats[i].nBlocks;
+                pStats[i].nAllocs += pCache->stats[i].nAllocs;
+            }
+        }
+    }
+
+    BOOL SMemPool::AddSlab(int nClass)
+    {
+        char *pSlab = (char *)RawAlloc(KSlabSize);
+        if (!pSlab)
+            return FALSE;
+        int cbBlock = s_cbClass[nClass];
+        for (int i = KSlabSize / cbBlock - 1; i >= 0; i--)
+        {
+            SMemFreeBlock *pBlock = (SMemFreeBlock *)(pSlab + i * cbBlock);
+            pBlock->pNext = m_central[nClass];
+            m_central[nClass] = pBlock;
+        }
+        return TRUE;
+    }
+
+    void *SMemPool::AllocSmall(SMemThreadCache *pCache, int nClass)
+    {
+        if (pCache)
+        {
+            if (!pCache->freeList[nClass])
+            {
+                //线程缓存空了，从中心链表成批取一次
+                SAutoLock lock(m_cs);
+                if (!m_central[nClass] && !AddSlab(nClass))
+                    return NULL;
+                int nBatch = m_nBatch[nClass];
+                while (m_central[nClass] && pCache->nFree[nClass] < nBatch)
+                {
+                    SMemFreeBlock *pBlock = m_central[nClass];
+                    m_central[nClass] = pBlock->pNext;
+                    pBlock->pNext = pCache->freeList[nClass];
+                    pCache->freeList[nClass] = pBlock;
+                    pCache->nFree[nClass]++;
+                }
+            }
+            SMemFreeBlock *pRet = pCache->freeList[nClass];
+            pCache->freeList[nClass] = pRet->pNext;
+            pCache->nFree[nClass]--;
+            return pRet;
+        }
+        SAutoLock lock(m_cs);
+        if (!m_central[nClass] && !AddSlab(nClass))
+            return NULL;
+        SMemFreeBlock *pRet = m_central[nClass];
+        m_central[nClass] = pRet->pNext;
+        return pRet;
+    }
+
+    void SMemPool::FreeSmall(SMemThreadCache *pCache, void *p, int nClass)
+    {
+        SMemFreeBlock *pBlock = (SMemFreeBlock *)p;
+        if (pCache)
+        {
+            pBlock->pNext = pCache->freeList[nClass];
+            pCache->freeList[nClass] = pBlock;
+            int nBatch = m_nBatch[nClass];
+            if (++pCache->nFree[nClass] <= nBatch * 2)
+                return;
+            //缓存的空闲块太多，还一批给中心链表，让其它线程可以复用
+            SMemFreeBlock *pHead = pCache->freeList[nClass];
+            SMemFreeBlock *pTail = pHead;
+            for (int i = 1; i < nBatch; i++)
+                pTail = pTail->pNext;
+            pCache->freeList[nClass] = pTail->pNext;
+            pCache->nFree[nClass] -= nBatch;
+            SAutoLock lock(m_cs);
+            pTail->pNext = m_central[nClass];
+            m_central[nClass] = pHead;
+            return;
+        }
+        SAutoLock lock(m_cs);
+        pBlock->pNext = m_central[nClass];
+        m_central[nClass] = pBlock;
+    }
+
+    void *SMemPool::Alloc(SMemThreadCache *pCache, size_t cb, int nTag, BOOL bArena)
+    {
+        SASSERT(nTag >= 0 && nTag < MEM_TAG_MAX);
+        if (cb > (size_t)-1 - KSmallMax)
+            return NULL;
+        size_t cbBlock = sizeof(SMemHead) + cb;
+        SMemHead *pHead;
+        int nClass;
+        if (bArena && pCache && pCache->pArena && nTag == pCache->nArenaTag)
+        {
+            nClass = KClassArena;
+            pHead = (SMemHead *)pCache->pArena->Alloc(cbBlock);
+        }
+        else if (cbBlock <= KSmallMax)
+        {
+            nClass = m_classOf[(cbBlock + KGranule - 1) / KGranule];
+            pHead = (SMemHead *)AllocSmall(pCache, nClass);
+        }
+        else
+        {
+            nClass = 0;
+            pHead = (SMemHead *)RawAlloc(cbBlock);
+        }
+        if (!pHead)
+            return NULL;
+        pHead->cbSize = cb;
+        pHead->nTag = (unsigned short)nTag;
+        pHead->nClass = (unsigned short)nClass;
+        Count(pCache, nTag, (INT_PTR)cb, 1, 1);
+        return pHead + 1;
+    }
+
+    void SMemPool::Free(SMemThreadCache *pCache, void *p)
+    {
+        SMemHead *pHead = (SMemHead *)p - 1;
+        Count(pCache, pHead->nTag, -(INT_PTR)pHead->cbSize, -1, 0);
+        if (pHead->nClass == KClassArena)
+            return; //随arena一起释放
+        if (pHead->nClass == 0)
+            RawFree(pHead);
+        else
+            FreeSmall(pCache, pHead, pHead->nClass);
+    }
+
+    void *SMemPool::Realloc(SMemThreadCache *pCache, void *p, size_t cb)
+    {
+        SMemHead *pHead = (SMemHead *)p - 1;
+        if (cb > (size_t)-1 - KSmallMax)
+            return NULL;
+        size_t cbBlock = sizeof(SMemHead) + cb;
+        int nTag = pHead->nTag;
+        INT_PTR cbDelta = (INT_PTR)cb - (INT_PTR)pHead->cbSize;
+        BOOL bInplace = FALSE;
+        if (pHead->nClass == KClassArena)
+            bInplace = pCache && pCache->pArena && pCache->pArena->Resize(pHead, cbBlock);
+        else if (pHead->nClass != 0)
+            bInplace = cbBlock <= s_cbClass[pHead->nClass];
+        else if (cbBlock > KSmallMax)
+        {
+            //大块留在底层分配器，交给realloc
+            SMemHead *pNew = (SMemHead *)RawRealloc(pHead, cbBlock);
+            if (!pNew)
+                return NULL;
+            pNew->cbSize = cb;
+            Count(pCache, nTag, cbDelta, 0, 1);
+            return pNew + 1;
+        }
+        if (bInplace)
+        {
+            pHead->cbSize = cb;
+            Count(pCache, nTag, cbDelta, 0, 0);
+            return p;
+        }
+        //不能原地增长时改从常规分配器分配：当前的arena可能是嵌套的内层arena，块搬进去会比原来更早失效
+        void *pRet = Alloc(pCache, cb, nTag, FALSE);
+        if (!pRet)
+            return NULL;
+        memcpy(pRet, p, smin(cb, pHead->cbSize));
+        Free(pCache, p);
+        return pRet;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    void * soui_mem_wrapper::SouiMalloc( size_t szMem, int nTag )
+    {
+        SMemPool *pPool = GetPool();
+        return pPool->Alloc(pPool->GetThreadCache(), szMem, nTag, TRUE);
     }
 
     void * soui_mem_wrapper::SouiRealloc( void *p,size_t szMem )
     {
-        return realloc(p,szMem);
+        if (!p)
+            return SouiMalloc(szMem);
+        if (szMem == 0)
+        {
+            SouiFree(p);
+            return NULL;
+        }
+        SMemPool *pPool = GetPool();
+        return pPool->Realloc(pPool->GetThreadCache(), p, szMem);
     }
 
-    void * soui_mem_wrapper::SouiCalloc( size_t count, size_t szEle )
+    void * soui_mem_wrapper::SouiCalloc( size_t count, size_t szEle, int nTag )
     {
-        return calloc(count,szEle);
+        if (szEle && count > (size_t)-1 / szEle)
+            return NULL;
+        void *p = SouiMalloc(count * szEle, nTag);
+        if (p)
+            memset(p, 0, count * szEle);
+        return p;
     }
 
     void soui_mem_wrapper::SouiFree( void *p )
     {
-        free(p);
+        if (!p)
+            return;
+        SMemPool *pPool = GetPool();
+        pPool->Free(pPool->GetThreadCache(), p);
+    }
+
+    size_t soui_mem_wrapper::SouiMemSize(void *p)
+    {
+        if (!p)
+            return 0;
+        SMemHead *pHead = (SMemHead *)p - 1;
+        if (pHead->nClass != 0 && pHead->nClass != KClassArena)
+            return s_cbClass[pHead->nClass] - sizeof(SMemHead);
+        return pHead->cbSize;
     }
 
+    BOOL soui_mem_wrapper::SetAllocator(IMemAllocator *pAllocator)
+    {
+        if (s_bAllocatorUsed)
+            return FALSE;
+        s_pAllocator = pAllocator;
+        return TRUE;
+    }
+
+    void soui_mem_wrapper::GetMemStat(SMemStat *pStats)
+    {
+        GetPool()->GetStat(pStats);
+    }
+
+    LPCSTR soui_mem_wrapper::GetMemTagName(int nTag)
+    {
+        if (nTag < 0 || nTag >= (int)(sizeof(s_tagNames) / sizeof(s_tagNames[0])))
+            return NULL;
+        return s_tagNames[nTag];
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    struct SMemArena::Page
+    {
+        Page *pNext;
+        size_t cbPage;
+    };
+
+    SMemArena::SMemArena(size_t cbPage)
+        : m_pPage(NULL)
+        , m_pCur(NULL)
+        , m_pEnd(NULL)
+        , m_pLast(NULL)
+        , m_cbPage(cbPage)
+        , m_cbUsed(0)
+    {
+    }
+
+    SMemArena::~SMemArena()
+    {
+        Reset();
+        if (m_pPage)
+            RawFree(m_pPage);
+    }
+
+    void *SMemArena::Alloc(size_t cb)
+    {
+        if (cb > (size_t)-1 - KPageHead - KArenaAlign)
+            return NULL;
+        cb = (cb + KArenaAlign - 1) & ~(size_t)(KArenaAlign - 1);
+        if (cb > (size_t)(m_pEnd - m_pCur))
+        {
+            size_t cbPage = smax(m_cbPage, cb + KPageHead);
+            Page *pPage = (Page *)RawAlloc(cbPage);
+            if (!pPage)
+                return NULL;
+            pPage->cbPage = cbPage;
+            pPage->pNext = m_pPage;
+            m_pPage = pPage;
+            m_pCur = (char *)pPage + KPageHead;
+            m_pEnd = (char *)pPage + cbPage;
+        }
+        m_pLast = m_pCur;
+        m_pCur += cb;
+        m_cbUsed += cb;
+        return m_pLast;
+    }
+
+    BOOL SMemArena::Resize(void *p, size_t cb)
+    {
+        if (p == NULL || (char *)p != m_pLast || cb > (size_t)(m_pEnd - m_pLast))
+            return FALSE;
+        cb = (cb + KArenaAlign - 1) & ~(size_t)(KArenaAlign - 1);
+        if (cb > (size_t)(m_pEnd - m_pLast)) //对齐后超出了当前页
+            return FALSE;
+        m_cbUsed = m_cbUsed - (m_pCur - m_pLast) + cb;
+        m_pCur = m_pLast + cb;
+        return TRUE;
+    }
+
+    void SMemArena::Reset()
+    {
+        //留下一个标准大小的页，每帧都Reset的arena不用反复申请
+        Page *pKeep = NULL;
+        while (m_pPage)
+        {
+            Page *pNext = m_pPage->pNext;
+            if (!pKeep && m_pPage->cbPage == m_cbPage)
+            {
+                pKeep = m_pPage;
+                pKeep->pNext = NULL;
+            }
+            else
+            {
+                RawFree(m_pPage);
+            }
+            m_pPage = pNext;
+        }
+        m_pPage = pKeep;
+        m_pCur = pKeep ? (char *)pKeep + KPageHead : NULL;
+        m_pEnd = pKeep ? (char *)pKeep + pKeep->cbPage : NULL;
+        m_pLast = NULL;
+        m_cbUsed = 0;
+    }
+
+    size_t SMemArena::GetUsedBytes() const
+    {
+        return m_cbUsed;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    SMemArenaScope::SMemArenaScope(SMemArena *pArena, int nTag)
+        : m_pPrev(NULL)
+        , m_nPrevTag(MEM_TAG_DEFAULT)
+    {
+        SMemThreadCache *pCache = GetPool()->GetThreadCache();
+        if (pCache)
+        {
+            m_pPrev = pCache->pArena;
+            m_nPrevTag = pCache->nArenaTag;
+            pCache->pArena = pArena;
+            pCache->nArenaTag = nTag;
+        }
+    }
+
+    SMemArenaScope::~SMemArenaScope()
+    {
+        SMemThreadCache *pCache = GetPool()->GetThreadCache();
+        if (pCache)
+        {
+            pCache->pArena = m_pPrev;
+            pCache->nArenaTag = m_nPrevTag;
+        }
+    }
 
 SNSEND
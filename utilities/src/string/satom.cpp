@@ -0,0 +1,144 @@
+﻿#include "string/satom.h"
+#include "string/sstringw.h"
+#include "soui_mem_wrapper.h"
+#include "helper/SCriticalSection.h"
+
+SNSBEGIN
+
+struct SAtomEntry
+{
+    const SAtomEntry *pNext;   // 同一个桶里的下一个原子
+    const SAtomEntry *pFolded; // 小写形式的原子，本身没有大写字符时指向自己
+    ULONG uHash;
+    ULONG uHashNoCase;
+    int nLen;
+    wchar_t szName[1];
+};
+
+// 原子表：固定数量的桶，每个桶是只在头部插入的单链表。
+// 插入在锁内完成，节点写完之后才挂到桶头；节点从不删除也不修改，所以查找不需要加锁。
+enum
+{
+    KAtomBuckets = 4096, // 必须是2的幂
+};
+
+static const SAtomEntry *volatile s_atomBuckets[KAtomBuckets];
+static LONG s_nAtoms = 0;
+
+static SCriticalSection &AtomLock()
+{
+    //不析构：其它静态对象析构时可能还会用到原子
+    static SCriticalSection *s_cs = new SCriticalSection;
+    return *s_cs;
+}
+
+static ULONG HashName(const wchar_t *psz, int nLen)
+{
+    ULONG uHash = 0;
+    for (int i = 0; i < nLen; i++)
+        uHash = (uHash << 5) + uHash + psz[i];
+    return uHash;
+}
+
+static const SAtomEntry *LookupEntry(const wchar_t *psz, int nLen, ULONG uHash)
+{
+    for (const SAtomEntry *p = s_atomBuckets[uHash & (KAtomBuckets - 1)]; p; p = p->pNext)
+    {
+        if (p->uHash == uHash && p->nLen == nLen && memcmp(p->szName, psz, nLen * sizeof(wchar_t)) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+//调用者持有AtomLock
+static const SAtomEntry *InsertEntry(const wchar_t *psz, int nLen, ULONG uHash)
+{
+    const SAtomEntry *pRet = LookupEntry(psz, nLen, uHash);
+    if (pRet)
+        return pRet;
+
+    const SAtomEntry *pFolded = NULL;
+    SStringW strLower(psz, nLen);
+    strLower.MakeLower();
+    if (memcmp(strLower.c_str(), psz, nLen * sizeof(wchar_t)) != 0)
+    {
+        pFolded = InsertEntry(strLower.c_str(), nLen, HashName(strLower.c_str(), nLen));
+        if (!pFolded)
+            return NULL;
+    }
+
+    SAtomEntry *pEntry = (SAtomEntry *)soui_mem_wrapper::SouiMalloc(sizeof(SAtomEntry) + nLen * sizeof(wchar_t), MEM_TAG_STRING);
+    if (!pEntry)
+        return NULL;
+    memcpy(pEntry->szName, psz, nLen * sizeof(wchar_t));
+    pEntry->szName[nLen] = 0;
+    pEntry->nLen = nLen;
+    pEntry->uHash = uHash;
+    pEntry->pFolded = pFolded ? pFolded : pEntry;
+    pEntry->uHashNoCase = pEntry->pFolded->uHash;
+
+    const SAtomEntry *volatile &pHead = s_atomBuckets[uHash & (KAtomBuckets - 1)];
+    pEntry->pNext = pHead;
+    // InterlockedIncrement是完整的内存屏障，保证其它线程看到新桶头时节点内容已经可见
+    InterlockedIncrement(&s_nAtoms);
+    pHead = pEntry;
+    return pEntry;
+}
+
+SAtom::SAtom(LPCWSTR pszName, int nLen)
+{
+    if (!pszName)
+        pszName = L"";
+    if (nLen < 0)
+        nLen = (int)wcslen(pszName);
+    ULONG uHash = HashName(pszName, nLen);
+    m_pEntry = LookupEntry(pszName, nLen, uHash);
+    if (!m_pEntry)
+    {
+        SAutoLock lock(AtomLock());
+        m_pEntry = InsertEntry(pszName, nLen, uHash);
+    }
+}
+
+SAtom SAtom::Find(LPCWSTR pszName, int nLen)
+{
+    if (!pszName)
+        pszName = L"";
+    if (nLen < 0)
+        nLen = (int)wcslen(pszName);
+    return FromEntry(LookupEntry(pszName, nLen, HashName(pszName, nLen)));
+}
+
+SAtom SAtom::FindNoCase(LPCWSTR pszName, int nLen)
+{
+    SStringW strLower(pszName, nLen);
+    strLower.MakeLower();
+    return Find(strLower.c_str(), strLower.GetLength());
+}
+
+LPCWSTR SAtom::GetName() const
+{
+    return m_pEntry ? m_pEntry->szName : L"";
+}
+
+int SAtom::GetLength() const
+{
+    return m_pEntry ? m_pEntry->nLen : 0;
+}
+
+ULONG SAtom::GetHash() const
+{
+    return m_pEntry ? m_pEntry->uHash : 0;
+}
+
+ULONG SAtom::GetHashNoCase() const
+{
+    return m_pEntry ? m_pEntry->uHashNoCase : 0;
+}
+
+SAtom SAtom::GetFolded() const
+{
+    return FromEntry(m_pEntry ? m_pEntry->pFolded : NULL);
+}
+
+SNSEND
@@ -32,7 +32,7 @@ int char_traits::Format(char** ppszDst, const char* pszFormat, va_list & args)
 	va_end(va2);
 #endif//_WIN32
 	if (len <= 0) return 0;
-	*ppszDst = (char*)soui_mem_wrapper::SouiMalloc(len + 1);
+	*ppszDst = (char*)soui_mem_wrapper::SouiMalloc(len + 1, MEM_TAG_STRING);
 	vsprintf_s(*ppszDst, len + 1, pszFormat, args);
 	return len;
 }
@@ -153,19 +153,10 @@ TStringData* SStringA::AllocData(int nLength, TStringData* pOldData /*= NULL*/)
 	if (nLength == 0)
 		return TStringData::InitDataNil();
 
-	int nSize = sizeof(TStringData) + (nLength + 1) * sizeof(char);
-	TStringData* pData;
-	if (pOldData == NULL)
-		pData = (TStringData*)soui_mem_wrapper::SouiMalloc(nSize);
-	else
-		pData = (TStringData*)soui_mem_wrapper::SouiRealloc(pOldData, nSize);
+	TStringData* pData = TStringData::Alloc(nLength, sizeof(char), pOldData);
 	if (pData == NULL)
 		return NULL;
 
-	pData->nRefs = 1;
-	pData->nDataLength = nLength;
-	pData->nAllocLength = nLength;
-
 	char* pchData = (char*)pData->data();
 	pchData[nLength] = '\0';
 
@@ -9,18 +9,35 @@ SNSBEGIN
     // For an empty string, m_pszData will point here
     // (note: avoids special case of checking for NULL m_pszData)
     // empty string data (and locked)
-    static int _tstr_rgInitData[] = { -1, 0, 0, 0, 0, 0, 0, 0 };
+    struct TStringDataNil
+    {
+        TStringData hdr;
+        wchar_t sz[2];
+    };
+    static TStringDataNil _tstr_initData = { { -1, 0, 0 }, { 0 } };
 
 	TStringData* TStringData::InitDataNil()
 	{
-		static TStringData* _tstr_initDataNil = (TStringData*)&_tstr_rgInitData;
-		return _tstr_initDataNil;
+		return &_tstr_initData.hdr;
 	}
 
 	const void* TStringData::InitPszNil()
 	{
-		static const void* _tstr_initPszNil = (const void*)(((unsigned char*)&_tstr_rgInitData) + sizeof(TStringData));
-		return _tstr_initPszNil;
+		return _tstr_initData.sz;
+	}
+
+	TStringData* TStringData::Alloc(int nLength, int cbChar, TStringData* pOldData)
+	{
+		//短字符串落在soui_mem_wrapper的小块分档里，同一档内增长时原地复用
+		size_t cbNeed = sizeof(TStringData) + (size_t)(nLength + 1) * cbChar;
+		TStringData* pData = (TStringData*)(pOldData ? soui_mem_wrapper::SouiRealloc(pOldData, cbNeed) : soui_mem_wrapper::SouiMalloc(cbNeed, MEM_TAG_STRING));
+		if (pData == NULL)
+			return NULL;
+
+		pData->nRefs = 1;
+		pData->nDataLength = nLength;
+		pData->nAllocLength = (int)((soui_mem_wrapper::SouiMemSize(pData) - sizeof(TStringData)) / cbChar) - 1;
+		return pData;
 	}
 
 	void* TStringData::data() const
@@ -60,14 +77,14 @@ SNSBEGIN
 	void TStringData::Release()
 	{
 		SASSERT(nRefs != 0);
-		if (--nRefs <= 0)
+		if (InterlockedDecrement(&nRefs) <= 0)
 			soui_mem_wrapper::SouiFree(this);
 	}
 
 	void TStringData::AddRef()
 	{
 		SASSERT(nRefs > 0);
-		nRefs++;
+		InterlockedIncrement(&nRefs);
 	}
 
 SNSEND
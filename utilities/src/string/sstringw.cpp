@@ -22,7 +22,7 @@ int wchar_traits::Format(wchar_t** ppszDst, const wchar_t* pszFormat, va_list &
 	if (len <= 0) {
 		return 0;
 	}
-	*ppszDst = (wchar_t*)soui_mem_wrapper::SouiMalloc((len + 1) * sizeof(wchar_t));
+	*ppszDst = (wchar_t*)soui_mem_wrapper::SouiMalloc((len + 1) * sizeof(wchar_t), MEM_TAG_STRING);
 	vswprintf_s(*ppszDst, len + 1, pszFormat, args);
 	return len;
 #else
@@ -54,7 +54,7 @@ int wchar_traits::Format(wchar_t** ppszDst, const wchar_t* pszFormat, va_list &
 	int len = vswprintf_s(stkBuf, 512, fmt, argsCopy);
 	va_end(argsCopy);
 	if (len >= 0) {
-		*ppszDst = (wchar_t*)soui_mem_wrapper::SouiMalloc((len + 1) * sizeof(wchar_t));
+		*ppszDst = (wchar_t*)soui_mem_wrapper::SouiMalloc((len + 1) * sizeof(wchar_t), MEM_TAG_STRING);
 		memcpy(*ppszDst, stkBuf, (len) * sizeof(wchar_t));
 		(*ppszDst)[len] = 0;
 		free(fmt);
@@ -80,7 +80,7 @@ int wchar_traits::Format(wchar_t** ppszDst, const wchar_t* pszFormat, va_list &
 			free(buf);
 			return 0;
 		}
-		*ppszDst = (wchar_t*)soui_mem_wrapper::SouiMalloc((len + 1) * sizeof(wchar_t));
+		*ppszDst = (wchar_t*)soui_mem_wrapper::SouiMalloc((len + 1) * sizeof(wchar_t), MEM_TAG_STRING);
 		memcpy(*ppszDst, buf, len * sizeof(wchar_t));
 		(*ppszDst)[len] = 0;
 		free(buf);
@@ -169,19 +169,10 @@ TStringData* SStringW::AllocData(int nLength, TStringData* pOldData /*= NULL*/)
 	if (nLength == 0)
 		return TStringData::InitDataNil();
 
-	int nSize = sizeof(TStringData) + (nLength + 1) * sizeof(wchar_t);
-	TStringData* pData;
-	if (pOldData == NULL)
-		pData = (TStringData*)soui_mem_wrapper::SouiMalloc(nSize);
-	else
-		pData = (TStringData*)soui_mem_wrapper::SouiRealloc(pOldData, nSize);
+	TStringData* pData = TStringData::Alloc(nLength, sizeof(wchar_t), pOldData);
 	if (pData == NULL)
 		return NULL;
 
-	pData->nRefs = 1;
-	pData->nDataLength = nLength;
-	pData->nAllocLength = nLength;
-
 	wchar_t* pchData = (wchar_t*)pData->data();
 	pchData[nLength] = '\0';
 
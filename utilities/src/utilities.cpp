@@ -318,24 +318,39 @@ HANDLE LoadIconFromMemory(const void* buf, UINT cbSize, BOOL fIcon, int width, i
 
 
 HRGN CreateRegionFromBitmap(HBITMAP hBmp, COLORREF crKey,COLORREF crMask)
+{
+    return CreateRegionFromBitmapRect(hBmp, NULL, crKey, crMask);
+}
+
+HRGN CreateRegionFromBitmapRect(HBITMAP hBmp, LPCRECT prcScan, COLORREF crKey, COLORREF crMask)
 {
     BITMAP bm={0};
     GetObject(hBmp,sizeof(bm),&bm);
     if(bm.bmBitsPixel!=32 || bm.bmBits==0)
         return 0;
+        RECT rcScan = { 0, 0, bm.bmWidth, bm.bmHeight };
+        if (prcScan)
+        {
+            rcScan.left = smax(prcScan->left, 0);
+            rcScan.top = smax(prcScan->top, 0);
+            rcScan.right = smin(prcScan->right, (LONG)bm.bmWidth);
+            rcScan.bottom = smin(prcScan->bottom, (LONG)bm.bmHeight);
+            if (rcScan.left >= rcScan.right || rcScan.top >= rcScan.bottom)
+                return 0;
+        }
             // 获取图像表面的数据指针
-        const COLORREF *bits = (const COLORREF *)bm.bmBits;
+        const COLORREF *bits = (const COLORREF *)bm.bmBits + rcScan.top * bm.bmWidth;
 
         SNS::SArray<RECT> lstRc;
-        for (int y = 0; y < bm.bmHeight; y++, bits += bm.bmWidth)
+        for (int y = rcScan.top; y < rcScan.bottom; y++, bits += bm.bmWidth)
         {
-            int x = 0;
-            while (x < bm.bmWidth)
+            int x = rcScan.left;
+            while (x < rcScan.right)
             {
-                while (x < bm.bmWidth && (bits[x] & crMask) == crKey)
+                while (x < rcScan.right && (bits[x] & crMask) == crKey)
                     x++;
                 int start = x;
-                while (x < bm.bmWidth && (bits[x] & crMask) != crKey)
+                while (x < rcScan.right && (bits[x] & crMask) != crKey)
                     x++;
                 if (start != x)
                 {
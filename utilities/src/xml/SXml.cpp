@@ -645,6 +645,11 @@ void SXmlDoc::SaveBinary(THIS_ FILE *f) SCONST
 	_doc->save_bin(f);
 }
 
+void SXmlDoc::save_bin_flat(FILE *f, int nCharSize) const
+{
+	_doc->save_bin_flat(f,nCharSize);
+}
+
 BOOL SXmlDoc::LoadBufferInplaceOwn(THIS_ void* contents, size_t size, unsigned int options , XmlEncoding encoding)
 {
 	_result = _doc->load_buffer_inplace_own(contents,size,options,(pugi::xml_encoding)encoding);